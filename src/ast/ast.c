@@ -2,17 +2,167 @@
 #include <string.h>
 
 #include "ast/ast.h"
+#include "utils/utils.h"
+
+/* Arena blocks; larger allocations get a block of their own. */
+#define AST_BLOCK_SIZE (32 * 1024)
+#define AST_ALIGN 8
+
+typedef struct AstBlock
+{
+    struct AstBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} AstBlock;
+
+struct AstArena
+{
+    AstBlock *blocks; // newest first; only the newest is allocated from
+    ASTNode **literals; // literal nodes whose values free_ast releases
+    int literal_count;
+    int literal_capacity;
+};
+
+static AstArena *ast_current;
+
+static void *ast_checked(void *ptr)
+{
+    if (!ptr)
+    {
+        log_error("Out of memory while building the syntax tree");
+        exit(1);
+    }
+    return ptr;
+}
+
+AstArena *ast_arena_create(void)
+{
+    return ast_checked(calloc(1, sizeof(AstArena)));
+}
+
+AstArena *ast_arena_enter(AstArena *arena)
+{
+    AstArena *previous = ast_current;
+    ast_current = arena;
+    return previous;
+}
+
+AstArena *ast_arena_of(ASTNode **nodes)
+{
+    return ((AstArena **)nodes)[-1];
+}
+
+static void ast_arena_destroy(AstArena *arena)
+{
+    for (int i = 0; i < arena->literal_count; ++i)
+        free_value(arena->literals[i]->data.lit.literal_value);
+    free(arena->literals);
+    AstBlock *block = arena->blocks;
+    while (block)
+    {
+        AstBlock *next = block->next;
+        free(block);
+        block = next;
+    }
+    free(arena);
+}
+
+static AstArena *ast_arena_current(void)
+{
+    if (!ast_current)
+    {
+        log_error("Syntax tree built outside of a program");
+        exit(1);
+    }
+    return ast_current;
+}
+
+void *ast_alloc(size_t size)
+{
+    AstArena *arena = ast_arena_current();
+    size = (size + AST_ALIGN - 1) & ~(size_t)(AST_ALIGN - 1);
+    AstBlock *block = arena->blocks;
+    if (!block || block->size - block->used < size)
+    {
+        size_t capacity = size > AST_BLOCK_SIZE / 4 ? size : AST_BLOCK_SIZE - sizeof(AstBlock);
+        AstBlock *fresh = ast_checked(malloc(sizeof(AstBlock) + capacity));
+        fresh->used = 0;
+        fresh->size = capacity;
+        /* A dedicated block goes behind the newest so its free space stays usable. */
+        if (block && capacity == size)
+        {
+            fresh->next = block->next;
+            block->next = fresh;
+        }
+        else
+        {
+            fresh->next = block;
+            arena->blocks = fresh;
+        }
+        block = fresh;
+    }
+    void *ptr = block->data + block->used;
+    block->used += size;
+    return ptr;
+}
+
+void *ast_realloc(void *ptr, size_t old_size, size_t new_size)
+{
+    if (ptr)
+    {
+        AstBlock *block = ast_arena_current()->blocks;
+        size_t old_rounded = (old_size + AST_ALIGN - 1) & ~(size_t)(AST_ALIGN - 1);
+        size_t new_rounded = (new_size + AST_ALIGN - 1) & ~(size_t)(AST_ALIGN - 1);
+        if ((char *)ptr + old_rounded == block->data + block->used &&
+            new_rounded <= block->size - block->used + old_rounded)
+        {
+            block->used = block->used - old_rounded + new_rounded;
+            return ptr;
+        }
+    }
+    void *grown = ast_alloc(new_size);
+    if (ptr)
+        memcpy(grown, ptr, old_size < new_size ? old_size : new_size);
+    return grown;
+}
+
+char *ast_strdup(const char *s)
+{
+    size_t len = strlen(s) + 1;
+    return memcpy(ast_alloc(len), s, len);
+}
+
+ASTNode **ast_program(ASTNode **nodes, int count)
+{
+    AstArena **header = ast_alloc(sizeof(AstArena *) + sizeof(ASTNode *) * count);
+    *header = ast_arena_current();
+    ASTNode **program = (ASTNode **)(header + 1);
+    if (count > 0)
+        memcpy(program, nodes, sizeof(ASTNode *) * count);
+    return program;
+}
 
 ASTNode *new_node(NodeType type, int line, int column)
 {
-    ASTNode *n = calloc(1, sizeof(ASTNode));
+    ASTNode *n = ast_alloc(sizeof(ASTNode));
+    memset(n, 0, sizeof(ASTNode));
     n->type = type;
     n->line = line;
     n->column = column;
-    n->is_static = false;
-    n->is_private = false;
-    n->annotations = NULL;
-    n->annotation_count = 0;
+    if (type == NODE_LITERAL)
+    {
+        /* Literals start out undefined; free_ast releases whatever value
+           they hold by then. */
+        AstArena *arena = ast_current;
+        if (arena->literal_count == arena->literal_capacity)
+        {
+            arena->literal_capacity = arena->literal_capacity ? arena->literal_capacity * 2 : 64;
+            arena->literals = ast_checked(realloc(arena->literals, sizeof(ASTNode *) * arena->literal_capacity));
+        }
+        arena->literals[arena->literal_count++] = n;
+        n->data.lit.literal_value = UNDEFINED_VAL;
+    }
     return n;
 }
 
@@ -45,7 +195,7 @@ ASTNode *new_func_call_node(ASTNode *callee)
     ASTNode *n = new_node(NODE_FUNC_CALL, callee->line, callee->column);
     n->data.call.func_callee = callee;
     if (callee->type == NODE_VAR)
-        n->data.call.func_name = strdup(callee->data.set.set_name);
+        n->data.call.func_name = ast_strdup(callee->data.set.set_name);
     else
         n->data.call.func_name = NULL;
     return n;
@@ -104,110 +254,20 @@ ASTNode *new_index_node(bool is_slice, bool has_start, bool has_end, int line, i
 
 void add_child(ASTNode *parent, ASTNode *child)
 {
-    parent->children = realloc(parent->children, sizeof(ASTNode *) * (parent->child_count + 1));
-    parent->children[parent->child_count++] = child;
-}
-
-static void free_node(ASTNode *n)
-{
-    if (!n)
-        return;
-
-    if (n->type == NODE_SET)
+    /* Child arrays hold a power of two slots, at least two, so one is full
+       exactly when its count is a power of two. */
+    int count = parent->child_count;
+    if (count == 0 || (count >= 2 && (count & (count - 1)) == 0))
     {
-        free(n->data.set.set_name);
-        if (n->data.set.set_attr)
-            free_node(n->data.set.set_attr);
+        int capacity = count ? count * 2 : 2;
+        parent->children = ast_realloc(parent->children, sizeof(ASTNode *) * count,
+                                       sizeof(ASTNode *) * capacity);
     }
-
-    if (n->type == NODE_LITERAL)
-    {
-        free_value(n->data.lit.literal_value);
-    }
-
-    if (n->type == NODE_FUNC_CALL)
-    {
-        free(n->data.call.func_name);
-        if (n->data.call.func_callee)
-            free_node(n->data.call.func_callee);
-    }
-
-    if (n->type == NODE_ATTR_ACCESS)
-    {
-        free(n->data.attr.object_name);
-        free(n->data.attr.attr_name);
-    }
-
-    if (n->type == NODE_CLASS_DEF)
-    {
-        free(n->data.cls.class_name);
-        for (int i = 0; i < n->data.cls.base_count; ++i)
-            free(n->data.cls.base_names[i]);
-        free(n->data.cls.base_names);
-    }
-
-    if (n->type == NODE_METHOD_DEF)
-    {
-        free(n->data.method.method_name);
-        for (int i = 0; i < n->data.method.param_count; ++i)
-            free(n->data.method.params[i]);
-        free(n->data.method.params);
-    }
-
-    if (n->type == NODE_FOR)
-    {
-        free(n->data.loop.loop_var);
-    }
-    if (n->type == NODE_IMPORT_MODULE)
-    {
-        free(n->data.import_module.module_name);
-    }
-    if (n->type == NODE_IMPORT_NAMES)
-    {
-        free(n->data.import_names.module_name);
-        for (int i = 0; i < n->data.import_names.name_count; ++i)
-            free(n->data.import_names.names[i]);
-        free(n->data.import_names.names);
-    }
-
-    if (n->type == NODE_OBJECT_LITERAL)
-    {
-        for (int i = 0; i < n->data.object.pair_count; ++i)
-        {
-            free(n->data.object.keys[i]);
-            free_node(n->data.object.values[i]);
-        }
-        free(n->data.object.keys);
-        free(n->data.object.values);
-    }
-
-    for (int i = 0; i < n->annotation_count; ++i)
-    {
-        Annotation *ann = n->annotations[i];
-        if (!ann)
-            continue;
-        free(ann->name);
-        for (int j = 0; j < ann->arg_count; ++j)
-            free_node(ann->args[j]);
-        free(ann->args);
-        free(ann);
-    }
-    free(n->annotations);
-
-    // Free any children (used for all types with nested structure)
-    for (int i = 0; i < n->child_count; ++i)
-    {
-        free_node(n->children[i]);
-    }
-
-    free(n->children);
-    free(n);
+    parent->children[parent->child_count++] = child;
 }
 
 void free_ast(ASTNode **nodes, int count)
 {
-    for (int i = 0; i < count; i++)
-        free_node(nodes[i]);
-
-    free(nodes);
-}
\ No newline at end of file
+    (void)count;
+    ast_arena_destroy(ast_arena_of(nodes));
+}
@@ -2,6 +2,8 @@
 #define AST_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "types/value.h"
 #include "lexer/lexer.h"
@@ -67,18 +69,20 @@ typedef struct Annotation
     int column;
 } Annotation;
 
+/* Most annotations one statement may carry. */
+#define AST_MAX_ANNOTATIONS UINT16_MAX
+
 typedef struct ASTNode
 {
-    NodeType type;
-
-    // Common
-    int line, column;
+    // Common, ordered so the header packs into 32 bytes
     struct ASTNode **children;
-    int child_count;
     Annotation **annotations;
-    int annotation_count;
-    bool is_static;
-    bool is_private;
+    int line, column;
+    int child_count;
+    NodeType type : 8;
+    bool is_static : 1;
+    bool is_private : 1;
+    uint16_t annotation_count;
 
     // Node-specific data
     union
@@ -167,6 +171,35 @@ typedef struct ASTNode
 
 } ASTNode;
 
+/*
+ * A parsed program lives in one AstArena. Its nodes, child arrays,
+ * annotations and identifier strings are bump-allocated from the arena,
+ * and the values held by literal nodes are recorded in it, so free_ast
+ * releases the whole program at once. Nodes are never freed one by one;
+ * the optimizer just drops the ones it replaces.
+ *
+ * The helpers below allocate from the arena made current by
+ * ast_arena_enter. parse_program and optimize_program enter the program's
+ * arena for their duration, so a module imported while another program
+ * runs gets an arena of its own.
+ */
+typedef struct AstArena AstArena;
+
+AstArena *ast_arena_create(void);
+/* Make `arena` (or NULL) current; returns the arena that was. */
+AstArena *ast_arena_enter(AstArena *arena);
+/* The arena of a program array returned by ast_program. */
+AstArena *ast_arena_of(ASTNode **nodes);
+
+/* Memory from the current arena, aligned for any AST field. */
+void *ast_alloc(size_t size);
+/* Resize `ptr`, `old_size` bytes long, growing in place when it was the
+   arena's last allocation. */
+void *ast_realloc(void *ptr, size_t old_size, size_t new_size);
+char *ast_strdup(const char *s);
+/* Copy the top-level statements into an array free_ast can release. */
+ASTNode **ast_program(ASTNode **nodes, int count);
+
 /* Helpers */
 ASTNode *new_node(NodeType type, int line, int column);
 ASTNode *new_var_node(char *name, int line, int column);
@@ -184,7 +217,7 @@ ASTNode *new_ternary_node(struct ASTNode *cond, struct ASTNode *true_expr,
 ASTNode *new_index_node(bool is_slice, bool has_start, bool has_end, int line, int column);
 void add_child(ASTNode *parent, ASTNode *child);
 
-/* Cleanup */
+/* Cleanup: release the arena of a program returned by ast_program. */
 void free_ast(ASTNode **nodes, int count);
 
 #endif
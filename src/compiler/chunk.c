@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler/chunk.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+#define CHUNK_MAX_INDEX 0xFFFF
+
+static const char *opcode_names[] = {
+#define ABLE_OPCODE_NAME(name) #name,
+    ABLE_OPCODES(ABLE_OPCODE_NAME)
+#undef ABLE_OPCODE_NAME
+};
+
+Chunk *chunk_create(const char *name)
+{
+    Chunk *chunk = calloc(1, sizeof(Chunk));
+    if (!chunk)
+    {
+        log_error("Out of memory while creating chunk");
+        exit(1);
+    }
+    chunk->name = strdup(name ? name : "<script>");
+    return chunk;
+}
+
+static void free_names(char **names, int count)
+{
+    for (int i = 0; i < count; ++i)
+        free(names[i]);
+    free(names);
+}
+
+void chunk_free(Chunk *chunk)
+{
+    if (!chunk)
+        return;
+
+    free(chunk->name);
+    free(chunk->code);
+    free(chunk->lines);
+    free(chunk->columns);
+
+    for (int i = 0; i < chunk->constant_count; ++i)
+        free_value(chunk->constants[i]);
+    free(chunk->constants);
+
+    free(chunk->names);
+
+    for (int i = 0; i < chunk->class_count; ++i)
+    {
+        free(chunk->classes[i].name);
+        free_names(chunk->classes[i].base_names, chunk->classes[i].base_count);
+    }
+    free(chunk->classes);
+
+    for (int i = 0; i < chunk->layout_count; ++i)
+        free(chunk->layouts[i].slots);
+    free(chunk->layouts);
+
+    for (int i = 0; i < chunk->site_count; ++i)
+    {
+        AnnotationSite *site = &chunk->sites[i];
+        for (int u = 0; u < site->use_count; ++u)
+            free(site->uses[u].name);
+        free(site->uses);
+    }
+    free(chunk->sites);
+    free(chunk->caches);
+    free(chunk->upvalues);
+
+    free(chunk);
+}
+
+void chunk_write(Chunk *chunk, uint8_t byte, int line, int column)
+{
+    if (chunk->count == chunk->capacity)
+    {
+        chunk->capacity = chunk->capacity ? chunk->capacity * 2 : 64;
+        chunk->code = realloc(chunk->code, chunk->capacity);
+        chunk->lines = realloc(chunk->lines, sizeof(int) * chunk->capacity);
+        chunk->columns = realloc(chunk->columns, sizeof(int) * chunk->capacity);
+        if (!chunk->code || !chunk->lines || !chunk->columns)
+        {
+            log_error("Out of memory while emitting bytecode");
+            exit(1);
+        }
+    }
+    chunk->code[chunk->count] = byte;
+    chunk->lines[chunk->count] = line;
+    chunk->columns[chunk->count] = column;
+    chunk->count++;
+}
+
+static void check_index(int index, const char *what)
+{
+    if (index > CHUNK_MAX_INDEX)
+    {
+        log_error("Too many %s in one function", what);
+        exit(1);
+    }
+}
+
+int chunk_add_constant(Chunk *chunk, Value value)
+{
+    if (chunk->constant_count == chunk->constant_capacity)
+    {
+        chunk->constant_capacity = chunk->constant_capacity ? chunk->constant_capacity * 2 : 8;
+        chunk->constants = realloc(chunk->constants, sizeof(Value) * chunk->constant_capacity);
+    }
+    chunk->constants[chunk->constant_count] = value;
+    check_index(chunk->constant_count, "constants");
+    return chunk->constant_count++;
+}
+
+int chunk_add_name(Chunk *chunk, const char *name)
+{
+    const char *atom = intern(name);
+    for (int i = 0; i < chunk->name_count; ++i)
+    {
+        if (chunk->names[i] == atom)
+            return i;
+    }
+    if (chunk->name_count == chunk->name_capacity)
+    {
+        chunk->name_capacity = chunk->name_capacity ? chunk->name_capacity * 2 : 8;
+        chunk->names = realloc(chunk->names, sizeof(char *) * chunk->name_capacity);
+    }
+    chunk->names[chunk->name_count] = atom;
+    check_index(chunk->name_count, "names");
+    return chunk->name_count++;
+}
+
+int chunk_add_class(Chunk *chunk, ClassInfo info)
+{
+    chunk->classes = realloc(chunk->classes, sizeof(ClassInfo) * (chunk->class_count + 1));
+    chunk->classes[chunk->class_count] = info;
+    check_index(chunk->class_count, "classes");
+    return chunk->class_count++;
+}
+
+int chunk_add_layout(Chunk *chunk, ObjectLayout layout)
+{
+    chunk->layouts = realloc(chunk->layouts, sizeof(ObjectLayout) * (chunk->layout_count + 1));
+    chunk->layouts[chunk->layout_count] = layout;
+    check_index(chunk->layout_count, "object literals");
+    return chunk->layout_count++;
+}
+
+int chunk_add_site(Chunk *chunk, AnnotationSite site)
+{
+    chunk->sites = realloc(chunk->sites, sizeof(AnnotationSite) * (chunk->site_count + 1));
+    chunk->sites[chunk->site_count] = site;
+    check_index(chunk->site_count, "annotation sites");
+    return chunk->site_count++;
+}
+
+int chunk_add_cache(Chunk *chunk)
+{
+    chunk->caches = realloc(chunk->caches, sizeof(AttrCache) * (chunk->cache_count + 1));
+    memset(&chunk->caches[chunk->cache_count], 0, sizeof(AttrCache));
+    check_index(chunk->cache_count, "attribute sites");
+    return chunk->cache_count++;
+}
+
+int chunk_add_upvalue(Chunk *chunk, UpvalueDesc desc)
+{
+    for (int i = 0; i < chunk->upvalue_count; ++i)
+    {
+        if (chunk->upvalues[i].is_local == desc.is_local && chunk->upvalues[i].index == desc.index)
+            return i;
+    }
+    chunk->upvalues = realloc(chunk->upvalues, sizeof(UpvalueDesc) * (chunk->upvalue_count + 1));
+    chunk->upvalues[chunk->upvalue_count] = desc;
+    check_index(chunk->upvalue_count, "captured variables");
+    return chunk->upvalue_count++;
+}
+
+const char *opcode_name(OpCode op)
+{
+    if (op >= BC_COUNT)
+        return "BC_UNKNOWN";
+    return opcode_names[op];
+}
+
+int opcode_length(const Chunk *chunk, int offset)
+{
+    switch ((OpCode)chunk->code[offset])
+    {
+    case BC_CONSTANT:
+    case BC_GET_GLOBAL:
+    case BC_SET_GLOBAL:
+    case BC_SET_PRIVATE:
+    case BC_GET_LOCAL:
+    case BC_SET_LOCAL:
+    case BC_GET_UPVALUE:
+    case BC_SET_UPVALUE:
+    case BC_JUMP:
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+    case BC_LOOP:
+    case BC_FOR_ITER:
+    case BC_CLOSURE:
+    case BC_OBJECT:
+    case BC_CLASS:
+    case BC_ANNOTATE:
+    case BC_IMPORT:
+        return 3;
+    case BC_SLICE:
+    case BC_CALL:
+    case BC_TAIL_CALL:
+        return 2;
+    case BC_METHOD:
+        return 4;
+    case BC_IMPORT_FROM:
+        return 5;
+    case BC_GET_ATTR:
+    case BC_GET_ATTR_FOR_SET:
+    case BC_SET_ATTR:
+        return 7;
+    case BC_INVOKE:
+    case BC_TAIL_INVOKE:
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+void chunk_disassemble(const Chunk *chunk)
+{
+    printf("== %s ==\n", chunk->name);
+    for (int offset = 0; offset < chunk->count;)
+    {
+        int length = opcode_length(chunk, offset);
+        printf("%04d %4d %-22s", offset, chunk->lines[offset], opcode_name(chunk->code[offset]));
+        for (int i = 1; i < length; ++i)
+            printf(" %02x", chunk->code[offset + i]);
+        printf("\n");
+        offset += length;
+    }
+}
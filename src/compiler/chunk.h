@@ -0,0 +1,209 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "types/value.h"
+#include "interpreter/annotations.h"
+#include "interpreter/attr.h"
+
+/*
+ * Opcode table. Operands follow the opcode byte in the listed order;
+ * u16 operands are stored big-endian. The X-macro keeps the enum, the
+ * disassembler names and the VM dispatch table in sync.
+ */
+#define ABLE_OPCODES(X)        \
+    X(BC_CONSTANT)        /* u16 const                 -> value      */ \
+    X(BC_UNDEFINED)       /*                           -> undefined  */ \
+    X(BC_NULL)            /*                           -> null       */ \
+    X(BC_TRUE)            /*                           -> true       */ \
+    X(BC_FALSE)           /*                           -> false      */ \
+    X(BC_POP)             /* value                     ->            */ \
+    X(BC_GET_GLOBAL)      /* u16 name                  -> value      */ \
+    X(BC_SET_GLOBAL)      /* u16 name         value    ->            */ \
+    X(BC_SET_PRIVATE)     /* u16 name         value    ->            */ \
+    X(BC_GET_LOCAL)       /* u16 slot                  -> value      */ \
+    X(BC_SET_LOCAL)       /* u16 slot         value    ->            */ \
+    X(BC_GET_UPVALUE)     /* u16 upvalue               -> value      */ \
+    X(BC_SET_UPVALUE)     /* u16 upvalue      value    ->            */ \
+    X(BC_GET_ATTR)        /* u16 name u16 recv u16 cache  recv -> value */ \
+    X(BC_GET_ATTR_FOR_SET)/* u16 name u16 recv u16 cache  recv -> value */ \
+    X(BC_SET_ATTR)        /* u16 name u16 recv u16 cache  value recv -> */ \
+    X(BC_INDEX)           /*             coll index    -> item       */ \
+    X(BC_SLICE)           /* u8 flags  coll [lo] [hi]  -> list       */ \
+    X(BC_ADD)                                                          \
+    X(BC_SUB)                                                          \
+    X(BC_MUL)                                                          \
+    X(BC_DIV)                                                          \
+    X(BC_MOD)                                                          \
+    X(BC_EQ)                                                           \
+    X(BC_STRICT_EQ)                                                    \
+    X(BC_LT)                                                           \
+    X(BC_GT)                                                           \
+    X(BC_LTE)                                                          \
+    X(BC_GTE)             /*             left right    -> result     */ \
+    /* Quickened forms of the operators above. The compiler never emits \
+       these; the VM rewrites a generic operator into one after seeing \
+       its operand types, and back when the types change. */           \
+    X(BC_ADD_INT)                                                      \
+    X(BC_ADD_NUM)                                                      \
+    X(BC_ADD_STR)                                                      \
+    X(BC_SUB_INT)                                                      \
+    X(BC_SUB_NUM)                                                      \
+    X(BC_MUL_INT)                                                      \
+    X(BC_MUL_NUM)                                                      \
+    X(BC_DIV_NUM)                                                      \
+    X(BC_EQ_INT)                                                       \
+    X(BC_EQ_NUM)                                                       \
+    X(BC_EQ_STR)                                                       \
+    X(BC_LT_INT)                                                       \
+    X(BC_LT_NUM)                                                       \
+    X(BC_LT_STR)                                                       \
+    X(BC_GT_INT)                                                       \
+    X(BC_GT_NUM)                                                       \
+    X(BC_GT_STR)                                                       \
+    X(BC_LTE_INT)                                                      \
+    X(BC_LTE_NUM)                                                      \
+    X(BC_LTE_STR)                                                      \
+    X(BC_GTE_INT)                                                      \
+    X(BC_GTE_NUM)                                                      \
+    X(BC_GTE_STR)         /*             left right    -> result     */ \
+    X(BC_NOT)             /* value                     -> bool       */ \
+    X(BC_TO_BOOL)         /* value                     -> bool       */ \
+    X(BC_INCREMENT)       /* number                    -> old new    */ \
+    X(BC_JUMP)            /* u16 offset                              */ \
+    X(BC_JUMP_IF_FALSE)   /* u16 offset       cond     ->            */ \
+    X(BC_JUMP_IF_TRUE)    /* u16 offset       cond     ->            */ \
+    X(BC_LOOP)            /* u16 offset (backwards)                  */ \
+    X(BC_ITER_INIT)       /* iterable                  -> state idx  */ \
+    X(BC_FOR_ITER)        /* u16 exit  state idx -> state idx item   */ \
+    X(BC_CALL)            /* u8 argc    callee args    -> result     */ \
+    X(BC_INVOKE)          /* u16 name u16 recv u8 argc u16 cache  recv args -> result */ \
+    X(BC_TAIL_CALL)       /* as BC_CALL, directly before BC_RETURN     */ \
+    X(BC_TAIL_INVOKE)     /* as BC_INVOKE, directly before BC_RETURN   */ \
+    X(BC_CLOSURE)         /* u16 const                 -> function   */ \
+    X(BC_OBJECT)          /* u16 layout     values     -> object     */ \
+    X(BC_AWAIT)           /* value                     -> resolved   */ \
+    X(BC_CLASS)           /* u16 class        bases    -> type       */ \
+    X(BC_METHOD)          /* u16 name u8 static type fn -> type      */ \
+    X(BC_ANNOTATE)        /* u16 site      value args  -> [value]    */ \
+    X(BC_IMPORT)          /* u16 module                -> module     */ \
+    X(BC_IMPORT_FROM)     /* u16 module u16 name       -> value      */ \
+    X(BC_RETURN)          /* value                                   */
+
+typedef enum
+{
+#define ABLE_OPCODE_ENUM(name) name,
+    ABLE_OPCODES(ABLE_OPCODE_ENUM)
+#undef ABLE_OPCODE_ENUM
+    BC_COUNT
+} OpCode;
+
+/* `recv` operands name the receiver for error messages; the flag marks
+ * an intermediate attribute rather than a variable. */
+#define RECV_INTERMEDIATE 0x8000
+
+/* BC_SLICE flags */
+#define SLICE_HAS_START 0x1
+#define SLICE_HAS_END 0x2
+
+typedef struct
+{
+    char *name;
+    char **base_names;
+    int base_count;
+} ClassInfo;
+
+/* An object literal, shaped at compile time: value i of the literal goes
+   into slot slots[i] of an object created with `shape`. Repeated keys
+   share a slot, so the last one wins. */
+typedef struct
+{
+    struct Shape *shape;
+    int *slots;
+    int key_count;
+} ObjectLayout;
+
+/* How a closure captures one variable of the function that creates it:
+ * a slot of the creating frame, or one of the creator's own upvalues. */
+typedef struct
+{
+    bool is_local;
+    uint16_t index;
+} UpvalueDesc;
+
+typedef enum
+{
+    ANNOTATION_SITE_ASSIGNMENT, /* target type depends on the runtime value */
+    ANNOTATION_SITE_METHOD,
+    ANNOTATION_SITE_CLASS
+} AnnotationSiteKind;
+
+typedef struct
+{
+    AnnotationSiteKind kind;
+    AnnotationUse *uses;
+    int use_count;
+    int arg_count;      /* total evaluated arguments on the stack */
+    const char *target_name; /* interned */
+    const char *store_name;  /* interned; NULL leaves the value on the stack */
+    bool is_private;
+} AnnotationSite;
+
+typedef struct Chunk
+{
+    char *name;
+
+    uint8_t *code;
+    int *lines;
+    int *columns;
+    int count;
+    int capacity;
+
+    Value *constants;
+    int constant_count;
+    int constant_capacity;
+
+    const char **names; /* interned */
+    int name_count;
+    int name_capacity;
+
+    ClassInfo *classes;
+    int class_count;
+
+    ObjectLayout *layouts;
+    int layout_count;
+
+    AnnotationSite *sites;
+    int site_count;
+
+    AttrCache *caches; /* one per attribute or invoke site */
+    int cache_count;
+
+    UpvalueDesc *upvalues;
+    int upvalue_count;
+
+    int local_count;    /* frame slots, parameters first */
+    int max_stack;      /* operand stack depth above the slots */
+
+    uint32_t hotness;   /* calls and loop back-edges, for the JIT */
+    struct JitCode *jit; /* native code once compiled (see jit.h) */
+    bool jit_rejected;  /* not translatable, or bailed out too often */
+} Chunk;
+
+Chunk *chunk_create(const char *name);
+void chunk_free(Chunk *chunk);
+void chunk_write(Chunk *chunk, uint8_t byte, int line, int column);
+int chunk_add_constant(Chunk *chunk, Value value);
+int chunk_add_name(Chunk *chunk, const char *name);
+int chunk_add_class(Chunk *chunk, ClassInfo info);
+int chunk_add_layout(Chunk *chunk, ObjectLayout layout);
+int chunk_add_site(Chunk *chunk, AnnotationSite site);
+int chunk_add_cache(Chunk *chunk);
+int chunk_add_upvalue(Chunk *chunk, UpvalueDesc desc);
+const char *opcode_name(OpCode op);
+int opcode_length(const Chunk *chunk, int offset);
+void chunk_disassemble(const Chunk *chunk);
+
+#endif
@@ -0,0 +1,938 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler/compiler.h"
+#include "types/shape.h"
+#include "types/value.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+#define MAX_CALL_ARGS 255
+#define MAX_JUMP 0xFFFF
+
+typedef struct LoopContext
+{
+    int continue_target;
+    int *break_jumps;
+    int break_count;
+    int break_capacity;
+    struct LoopContext *enclosing;
+} LoopContext;
+
+typedef struct NameList
+{
+    const char **items;
+    int count;
+    int capacity;
+} NameList;
+
+typedef struct Compiler
+{
+    Chunk *chunk;
+    int depth;
+    LoopContext *loop;
+    struct Compiler *enclosing; /* enclosing function, NULL at module level */
+    const NameList *globals;    /* names assigned at module level */
+    bool is_function;
+    NameList slots;             /* parameters, then function locals */
+} Compiler;
+
+typedef enum
+{
+    VAR_GLOBAL,
+    VAR_LOCAL,
+    VAR_UPVALUE
+} VarKind;
+
+typedef struct
+{
+    VarKind kind;
+    int index;
+} VarRef;
+
+static void compile_expr(Compiler *c, ASTNode *n);
+static void compile_stmt(Compiler *c, ASTNode *n);
+static void compile_block(Compiler *c, ASTNode **nodes, int count);
+static void compile_function(Compiler *enclosing, Function *fn);
+
+/* --- emission helpers --- */
+
+static void emit_byte(Compiler *c, uint8_t byte, int line, int column)
+{
+    chunk_write(c->chunk, byte, line, column);
+}
+
+static void emit_u16(Compiler *c, int value, int line, int column)
+{
+    emit_byte(c, (uint8_t)((value >> 8) & 0xFF), line, column);
+    emit_byte(c, (uint8_t)(value & 0xFF), line, column);
+}
+
+/* Emit an opcode and account for its effect on the operand stack depth. */
+static void emit_op(Compiler *c, OpCode op, int stack_effect, int line, int column)
+{
+    emit_byte(c, (uint8_t)op, line, column);
+    c->depth += stack_effect;
+    if (c->depth > c->chunk->max_stack)
+        c->chunk->max_stack = c->depth;
+}
+
+static void emit_op_u16(Compiler *c, OpCode op, int operand, int stack_effect, int line, int column)
+{
+    emit_op(c, op, stack_effect, line, column);
+    emit_u16(c, operand, line, column);
+}
+
+static int emit_jump(Compiler *c, OpCode op, int stack_effect, int line, int column)
+{
+    emit_op(c, op, stack_effect, line, column);
+    emit_u16(c, 0xFFFF, line, column);
+    return c->chunk->count - 2;
+}
+
+static void patch_jump(Compiler *c, int operand_offset)
+{
+    int jump = c->chunk->count - (operand_offset + 2);
+    if (jump > MAX_JUMP)
+    {
+        log_script_error(c->chunk->lines[operand_offset], c->chunk->columns[operand_offset],
+                         "Too much code to jump over");
+        exit(1);
+    }
+    c->chunk->code[operand_offset] = (uint8_t)((jump >> 8) & 0xFF);
+    c->chunk->code[operand_offset + 1] = (uint8_t)(jump & 0xFF);
+}
+
+static void emit_loop(Compiler *c, int target, int line, int column)
+{
+    emit_op(c, BC_LOOP, 0, line, column);
+    int offset = c->chunk->count - target + 2;
+    if (offset > MAX_JUMP)
+    {
+        log_script_error(line, column, "Loop body too large");
+        exit(1);
+    }
+    emit_u16(c, offset, line, column);
+}
+
+static int name_index(Compiler *c, const char *name)
+{
+    return chunk_add_name(c->chunk, name);
+}
+
+static int recv_operand(Compiler *c, const char *name, bool intermediate, int line, int column)
+{
+    int idx = name_index(c, name);
+    if (idx >= RECV_INTERMEDIATE)
+    {
+        log_script_error(line, column, "Too many names in one function");
+        exit(1);
+    }
+    return intermediate ? (idx | RECV_INTERMEDIATE) : idx;
+}
+
+/* --- variable resolution --- */
+
+static int namelist_find(const NameList *list, const char *name)
+{
+    for (int i = 0; i < list->count; ++i)
+    {
+        if (strcmp(list->items[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+static void namelist_push(NameList *list, const char *name)
+{
+    if (list->count == list->capacity)
+    {
+        list->capacity = list->capacity ? list->capacity * 2 : 8;
+        list->items = realloc(list->items, sizeof(char *) * list->capacity);
+    }
+    list->items[list->count++] = name;
+}
+
+static void namelist_add(NameList *list, const char *name)
+{
+    if (namelist_find(list, name) < 0)
+        namelist_push(list, name);
+}
+
+/*
+ * Collect the names a statement list assigns, looking through nested
+ * blocks but not into nested functions or methods. These are the names
+ * the function (or module) itself declares.
+ */
+static void collect_declarations(ASTNode **nodes, int count, NameList *out)
+{
+    for (int i = 0; i < count; ++i)
+    {
+        ASTNode *n = nodes[i];
+        switch (n->type)
+        {
+        case NODE_SET:
+            if (!n->data.set.set_attr)
+                namelist_add(out, n->data.set.set_name);
+            break;
+        case NODE_CLASS_DEF:
+            namelist_add(out, n->data.cls.class_name);
+            break;
+        case NODE_FOR:
+            namelist_add(out, n->data.loop.loop_var);
+            collect_declarations(n->children[1]->children, n->children[1]->child_count, out);
+            break;
+        case NODE_WHILE:
+            collect_declarations(n->children[1]->children, n->children[1]->child_count, out);
+            break;
+        case NODE_IF:
+            collect_declarations(&n->children[1], n->child_count - 1, out);
+            break;
+        case NODE_BLOCK:
+            collect_declarations(n->children, n->child_count, out);
+            break;
+        case NODE_IMPORT_MODULE:
+            namelist_add(out, n->data.import_module.module_name);
+            break;
+        case NODE_IMPORT_NAMES:
+            for (int k = 0; k < n->data.import_names.name_count; ++k)
+                namelist_add(out, n->data.import_names.names[k]);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+static bool declared_in_enclosing(Compiler *c, const char *name)
+{
+    for (Compiler *e = c->enclosing; e; e = e->enclosing)
+    {
+        if (namelist_find(&e->slots, name) >= 0)
+            return true;
+    }
+    return false;
+}
+
+static int resolve_upvalue(Compiler *c, const char *name)
+{
+    if (!c->enclosing)
+        return -1;
+    int slot = namelist_find(&c->enclosing->slots, name);
+    if (slot >= 0)
+        return chunk_add_upvalue(c->chunk, (UpvalueDesc){.is_local = true, .index = (uint16_t)slot});
+    int up = resolve_upvalue(c->enclosing, name);
+    if (up >= 0)
+        return chunk_add_upvalue(c->chunk, (UpvalueDesc){.is_local = false, .index = (uint16_t)up});
+    return -1;
+}
+
+/*
+ * Inside a function, parameters and the names it assigns live in frame
+ * slots, and names owned by an enclosing function are captured as
+ * upvalues. Everything else, including assignments to names the module
+ * declares, goes through the module's environment by name.
+ */
+static VarRef resolve_variable(Compiler *c, const char *name)
+{
+    VarRef ref = {.kind = VAR_GLOBAL};
+    if (c->is_function)
+    {
+        ref.index = namelist_find(&c->slots, name);
+        if (ref.index >= 0)
+        {
+            ref.kind = VAR_LOCAL;
+            return ref;
+        }
+        ref.index = resolve_upvalue(c, name);
+        if (ref.index >= 0)
+        {
+            ref.kind = VAR_UPVALUE;
+            return ref;
+        }
+    }
+    ref.index = name_index(c, name);
+    return ref;
+}
+
+static void emit_load(Compiler *c, const char *name, int line, int column)
+{
+    VarRef ref = resolve_variable(c, name);
+    static const OpCode loads[] = {[VAR_GLOBAL] = BC_GET_GLOBAL, [VAR_LOCAL] = BC_GET_LOCAL,
+                                   [VAR_UPVALUE] = BC_GET_UPVALUE};
+    emit_op_u16(c, loads[ref.kind], ref.index, 1, line, column);
+}
+
+static void emit_store(Compiler *c, VarRef ref, bool is_private, int line, int column)
+{
+    OpCode op = BC_SET_GLOBAL;
+    if (ref.kind == VAR_LOCAL)
+        op = BC_SET_LOCAL;
+    else if (ref.kind == VAR_UPVALUE)
+        op = BC_SET_UPVALUE;
+    else if (is_private)
+        op = BC_SET_PRIVATE;
+    emit_op_u16(c, op, ref.index, -1, line, column);
+}
+
+static void check_arg_count(int count, int line, int column)
+{
+    if (count > MAX_CALL_ARGS)
+    {
+        log_script_error(line, column, "Too many arguments in call (max %d)", MAX_CALL_ARGS);
+        exit(1);
+    }
+}
+
+/* --- attribute chains --- */
+
+static const char *segment_name(ASTNode *attr, int i)
+{
+    return attr->children[i]->data.attr.attr_name;
+}
+
+/*
+ * Push the receiver that owns segment `upto` of an attribute chain: the
+ * base variable followed by segments [0, upto). When `for_set` is true,
+ * missing intermediates are created as empty objects.
+ */
+static void compile_chain_receiver(Compiler *c, ASTNode *attr, int upto, bool for_set)
+{
+    emit_load(c, attr->data.attr.object_name, attr->line, attr->column);
+    for (int i = 0; i < upto; ++i)
+    {
+        ASTNode *seg = attr->children[i];
+        int recv = i == 0 ? recv_operand(c, attr->data.attr.object_name, false, attr->line, attr->column)
+                          : recv_operand(c, segment_name(attr, i - 1), true, attr->line, attr->column);
+        int line = i == 0 ? attr->line : attr->children[i - 1]->line;
+        int column = i == 0 ? attr->column : attr->children[i - 1]->column;
+        emit_op_u16(c, for_set ? BC_GET_ATTR_FOR_SET : BC_GET_ATTR, name_index(c, seg->data.attr.attr_name),
+                    0, line, column);
+        emit_u16(c, recv, line, column);
+        emit_u16(c, chunk_add_cache(c->chunk), line, column);
+    }
+}
+
+static int chain_recv_operand(Compiler *c, ASTNode *attr, int upto)
+{
+    if (upto == 0)
+        return recv_operand(c, attr->data.attr.object_name, false, attr->line, attr->column);
+    return recv_operand(c, segment_name(attr, upto - 1), true, attr->line, attr->column);
+}
+
+static void compile_attr_read(Compiler *c, ASTNode *attr)
+{
+    compile_chain_receiver(c, attr, attr->child_count - 1, false);
+    int last = attr->child_count - 1;
+    int line = last == 0 ? attr->line : attr->children[last - 1]->line;
+    int column = last == 0 ? attr->column : attr->children[last - 1]->column;
+    int recv = chain_recv_operand(c, attr, last);
+    emit_op_u16(c, BC_GET_ATTR, name_index(c, segment_name(attr, last)), 0, line, column);
+    emit_u16(c, recv, line, column);
+    emit_u16(c, chunk_add_cache(c->chunk), line, column);
+}
+
+/* Stack: [value] -> [] */
+static void compile_attr_store(Compiler *c, ASTNode *attr)
+{
+    int last = attr->child_count - 1;
+    compile_chain_receiver(c, attr, last, true);
+    int recv = chain_recv_operand(c, attr, last);
+    emit_op_u16(c, BC_SET_ATTR, name_index(c, segment_name(attr, last)), -2, attr->line, attr->column);
+    emit_u16(c, recv, attr->line, attr->column);
+    emit_u16(c, chunk_add_cache(c->chunk), attr->line, attr->column);
+}
+
+/* --- expressions --- */
+
+static void compile_literal(Compiler *c, ASTNode *n)
+{
+    Value *lit = &n->data.lit.literal_value;
+    switch (value_type(*lit))
+    {
+    case VAL_UNDEFINED:
+        emit_op(c, BC_UNDEFINED, 1, n->line, n->column);
+        return;
+    case VAL_NULL:
+        emit_op(c, BC_NULL, 1, n->line, n->column);
+        return;
+    case VAL_BOOL:
+        emit_op(c, AS_BOOL(*lit) ? BC_TRUE : BC_FALSE, 1, n->line, n->column);
+        return;
+    case VAL_FUNCTION:
+    {
+        compile_function(c, AS_FUNCTION(*lit));
+        int idx = chunk_add_constant(c->chunk, *lit);
+        emit_op_u16(c, BC_CLOSURE, idx, 1, n->line, n->column);
+        return;
+    }
+    default:
+    {
+        int idx = chunk_add_constant(c->chunk, clone_value(lit));
+        emit_op_u16(c, BC_CONSTANT, idx, 1, n->line, n->column);
+        return;
+    }
+    }
+}
+
+static void compile_args(Compiler *c, ASTNode *call)
+{
+    check_arg_count(call->child_count, call->line, call->column);
+    for (int i = 0; i < call->child_count; ++i)
+        compile_expr(c, call->children[i]);
+}
+
+/* `tail` marks a call whose result the function returns directly, which
+   the VM may run in the caller's frame. */
+static void compile_call(Compiler *c, ASTNode *n, bool tail)
+{
+    ASTNode *callee = n->data.call.func_callee;
+    int argc = n->child_count;
+
+    if (callee->type == NODE_ATTR_ACCESS && callee->child_count > 0)
+    {
+        int last = callee->child_count - 1;
+        compile_chain_receiver(c, callee, last, false);
+        int recv = chain_recv_operand(c, callee, last);
+        compile_args(c, n);
+        emit_op_u16(c, tail ? BC_TAIL_INVOKE : BC_INVOKE, name_index(c, segment_name(callee, last)), -argc, n->line, n->column);
+        emit_u16(c, recv, n->line, n->column);
+        emit_byte(c, (uint8_t)argc, n->line, n->column);
+        emit_u16(c, chunk_add_cache(c->chunk), n->line, n->column);
+        return;
+    }
+
+    compile_expr(c, callee);
+    compile_args(c, n);
+    emit_op(c, tail ? BC_TAIL_CALL : BC_CALL, -argc, n->line, n->column);
+    emit_byte(c, (uint8_t)argc, n->line, n->column);
+}
+
+static void compile_increment(Compiler *c, ASTNode *n)
+{
+    ASTNode *target = n->children[0];
+    if (target->type == NODE_VAR)
+    {
+        emit_load(c, target->data.set.set_name, target->line, target->column);
+        emit_op(c, BC_INCREMENT, 1, target->line, target->column);
+        emit_store(c, resolve_variable(c, target->data.set.set_name), false, target->line, target->column);
+        return;
+    }
+    if (target->type == NODE_ATTR_ACCESS && target->child_count > 0)
+    {
+        compile_attr_read(c, target);
+        emit_op(c, BC_INCREMENT, 1, target->line, target->column);
+        compile_attr_store(c, target);
+        return;
+    }
+    log_script_error(target->line, target->column, "Invalid increment target");
+    exit(1);
+}
+
+static void compile_index(Compiler *c, ASTNode *n)
+{
+    compile_expr(c, n->children[0]);
+    if (n->data.index.is_slice)
+    {
+        int child = 1;
+        uint8_t flags = 0;
+        if (n->data.index.has_start)
+        {
+            compile_expr(c, n->children[child++]);
+            flags |= SLICE_HAS_START;
+        }
+        if (n->data.index.has_end)
+        {
+            compile_expr(c, n->children[child]);
+            flags |= SLICE_HAS_END;
+        }
+        int popped = (flags & SLICE_HAS_START ? 1 : 0) + (flags & SLICE_HAS_END ? 1 : 0);
+        emit_op(c, BC_SLICE, -popped, n->line, n->column);
+        emit_byte(c, flags, n->line, n->column);
+        return;
+    }
+    compile_expr(c, n->children[1]);
+    emit_op(c, BC_INDEX, -1, n->line, n->column);
+}
+
+static OpCode binary_opcode(BinaryOp op)
+{
+    switch (op)
+    {
+    case OP_ADD:
+        return BC_ADD;
+    case OP_SUB:
+        return BC_SUB;
+    case OP_MUL:
+        return BC_MUL;
+    case OP_DIV:
+        return BC_DIV;
+    case OP_MOD:
+        return BC_MOD;
+    case OP_EQ:
+        return BC_EQ;
+    case OP_STRICT_EQ:
+        return BC_STRICT_EQ;
+    case OP_LT:
+        return BC_LT;
+    case OP_GT:
+        return BC_GT;
+    case OP_LTE:
+        return BC_LTE;
+    default:
+        return BC_GTE;
+    }
+}
+
+static void compile_logical(Compiler *c, ASTNode *n)
+{
+    bool is_and = n->data.binary.op == OP_AND;
+    compile_expr(c, n->children[0]);
+    int short_jump = emit_jump(c, is_and ? BC_JUMP_IF_FALSE : BC_JUMP_IF_TRUE, -1, n->line, n->column);
+    compile_expr(c, n->children[1]);
+    emit_op(c, BC_TO_BOOL, 0, n->line, n->column);
+    int end_jump = emit_jump(c, BC_JUMP, 0, n->line, n->column);
+    patch_jump(c, short_jump);
+    c->depth--;
+    emit_op(c, is_and ? BC_FALSE : BC_TRUE, 1, n->line, n->column);
+    patch_jump(c, end_jump);
+}
+
+static void compile_binary(Compiler *c, ASTNode *n)
+{
+    if (n->data.binary.op == OP_AND || n->data.binary.op == OP_OR)
+    {
+        compile_logical(c, n);
+        return;
+    }
+    compile_expr(c, n->children[0]);
+    compile_expr(c, n->children[1]);
+    emit_op(c, binary_opcode(n->data.binary.op), -1, n->line, n->column);
+}
+
+static void compile_ternary(Compiler *c, ASTNode *n)
+{
+    compile_expr(c, n->children[0]);
+    int else_jump = emit_jump(c, BC_JUMP_IF_FALSE, -1, n->line, n->column);
+    compile_expr(c, n->children[1]);
+    int end_jump = emit_jump(c, BC_JUMP, 0, n->line, n->column);
+    patch_jump(c, else_jump);
+    c->depth--;
+    compile_expr(c, n->children[2]);
+    patch_jump(c, end_jump);
+}
+
+static void compile_object_literal(Compiler *c, ASTNode *n)
+{
+    int count = n->data.object.pair_count;
+    ObjectLayout layout = {.shape = shape_root(), .slots = NULL, .key_count = count};
+    if (count > 0)
+        layout.slots = malloc(sizeof(int) * count);
+    for (int i = 0; i < count; ++i)
+    {
+        const char *key = intern(n->data.object.keys[i]);
+        int slot = shape_find(layout.shape, key);
+        if (slot < 0)
+        {
+            layout.shape = shape_add(layout.shape, key);
+            slot = layout.shape->key_count - 1;
+        }
+        layout.slots[i] = slot;
+        compile_expr(c, n->data.object.values[i]);
+    }
+    int idx = chunk_add_layout(c->chunk, layout);
+    emit_op_u16(c, BC_OBJECT, idx, 1 - count, n->line, n->column);
+}
+
+static void compile_expr(Compiler *c, ASTNode *n)
+{
+    switch (n->type)
+    {
+    case NODE_VAR:
+        emit_load(c, n->data.set.set_name, n->line, n->column);
+        break;
+    case NODE_ATTR_ACCESS:
+        if (n->child_count == 0)
+            emit_load(c, n->data.attr.object_name, n->line, n->column);
+        else
+            compile_attr_read(c, n);
+        break;
+    case NODE_LITERAL:
+        compile_literal(c, n);
+        break;
+    case NODE_AWAIT:
+        compile_expr(c, n->children[0]);
+        emit_op(c, BC_AWAIT, 0, n->line, n->column);
+        break;
+    case NODE_OBJECT_LITERAL:
+        compile_object_literal(c, n);
+        break;
+    case NODE_FUNC_CALL:
+        compile_call(c, n, false);
+        break;
+    case NODE_POSTFIX_INC:
+        compile_increment(c, n);
+        break;
+    case NODE_INDEX:
+        compile_index(c, n);
+        break;
+    case NODE_UNARY:
+        compile_expr(c, n->children[0]);
+        emit_op(c, BC_NOT, 0, n->line, n->column);
+        break;
+    case NODE_BINARY:
+        compile_binary(c, n);
+        break;
+    case NODE_TERNARY:
+        compile_ternary(c, n);
+        break;
+    default:
+        log_script_error(n->line, n->column, "Unsupported eval node type");
+        exit(1);
+    }
+}
+
+/* --- annotations --- */
+
+/*
+ * Evaluate every annotation argument onto the stack and register an
+ * annotation site describing how BC_ANNOTATE should apply them.
+ */
+static int compile_annotation_site(Compiler *c, ASTNode *n, AnnotationSiteKind kind,
+                                   const char *target_name, const char *store_name, bool is_private)
+{
+    AnnotationSite site = {0};
+    site.kind = kind;
+    site.use_count = n->annotation_count;
+    site.uses = malloc(sizeof(AnnotationUse) * n->annotation_count);
+    for (int i = 0; i < n->annotation_count; ++i)
+    {
+        Annotation *ann = n->annotations[i];
+        site.uses[i].name = strdup(ann->name);
+        site.uses[i].arg_count = ann->arg_count;
+        site.uses[i].is_call = ann->is_call;
+        site.uses[i].line = ann->line;
+        site.uses[i].column = ann->column;
+        for (int a = 0; a < ann->arg_count; ++a)
+            compile_expr(c, ann->args[a]);
+        site.arg_count += ann->arg_count;
+    }
+    site.target_name = target_name ? intern(target_name) : NULL;
+    site.store_name = store_name ? intern(store_name) : NULL;
+    site.is_private = is_private;
+    return chunk_add_site(c->chunk, site);
+}
+
+static void emit_annotate(Compiler *c, int site_idx, int line, int column)
+{
+    AnnotationSite *site = &c->chunk->sites[site_idx];
+    int effect = -site->arg_count - (site->store_name ? 1 : 0);
+    emit_op_u16(c, BC_ANNOTATE, site_idx, effect, line, column);
+}
+
+/* --- statements --- */
+
+static void compile_store_var(Compiler *c, const char *name, bool is_private, int line, int column)
+{
+    emit_store(c, resolve_variable(c, name), is_private, line, column);
+}
+
+/* Stack: [value] -> []. Apply the node's annotations, then bind `name`. */
+static void compile_annotated_store(Compiler *c, ASTNode *n, AnnotationSiteKind kind, const char *name)
+{
+    VarRef ref = resolve_variable(c, name);
+    bool by_name = ref.kind == VAR_GLOBAL;
+    int site = compile_annotation_site(c, n, kind, name, by_name ? name : NULL, n->is_private);
+    emit_annotate(c, site, n->line, n->column);
+    if (!by_name)
+        emit_store(c, ref, false, n->line, n->column);
+}
+
+static void compile_set(Compiler *c, ASTNode *n)
+{
+    if (n->data.set.set_attr)
+    {
+        if (n->annotation_count > 0)
+        {
+            log_script_error(n->line, n->column, "Annotations are not supported on attribute assignments");
+            exit(1);
+        }
+        compile_expr(c, n->children[0]);
+        compile_attr_store(c, n->data.set.set_attr);
+        return;
+    }
+
+    compile_expr(c, n->children[0]);
+    if (n->annotation_count > 0)
+    {
+        compile_annotated_store(c, n, ANNOTATION_SITE_ASSIGNMENT, n->data.set.set_name);
+        return;
+    }
+    compile_store_var(c, n->data.set.set_name, n->is_private, n->line, n->column);
+}
+
+static Function *method_prototype(Compiler *c, ASTNode *method)
+{
+    Function *fn = function_create(method->data.method.method_name, method->data.method.params,
+                                   method->data.method.param_count, method->children, method->child_count,
+                                   method->data.method.is_async);
+    compile_function(c, fn);
+    return fn;
+}
+
+static void compile_class(Compiler *c, ASTNode *n)
+{
+    ClassInfo info;
+    info.name = strdup(n->data.cls.class_name);
+    info.base_count = n->data.cls.base_count;
+    info.base_names = malloc(sizeof(char *) * (info.base_count > 0 ? info.base_count : 1));
+    for (int i = 0; i < info.base_count; ++i)
+    {
+        info.base_names[i] = strdup(n->data.cls.base_names[i]);
+        emit_load(c, info.base_names[i], n->line, n->column);
+    }
+    emit_op_u16(c, BC_CLASS, chunk_add_class(c->chunk, info), 1 - info.base_count, n->line, n->column);
+
+    for (int m = 0; m < n->child_count; ++m)
+    {
+        ASTNode *method = n->children[m];
+        Value proto = FUNCTION_VAL(method_prototype(c, method));
+        emit_op_u16(c, BC_CLOSURE, chunk_add_constant(c->chunk, proto), 1, method->line, method->column);
+        if (method->annotation_count > 0)
+        {
+            int site = compile_annotation_site(c, method, ANNOTATION_SITE_METHOD,
+                                               method->data.method.method_name, NULL, false);
+            emit_annotate(c, site, method->line, method->column);
+        }
+        emit_op_u16(c, BC_METHOD, name_index(c, method->data.method.method_name), -1,
+                    method->line, method->column);
+        emit_byte(c, method->is_static ? 1 : 0, method->line, method->column);
+    }
+
+    if (n->annotation_count > 0)
+    {
+        compile_annotated_store(c, n, ANNOTATION_SITE_CLASS, n->data.cls.class_name);
+        return;
+    }
+    compile_store_var(c, n->data.cls.class_name, n->is_private, n->line, n->column);
+}
+
+static void compile_if(Compiler *c, ASTNode *n)
+{
+    compile_expr(c, n->children[0]);
+    int else_jump = emit_jump(c, BC_JUMP_IF_FALSE, -1, n->line, n->column);
+    ASTNode *then_block = n->children[1];
+    compile_block(c, then_block->children, then_block->child_count);
+    if (n->child_count < 3)
+    {
+        patch_jump(c, else_jump);
+        return;
+    }
+    int end_jump = emit_jump(c, BC_JUMP, 0, n->line, n->column);
+    patch_jump(c, else_jump);
+    ASTNode *else_node = n->children[2];
+    if (else_node->type == NODE_IF)
+        compile_if(c, else_node);
+    else
+        compile_block(c, else_node->children, else_node->child_count);
+    patch_jump(c, end_jump);
+}
+
+static void loop_begin(Compiler *c, LoopContext *loop, int continue_target)
+{
+    loop->continue_target = continue_target;
+    loop->break_jumps = NULL;
+    loop->break_count = 0;
+    loop->break_capacity = 0;
+    loop->enclosing = c->loop;
+    c->loop = loop;
+}
+
+static void loop_end(Compiler *c, LoopContext *loop)
+{
+    for (int i = 0; i < loop->break_count; ++i)
+        patch_jump(c, loop->break_jumps[i]);
+    free(loop->break_jumps);
+    c->loop = loop->enclosing;
+}
+
+static void compile_for(Compiler *c, ASTNode *n)
+{
+    compile_expr(c, n->children[0]);
+    emit_op(c, BC_ITER_INIT, 1, n->line, n->column);
+
+    LoopContext loop;
+    int start = c->chunk->count;
+    loop_begin(c, &loop, start);
+    int exit_jump = emit_jump(c, BC_FOR_ITER, 1, n->line, n->column);
+    compile_store_var(c, n->data.loop.loop_var, false, n->line, n->column);
+    ASTNode *body = n->children[1];
+    compile_block(c, body->children, body->child_count);
+    emit_loop(c, start, n->line, n->column);
+
+    patch_jump(c, exit_jump);
+    loop_end(c, &loop);
+    emit_op(c, BC_POP, -1, n->line, n->column);
+    emit_op(c, BC_POP, -1, n->line, n->column);
+}
+
+static void compile_while(Compiler *c, ASTNode *n)
+{
+    LoopContext loop;
+    int start = c->chunk->count;
+    loop_begin(c, &loop, start);
+    compile_expr(c, n->children[0]);
+    int exit_jump = emit_jump(c, BC_JUMP_IF_FALSE, -1, n->line, n->column);
+    ASTNode *body = n->children[1];
+    compile_block(c, body->children, body->child_count);
+    emit_loop(c, start, n->line, n->column);
+    patch_jump(c, exit_jump);
+    loop_end(c, &loop);
+}
+
+static void compile_break(Compiler *c, ASTNode *n)
+{
+    LoopContext *loop = c->loop;
+    if (!loop)
+    {
+        log_script_error(n->line, n->column, "'break' outside of a loop");
+        exit(1);
+    }
+    if (loop->break_count == loop->break_capacity)
+    {
+        loop->break_capacity = loop->break_capacity ? loop->break_capacity * 2 : 4;
+        loop->break_jumps = realloc(loop->break_jumps, sizeof(int) * loop->break_capacity);
+    }
+    loop->break_jumps[loop->break_count++] = emit_jump(c, BC_JUMP, 0, n->line, n->column);
+}
+
+static void compile_continue(Compiler *c, ASTNode *n)
+{
+    if (!c->loop)
+    {
+        log_script_error(n->line, n->column, "'continue' outside of a loop");
+        exit(1);
+    }
+    emit_loop(c, c->loop->continue_target, n->line, n->column);
+}
+
+static void compile_stmt(Compiler *c, ASTNode *n)
+{
+    switch (n->type)
+    {
+    case NODE_SET:
+        compile_set(c, n);
+        break;
+    case NODE_CLASS_DEF:
+        compile_class(c, n);
+        break;
+    case NODE_FUNC_CALL:
+    case NODE_POSTFIX_INC:
+        compile_expr(c, n);
+        emit_op(c, BC_POP, -1, n->line, n->column);
+        break;
+    case NODE_IF:
+        compile_if(c, n);
+        break;
+    case NODE_RETURN:
+        if (c->is_function && n->children[0]->type == NODE_FUNC_CALL)
+            compile_call(c, n->children[0], true);
+        else
+            compile_expr(c, n->children[0]);
+        emit_op(c, BC_RETURN, -1, n->line, n->column);
+        break;
+    case NODE_BLOCK:
+        compile_block(c, n->children, n->child_count);
+        break;
+    case NODE_FOR:
+        compile_for(c, n);
+        break;
+    case NODE_WHILE:
+        compile_while(c, n);
+        break;
+    case NODE_BREAK:
+        compile_break(c, n);
+        break;
+    case NODE_CONTINUE:
+        compile_continue(c, n);
+        break;
+    case NODE_IMPORT_MODULE:
+    {
+        const char *module = n->data.import_module.module_name;
+        emit_op_u16(c, BC_IMPORT, name_index(c, module), 1, n->line, n->column);
+        compile_store_var(c, module, false, n->line, n->column);
+        break;
+    }
+    case NODE_IMPORT_NAMES:
+    {
+        int module = name_index(c, n->data.import_names.module_name);
+        for (int i = 0; i < n->data.import_names.name_count; ++i)
+        {
+            const char *name = n->data.import_names.names[i];
+            emit_op_u16(c, BC_IMPORT_FROM, module, 1, n->line, n->column);
+            emit_u16(c, name_index(c, name), n->line, n->column);
+            compile_store_var(c, name, false, n->line, n->column);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+static void compile_block(Compiler *c, ASTNode **nodes, int count)
+{
+    for (int i = 0; i < count; ++i)
+        compile_stmt(c, nodes[i]);
+}
+
+static void compile_body(Compiler *c, ASTNode **nodes, int count)
+{
+    compile_block(c, nodes, count);
+    int line = count > 0 ? nodes[count - 1]->line : 0;
+    emit_op(c, BC_UNDEFINED, 1, line, 0);
+    emit_op(c, BC_RETURN, -1, line, 0);
+}
+
+Chunk *compile_program(ASTNode **nodes, int count, const char *name)
+{
+    NameList globals = {0};
+    collect_declarations(nodes, count, &globals);
+    Compiler c = {.chunk = chunk_create(name), .globals = &globals};
+    compile_body(&c, nodes, count);
+    free(globals.items);
+    return c.chunk;
+}
+
+/*
+ * Compile a function prototype's body into fn->chunk. Slots are assigned
+ * up front so closures compiled inside the body can capture any of them.
+ */
+static void compile_function(Compiler *enclosing, Function *fn)
+{
+    if (fn->chunk)
+        return;
+
+    Compiler c = {.chunk = chunk_create(fn->name ? fn->name : "<anonymous>"),
+                  .enclosing = enclosing->is_function ? enclosing : NULL,
+                  .globals = enclosing->globals,
+                  .is_function = true};
+    /* Argument i is copied into slot i. */
+    for (int i = 0; i < fn->param_count; ++i)
+        namelist_push(&c.slots, fn->params[i]);
+
+    NameList declared = {0};
+    collect_declarations(fn->body, fn->body_count, &declared);
+    for (int i = 0; i < declared.count; ++i)
+    {
+        const char *name = declared.items[i];
+        if (!declared_in_enclosing(&c, name) && namelist_find(c.globals, name) < 0)
+            namelist_add(&c.slots, name);
+    }
+    free(declared.items);
+
+    compile_body(&c, fn->body, fn->body_count);
+    c.chunk->local_count = c.slots.count;
+    free(c.slots.items);
+    fn->chunk = c.chunk;
+}
@@ -0,0 +1,13 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include "ast/ast.h"
+#include "compiler/chunk.h"
+#include "types/function.h"
+
+/* Compile a top-level statement list. The chunk owns copies of every name
+ * and constant it needs, so the AST may be freed once this returns.
+ * Function literals are compiled into their prototypes along the way. */
+Chunk *compile_program(ASTNode **nodes, int count, const char *name);
+
+#endif
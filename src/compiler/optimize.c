@@ -0,0 +1,491 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "compiler/optimize.h"
+#include "interpreter/interpreter.h"
+#include "types/function.h"
+#include "types/value.h"
+
+/* Largest function body expression, in nodes, that is copied into callers. */
+#define INLINE_MAX_NODES 16
+
+/*
+ * What the optimizer knows about one module-level name. A name becomes a
+ * binding (a constant or an inlinable function) once the statement that
+ * assigns it has been passed, and only if nothing else in the module ever
+ * writes or shadows it.
+ */
+typedef struct ModuleName
+{
+    const char *name;
+    int writes;
+    bool shadowed;
+    bool has_constant;
+    Value constant; /* borrowed from the assigning literal */
+    Function *inline_fn;
+} ModuleName;
+
+typedef struct Optimizer
+{
+    ModuleName *names;
+    int count;
+    int capacity;
+} Optimizer;
+
+static ModuleName *find_name(Optimizer *o, const char *name)
+{
+    for (int i = 0; i < o->count; ++i)
+    {
+        if (strcmp(o->names[i].name, name) == 0)
+            return &o->names[i];
+    }
+    return NULL;
+}
+
+static ModuleName *intern_name(Optimizer *o, const char *name)
+{
+    ModuleName *entry = find_name(o, name);
+    if (entry)
+        return entry;
+    if (o->count == o->capacity)
+    {
+        o->capacity = o->capacity ? o->capacity * 2 : 16;
+        o->names = realloc(o->names, sizeof(ModuleName) * o->capacity);
+    }
+    entry = &o->names[o->count++];
+    memset(entry, 0, sizeof(*entry));
+    entry->name = name;
+    return entry;
+}
+
+static void note_write(Optimizer *o, const char *name)
+{
+    intern_name(o, name)->writes++;
+}
+
+static void note_params(Optimizer *o, char **params, int count)
+{
+    for (int i = 0; i < count; ++i)
+        intern_name(o, params[i])->shadowed = true;
+}
+
+/* --- pre-scan: every write and every parameter in the module --- */
+
+static void scan_node(Optimizer *o, ASTNode *n);
+
+static void scan_nodes(Optimizer *o, ASTNode **nodes, int count)
+{
+    for (int i = 0; i < count; ++i)
+        scan_node(o, nodes[i]);
+}
+
+static void scan_node(Optimizer *o, ASTNode *n)
+{
+    if (!n)
+        return;
+    switch (n->type)
+    {
+    case NODE_SET:
+        if (!n->data.set.set_attr)
+            note_write(o, n->data.set.set_name);
+        break;
+    case NODE_FOR:
+        note_write(o, n->data.loop.loop_var);
+        break;
+    case NODE_CLASS_DEF:
+        note_write(o, n->data.cls.class_name);
+        break;
+    case NODE_METHOD_DEF:
+        note_params(o, n->data.method.params, n->data.method.param_count);
+        break;
+    case NODE_IMPORT_MODULE:
+        note_write(o, n->data.import_module.module_name);
+        break;
+    case NODE_IMPORT_NAMES:
+        for (int i = 0; i < n->data.import_names.name_count; ++i)
+            note_write(o, n->data.import_names.names[i]);
+        break;
+    case NODE_POSTFIX_INC:
+        if (n->children[0]->type == NODE_VAR)
+            note_write(o, n->children[0]->data.set.set_name);
+        break;
+    case NODE_FUNC_CALL:
+        scan_node(o, n->data.call.func_callee);
+        break;
+    case NODE_OBJECT_LITERAL:
+        scan_nodes(o, n->data.object.values, n->data.object.pair_count);
+        break;
+    case NODE_LITERAL:
+        if (IS_FUNCTION(n->data.lit.literal_value))
+        {
+            Function *fn = AS_FUNCTION(n->data.lit.literal_value);
+            note_params(o, fn->params, fn->param_count);
+            scan_nodes(o, fn->body, fn->body_count);
+        }
+        break;
+    default:
+        break;
+    }
+    for (int i = 0; i < n->annotation_count; ++i)
+        scan_nodes(o, n->annotations[i]->args, n->annotations[i]->arg_count);
+    scan_nodes(o, n->children, n->child_count);
+}
+
+/* --- helpers --- */
+
+static bool is_constant(ASTNode *n)
+{
+    if (n->type != NODE_LITERAL)
+        return false;
+    Value v = n->data.lit.literal_value;
+    return IS_NUMBER(v) || IS_STRING(v) || IS_BOOL(v) || IS_NULL(v) || IS_UNDEFINED(v);
+}
+
+static ASTNode *literal_node(Value value, int line, int column)
+{
+    ASTNode *n = new_node(NODE_LITERAL, line, column);
+    n->data.lit.literal_value = value;
+    return n;
+}
+
+/* Replace `n` with its child `index`. Dropped nodes stay in the program's
+ * arena until free_ast. */
+static ASTNode *take_child(ASTNode *n, int index)
+{
+    return n->children[index];
+}
+
+/*
+ * True when a statement assigns a name of its own. The compiler decides
+ * which names are slots (or module globals) from every assignment in the
+ * body, reachable or not, so such statements are never dropped.
+ */
+static bool declares_names(ASTNode *n)
+{
+    switch (n->type)
+    {
+    case NODE_SET:
+        return !n->data.set.set_attr;
+    case NODE_CLASS_DEF:
+    case NODE_FOR:
+    case NODE_IMPORT_MODULE:
+    case NODE_IMPORT_NAMES:
+        return true;
+    case NODE_IF:
+    case NODE_WHILE:
+    case NODE_BLOCK:
+        for (int i = 0; i < n->child_count; ++i)
+        {
+            if (declares_names(n->children[i]))
+                return true;
+        }
+        return false;
+    default:
+        return false;
+    }
+}
+
+/* --- folding --- */
+
+/* Only operand types the runtime accepts without raising are folded, so a
+ * type error still surfaces when (and if) the expression runs. */
+static bool can_fold_binary(BinaryOp op, Value left, Value right)
+{
+    switch (op)
+    {
+    case OP_EQ:
+    case OP_STRICT_EQ:
+        return true;
+    case OP_LT:
+    case OP_GT:
+    case OP_LTE:
+    case OP_GTE:
+        return ((IS_NUMBER(left) || IS_BOOL(left)) && (IS_NUMBER(right) || IS_BOOL(right))) ||
+               (IS_STRING(left) && IS_STRING(right));
+    case OP_ADD:
+        return (IS_NUMBER(left) && IS_NUMBER(right)) || (IS_STRING(left) && IS_STRING(right));
+    case OP_SUB:
+    case OP_MUL:
+    case OP_DIV:
+    case OP_MOD:
+        return IS_NUMBER(left) && IS_NUMBER(right);
+    default:
+        return false;
+    }
+}
+
+static ASTNode *fold_binary(ASTNode *n)
+{
+    BinaryOp op = n->data.binary.op;
+    ASTNode *left = n->children[0];
+    ASTNode *right = n->children[1];
+
+    if (op == OP_AND || op == OP_OR)
+    {
+        /* The result is always a boolean; the right side only needs to be
+           known when the left does not decide it. */
+        if (!is_constant(left))
+            return n;
+        bool lhs = interpreter_to_boolean(left->data.lit.literal_value);
+        if (lhs == (op == OP_OR))
+        {
+            return literal_node(BOOL_VAL(lhs), n->line, n->column);
+        }
+        if (!is_constant(right))
+            return n;
+        bool rhs = interpreter_to_boolean(right->data.lit.literal_value);
+        return literal_node(BOOL_VAL(rhs), n->line, n->column);
+    }
+
+    if (!is_constant(left) || !is_constant(right))
+        return n;
+    Value lv = left->data.lit.literal_value;
+    Value rv = right->data.lit.literal_value;
+    if (!can_fold_binary(op, lv, rv))
+        return n;
+    return literal_node(interpreter_binary_op(op, lv, rv, n->line, n->column), n->line, n->column);
+}
+
+static ASTNode *fold_unary(ASTNode *n)
+{
+    if (!is_constant(n->children[0]))
+        return n;
+    bool truthy = interpreter_to_boolean(n->children[0]->data.lit.literal_value);
+    return literal_node(BOOL_VAL(!truthy), n->line, n->column);
+}
+
+static ASTNode *fold_ternary(ASTNode *n)
+{
+    if (!is_constant(n->children[0]))
+        return n;
+    bool truthy = interpreter_to_boolean(n->children[0]->data.lit.literal_value);
+    return take_child(n, truthy ? 1 : 2);
+}
+
+static ASTNode *prune_if(ASTNode *n)
+{
+    if (!is_constant(n->children[0]))
+        return n;
+    bool truthy = interpreter_to_boolean(n->children[0]->data.lit.literal_value);
+    if (truthy)
+    {
+        if (n->child_count > 2 && declares_names(n->children[2]))
+            return n;
+        return take_child(n, 1);
+    }
+    if (declares_names(n->children[1]))
+        return n;
+    if (n->child_count > 2)
+        return take_child(n, 2);
+    return new_node(NODE_BLOCK, n->line, n->column);
+}
+
+static ASTNode *prune_while(ASTNode *n)
+{
+    if (!is_constant(n->children[0]) || interpreter_to_boolean(n->children[0]->data.lit.literal_value))
+        return n;
+    if (declares_names(n->children[1]))
+        return n;
+    return new_node(NODE_BLOCK, n->line, n->column);
+}
+
+/* --- inlining --- */
+
+static int param_index(Function *fn, const char *name)
+{
+    for (int i = 0; i < fn->param_count; ++i)
+    {
+        if (strcmp(fn->params[i], name) == 0)
+            return i;
+    }
+    return -1;
+}
+
+/* An inlinable body reads only its parameters and constants, so copying
+ * it into any caller cannot change what its names refer to. */
+static bool is_inline_expr(Function *fn, ASTNode *n, int *budget)
+{
+    if (--*budget < 0)
+        return false;
+    switch (n->type)
+    {
+    case NODE_LITERAL:
+        return is_constant(n);
+    case NODE_VAR:
+        return param_index(fn, n->data.set.set_name) >= 0;
+    case NODE_UNARY:
+    case NODE_BINARY:
+    case NODE_TERNARY:
+        for (int i = 0; i < n->child_count; ++i)
+        {
+            if (!is_inline_expr(fn, n->children[i], budget))
+                return false;
+        }
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool is_inlinable(Function *fn)
+{
+    if (fn->is_async || fn->body_count != 1 || fn->body[0]->type != NODE_RETURN)
+        return false;
+    int budget = INLINE_MAX_NODES;
+    return is_inline_expr(fn, fn->body[0]->children[0], &budget);
+}
+
+/* Arguments are copied wherever the parameter is read, so only reads
+ * without side effects are passed through. */
+static bool is_inline_arg(ASTNode *n)
+{
+    return is_constant(n) || n->type == NODE_VAR;
+}
+
+static ASTNode *copy_arg(ASTNode *arg, int line, int column)
+{
+    if (arg->type == NODE_VAR)
+        return new_var_node(arg->data.set.set_name, line, column);
+    return literal_node(clone_value(&arg->data.lit.literal_value), line, column);
+}
+
+static ASTNode *instantiate(Function *fn, ASTNode *n, ASTNode **args, int line, int column)
+{
+    switch (n->type)
+    {
+    case NODE_LITERAL:
+        return literal_node(clone_value(&n->data.lit.literal_value), line, column);
+    case NODE_VAR:
+        return copy_arg(args[param_index(fn, n->data.set.set_name)], line, column);
+    default:
+    {
+        ASTNode *copy = new_node(n->type, line, column);
+        copy->data = n->data;
+        for (int i = 0; i < n->child_count; ++i)
+            add_child(copy, instantiate(fn, n->children[i], args, line, column));
+        return copy;
+    }
+    }
+}
+
+/* --- rewriting --- */
+
+static ASTNode *optimize_node(Optimizer *o, ASTNode *n);
+
+static void optimize_nodes(Optimizer *o, ASTNode **nodes, int count)
+{
+    for (int i = 0; i < count; ++i)
+        nodes[i] = optimize_node(o, nodes[i]);
+}
+
+static ASTNode *inline_call(Optimizer *o, ASTNode *n)
+{
+    ASTNode *callee = n->data.call.func_callee;
+    if (callee->type != NODE_VAR)
+        return n;
+    ModuleName *entry = find_name(o, callee->data.set.set_name);
+    if (!entry || !entry->inline_fn || entry->inline_fn->param_count != n->child_count)
+        return n;
+    for (int i = 0; i < n->child_count; ++i)
+    {
+        if (!is_inline_arg(n->children[i]))
+            return n;
+    }
+    Function *fn = entry->inline_fn;
+    ASTNode *body = instantiate(fn, fn->body[0]->children[0], n->children, n->line, n->column);
+    return optimize_node(o, body);
+}
+
+static ASTNode *optimize_node(Optimizer *o, ASTNode *n)
+{
+    if (!n)
+        return n;
+
+    switch (n->type)
+    {
+    case NODE_VAR:
+    {
+        ModuleName *entry = find_name(o, n->data.set.set_name);
+        if (!entry || !entry->has_constant)
+            return n;
+        return literal_node(clone_value(&entry->constant), n->line, n->column);
+    }
+    case NODE_POSTFIX_INC:
+        /* The target is written, not read. */
+        return n;
+    case NODE_FUNC_CALL:
+        if (n->data.call.func_callee->type != NODE_VAR)
+            n->data.call.func_callee = optimize_node(o, n->data.call.func_callee);
+        break;
+    case NODE_OBJECT_LITERAL:
+        optimize_nodes(o, n->data.object.values, n->data.object.pair_count);
+        break;
+    case NODE_LITERAL:
+        if (IS_FUNCTION(n->data.lit.literal_value))
+        {
+            Function *fn = AS_FUNCTION(n->data.lit.literal_value);
+            optimize_nodes(o, fn->body, fn->body_count);
+        }
+        return n;
+    default:
+        break;
+    }
+
+    for (int i = 0; i < n->annotation_count; ++i)
+        optimize_nodes(o, n->annotations[i]->args, n->annotations[i]->arg_count);
+    optimize_nodes(o, n->children, n->child_count);
+
+    switch (n->type)
+    {
+    case NODE_UNARY:
+        return fold_unary(n);
+    case NODE_BINARY:
+        return fold_binary(n);
+    case NODE_TERNARY:
+        return fold_ternary(n);
+    case NODE_IF:
+        return prune_if(n);
+    case NODE_WHILE:
+        return prune_while(n);
+    case NODE_FUNC_CALL:
+        return inline_call(o, n);
+    default:
+        return n;
+    }
+}
+
+/* After a top-level statement runs, the name it assigns is bound for
+ * every later statement if the module never writes or shadows it again. */
+static void bind_declaration(Optimizer *o, ASTNode *n)
+{
+    if (n->type != NODE_SET || n->data.set.set_attr || n->annotation_count > 0)
+        return;
+    ModuleName *entry = find_name(o, n->data.set.set_name);
+    if (!entry || entry->writes != 1 || entry->shadowed)
+        return;
+    ASTNode *value = n->children[0];
+    if (is_constant(value))
+    {
+        entry->has_constant = true;
+        entry->constant = value->data.lit.literal_value;
+    }
+    else if (value->type == NODE_LITERAL && IS_FUNCTION(value->data.lit.literal_value) &&
+             is_inlinable(AS_FUNCTION(value->data.lit.literal_value)))
+    {
+        entry->inline_fn = AS_FUNCTION(value->data.lit.literal_value);
+    }
+}
+
+void optimize_program(ASTNode **nodes, int count)
+{
+    AstArena *outer = ast_arena_enter(ast_arena_of(nodes));
+    Optimizer o = {0};
+    scan_nodes(&o, nodes, count);
+    for (int i = 0; i < count; ++i)
+    {
+        nodes[i] = optimize_node(&o, nodes[i]);
+        bind_declaration(&o, nodes[i]);
+    }
+    free(o.names);
+    ast_arena_enter(outer);
+}
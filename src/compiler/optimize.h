@@ -0,0 +1,13 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast/ast.h"
+
+/* Rewrite a parsed module in place before it is compiled: fold constant
+ * expressions, drop branches that can never run, propagate module-level
+ * constants that are assigned exactly once, and inline small
+ * single-expression functions at their call sites. New nodes come from
+ * the program's arena, and the top-level array keeps its length. */
+void optimize_program(ASTNode **nodes, int count);
+
+#endif
@@ -2,6 +2,10 @@
 #include <string.h>
 
 #include "interpreter/annotations.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "types/object.h"
+#include "types/str.h"
 #include "utils/utils.h"
 #include "uthash.h"
 
@@ -45,6 +49,19 @@ void annotations_cleanup(void)
     }
 }
 
+void annotations_mark_roots(void)
+{
+    AnnotationHandlerEntry *entry, *tmp;
+    HASH_ITER(hh, modifier_handlers, entry, tmp)
+    {
+        gc_mark_value(entry->handler);
+    }
+    HASH_ITER(hh, decorator_handlers, entry, tmp)
+    {
+        gc_mark_value(entry->handler);
+    }
+}
+
 void annotations_register(const char *name, AnnotationHandlerType type, Value handler)
 {
     if (!name)
@@ -72,7 +89,7 @@ Value annotations_clone_handler(const char *name, AnnotationHandlerType type)
     HASH_FIND_STR(*table, name, entry);
     if (!entry)
     {
-        Value undef = {.type = VAL_UNDEFINED};
+        Value undef = UNDEFINED_VAL;
         return undef;
     }
     return clone_value(&entry->handler);
@@ -85,3 +102,143 @@ bool annotations_has_handler(const char *name, AnnotationHandlerType type)
     HASH_FIND_STR(*table, name, entry);
     return entry != NULL;
 }
+
+static const char *annotation_target_label(AnnotationTargetType type)
+{
+    switch (type)
+    {
+    case ANNOTATION_TARGET_FUNCTION:
+        return "function";
+    case ANNOTATION_TARGET_METHOD:
+        return "method";
+    case ANNOTATION_TARGET_CLASS:
+        return "class";
+    case ANNOTATION_TARGET_ASSIGNMENT:
+        return "assignment";
+    default:
+        return NULL;
+    }
+}
+
+bool annotations_apply(const AnnotationUse *uses, int count, Value *args, Value *value,
+                       AnnotationTargetType target_type, const char *name)
+{
+    if (count == 0)
+        return false;
+
+    Value *decorators = calloc(count, sizeof(Value));
+    Value *modifiers = calloc(count, sizeof(Value));
+    Value **use_args = calloc(count, sizeof(Value *));
+    if (!decorators || !modifiers || !use_args)
+    {
+        log_script_error(uses[0].line, uses[0].column, "Out of memory while applying annotations");
+        exit(1);
+    }
+
+    Value *next_arg = args;
+    for (int i = 0; i < count; ++i)
+    {
+        const AnnotationUse *ann = &uses[i];
+        use_args[i] = next_arg;
+        next_arg += ann->arg_count;
+        decorators[i] = annotations_clone_handler(ann->name, ANNOTATION_HANDLER_DECORATOR);
+        modifiers[i] = annotations_clone_handler(ann->name, ANNOTATION_HANDLER_MODIFIER);
+        if (IS_UNDEFINED(decorators[i]) && IS_UNDEFINED(modifiers[i]))
+        {
+            log_script_error(ann->line, ann->column, "Unknown annotation '@%s'", ann->name);
+            exit(1);
+        }
+        if (ann->is_call && IS_UNDEFINED(decorators[i]))
+        {
+            log_script_error(ann->line, ann->column, "Annotation '@%s' does not support arguments", ann->name);
+            exit(1);
+        }
+        if (ann->arg_count > 0 && !IS_UNDEFINED(modifiers[i]) && IS_UNDEFINED(decorators[i]))
+        {
+            log_script_error(ann->line, ann->column, "Modifier '@%s' does not accept arguments", ann->name);
+            exit(1);
+        }
+    }
+
+    for (int i = count - 1; i >= 0; --i)
+    {
+        if (IS_UNDEFINED(decorators[i]))
+            continue;
+        const AnnotationUse *ann = &uses[i];
+        Value decorator_callable = decorators[i];
+        decorators[i] = UNDEFINED_VAL;
+
+        if (ann->is_call)
+        {
+            Value intermediate = interpreter_call_value(decorator_callable, use_args[i], ann->arg_count, ann->line, ann->column);
+            free_value(decorator_callable);
+            decorator_callable = intermediate;
+        }
+
+        Value decorator_args[1];
+        decorator_args[0] = *value;
+        Value decorated = interpreter_call_value(decorator_callable, decorator_args, 1, ann->line, ann->column);
+        free_value(decorator_callable);
+        free_value(*value);
+        *value = decorated;
+    }
+
+    Object *info_obj = object_create();
+    if (!info_obj)
+    {
+        log_script_error(uses[0].line, uses[0].column, "Out of memory while applying annotations");
+        exit(1);
+    }
+    Value info_val = OBJECT_VAL(info_obj);
+    const char *label = annotation_target_label(target_type);
+    if (label)
+    {
+        Value type_val = STRING_VAL(string_from(label));
+        object_set(info_obj, "target_type", type_val);
+        free_value(type_val);
+    }
+    if (name)
+    {
+        Value name_val = STRING_VAL(string_from(name));
+        object_set(info_obj, "name", name_val);
+        free_value(name_val);
+    }
+
+    bool assign_private = false;
+    for (int i = 0; i < count; ++i)
+    {
+        if (IS_UNDEFINED(modifiers[i]))
+            continue;
+        const AnnotationUse *ann = &uses[i];
+        Value modifier_args[2];
+        modifier_args[0] = *value;
+        modifier_args[1] = info_val;
+        Value result = interpreter_call_value(modifiers[i], modifier_args, 2, ann->line, ann->column);
+        free_value(modifiers[i]);
+        modifiers[i] = UNDEFINED_VAL;
+
+        if (IS_OBJECT(result))
+        {
+            Value flag = object_get(AS_OBJECT(result), "assign_private");
+            if (IS_BOOL(flag) && AS_BOOL(flag))
+                assign_private = true;
+        }
+        free_value(result);
+    }
+
+    free_value(info_val);
+
+    for (int i = 0; i < count; ++i)
+    {
+        if (!IS_UNDEFINED(decorators[i]))
+            free_value(decorators[i]);
+        if (!IS_UNDEFINED(modifiers[i]))
+            free_value(modifiers[i]);
+    }
+
+    free(decorators);
+    free(modifiers);
+    free(use_args);
+
+    return assign_private;
+}
@@ -11,10 +11,34 @@ typedef enum
     ANNOTATION_HANDLER_DECORATOR
 } AnnotationHandlerType;
 
+typedef enum
+{
+    ANNOTATION_TARGET_FUNCTION,
+    ANNOTATION_TARGET_METHOD,
+    ANNOTATION_TARGET_CLASS,
+    ANNOTATION_TARGET_ASSIGNMENT
+} AnnotationTargetType;
+
+/* Compiled form of an `@name(args)` annotation; its arguments are
+ * evaluated by the caller and passed to annotations_apply in order. */
+typedef struct AnnotationUse
+{
+    char *name;
+    int arg_count;
+    bool is_call;
+    int line;
+    int column;
+} AnnotationUse;
+
 void annotations_init(void);
 void annotations_cleanup(void);
 void annotations_register(const char *name, AnnotationHandlerType type, Value handler);
 Value annotations_clone_handler(const char *name, AnnotationHandlerType type);
 bool annotations_has_handler(const char *name, AnnotationHandlerType type);
+/* Mark every registered handler for the collector. */
+void annotations_mark_roots(void);
+/* Decorators replace the owned `*value` with their result, releasing it. */
+bool annotations_apply(const AnnotationUse *uses, int count, Value *args, Value *value,
+                       AnnotationTargetType target_type, const char *name);
 
 #endif
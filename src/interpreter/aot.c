@@ -0,0 +1,199 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "ast/ast.h"
+#include "compiler/compiler.h"
+#include "compiler/optimize.h"
+#include "interpreter/aot.h"
+#include "interpreter/interpreter.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "types/function.h"
+#include "types/shape.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+typedef struct
+{
+    char *name;
+    char *source;
+} SourceFile;
+
+typedef struct
+{
+    FILE *out;
+    SourceFile *modules;
+    int module_count;
+    int module_capacity;
+    JitPrecompiled *functions;
+    int function_count;
+    int function_capacity;
+} Translation;
+
+static bool has_module(const Translation *t, const char *name)
+{
+    for (int i = 0; i < t->module_count; ++i)
+    {
+        if (strcmp(t->modules[i].name, name) == 0)
+            return true;
+    }
+    return false;
+}
+
+/* Queue `name` for bundling. A module missing from the module path is
+   left for the bundle to look for when it runs. */
+static void add_module(Translation *t, const char *name)
+{
+    if (has_module(t, name))
+        return;
+    char *file = find_module_file(name);
+    if (!file)
+        return;
+    if (t->module_count == t->module_capacity)
+    {
+        t->module_capacity = t->module_capacity ? t->module_capacity * 2 : 8;
+        t->modules = realloc(t->modules, sizeof(SourceFile) * t->module_capacity);
+    }
+    t->modules[t->module_count++] = (SourceFile){.name = strdup(name), .source = read_file(file)};
+    free(file);
+}
+
+static void add_function(Translation *t, const Chunk *chunk)
+{
+    char symbol[32];
+    snprintf(symbol, sizeof(symbol), "able_fn_%d", t->function_count);
+    if (!jit_emit_c(chunk, symbol, t->out))
+        return;
+    if (t->function_count == t->function_capacity)
+    {
+        t->function_capacity = t->function_capacity ? t->function_capacity * 2 : 8;
+        t->functions = realloc(t->functions, sizeof(JitPrecompiled) * t->function_capacity);
+    }
+    t->functions[t->function_count++] = (JitPrecompiled){
+        .name = strdup(chunk->name),
+        .hash = jit_chunk_hash(chunk),
+        .code_count = chunk->count,
+        .local_count = chunk->local_count,
+    };
+}
+
+/* Translate the functions defined in `chunk` and queue its imports. */
+static void translate_chunk(Translation *t, const Chunk *chunk, bool is_function)
+{
+    for (int offset = 0; offset < chunk->count; offset += opcode_length(chunk, offset))
+    {
+        OpCode op = (OpCode)chunk->code[offset];
+        if (op == BC_IMPORT || op == BC_IMPORT_FROM)
+            add_module(t, chunk->names[(chunk->code[offset + 1] << 8) | chunk->code[offset + 2]]);
+    }
+    if (is_function)
+        add_function(t, chunk);
+    for (int i = 0; i < chunk->constant_count; ++i)
+    {
+        Value v = chunk->constants[i];
+        if (IS_FUNCTION(v) && AS_FUNCTION(v)->chunk)
+            translate_chunk(t, AS_FUNCTION(v)->chunk, true);
+    }
+}
+
+/* Compile `source` exactly as interpreter_run would, then translate it. */
+static void translate_source(Translation *t, const char *source, const char *name)
+{
+    Lexer lexer;
+    lexer_init(&lexer, source);
+    int count;
+    ASTNode **prog = parse_program(&lexer, &count);
+    optimize_program(prog, count);
+    Chunk *chunk = compile_program(prog, count, name);
+    translate_chunk(t, chunk, false);
+    chunk_free(chunk);
+    free_ast(prog, count);
+}
+
+/* `s` as a C string literal, split after each newline. */
+static void emit_string(FILE *out, const char *s)
+{
+    fputc('"', out);
+    for (; *s; ++s)
+    {
+        unsigned char c = (unsigned char)*s;
+        if (c == '\n')
+            fputs(s[1] ? "\\n\"\n    \"" : "\\n", out);
+        else if (c == '"' || c == '\\' || c == '?')
+            fprintf(out, "\\%c", c);
+        else if (c == '\t')
+            fputs("\\t", out);
+        else if (c < 0x20 || c >= 0x7f)
+            fprintf(out, "\\%03o", c);
+        else
+            fputc(c, out);
+    }
+    fputs("\"", out);
+}
+
+bool aot_bundle_program(const char *path, const char *exec_path, FILE *out)
+{
+    Translation t = {.out = out};
+    module_system_init(NULL, exec_path);
+    char *source = read_file(path);
+
+    fprintf(out, "/* Generated by able_exe --bundle from %s. */\n\n#include \"interpreter/aot.h\"\n\n", path);
+    /* builtins_register imports this before the program runs. */
+    add_module(&t, "builtins");
+    translate_source(&t, source, path);
+    for (int i = 0; i < t.module_count; ++i)
+        translate_source(&t, t.modules[i].source, t.modules[i].name);
+
+    fputs("static const char program_source[] =\n    ", out);
+    emit_string(out, source);
+    fputs(";\n\n", out);
+    for (int i = 0; i < t.module_count; ++i)
+    {
+        fprintf(out, "static const char module_source_%d[] =\n    ", i);
+        emit_string(out, t.modules[i].source);
+        fputs(";\n\n", out);
+    }
+
+    fputs("static const EmbeddedModule modules[] = {\n", out);
+    for (int i = 0; i < t.module_count; ++i)
+        fprintf(out, "    {\"%s\", module_source_%d},\n", t.modules[i].name, i);
+    fputs("    {NULL, NULL},\n};\n\n", out);
+
+    fputs("static const JitPrecompiled functions[] = {\n", out);
+    for (int i = 0; i < t.function_count; ++i)
+    {
+        const JitPrecompiled *fn = &t.functions[i];
+        fprintf(out, "    {\"%s\", %uu, %d, %d, able_fn_%d},\n", fn->name, (unsigned)fn->hash, fn->code_count,
+                fn->local_count, i);
+    }
+    fputs("    {NULL, 0, 0, 0, NULL},\n};\n\n", out);
+
+    fputs("int main(int argc, char *argv[])\n{\n    static const AotProgram program = {\n        .script = ", out);
+    emit_string(out, path);
+    fprintf(out, ",\n        .source = program_source,\n        .modules = modules,\n        .module_count = %d,\n"
+                 "        .functions = functions,\n        .function_count = %d,\n    };\n"
+                 "    (void)argc;\n    return aot_main(&program, argv[0]);\n}\n",
+            t.module_count, t.function_count);
+
+    for (int i = 0; i < t.module_count; ++i)
+    {
+        free(t.modules[i].name);
+        free(t.modules[i].source);
+    }
+    free(t.modules);
+    for (int i = 0; i < t.function_count; ++i)
+        free((char *)t.functions[i].name);
+    free(t.functions);
+    free(source);
+    shape_cleanup();
+    intern_cleanup();
+    return fflush(out) == 0 && !ferror(out);
+}
+
+int aot_main(const AotProgram *program, const char *exec_path)
+{
+    module_set_embedded(program->modules, program->module_count);
+    jit_set_precompiled(program->functions, program->function_count);
+    interpreter_run_script(program->script, program->source, exec_path);
+    return 0;
+}
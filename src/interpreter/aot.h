@@ -0,0 +1,186 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "interpreter/jit.h"
+#include "interpreter/module.h"
+#include "types/value.h"
+
+/*
+ * Bundling. `able_exe --bundle script.abl` writes a C program that embeds
+ * the source of the script and every module it imports, so that linked
+ * against build/libable.a it runs without the source tree. This is not a
+ * translation of the program to C: the bundle compiles and interprets the
+ * embedded sources at startup exactly like able_exe. Only leaf kernels,
+ * the functions the JIT could compile (see jit.h), are precompiled to C
+ * functions, and they bail out to the bytecode on anything but numbers
+ * and booleans.
+ */
+
+typedef struct
+{
+    const char *script; /* path the program was bundled from */
+    const char *source;
+    const EmbeddedModule *modules;
+    int module_count;
+    const JitPrecompiled *functions;
+    int function_count;
+} AotProgram;
+
+/* Write the bundle of the program at `path` and its imports to `out`.
+   Returns false if writing fails. */
+bool aot_bundle_program(const char *path, const char *exec_path, FILE *out);
+
+/* Entry point of a bundle. */
+int aot_main(const AotProgram *program, const char *exec_path);
+
+/* --- helpers for generated code ---
+ *
+ * Each mirrors interpreter_binary_op or interpreter_to_boolean for the
+ * operands it accepts and returns false for everything else, which makes
+ * the generated function bail out.
+ */
+
+static inline bool aot_int(int64_t i, Value *out)
+{
+    /* Wider results are boxed on the heap by the interpreter. */
+    if (i < INT48_MIN || i > INT48_MAX)
+        return false;
+    *out = SMALL_INT_VAL(i);
+    return true;
+}
+
+static inline bool aot_is_number(Value v)
+{
+    return IS_DOUBLE(v) || IS_SMALL_INT(v);
+}
+
+static inline bool aot_add(Value a, Value b, Value *out)
+{
+    if (IS_SMALL_INT(a) && IS_SMALL_INT(b))
+        return aot_int(AS_SMALL_INT(a) + AS_SMALL_INT(b), out);
+    if (!aot_is_number(a) || !aot_is_number(b))
+        return false;
+    *out = NUMBER_VAL(AS_NUMBER(a) + AS_NUMBER(b));
+    return true;
+}
+
+static inline bool aot_sub(Value a, Value b, Value *out)
+{
+    if (IS_SMALL_INT(a) && IS_SMALL_INT(b))
+        return aot_int(AS_SMALL_INT(a) - AS_SMALL_INT(b), out);
+    if (!aot_is_number(a) || !aot_is_number(b))
+        return false;
+    *out = NUMBER_VAL(AS_NUMBER(a) - AS_NUMBER(b));
+    return true;
+}
+
+static inline bool aot_mul(Value a, Value b, Value *out)
+{
+    if (IS_SMALL_INT(a) && IS_SMALL_INT(b))
+    {
+        int64_t x = AS_SMALL_INT(a);
+        int64_t y = AS_SMALL_INT(b);
+        /* 48-bit operands below 2^31 cannot overflow int64. */
+        if (x > INT32_MAX || x < -INT32_MAX || y > INT32_MAX || y < -INT32_MAX)
+            return false;
+        /* The interpreter makes a negative zero product -0.0. */
+        if (x * y == 0 && (x < 0 || y < 0))
+            return false;
+        return aot_int(x * y, out);
+    }
+    if (!aot_is_number(a) || !aot_is_number(b))
+        return false;
+    *out = NUMBER_VAL(AS_NUMBER(a) * AS_NUMBER(b));
+    return true;
+}
+
+static inline bool aot_mod(Value a, Value b, Value *out)
+{
+    if (IS_SMALL_INT(a) && IS_SMALL_INT(b) && AS_SMALL_INT(b) != 0)
+    {
+        int64_t x = AS_SMALL_INT(a);
+        int64_t y = AS_SMALL_INT(b);
+        int64_t rem = y == -1 ? 0 : x % y;
+        /* The interpreter makes a zero remainder of a negative -0.0. */
+        if (rem == 0 && x < 0)
+            return false;
+        return aot_int(rem, out);
+    }
+    if (!aot_is_number(a) || !aot_is_number(b))
+        return false;
+    *out = NUMBER_VAL(fmod(AS_NUMBER(a), AS_NUMBER(b)));
+    return true;
+}
+
+/* A number or boolean as a double, as comparisons see it. */
+static inline bool aot_number(Value v, double *out)
+{
+    if (aot_is_number(v))
+        *out = AS_NUMBER(v);
+    else if (IS_BOOL(v))
+        *out = AS_BOOL(v) ? 1 : 0;
+    else
+        return false;
+    return true;
+}
+
+static inline bool aot_eq(Value a, Value b, Value *out)
+{
+    double x, y;
+    if (VALUE_HAS_SUBTAG(a, VALUE_SUBTAG_CONST) && VALUE_HAS_SUBTAG(b, VALUE_SUBTAG_CONST) &&
+        IS_BOOL(a) == IS_BOOL(b))
+        *out = BOOL_VAL(a.bits == b.bits);
+    else if (aot_number(a, &x) && aot_number(b, &y))
+        *out = BOOL_VAL(x == y);
+    else if (aot_is_number(a) || aot_is_number(b) || IS_BOOL(a) || IS_BOOL(b))
+    {
+        /* A number or boolean against null or undefined. */
+        if (!VALUE_HAS_SUBTAG(a, VALUE_SUBTAG_CONST) && !VALUE_HAS_SUBTAG(b, VALUE_SUBTAG_CONST))
+            return false;
+        *out = BOOL_VAL(false);
+    }
+    else
+        return false;
+    return true;
+}
+
+#define AOT_COMPARE(name, cmp)                              \
+    static inline bool name(Value a, Value b, Value *out)   \
+    {                                                       \
+        double x, y;                                        \
+        if (!aot_number(a, &x) || !aot_number(b, &y))       \
+            return false;                                   \
+        *out = BOOL_VAL(x cmp y);                           \
+        return true;                                        \
+    }
+
+AOT_COMPARE(aot_lt, <)
+AOT_COMPARE(aot_gt, >)
+AOT_COMPARE(aot_lte, <=)
+AOT_COMPARE(aot_gte, >=)
+
+#undef AOT_COMPARE
+
+/* Truthiness: 1 or 0, or -1 when it needs the runtime. */
+static inline int aot_truth(Value v)
+{
+    if (IS_BOOL(v))
+        return AS_BOOL(v);
+    if (aot_is_number(v))
+        return AS_NUMBER(v) != 0;
+    if (IS_NULL(v) || IS_UNDEFINED(v))
+        return 0;
+    return -1;
+}
+
+/* Whether `v` can be returned without an owning copy. */
+static inline bool aot_plain(Value v)
+{
+    return aot_is_number(v) || VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_CONST);
+}
+
+#endif
@@ -3,111 +3,216 @@
 
 #include "interpreter/attr.h"
 
-static Value type_lookup(Type *t, const char *name)
+static Value bind_method(Value receiver, Value attr)
 {
-    Value val = object_get(t->attributes, name);
-    if (val.type != VAL_NULL)
-        return val;
-    for (int i = 0; i < t->base_count; ++i)
+    if (IS_INSTANCE(receiver) && IS_FUNCTION(attr) && AS_FUNCTION(attr)->bind_on_access)
     {
-        val = type_lookup(t->bases[i], name);
-        if (val.type != VAL_NULL && val.type != VAL_UNDEFINED)
-            return val;
+        Value v = BOUND_METHOD_VAL(instance_bind(AS_INSTANCE(receiver), AS_FUNCTION(attr)));
+        return v;
     }
-    Value undef = {.type = VAL_UNDEFINED};
-    return undef;
+    return attr;
 }
 
-Value value_get_attr(Value receiver, const char *name)
+/* value_get_attr without binding methods found on an instance. */
+static Value lookup_attr(Value receiver, const char *name)
 {
-    if (receiver.type == VAL_INSTANCE)
+    if (IS_INSTANCE(receiver))
     {
-        Value attr = object_get(receiver.instance->attributes, name);
-        if (attr.type != VAL_NULL)
-        {
-            if (attr.type == VAL_FUNCTION && attr.func->bind_on_access)
-            {
-                BoundMethod *bm = malloc(sizeof(BoundMethod));
-                bm->self = receiver.instance;
-                bm->func = attr.func;
-                Value v = {.type = VAL_BOUND_METHOD, .bound = bm};
-                return v;
-            }
+        Value attr = object_get_atom(AS_INSTANCE(receiver)->attributes, name);
+        if (!IS_NULL(attr))
             return attr;
-        }
-        attr = type_lookup(receiver.instance->cls, name);
-        if (attr.type != VAL_UNDEFINED && attr.type != VAL_NULL)
-        {
-            if (attr.type == VAL_FUNCTION && attr.func->bind_on_access)
-            {
-                BoundMethod *bm = malloc(sizeof(BoundMethod));
-                bm->self = receiver.instance;
-                bm->func = attr.func;
-                Value v = {.type = VAL_BOUND_METHOD, .bound = bm};
-                return v;
-            }
+        attr = type_lookup(AS_INSTANCE(receiver)->cls, name);
+        if (!IS_UNDEFINED(attr) && !IS_NULL(attr))
             return attr;
-        }
-        Value undef = {.type = VAL_UNDEFINED};
+        Value undef = UNDEFINED_VAL;
         return undef;
     }
-    else if (receiver.type == VAL_TYPE)
+    else if (IS_TYPE(receiver))
     {
-        Value attr = object_get(receiver.cls->attributes, name);
-        if (attr.type == VAL_NULL)
+        Value attr = object_get_atom(AS_TYPE(receiver)->attributes, name);
+        if (IS_NULL(attr))
         {
-            Value undef = {.type = VAL_UNDEFINED};
+            Value undef = UNDEFINED_VAL;
             return undef;
         }
         return attr;
     }
-    else if (receiver.type == VAL_FUNCTION)
+    else if (IS_FUNCTION(receiver))
     {
-        if (!receiver.func->attributes)
+        if (!AS_FUNCTION(receiver)->attributes)
         {
-            Value undef = {.type = VAL_UNDEFINED};
+            Value undef = UNDEFINED_VAL;
             return undef;
         }
-        Value attr = object_get(receiver.func->attributes, name);
-        if (attr.type == VAL_NULL)
+        Value attr = object_get_atom(AS_FUNCTION(receiver)->attributes, name);
+        if (IS_NULL(attr))
         {
-            Value undef = {.type = VAL_UNDEFINED};
+            Value undef = UNDEFINED_VAL;
             return undef;
         }
         return attr;
     }
-    else if (receiver.type == VAL_OBJECT)
+    else if (IS_OBJECT(receiver))
     {
-        return object_get(receiver.obj, name);
+        return object_get_atom(AS_OBJECT(receiver), name);
     }
 
-    Value undef = {.type = VAL_UNDEFINED};
+    Value undef = UNDEFINED_VAL;
     return undef;
 }
 
+Value value_get_attr(Value receiver, const char *name)
+{
+    return bind_method(receiver, lookup_attr(receiver, name));
+}
+
 void value_set_attr(Value receiver, const char *name, Value val)
 {
-    if (receiver.type == VAL_INSTANCE)
+    if (IS_INSTANCE(receiver))
     {
-        object_set(receiver.instance->attributes, name, val);
+        object_set_atom(AS_INSTANCE(receiver)->attributes, name, val);
         return;
     }
-    if (receiver.type == VAL_TYPE)
+    if (IS_TYPE(receiver))
     {
-        object_set(receiver.cls->attributes, name, val);
+        object_set_atom(AS_TYPE(receiver)->attributes, name, val);
+        type_epoch++;
         return;
     }
-    if (receiver.type == VAL_FUNCTION)
+    if (IS_FUNCTION(receiver))
     {
-        if (!receiver.func->attributes)
-            receiver.func->attributes = object_create();
-        object_set(receiver.func->attributes, name, val);
+        if (!AS_FUNCTION(receiver)->attributes)
+            AS_FUNCTION(receiver)->attributes = object_create();
+        object_set_atom(AS_FUNCTION(receiver)->attributes, name, val);
         return;
     }
-    if (receiver.type == VAL_OBJECT)
+    if (IS_OBJECT(receiver))
     {
-        object_set(receiver.obj, name, val);
+        object_set_atom(AS_OBJECT(receiver), name, val);
         return;
     }
 }
 
+/* The object holding `receiver`'s own attributes, if it has one. */
+static Object *attribute_store(Value receiver)
+{
+    switch (value_type(receiver))
+    {
+    case VAL_INSTANCE:
+        return AS_INSTANCE(receiver)->attributes;
+    case VAL_TYPE:
+        return AS_TYPE(receiver)->attributes;
+    case VAL_FUNCTION:
+        return AS_FUNCTION(receiver)->attributes;
+    case VAL_OBJECT:
+        return AS_OBJECT(receiver);
+    default:
+        return NULL;
+    }
+}
+
+static AttrCacheEntry *cache_add(AttrCache *cache, AttrCacheKind kind, const Shape *shape)
+{
+    if (cache->count == ATTR_CACHE_WAYS)
+    {
+        cache->megamorphic = true;
+        return NULL;
+    }
+    AttrCacheEntry *entry = &cache->entries[cache->count++];
+    entry->kind = kind;
+    entry->shape = shape;
+    return entry;
+}
+
+Value value_get_method_cached(Value receiver, const char *name, AttrCache *cache)
+{
+    /* Objects indexed by hash have no shape to key the cache on. */
+    Object *store = attribute_store(receiver);
+    if (!store || !store->shape || cache->megamorphic)
+        return lookup_attr(receiver, name);
+
+    for (int i = 0; i < cache->count; ++i)
+    {
+        AttrCacheEntry *entry = &cache->entries[i];
+        if (entry->shape != store->shape)
+            continue;
+        if (entry->kind == ATTR_CACHE_SLOT)
+        {
+            Value attr = object_get_slot(store, entry->slot);
+            /* A stored null reads as missing; let the slow path decide. */
+            if (IS_NULL(attr))
+                break;
+            return attr;
+        }
+        if (entry->kind == ATTR_CACHE_CLASS && entry->cls == AS_INSTANCE(receiver)->cls &&
+            entry->epoch == type_epoch)
+            return entry->method;
+    }
+
+    int slot = shape_find(store->shape, name);
+    if (slot >= 0)
+    {
+        AttrCacheEntry *entry = cache_add(cache, ATTR_CACHE_SLOT, store->shape);
+        if (entry)
+            entry->slot = slot;
+    }
+    else if (IS_INSTANCE(receiver))
+    {
+        /* Only methods are cached: they are the hot case, and a function
+           value stays valid for as long as type_epoch is unchanged. */
+        Value method = type_lookup(AS_INSTANCE(receiver)->cls, name);
+        if (IS_FUNCTION(method))
+        {
+            AttrCacheEntry *entry = cache_add(cache, ATTR_CACHE_CLASS, store->shape);
+            if (entry)
+            {
+                entry->cls = AS_INSTANCE(receiver)->cls;
+                entry->epoch = type_epoch;
+                entry->method = method;
+            }
+        }
+    }
+    return lookup_attr(receiver, name);
+}
+
+Value value_get_attr_cached(Value receiver, const char *name, AttrCache *cache)
+{
+    return bind_method(receiver, value_get_method_cached(receiver, name, cache));
+}
+
+void value_set_attr_cached(Value receiver, const char *name, Value val, AttrCache *cache)
+{
+    Object *store = attribute_store(receiver);
+    if (!store || !store->shape || cache->megamorphic)
+    {
+        value_set_attr(receiver, name, val);
+        return;
+    }
+
+    for (int i = 0; i < cache->count; ++i)
+    {
+        AttrCacheEntry *entry = &cache->entries[i];
+        if (entry->shape != store->shape)
+            continue;
+        if (entry->kind == ATTR_CACHE_SLOT)
+            object_set_slot(store, entry->slot, val);
+        else if (entry->kind == ATTR_CACHE_ADD)
+            object_append(store, entry->next, val);
+        else
+            continue;
+        if (IS_TYPE(receiver))
+            type_epoch++;
+        return;
+    }
+
+    const Shape *before = store->shape;
+    int slot = shape_find(before, name);
+    value_set_attr(receiver, name, val);
+    if (!store->shape)
+        return;
+    AttrCacheEntry *entry = cache_add(cache, slot >= 0 ? ATTR_CACHE_SLOT : ATTR_CACHE_ADD, before);
+    if (!entry)
+        return;
+    entry->slot = slot;
+    entry->next = store->shape;
+}
@@ -7,7 +7,47 @@
 #include "types/instance.h"
 #include "types/function.h"
 
+/*
+ * Inline cache for one attribute site in a chunk. Entries are keyed by the
+ * shape of the receiver's attribute object and remember the slot holding
+ * the name, the shape transition that adds it, or (for instances) the
+ * method found on the class. A site holds up to ATTR_CACHE_WAYS shapes
+ * (polymorphic) and then stops caching (megamorphic).
+ */
+#define ATTR_CACHE_WAYS 4
+
+typedef enum
+{
+    ATTR_CACHE_SLOT,  /* name lives in `slot` */
+    ATTR_CACHE_ADD,   /* storing name moves the object to shape `next` */
+    ATTR_CACHE_CLASS  /* instance of `cls` inherits `method` */
+} AttrCacheKind;
+
+typedef struct
+{
+    AttrCacheKind kind;
+    const Shape *shape;
+    int slot;
+    Shape *next;
+    const Type *cls;
+    unsigned epoch; /* type_epoch when `method` was resolved */
+    Value method;
+} AttrCacheEntry;
+
+typedef struct AttrCache
+{
+    AttrCacheEntry entries[ATTR_CACHE_WAYS];
+    int count;
+    bool megamorphic;
+} AttrCache;
+
+/* `name` must be interned (see utils/intern.h). */
 Value value_get_attr(Value receiver, const char *name);
 void value_set_attr(Value receiver, const char *name, Value val);
+Value value_get_attr_cached(Value receiver, const char *name, AttrCache *cache);
+/* Like value_get_attr_cached, but a method found through an instance is
+   returned as the plain function, for callers that supply the receiver. */
+Value value_get_method_cached(Value receiver, const char *name, AttrCache *cache);
+void value_set_attr_cached(Value receiver, const char *name, Value val, AttrCache *cache);
 
 #endif
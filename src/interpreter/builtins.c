@@ -1,36 +1,426 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <unistd.h>
+
 #include "interpreter/builtins.h"
+#include "interpreter/annotations.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
 #include "interpreter/module.h"
+#include "interpreter/network.h"
+#include "interpreter/server.h"
+#include "types/list.h"
+#include "types/native.h"
 #include "types/object.h"
 #include "types/promise.h"
+#include "types/str.h"
 #include "types/value.h"
+#include "utils/json.h"
 #include "utils/utils.h"
 
+static Value undefined_value(void)
+{
+    Value undef = UNDEFINED_VAL;
+    return undef;
+}
+
+static Value native_http(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    return network_execute(self->name, args, argc, line, column);
+}
+
+static Value native_server_listen(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    return interpreter_server_listen(args, argc, line, column);
+}
+
+static Value register_handler(const NativeFunction *self, Value *args, AnnotationHandlerType type,
+                              int line, int column)
+{
+    Value name_val = args[0];
+    Value handler_val = args[1];
+    if (!IS_STRING(name_val))
+    {
+        log_script_error(line, column, "%s expects string name", self->name);
+        exit(1);
+    }
+    if (!IS_FUNCTION(handler_val))
+    {
+        log_script_error(line, column, "%s expects function handler", self->name);
+        exit(1);
+    }
+    annotations_register(AS_STRING(name_val), type, handler_val);
+    return undefined_value();
+}
+
+static Value native_register_modifier(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)argc;
+    return register_handler(self, args, ANNOTATION_HANDLER_MODIFIER, line, column);
+}
+
+static Value native_register_decorator(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)argc;
+    return register_handler(self, args, ANNOTATION_HANDLER_DECORATOR, line, column);
+}
+
+static Value native_pr(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)line;
+    (void)column;
+    for (int j = 0; j < argc; ++j)
+        print_value(args[j], 0);
+    printf("\n");
+    return undefined_value();
+}
+
+static Value native_type(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    (void)line;
+    (void)column;
+    const char *type_name = value_type_name(value_type(args[0]));
+    Value res = STRING_VAL(string_from(type_name));
+    return res;
+}
+
+static Value native_bool(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    (void)line;
+    (void)column;
+    Value res = BOOL_VAL(interpreter_to_boolean(args[0]));
+    return res;
+}
+
+static Value native_len(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value arg = args[0];
+    if (IS_STRING(arg))
+    {
+        Value res = INT_VAL((int64_t)string_length(AS_STRING(arg)));
+        return res;
+    }
+    if (IS_LIST(arg))
+    {
+        Value res = INT_VAL(AS_LIST(arg)->count);
+        return res;
+    }
+    if (IS_OBJECT(arg))
+    {
+        Value res = INT_VAL(AS_OBJECT(arg)->count);
+        return res;
+    }
+    log_script_error(line, column, "len() unsupported type");
+    exit(1);
+}
+
+static Value native_int(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    (void)line;
+    (void)column;
+    Value arg = args[0];
+    if (IS_INT(arg))
+        return clone_value(&arg);
+    if (IS_STRING(arg))
+    {
+        /* Parse integer text exactly instead of through a double. */
+        char *end = NULL;
+        errno = 0;
+        long long parsed = strtoll(AS_STRING(arg), &end, 10);
+        if (end != AS_STRING(arg) && errno != ERANGE)
+            return INT_VAL(parsed);
+    }
+    double num = trunc(interpreter_to_number(arg));
+    if (num >= -9223372036854775808.0 && num < 9223372036854775808.0)
+        return INT_VAL((int64_t)num);
+    return NUMBER_VAL(num);
+}
+
+static Value native_float(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    (void)line;
+    (void)column;
+    Value res = NUMBER_VAL(interpreter_to_number(args[0]));
+    return res;
+}
+
+static Value native_str(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value arg = args[0];
+    char buf[64];
+    switch (value_type(arg))
+    {
+    case VAL_NUMBER:
+        if (IS_INT(arg))
+            snprintf(buf, sizeof(buf), "%lld", (long long)AS_INT(arg));
+        else
+            snprintf(buf, sizeof(buf), "%g", AS_NUMBER(arg));
+        return STRING_VAL(string_from(buf));
+    case VAL_BOOL:
+        return STRING_VAL(string_from(AS_BOOL(arg) ? "true" : "false"));
+    case VAL_STRING:
+        return clone_value(&arg);
+    default:
+        log_script_error(line, column, "str() unsupported type");
+        exit(1);
+    }
+}
+
+static Value native_json_stringify(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    char *json = NULL;
+    char *error = NULL;
+    if (!json_stringify_value(&args[0], &json, &error))
+    {
+        if (error)
+        {
+            log_script_error(line, column, "json_stringify failed: %s", error);
+            free(error);
+        }
+        else
+        {
+            log_script_error(line, column, "json_stringify failed");
+        }
+        exit(1);
+    }
+
+    Value res = STRING_VAL(string_from(json));
+    free(json);
+    return res;
+}
+
+static Value native_json_parse(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value arg = args[0];
+    if (!IS_STRING(arg))
+    {
+        log_script_error(line, column, "json_parse() expects a string argument");
+        exit(1);
+    }
+
+    Value parsed = NULL_VAL;
+    char *error = NULL;
+    if (!json_parse_string(AS_STRING(arg), &parsed, &error))
+    {
+        if (error)
+        {
+            log_script_error(line, column, "json_parse failed: %s", error);
+            free(error);
+        }
+        else
+        {
+            log_script_error(line, column, "json_parse failed");
+        }
+        exit(1);
+    }
+
+    return parsed;
+}
+
+static Value native_read_text_file(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value path = args[0];
+    if (!IS_STRING(path))
+    {
+        log_script_error(line, column, "read_text_file() expects a string path");
+        exit(1);
+    }
+
+    char *content = read_file(AS_STRING(path));
+    Value res = STRING_VAL(string_from(content));
+    free(content);
+    return res;
+}
+
+static Value native_dict(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    if (argc == 0)
+        return OBJECT_VAL(object_create());
+    Value arg = args[0];
+    if (!IS_OBJECT(arg))
+    {
+        log_script_error(line, column, "dict() expects an object");
+        exit(1);
+    }
+    return OBJECT_VAL(clone_object(AS_OBJECT(arg)));
+}
+
+static Value native_range(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value arg = args[0];
+    if (!IS_NUMBER(arg))
+    {
+        log_script_error(line, column, "range() expects a number");
+        exit(1);
+    }
+    int limit = (int)AS_NUMBER(arg);
+    return LIST_VAL(list_range(0, limit));
+}
+
+static Value native_input(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)line;
+    (void)column;
+    if (argc == 1)
+    {
+        Value prompt = args[0];
+        if (IS_STRING(prompt))
+            fwrite(AS_STRING(prompt), 1, string_length(AS_STRING(prompt)), stdout);
+    }
+    char buf[256];
+    if (!fgets(buf, sizeof(buf), stdin))
+    {
+        buf[0] = '\0';
+    }
+    size_t len = strlen(buf);
+    if (len > 0 && buf[len - 1] == '\n')
+        buf[len - 1] = '\0';
+    return STRING_VAL(string_from(buf));
+}
+
+static Value native_time(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)args;
+    (void)argc;
+    (void)line;
+    (void)column;
+    double t = (double)time(NULL);
+    return NUMBER_VAL(t);
+}
+
+static Value native_gc_stats(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)args;
+    (void)argc;
+    (void)line;
+    (void)column;
+    return gc_stats_value();
+}
+
+static Value native_sleep(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)argc;
+    Value arg = args[0];
+    if (!IS_NUMBER(arg))
+    {
+        log_script_error(line, column, "sleep() expects a number");
+        exit(1);
+    }
+    double sec = interpreter_to_number(arg);
+    if (sec > 0)
+        usleep((useconds_t)(sec * 1000000));
+    return undefined_value();
+}
+
+static Value native_list(const NativeFunction *self, Value *args, int argc, int line, int column)
+{
+    (void)self;
+    (void)line;
+    (void)column;
+    List *list = list_create();
+    if (argc == 1)
+    {
+        Value arg = args[0];
+        if (IS_LIST(arg))
+        {
+            free_list(list);
+            list = clone_list(AS_LIST(arg));
+        }
+        else
+        {
+            list_append(list, arg);
+        }
+    }
+    Value res = LIST_VAL(list);
+    return res;
+}
+
+static const NativeFunction natives[] = {
+    {"pr", native_pr, 0, NATIVE_VARIADIC},
+    {"input", native_input, 0, 1},
+    {"type", native_type, 1, 1},
+    {"len", native_len, 1, 1},
+    {"bool", native_bool, 1, 1},
+    {"int", native_int, 1, 1},
+    {"float", native_float, 1, 1},
+    {"str", native_str, 1, 1},
+    {"list", native_list, 0, 1},
+    {"dict", native_dict, 0, 1},
+    {"range", native_range, 1, 1},
+    {"time", native_time, 0, 0},
+    {"sleep", native_sleep, 1, 1},
+    {"gc_stats", native_gc_stats, 0, 0},
+    {"register_modifier", native_register_modifier, 2, 2},
+    {"register_decorator", native_register_decorator, 2, 2},
+    {"server_listen", native_server_listen, 0, NATIVE_VARIADIC},
+    {"json_stringify", native_json_stringify, 1, 1},
+    {"json_parse", native_json_parse, 1, 1},
+    {"read_text_file", native_read_text_file, 1, 1},
+    {"GET", native_http, 0, NATIVE_VARIADIC},
+    {"POST", native_http, 0, NATIVE_VARIADIC},
+    {"PUT", native_http, 0, NATIVE_VARIADIC},
+    {"PATCH", native_http, 0, NATIVE_VARIADIC},
+    {"DELETE", native_http, 0, NATIVE_VARIADIC},
+    {"HEAD", native_http, 0, NATIVE_VARIADIC},
+    {"OPTIONS", native_http, 0, NATIVE_VARIADIC},
+};
+
 void builtins_register(Env *global_env, const char *file_path)
 {
-    const char *funcs[] = {"pr", "input", "type", "len", "bool", "int", "float",
-                            "str", "list", "dict", "range", "register_modifier", "register_decorator",
-                            "server_listen", "json_stringify", "json_parse", "read_text_file"};
-    Value undef = {.type = VAL_UNDEFINED};
-    for (size_t i = 0; i < sizeof(funcs) / sizeof(funcs[0]); ++i)
-        set_variable(global_env, funcs[i], undef);
+    for (size_t i = 0; i < sizeof(natives) / sizeof(natives[0]); ++i)
+    {
+        Value native = NATIVE_VAL(&natives[i]);
+        set_variable(global_env, natives[i].name, native);
+    }
 
+    Value undef = UNDEFINED_VAL;
     const char *errors[] = {"TypeError", "ImportError", "StopIteration"};
     for (size_t i = 0; i < sizeof(errors) / sizeof(errors[0]); ++i)
         set_variable(global_env, errors[i], undef);
 
-    Value ver = {.type = VAL_STRING, .str = strdup("0.1.0")};
+    Value ver = STRING_VAL(string_from("0.1.0"));
     set_variable(global_env, "__version__", ver);
-    Value filev = {.type = VAL_STRING, .str = strdup(file_path)};
+    Value filev = STRING_VAL(string_from(file_path));
     set_variable(global_env, "__file__", filev);
     Value promise_ns = promise_namespace_value();
     set_variable(global_env, "Promise", promise_ns);
 
     /* Load Able-defined built-ins from lib/builtins.abl */
     Value mod = import_module_value("builtins", 0, 0);
-    Object *obj = mod.obj;
+    Object *obj = AS_OBJECT(mod);
     for (int i = 0; i < obj->count; ++i)
     {
-        set_variable(global_env, obj->pairs[i].key, obj->pairs[i].value);
+        set_variable(global_env, object_key(obj, i), obj->values[i]);
     }
 }
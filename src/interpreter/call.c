@@ -3,50 +3,35 @@
 #include "types/env.h"
 #include "types/function.h"
 #include "types/instance.h"
+#include "types/native.h"
 #include "types/promise.h"
 #include "types/type.h"
+#include "utils/intern.h"
 #include "utils/utils.h"
 #include "interpreter/attr.h"
 #include "interpreter/stack.h"
 #include "interpreter/interpreter.h"
-
-extern CallStack call_stack;
+#include "interpreter/vm.h"
 
 static Value run_async_task(AsyncTask *task)
 {
-    Function *fn = task->fn;
-    Env *env = env_create(fn->env);
-    int offset = 0;
-    if (task->has_self)
-    {
-        set_variable(env, fn->params[0], task->self);
-        offset = 1;
-    }
-    for (int i = 0; i < task->arg_count; ++i)
-        set_variable(env, fn->params[i + offset], task->args[i]);
-
-    CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
-    push_frame(&call_stack, frame);
-    Value result = run_ast(fn->body, fn->body_count);
-    pop_frame(&call_stack);
-    env_release(env);
-    return result;
+    return vm_call(task->fn, task->has_self, task->self, task->args, task->arg_count);
 }
 
 Value interpreter_create_async_promise(Function *fn, Value *args, int arg_count, bool has_self, Value self, int line, int column)
 {
     AsyncTask *task = async_task_create(fn, args, arg_count, has_self, self, line, column);
     Promise *promise = promise_create_with_task(task);
-    Value promise_val = {.type = VAL_PROMISE, .promise = promise};
+    Value promise_val = PROMISE_VAL(promise);
     return promise_val;
 }
 
 Value interpreter_await(Value awaited, int line, int column)
 {
     Value current = clone_value(&awaited);
-    while (current.type == VAL_PROMISE)
+    while (IS_PROMISE(current))
     {
-        Promise *promise = current.promise;
+        Promise *promise = AS_PROMISE(current);
         PromiseState state = promise_state(promise);
 
         if (state == PROMISE_PENDING)
@@ -71,7 +56,7 @@ Value interpreter_await(Value awaited, int line, int column)
         if (state == PROMISE_FULFILLED)
         {
             Value next = promise_clone_result(promise);
-            if (next.type == VAL_PROMISE && next.promise == promise)
+            if (IS_PROMISE(next) && AS_PROMISE(next) == promise)
             {
                 free_value(next);
                 free_value(current);
@@ -87,8 +72,8 @@ Value interpreter_await(Value awaited, int line, int column)
         {
             Value reason = promise_clone_reason(promise);
             free_value(current);
-            if (reason.type == VAL_STRING)
-                log_script_error(line, column, "Promise rejected: %s", reason.str);
+            if (IS_STRING(reason))
+                log_script_error(line, column, "Promise rejected: %s", AS_STRING(reason));
             else
                 log_script_error(line, column, "Promise rejected");
             free_value(reason);
@@ -101,98 +86,99 @@ Value interpreter_await(Value awaited, int line, int column)
     return current;
 }
 
+static void check_native_arity(const NativeFunction *native, int arg_count, int line, int column)
+{
+    if (arg_count >= native->min_args && (native->max_args == NATIVE_VARIADIC || arg_count <= native->max_args))
+        return;
+    if (native->min_args == native->max_args)
+        log_script_error(line, column, "%s() expects %d argument%s, but got %d", native->name,
+                         native->min_args, native->min_args == 1 ? "" : "s", arg_count);
+    else if (native->max_args == NATIVE_VARIADIC)
+        log_script_error(line, column, "%s() expects at least %d arguments, but got %d", native->name,
+                         native->min_args, arg_count);
+    else
+        log_script_error(line, column, "%s() expects %d to %d arguments, but got %d", native->name,
+                         native->min_args, native->max_args, arg_count);
+    exit(1);
+}
+
+Value interpreter_call_method(Function *fn, Value self, Value *args, int arg_count, int line, int column)
+{
+    if (fn->param_count - 1 != arg_count)
+    {
+        log_script_error(line, column,
+                         "Function '%s' expects %d arguments, but got %d",
+                         fn->name ? fn->name : "anonymous", fn->param_count - 1, arg_count);
+        exit(1);
+    }
+    if (fn->is_async)
+        return interpreter_create_async_promise(fn, args, arg_count, true, self, line, column);
+    return vm_call(fn, true, self, args, arg_count);
+}
+
 Value interpreter_call_value(Value callee, Value *args, int arg_count, int line, int column)
 {
-    if (callee.type == VAL_BOUND_METHOD)
+    if (IS_NATIVE(callee))
     {
-        Function *fn = callee.bound->func;
-        if (fn->param_count - 1 != arg_count)
-        {
-            log_script_error(line, column,
-                             "Function expects %d arguments, but got %d",
-                             fn->param_count - 1, arg_count);
-            exit(1);
-        }
-        Value self_val = {.type = VAL_INSTANCE, .instance = callee.bound->self};
-        if (fn->is_async)
-            return interpreter_create_async_promise(fn, args, arg_count, true, self_val, line, column);
-        Env *env = env_create(fn->env);
-        set_variable(env, fn->params[0], self_val);
-        for (int p = 0; p < arg_count; ++p)
-            set_variable(env, fn->params[p + 1], args[p]);
-        CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
-        push_frame(&call_stack, frame);
-        Value result = run_ast(fn->body, fn->body_count);
-        pop_frame(&call_stack);
-        Value ret_val = clone_value(&result);
-        env_release(env);
-        return ret_val;
+        check_native_arity(AS_NATIVE(callee), arg_count, line, column);
+        return AS_NATIVE(callee)->impl(AS_NATIVE(callee), args, arg_count, line, column);
+    }
+    if (IS_BOUND_METHOD(callee))
+    {
+        Value self_val = INSTANCE_VAL(AS_BOUND_METHOD(callee)->self);
+        return interpreter_call_method(AS_BOUND_METHOD(callee)->func, self_val, args, arg_count, line, column);
     }
-    if (callee.type == VAL_TYPE && promise_type_is_namespace(callee.cls))
+    if (IS_TYPE(callee) && promise_type_is_namespace(AS_TYPE(callee)))
     {
         log_script_error(line, column, "Promise cannot be instantiated directly");
         exit(1);
     }
-    if (callee.type == VAL_TYPE)
+    if (IS_TYPE(callee))
     {
-        Instance *inst = instance_create(callee.cls);
-        Value inst_val = {.type = VAL_INSTANCE, .instance = inst};
-        Value init = value_get_attr(inst_val, "init");
-        if (init.type == VAL_BOUND_METHOD)
+        Instance *inst = instance_create(AS_TYPE(callee));
+        Value inst_val = INSTANCE_VAL(inst);
+        /* A fresh instance has no attributes of its own, so init can only
+           come from the class; call it without binding a method value. */
+        Value init = type_lookup(AS_TYPE(callee), intern("init"));
+        if (IS_FUNCTION(init) && AS_FUNCTION(init)->bind_on_access)
         {
-            Function *fn = init.bound->func;
+            Function *fn = AS_FUNCTION(init);
             if (fn->param_count - 1 != arg_count)
             {
                 log_script_error(line, column, "init expects %d arguments, got %d",
                                  fn->param_count - 1, arg_count);
                 exit(1);
             }
-            Env *env = env_create(fn->env);
-            Value selfv = {.type = VAL_INSTANCE, .instance = init.bound->self};
-            set_variable(env, fn->params[0], selfv);
-            for (int p = 0; p < arg_count; ++p)
-                set_variable(env, fn->params[p + 1], args[p]);
-            CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
-            push_frame(&call_stack, frame);
-            run_ast(fn->body, fn->body_count);
-            pop_frame(&call_stack);
-            env_release(env);
+            Value ignored = vm_call(fn, true, inst_val, args, arg_count);
+            free_value(ignored);
         }
         return inst_val;
     }
-    if (callee.type != VAL_FUNCTION)
+    if (!IS_FUNCTION(callee))
     {
         log_script_error(line, column, "Attempting to call non-function");
         exit(1);
     }
-    Function *fn = callee.func;
+    Function *fn = AS_FUNCTION(callee);
     if (fn->param_count != arg_count)
     {
-        log_script_error(line, column, "Function expects %d arguments, but got %d",
-                         fn->param_count, arg_count);
+        log_script_error(line, column, "Function '%s' expects %d arguments, but got %d",
+                         fn->name ? fn->name : "anonymous", fn->param_count, arg_count);
         exit(1);
     }
     if (fn->is_async)
     {
-        Value undef = {.type = VAL_UNDEFINED};
+        Value undef = UNDEFINED_VAL;
         return interpreter_create_async_promise(fn, args, arg_count, false, undef, line, column);
     }
-    Env *env = env_create(fn->env);
-    for (int p = 0; p < arg_count; ++p)
-        set_variable(env, fn->params[p], args[p]);
-    CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
-    push_frame(&call_stack, frame);
-    Value result = run_ast(fn->body, fn->body_count);
-    pop_frame(&call_stack);
-    Value ret_val = clone_value(&result);
-    env_release(env);
-    return ret_val;
+    Value undef = UNDEFINED_VAL;
+    return vm_call(fn, false, undef, args, arg_count);
 }
 
 Value interpreter_call_and_await(Value callee, Value *args, int arg_count, int line, int column)
 {
     Value result = interpreter_call_value(callee, args, arg_count, line, column);
-    if (result.type != VAL_PROMISE)
+    if (!IS_PROMISE(result))
         return result;
 
     Value awaited = interpreter_await(result, line, column);
@@ -0,0 +1,752 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "interpreter/gc.h"
+#include "interpreter/annotations.h"
+#include "interpreter/module.h"
+#include "interpreter/vm.h"
+#include "types/function.h"
+#include "types/instance.h"
+#include "types/list.h"
+#include "types/object.h"
+#include "types/promise.h"
+#include "types/type.h"
+#include "utils/utils.h"
+
+/* Collect once this many objects are tracked, and after each collection
+   once twice as many as survived it. */
+#define GC_MIN_THRESHOLD 4096
+#define GC_DEFAULT_STEP 1000
+#define GC_DEFAULT_YOUNG 1024
+/* Pause histogram: bucket i counts pauses under 2^(i+1) microseconds, the
+   last one everything longer. */
+#define GC_PAUSE_BUCKETS 16
+
+bool gc_requested = false;
+bool gc_incremental = false;
+
+/* A reached allocation. `grey` holds the value while it waits to be
+   scanned and is 0 afterwards, or from the start for allocations scanned
+   where they are reached. */
+typedef struct
+{
+    const void *ptr;
+    uint64_t grey;
+} Mark;
+
+static struct
+{
+    bool enabled;
+    bool stats;
+    GcObject *objects; // newest first: the young, then the old
+    int count;
+    int young_count;
+    int threshold;
+    Value **roots;
+    int root_count;
+    int root_capacity;
+    /* Every allocation reached so far (open addressing, capacity a power
+       of two) and the values left to scan. In incremental mode these
+       outlive a collection. */
+    Mark *marks;
+    size_t mark_count;
+    size_t mark_capacity;
+    Value *pending;
+    int pending_count;
+    int pending_capacity;
+    int step;
+    long budget;          // values to scan in the next marking step
+    int previous_pending; // left to scan after the last one
+    int young_threshold;
+    bool marking;    // an old-generation cycle is under way
+    bool cycle_due;  // marks are not yet complete for the old generation
+    int collections;
+    int minor_collections;
+    int steps;
+    long freed[3]; // by GcKind
+    long pauses[GC_PAUSE_BUCKETS];
+    long longest_pause;
+} gc;
+
+void gc_init(void)
+{
+    gc.enabled = env_flag("ABLE_GC", true);
+    gc.stats = env_flag("ABLE_GC_STATS", false);
+    gc.threshold = GC_MIN_THRESHOLD;
+    gc.young_count = 0;
+    gc.collections = 0;
+    gc.minor_collections = 0;
+    gc.steps = 0;
+    memset(gc.freed, 0, sizeof(gc.freed));
+    memset(gc.pauses, 0, sizeof(gc.pauses));
+    gc.longest_pause = 0;
+    gc_requested = false;
+    gc_incremental = false;
+}
+
+void gc_track(GcObject *object, GcKind kind)
+{
+    object->kind = kind;
+    object->old = false;
+    object->prev = NULL;
+    object->next = gc.objects;
+    if (gc.objects)
+        gc.objects->prev = object;
+    gc.objects = object;
+    gc.young_count++;
+    if (++gc.count >= gc.threshold && gc.enabled)
+        gc_requested = true;
+}
+
+void gc_untrack(GcObject *object)
+{
+    if (object->prev)
+        object->prev->next = object->next;
+    else
+        gc.objects = object->next;
+    if (object->next)
+        object->next->prev = object->prev;
+    if (!object->old)
+        gc.young_count--;
+    gc.count--;
+}
+
+void gc_push_root(Value *slot)
+{
+    if (gc.root_count == gc.root_capacity)
+    {
+        gc.root_capacity = gc.root_capacity ? gc.root_capacity * 2 : 16;
+        gc.roots = realloc(gc.roots, sizeof(Value *) * gc.root_capacity);
+        if (!gc.roots)
+        {
+            log_error("Out of memory while registering a root");
+            exit(1);
+        }
+    }
+    gc.roots[gc.root_count++] = slot;
+}
+
+void gc_pop_roots(int count)
+{
+    gc.root_count -= count;
+}
+
+// ————— MARKING ————— //
+
+/* The allocation behind `v`, or NULL for inline values and natives. */
+static const void *heap_pointer(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_NUMBER:
+        return IS_INT64_BOX(v) ? AS_INT64_BOX(v) : NULL;
+    case VAL_STRING:
+        return AS_STRING(v);
+    case VAL_OBJECT:
+        return AS_OBJECT(v);
+    case VAL_LIST:
+        return AS_LIST(v);
+    case VAL_INSTANCE:
+        return AS_INSTANCE(v);
+    case VAL_FUNCTION:
+        return AS_FUNCTION(v);
+    case VAL_TYPE:
+        return AS_TYPE(v);
+    case VAL_BOUND_METHOD:
+        return AS_BOUND_METHOD(v);
+    case VAL_PROMISE:
+        return AS_PROMISE(v);
+    default:
+        return NULL;
+    }
+}
+
+static size_t pointer_hash(const void *ptr)
+{
+    return (size_t)(((uint64_t)(uintptr_t)ptr * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+static Mark *find_mark(const void *ptr)
+{
+    if (gc.mark_count == 0)
+        return NULL;
+    size_t mask = gc.mark_capacity - 1;
+    for (size_t i = pointer_hash(ptr) & mask; gc.marks[i].ptr; i = (i + 1) & mask)
+    {
+        if (gc.marks[i].ptr == ptr)
+            return &gc.marks[i];
+    }
+    return NULL;
+}
+
+static bool is_marked(const void *ptr)
+{
+    return find_mark(ptr) != NULL;
+}
+
+static Mark *insert_mark(const void *ptr)
+{
+    size_t mask = gc.mark_capacity - 1;
+    size_t i = pointer_hash(ptr) & mask;
+    while (gc.marks[i].ptr)
+        i = (i + 1) & mask;
+    gc.marks[i] = (Mark){.ptr = ptr, .grey = 0};
+    gc.mark_count++;
+    return &gc.marks[i];
+}
+
+/* Mark `ptr`; NULL if it already was. */
+static Mark *mark_pointer(const void *ptr)
+{
+    if (is_marked(ptr))
+        return NULL;
+    if ((gc.mark_count + 1) * 2 > gc.mark_capacity)
+    {
+        Mark *old = gc.marks;
+        size_t old_capacity = gc.mark_capacity;
+        gc.mark_capacity = old_capacity ? old_capacity * 2 : 1024;
+        gc.marks = calloc(gc.mark_capacity, sizeof(Mark));
+        if (!gc.marks)
+        {
+            log_error("Out of memory while collecting garbage");
+            exit(1);
+        }
+        gc.mark_count = 0;
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old[i].ptr)
+                *insert_mark(old[i].ptr) = old[i];
+        }
+        free(old);
+    }
+    return insert_mark(ptr);
+}
+
+/* Remove the mark for `ptr`, shifting back the entries probed past it. */
+static void unmark(const void *ptr)
+{
+    Mark *mark = find_mark(ptr);
+    if (!mark)
+        return;
+    size_t mask = gc.mark_capacity - 1;
+    size_t hole = (size_t)(mark - gc.marks);
+    for (size_t i = (hole + 1) & mask; gc.marks[i].ptr; i = (i + 1) & mask)
+    {
+        size_t home = pointer_hash(gc.marks[i].ptr) & mask;
+        /* Entry i may fill the hole unless its home lies in (hole, i]. */
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            gc.marks[hole] = gc.marks[i];
+            hole = i;
+        }
+    }
+    gc.marks[hole] = (Mark){0};
+    gc.mark_count--;
+}
+
+static void clear_marks(void)
+{
+    if (gc.marks)
+        memset(gc.marks, 0, sizeof(Mark) * gc.mark_capacity);
+    gc.mark_count = 0;
+    gc.pending_count = 0;
+}
+
+void gc_mark_value(Value v)
+{
+    const void *ptr = heap_pointer(v);
+    Mark *mark = ptr ? mark_pointer(ptr) : NULL;
+    if (!mark)
+        return;
+    mark->grey = v.bits;
+    if (gc.pending_count == gc.pending_capacity)
+    {
+        gc.pending_capacity = gc.pending_capacity ? gc.pending_capacity * 2 : 256;
+        gc.pending = realloc(gc.pending, sizeof(Value) * gc.pending_capacity);
+        if (!gc.pending)
+        {
+            log_error("Out of memory while collecting garbage");
+            exit(1);
+        }
+    }
+    gc.pending[gc.pending_count++] = v;
+}
+
+void gc_mark_env(Env *env)
+{
+    for (Env *e = env; e && mark_pointer(e); e = e->parent)
+    {
+        Variable *var, *tmp;
+        HASH_ITER(hh, e->vars, var, tmp)
+        {
+            gc_mark_value(var->value);
+        }
+    }
+}
+
+static void mark_fields(Object *obj)
+{
+    for (int i = 0; i < obj->count; ++i)
+        gc_mark_value(obj->values[i]);
+}
+
+/* Attributes are marked themselves so that stores into them are seen. */
+static void mark_attributes(Object *obj)
+{
+    if (obj && mark_pointer(obj))
+        mark_fields(obj);
+}
+
+/* Mark what a marked value refers to. */
+static void scan(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_LIST:
+    {
+        /* All of the buffer: a slice shares it with its parent. */
+        ListBuffer *buffer = AS_LIST(v)->buffer;
+        if (buffer && mark_pointer(buffer))
+        {
+            for (int i = 0; i < buffer->count; ++i)
+                gc_mark_value(buffer->items[i]);
+        }
+        break;
+    }
+    case VAL_OBJECT:
+        mark_fields(AS_OBJECT(v));
+        break;
+    case VAL_INSTANCE:
+    {
+        Instance *inst = AS_INSTANCE(v);
+        mark_attributes(inst->attributes);
+        if (inst->cls)
+            gc_mark_value(TYPE_VAL(inst->cls));
+        for (int i = 0; i < inst->method_count; ++i)
+            gc_mark_value(FUNCTION_VAL(inst->methods[i]->func));
+        break;
+    }
+    case VAL_FUNCTION:
+    {
+        Function *fn = AS_FUNCTION(v);
+        mark_attributes(fn->attributes);
+        gc_mark_env(fn->env);
+        for (int i = 0; i < fn->upvalue_count; ++i)
+        {
+            if (mark_pointer(fn->upvalues[i]))
+                gc_mark_value(*fn->upvalues[i]->location);
+        }
+        break;
+    }
+    case VAL_TYPE:
+    {
+        Type *type = AS_TYPE(v);
+        mark_attributes(type->attributes);
+        for (int i = 0; i < type->base_count; ++i)
+            gc_mark_value(TYPE_VAL(type->bases[i]));
+        break;
+    }
+    case VAL_BOUND_METHOD:
+        gc_mark_value(INSTANCE_VAL(AS_BOUND_METHOD(v)->self));
+        gc_mark_value(FUNCTION_VAL(AS_BOUND_METHOD(v)->func));
+        break;
+    case VAL_PROMISE:
+    {
+        Promise *promise = AS_PROMISE(v);
+        gc_mark_value(promise->result);
+        gc_mark_value(promise->reason);
+        AsyncTask *task = promise->task;
+        if (task)
+        {
+            gc_mark_value(FUNCTION_VAL(task->fn));
+            for (int i = 0; i < task->arg_count; ++i)
+                gc_mark_value(task->args[i]);
+            gc_mark_value(task->self);
+        }
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+/* Scan up to `budget` pending values, or all of them if it is negative. */
+static void drain(long budget)
+{
+    while (gc.pending_count > 0 && budget != 0)
+    {
+        Value v = gc.pending[--gc.pending_count];
+        /* Skip it if it was freed since it was reached, or already scanned
+           after being reached again. */
+        Mark *mark = find_mark(heap_pointer(v));
+        if (!mark || mark->grey != v.bits)
+            continue;
+        mark->grey = 0;
+        scan(v);
+        budget--;
+    }
+}
+
+static void mark_roots(void)
+{
+    vm_mark_roots();
+    module_mark_roots();
+    annotations_mark_roots();
+    for (int i = 0; i < gc.root_count; ++i)
+        gc_mark_value(*gc.roots[i]);
+}
+
+static bool holds_references(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_LIST:
+    case VAL_OBJECT:
+    case VAL_INSTANCE:
+    case VAL_FUNCTION:
+    case VAL_TYPE:
+    case VAL_BOUND_METHOD:
+    case VAL_PROMISE:
+        return true;
+    default:
+        return false;
+    }
+}
+
+void gc_record_store(const void *owner, Value v)
+{
+    /* A container not marked yet is scanned whenever it is reached. */
+    if (holds_references(v) && is_marked(owner))
+        gc_mark_value(v);
+}
+
+void gc_record_free(const void *ptr)
+{
+    unmark(ptr);
+}
+
+// ————— SWEEPING ————— //
+
+/* free_value for what garbage holds. Marked values stay, even if this
+   was their last counted reference: the VM may still be reading them.
+   Tracked objects are left to the sweep. */
+static void release(Value v)
+{
+    const void *ptr = heap_pointer(v);
+    if (!ptr || is_marked(ptr))
+        return;
+    switch (value_type(v))
+    {
+    case VAL_LIST:
+        free_list_with(AS_LIST(v), release);
+        break;
+    case VAL_OBJECT:
+        free_object_with(AS_OBJECT(v), release);
+        break;
+    case VAL_BOUND_METHOD:
+    {
+        BoundMethod *bm = AS_BOUND_METHOD(v);
+        if (bm->ref_count > 0 && --bm->ref_count == 0)
+            bound_method_free(bm);
+        break;
+    }
+    case VAL_STRING:
+    case VAL_NUMBER:
+        free_value(v);
+        break;
+    default:
+        break;
+    }
+}
+
+/* Free every tracked object that is not marked, or only the young ones. */
+static void sweep(bool young_only)
+{
+    int count = 0;
+    for (GcObject *object = gc.objects; object && !(young_only && object->old); object = object->next)
+    {
+        if (!is_marked(object))
+            count++;
+    }
+    if (count == 0)
+        return;
+
+    /* `gc` is the first member of each tracked struct. */
+    GcObject **garbage = malloc(sizeof(GcObject *) * count);
+    if (!garbage)
+    {
+        log_error("Out of memory while collecting garbage");
+        exit(1);
+    }
+    count = 0;
+    for (GcObject *object = gc.objects; object && !(young_only && object->old); object = object->next)
+    {
+        if (!is_marked(object))
+            garbage[count++] = object;
+    }
+
+    /* Releasing a closure's Env can free its variables, which may hold the
+       last counted reference to other garbage: pin that first. */
+    for (int i = 0; i < count; ++i)
+    {
+        if (garbage[i]->kind == GC_INSTANCE)
+            ((Instance *)garbage[i])->ref_count++;
+        else if (garbage[i]->kind == GC_PROMISE)
+            ((Promise *)garbage[i])->ref_count++;
+    }
+    /* Upvalues can be shared; marking one frees it only once, and its mark
+       goes with the others below. */
+    Upvalue **upvalues = NULL;
+    int upvalue_count = 0;
+    int upvalue_capacity = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        if (garbage[i]->kind != GC_CLOSURE)
+            continue;
+        Function *fn = (Function *)garbage[i];
+        env_release(fn->env);
+        fn->env = NULL;
+        for (int j = 0; j < fn->upvalue_count; ++j)
+        {
+            Upvalue *up = fn->upvalues[j];
+            if (!mark_pointer(up) || up->location != &up->closed)
+                continue;
+            release(up->closed);
+            if (upvalue_count == upvalue_capacity)
+            {
+                upvalue_capacity = upvalue_capacity ? upvalue_capacity * 2 : 16;
+                upvalues = realloc(upvalues, sizeof(Upvalue *) * upvalue_capacity);
+                if (!upvalues)
+                {
+                    log_error("Out of memory while collecting garbage");
+                    exit(1);
+                }
+            }
+            upvalues[upvalue_count++] = up;
+        }
+    }
+
+    for (int i = 0; i < count; ++i)
+    {
+        GcKind kind = garbage[i]->kind;
+        if (kind == GC_CLOSURE)
+            function_free_closure((Function *)garbage[i], release);
+        else if (kind == GC_INSTANCE)
+            instance_destroy((Instance *)garbage[i], release);
+        else
+            promise_destroy((Promise *)garbage[i], release);
+        gc.freed[kind]++;
+    }
+    free(garbage);
+    for (int i = 0; i < upvalue_count; ++i)
+    {
+        unmark(upvalues[i]);
+        free(upvalues[i]);
+    }
+    free(upvalues);
+}
+
+/* Everything that survived a collection is old. */
+static void promote(void)
+{
+    for (GcObject *object = gc.objects; object && !object->old; object = object->next)
+        object->old = true;
+    gc.young_count = 0;
+}
+
+static void finish_cycle(void)
+{
+    sweep(false);
+    promote();
+    gc.marking = false;
+    gc.collections++;
+    gc.threshold = gc.count * 2 > GC_MIN_THRESHOLD ? gc.count * 2 : GC_MIN_THRESHOLD;
+    gc_requested = false;
+}
+
+static void record_pause(const struct timespec *start)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    long us = (long)(end.tv_sec - start->tv_sec) * 1000000L + (end.tv_nsec - start->tv_nsec) / 1000;
+    int bucket = 0;
+    while (bucket < GC_PAUSE_BUCKETS - 1 && (2L << bucket) <= us)
+        bucket++;
+    gc.pauses[bucket]++;
+    if (us > gc.longest_pause)
+        gc.longest_pause = us;
+}
+
+void gc_collect(void)
+{
+    if (!gc.enabled || !vm_can_collect())
+        return;
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    /* From scratch, which also completes an incremental cycle. */
+    clear_marks();
+    mark_roots();
+    drain(-1);
+    finish_cycle();
+    gc.cycle_due = false;
+    record_pause(&start);
+}
+
+static int env_count(const char *name, int fallback)
+{
+    const char *value = getenv(name);
+    int count = value ? atoi(value) : 0;
+    return count > 0 ? count : fallback;
+}
+
+GcIncremental gc_incremental_defaults(void)
+{
+    const char *mode = getenv("ABLE_GC_MODE");
+    return (GcIncremental){
+        .enabled = mode && strcmp(mode, "incremental") == 0,
+        .step = env_count("ABLE_GC_STEP", GC_DEFAULT_STEP),
+        .young = env_count("ABLE_GC_YOUNG", GC_DEFAULT_YOUNG),
+    };
+}
+
+void gc_set_incremental(const GcIncremental *config)
+{
+    gc.step = config->step > 0 ? config->step : GC_DEFAULT_STEP;
+    gc.young_threshold = config->young > 0 ? config->young : GC_DEFAULT_YOUNG;
+    bool enabled = config->enabled && gc.enabled;
+    if (enabled == gc_incremental)
+        return;
+    /* Marks left by a full collection miss every free since, so the old
+       generation starts with a cycle of its own. */
+    gc_incremental = enabled;
+    clear_marks();
+    gc.marking = false;
+    gc.cycle_due = enabled;
+}
+
+void gc_step(void)
+{
+    if (!gc.enabled || !vm_can_collect())
+        return;
+    if (!gc_incremental)
+    {
+        if (gc_requested)
+            gc_collect();
+        return;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    if (gc.marking || gc.cycle_due || gc.count - gc.young_count >= gc.threshold)
+    {
+        if (!gc.marking)
+        {
+            clear_marks();
+            mark_roots();
+            gc.marking = true;
+            gc.cycle_due = false;
+            gc.budget = gc.step;
+            gc.previous_pending = gc.pending_count;
+        }
+        drain(gc.budget);
+        /* Stores in between can mark faster than steps scan; when they
+           did, double the steps until marking gains on the program. */
+        if (gc.pending_count >= gc.previous_pending)
+            gc.budget *= 2;
+        gc.previous_pending = gc.pending_count;
+        /* Marked through: catch what the roots gained since, and sweep. */
+        if (gc.pending_count == 0)
+        {
+            mark_roots();
+            drain(-1);
+            finish_cycle();
+        }
+        gc.steps++;
+    }
+    else if (gc.young_count >= gc.young_threshold)
+    {
+        /* Old objects are still marked, so marking stops at them. */
+        mark_roots();
+        drain(-1);
+        sweep(true);
+        promote();
+        gc.minor_collections++;
+    }
+    else
+        return;
+    record_pause(&start);
+}
+
+static const char *pause_label(int bucket, char *buf, size_t size)
+{
+    if (bucket < GC_PAUSE_BUCKETS - 1)
+        snprintf(buf, size, "<%ldus", 2L << bucket);
+    else
+        snprintf(buf, size, ">=%ldus", 1L << bucket);
+    return buf;
+}
+
+static void set_count(Object *obj, const char *key, long count)
+{
+    Value v = INT_VAL(count);
+    object_set(obj, key, v);
+}
+
+Value gc_stats_value(void)
+{
+    Object *stats = object_create();
+    set_count(stats, "collections", gc.collections);
+    set_count(stats, "minor_collections", gc.minor_collections);
+    set_count(stats, "marking_steps", gc.steps);
+    set_count(stats, "live", gc.count);
+    set_count(stats, "longest_pause_us", gc.longest_pause);
+    Object *pauses = object_create();
+    char label[32];
+    for (int i = 0; i < GC_PAUSE_BUCKETS; ++i)
+    {
+        if (gc.pauses[i])
+            set_count(pauses, pause_label(i, label, sizeof(label)), gc.pauses[i]);
+    }
+    Value pauses_val = OBJECT_VAL(pauses);
+    object_set(stats, "pauses", pauses_val);
+    free_value(pauses_val);
+    return OBJECT_VAL(stats);
+}
+
+void gc_cleanup(void)
+{
+    if (gc.stats)
+    {
+        fprintf(stderr, "gc: %d collections, freed %ld closures, %ld instances, %ld promises, %d live at exit\n",
+                gc.collections, gc.freed[GC_CLOSURE], gc.freed[GC_INSTANCE], gc.freed[GC_PROMISE], gc.count);
+        fprintf(stderr, "gc: %d minor collections, %d marking steps, longest pause %ldus\n", gc.minor_collections,
+                gc.steps, gc.longest_pause);
+        fprintf(stderr, "gc: pauses");
+        char label[32];
+        for (int i = 0; i < GC_PAUSE_BUCKETS; ++i)
+        {
+            if (gc.pauses[i])
+                fprintf(stderr, " %s:%ld", pause_label(i, label, sizeof(label)), gc.pauses[i]);
+        }
+        fputc('\n', stderr);
+    }
+    /* With nothing marked, everything left is garbage. */
+    gc_incremental = false;
+    clear_marks();
+    sweep(false);
+
+    free(gc.marks);
+    free(gc.pending);
+    free(gc.roots);
+    gc.marks = NULL;
+    gc.mark_capacity = 0;
+    gc.pending = NULL;
+    gc.pending_capacity = 0;
+    gc.roots = NULL;
+    gc.root_count = 0;
+    gc.root_capacity = 0;
+}
@@ -0,0 +1,110 @@
+#ifndef GC_H
+#define GC_H
+
+#include <stdbool.h>
+
+#include "types/env.h"
+#include "types/value.h"
+
+/*
+ * Cycle collector. Reference counts free most values, but functions are
+ * not counted and a closure retains the Env that usually holds it, so
+ * closures and everything they capture used to live until exit. Closures,
+ * instances and promises are tracked here. A collection marks whatever is
+ * reachable from the call frames, the module table, the annotation
+ * registries and pushed roots, then frees the tracked objects it did not
+ * reach along with everything only they held.
+ *
+ * Collections run only where every live value is visible: at loop
+ * back-edges and closure creation in the outermost dispatch loop, and
+ * where gc_collect is called explicitly (the HTTP server does so between
+ * requests). Values that C code may still be reading are marked, so a
+ * marked value is never freed even when garbage holds it.
+ *
+ * Request-serving processes can run it incrementally instead (see
+ * gc_set_incremental): marks then persist between collections, so the
+ * objects that survived are an old generation and objects tracked since
+ * are young. Between requests gc_step either runs a minor collection,
+ * which marks from the roots without re-marking the old generation and
+ * sweeps only the young, or a bounded step of marking the old generation
+ * from scratch. Stores into a marked container mark the stored value
+ * (gc_write_barrier) and frees drop their marks (gc_forget), which keeps
+ * the marks true while script code runs in between.
+ *
+ * ABLE_GC=0 turns collection off; ABLE_GC_STATS=1 prints counters and a
+ * histogram of pause times on exit.
+ */
+
+typedef enum
+{
+    GC_CLOSURE,
+    GC_INSTANCE,
+    GC_PROMISE
+} GcKind;
+
+/* First member of every tracked object. */
+typedef struct GcObject
+{
+    struct GcObject *prev;
+    struct GcObject *next;
+    GcKind kind;
+    bool old; // survived a collection
+} GcObject;
+
+/* Set once enough objects have been tracked since the last collection. */
+extern bool gc_requested;
+/* Set while incremental mode is on. */
+extern bool gc_incremental;
+
+typedef struct
+{
+    bool enabled;
+    int step;  /* values scanned per old-generation marking step */
+    int young; /* objects tracked between minor collections */
+} GcIncremental;
+
+void gc_init(void);
+/* Free every tracked object. Call once nothing can reach them. */
+void gc_cleanup(void);
+void gc_track(GcObject *object, GcKind kind);
+void gc_untrack(GcObject *object);
+/* Collect now, unless script code is running below C code (see
+   vm_can_collect). */
+void gc_collect(void);
+
+/* Incremental settings from ABLE_GC_MODE ("incremental" or "full"),
+   ABLE_GC_STEP and ABLE_GC_YOUNG. */
+GcIncremental gc_incremental_defaults(void);
+void gc_set_incremental(const GcIncremental *config);
+/* Call where only the roots are live, like between requests: collects if
+   due, or in incremental mode runs whatever collection work is due. */
+void gc_step(void);
+/* The counters ABLE_GC_STATS prints, as an object for gc_stats(). */
+Value gc_stats_value(void);
+
+/* Keep `*slot` alive across collections until popped. */
+void gc_push_root(Value *slot);
+void gc_pop_roots(int count);
+
+/* For the root providers called by gc_collect. */
+void gc_mark_value(Value v);
+void gc_mark_env(Env *env);
+
+void gc_record_store(const void *owner, Value v);
+void gc_record_free(const void *ptr);
+
+/* Call after storing `v` into storage belonging to `owner`. */
+static inline void gc_write_barrier(const void *owner, Value v)
+{
+    if (gc_incremental)
+        gc_record_store(owner, v);
+}
+
+/* Call before freeing an allocation the collector may have marked. */
+static inline void gc_forget(const void *ptr)
+{
+    if (gc_incremental)
+        gc_record_free(ptr);
+}
+
+#endif
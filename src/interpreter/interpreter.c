@@ -2,8 +2,6 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <time.h>
-#include <unistd.h>
 
 #include "types/object.h"
 #include "ast/ast.h"
@@ -11,60 +9,60 @@
 #include "types/function.h"
 #include "types/list.h"
 #include "types/promise.h"
+#include "types/str.h"
 #include "types/type.h"
 #include "types/instance.h"
+#include "types/shape.h"
+#include "compiler/compiler.h"
+#include "compiler/optimize.h"
 #include "interpreter/attr.h"
-#include "interpreter/resolve.h"
+#include "interpreter/builtins.h"
+#include "interpreter/gc.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/stack.h"
-#include "interpreter/module.h"
-#include "interpreter/network.h"
-#include "interpreter/server.h"
 #include "interpreter/annotations.h"
+#include "interpreter/jit.h"
+#include "interpreter/module.h"
+#include "interpreter/vm.h"
+#include "lexer/lexer.h"
+#include "parser/parser.h"
+#include "utils/intern.h"
 #include "utils/utils.h"
-#include "utils/json.h"
 #include "types/type_registry.h"
 
 CallStack call_stack;
-static bool break_flag = false;
-static bool continue_flag = false;
 
-typedef enum
+/* Atoms of the intrinsic method names, so dispatch compares pointers. */
+static struct
 {
-    ANNOTATION_TARGET_FUNCTION,
-    ANNOTATION_TARGET_METHOD,
-    ANNOTATION_TARGET_CLASS,
-    ANNOTATION_TARGET_ASSIGNMENT
-} AnnotationTargetType;
+    const char *append, *remove, *get, *extend, *resolve, *reject;
+} intrinsic;
 
-static Value exec_func_call(ASTNode *n);
-static Value resolve_attr_prefix(ASTNode *attr_node, int count);
-
-static double to_number(Value v)
+double interpreter_to_number(Value v)
 {
-    switch (v.type)
+    switch (value_type(v))
     {
     case VAL_NUMBER:
-        return v.num;
+        return AS_NUMBER(v);
     case VAL_BOOL:
-        return v.boolean ? 1 : 0;
+        return AS_BOOL(v) ? 1 : 0;
     case VAL_STRING:
-        return atof(v.str);
+        return atof(AS_STRING(v));
     default:
         return NAN;
     }
 }
 
-static bool to_boolean(Value v)
+bool interpreter_to_boolean(Value v)
 {
-    switch (v.type)
+    switch (value_type(v))
     {
     case VAL_BOOL:
-        return v.boolean;
+        return AS_BOOL(v);
     case VAL_NUMBER:
-        return v.num != 0;
+        return AS_NUMBER(v) != 0;
     case VAL_STRING:
-        return v.str && v.str[0] != '\0';
+        return string_length(AS_STRING(v)) > 0;
     case VAL_NULL:
     case VAL_UNDEFINED:
         return false;
@@ -73,27 +71,71 @@ static bool to_boolean(Value v)
     }
 }
 
+/* number_order result when either side is NaN. */
+#define NUMBER_UNORDERED 2
+
+/* -1, 0 or 1 as `i` is below, at or above `d`, without rounding `i`. */
+static int int_double_order(int64_t i, double d)
+{
+    if (d != d)
+        return NUMBER_UNORDERED;
+    if (d >= 9223372036854775808.0)
+        return -1;
+    if (d < -9223372036854775808.0)
+        return 1;
+    /* In range, so truncation is exact and so is the fraction left. */
+    int64_t whole = (int64_t)d;
+    if (i != whole)
+        return i < whole ? -1 : 1;
+    double fraction = d - (double)whole;
+    return fraction > 0 ? -1 : fraction < 0 ? 1 : 0;
+}
 
+/* Compare two numbers exactly. Converting an int to double rounds once it
+   needs more than 53 bits, which made INT64_MAX equal INT64_MAX + 1. */
+static int number_order(Value a, Value b)
+{
+    if (IS_INT(a) && IS_INT(b))
+    {
+        int64_t x = AS_INT(a);
+        int64_t y = AS_INT(b);
+        return (x > y) - (x < y);
+    }
+    if (IS_INT(a))
+        return int_double_order(AS_INT(a), b.num);
+    if (IS_INT(b))
+    {
+        int order = int_double_order(AS_INT(b), a.num);
+        return order == NUMBER_UNORDERED ? order : -order;
+    }
+    if (a.num == b.num)
+        return 0;
+    if (a.num < b.num)
+        return -1;
+    return a.num > b.num ? 1 : NUMBER_UNORDERED;
+}
 
 static bool strict_equal(Value a, Value b)
 {
-    if (a.type != b.type)
+    if (value_type(a) != value_type(b))
         return false;
 
-    switch (a.type)
+    switch (value_type(a))
     {
     case VAL_NUMBER:
-        return a.num == b.num;
+        return number_order(a, b) == 0;
     case VAL_STRING:
-        return strcmp(a.str, b.str) == 0;
+        return string_equals(AS_STRING(a), AS_STRING(b));
     case VAL_BOOL:
-        return a.boolean == b.boolean;
+        return AS_BOOL(a) == AS_BOOL(b);
     case VAL_OBJECT:
-        return a.obj == b.obj;
+        return AS_OBJECT(a) == AS_OBJECT(b);
     case VAL_FUNCTION:
-        return a.func == b.func;
+        return AS_FUNCTION(a) == AS_FUNCTION(b);
+    case VAL_NATIVE:
+        return AS_NATIVE(a) == AS_NATIVE(b);
     case VAL_LIST:
-        return a.list == b.list;
+        return AS_LIST(a) == AS_LIST(b);
     case VAL_NULL:
     case VAL_UNDEFINED:
         return true;
@@ -104,56 +146,190 @@ static bool strict_equal(Value a, Value b)
 
 static bool loose_equal(Value a, Value b)
 {
-    if (a.type == b.type)
+    if (value_type(a) == value_type(b))
         return strict_equal(a, b);
 
-    if ((a.type == VAL_NUMBER || a.type == VAL_STRING || a.type == VAL_BOOL) &&
-        (b.type == VAL_NUMBER || b.type == VAL_STRING || b.type == VAL_BOOL))
+    if ((IS_NUMBER(a) || IS_STRING(a) || IS_BOOL(a)) &&
+        (IS_NUMBER(b) || IS_STRING(b) || IS_BOOL(b)))
     {
-        double na = to_number(a);
-        double nb = to_number(b);
+        double na = interpreter_to_number(a);
+        double nb = interpreter_to_number(b);
         return na == nb;
     }
 
     return false;
 }
 
-static Value resolve_attr_prefix(ASTNode *attr_node, int count)
+/* Integer arithmetic, exact while the result fits in int64. Returns false
+   when it does not (or when the quotient is fractional, or the divisor is
+   zero) so the caller falls back to doubles. A zero that doubles would
+   make negative is -0.0, as it was before integers were exact. */
+static bool int_binary_op(BinaryOp op, int64_t a, int64_t b, Value *out)
 {
-    Value base = get_variable(interpreter_current_env(), attr_node->data.attr.object_name,
-                              attr_node->line, attr_node->column);
-    for (int i = 0; i < count; ++i)
+    switch (op)
+    {
+    case OP_ADD:
+        if ((b > 0 && a > INT64_MAX - b) || (b < 0 && a < INT64_MIN - b))
+            return false;
+        *out = INT_VAL(a + b);
+        return true;
+    case OP_SUB:
+        if ((b < 0 && a > INT64_MAX + b) || (b > 0 && a < INT64_MIN + b))
+            return false;
+        *out = INT_VAL(a - b);
+        return true;
+    case OP_MUL:
+        if (a > 0 ? (b > 0 ? a > INT64_MAX / b : b < INT64_MIN / a)
+                  : (b > 0 ? a < INT64_MIN / b : (a != 0 && b < INT64_MAX / a)))
+            return false;
+        *out = (a == 0 && b < 0) || (b == 0 && a < 0) ? NUMBER_VAL(-0.0) : INT_VAL(a * b);
+        return true;
+    case OP_DIV:
+        if (b == 0 || (b == -1 && a == INT64_MIN) || a % b != 0)
+            return false;
+        *out = a == 0 && b < 0 ? NUMBER_VAL(-0.0) : INT_VAL(a / b);
+        return true;
+    case OP_MOD:
     {
-        if (base.type != VAL_OBJECT)
+        if (b == 0)
+            return false;
+        int64_t rem = b == -1 ? 0 : a % b;
+        *out = rem == 0 && a < 0 ? NUMBER_VAL(-0.0) : INT_VAL(rem);
+        return true;
+    }
+        return true;
+    default:
+        return false;
+    }
+}
+
+/* Whether an order from number_order or string_compare satisfies `op`. */
+static bool order_matches(BinaryOp op, int order)
+{
+    if (order == NUMBER_UNORDERED)
+        return false;
+    switch (op)
+    {
+    case OP_LT:
+        return order < 0;
+    case OP_GT:
+        return order > 0;
+    case OP_LTE:
+        return order <= 0;
+    default:
+        return order >= 0;
+    }
+}
+
+Value interpreter_binary_op(BinaryOp op, Value left, Value right, int line, int column)
+{
+    if (op == OP_EQ || op == OP_STRICT_EQ)
+    {
+        bool eq = op == OP_EQ ? loose_equal(left, right)
+                                        : strict_equal(left, right);
+        return BOOL_VAL(eq);
+    }
+
+    if (op == OP_LT || op == OP_GT ||
+        op == OP_LTE || op == OP_GTE)
+    {
+        bool cmp;
+        if ((IS_NUMBER(left) || IS_BOOL(left)) &&
+            (IS_NUMBER(right) || IS_BOOL(right)))
+        {
+            Value ln = IS_BOOL(left) ? SMALL_INT_VAL(AS_BOOL(left)) : left;
+            Value rn = IS_BOOL(right) ? SMALL_INT_VAL(AS_BOOL(right)) : right;
+            cmp = order_matches(op, number_order(ln, rn));
+        }
+        else if (IS_STRING(left) && IS_STRING(right))
+        {
+            int c = string_compare(AS_STRING(left), AS_STRING(right));
+            cmp = order_matches(op, (c > 0) - (c < 0));
+        }
+        else
         {
-            log_script_error(attr_node->children[i]->line,
-                              attr_node->children[i]->column,
-                              "Error: intermediate '%s' is not an object",
-                              attr_node->children[i]->data.attr.attr_name);
+            log_script_error(line, column, "Type error in binary expression");
             exit(1);
         }
-        base = object_get(base.obj, attr_node->children[i]->data.attr.attr_name);
+        return BOOL_VAL(cmp);
     }
-    return base;
+
+    if (IS_NUMBER(left) && IS_NUMBER(right))
+    {
+        Value res = NUMBER_VAL(0);
+        if (IS_INT(left) && IS_INT(right) && int_binary_op(op, AS_INT(left), AS_INT(right), &res))
+            return res;
+        switch (op)
+        {
+        case OP_ADD:
+            res = NUMBER_VAL(AS_NUMBER(left) + AS_NUMBER(right));
+            break;
+        case OP_SUB:
+            res = NUMBER_VAL(AS_NUMBER(left) - AS_NUMBER(right));
+            break;
+        case OP_MUL:
+            res = NUMBER_VAL(AS_NUMBER(left) * AS_NUMBER(right));
+            break;
+        case OP_DIV:
+            res = NUMBER_VAL(AS_NUMBER(right) != 0 ? AS_NUMBER(left) / AS_NUMBER(right) : 0);
+            break;
+        case OP_MOD:
+            res = NUMBER_VAL(fmod(AS_NUMBER(left), AS_NUMBER(right)));
+            break;
+        default:
+            log_script_error(line, column, "Unknown operator");
+            exit(1);
+        }
+        return res;
+    }
+    if (op == OP_ADD && IS_STRING(left) && IS_STRING(right))
+    {
+        size_t len1 = string_length(AS_STRING(left));
+        size_t len2 = string_length(AS_STRING(right));
+        char *buf = string_alloc(len1 + len2);
+        memcpy(buf, AS_STRING(left), len1);
+        memcpy(buf + len1, AS_STRING(right), len2);
+        return STRING_VAL(buf);
+    }
+    if (op == OP_ADD && IS_LIST(left) && IS_LIST(right))
+    {
+        List *list = clone_list(AS_LIST(left));
+        list_extend(list, AS_LIST(right));
+        return LIST_VAL(list);
+    }
+
+    log_script_error(line, column, "Type error in binary expression");
+    exit(1);
 }
 
 void interpreter_init()
 {
+    gc_init();
     stack_init(&call_stack);
+    vm_init();
+    jit_init();
     type_registry_init();
     annotations_init();
+    intrinsic.append = intern("append");
+    intrinsic.remove = intern("remove");
+    intrinsic.get = intern("get");
+    intrinsic.extend = intern("extend");
+    intrinsic.resolve = intern("resolve");
+    intrinsic.reject = intern("reject");
 }
 
 void interpreter_cleanup()
 {
     annotations_cleanup();
     type_registry_cleanup();
+    jit_cleanup();
+    vm_free();
     stack_free(&call_stack);
 }
 
 void interpreter_set_env(Env *env)
 {
-    CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
+    CallFrame frame = {.env = env, .chunk = NULL};
     push_frame(&call_stack, frame);
 }
 
@@ -170,1474 +346,193 @@ Env *interpreter_current_env()
     return frame->env;
 }
 
-static Value eval_node(ASTNode *n)
+Value interpreter_run(ASTNode **nodes, int count, const char *name)
 {
-    switch (n->type)
-    {
-    case NODE_VAR:
-        return get_variable(interpreter_current_env(), n->data.set.set_name, n->line, n->column);
-    case NODE_ATTR_ACCESS:
-        return resolve_attribute_chain(n);
-    case NODE_LITERAL:
-        return clone_value(&n->data.lit.literal_value);
-    case NODE_AWAIT:
-    {
-        Value awaited = eval_node(n->children[0]);
-        Value resolved = interpreter_await(awaited, n->line, n->column);
-        return resolved;
-    }
-    case NODE_OBJECT_LITERAL:
-    {
-        Object *obj = malloc(sizeof(Object));
-        obj->count = 0;
-        obj->capacity = 0;
-        obj->pairs = NULL;
-        for (int i = 0; i < n->data.object.pair_count; ++i)
-        {
-            Value val = eval_node(n->data.object.values[i]);
-            object_set(obj, n->data.object.keys[i], val);
-        }
-        return (Value){.type = VAL_OBJECT, .obj = obj};
-    }
-    case NODE_FUNC_CALL:
-        return exec_func_call(n);
-    case NODE_POSTFIX_INC:
-    {
-        ASTNode *target = n->children[0];
-        Value old;
-        if (target->type == NODE_VAR)
-        {
-            old = get_variable(interpreter_current_env(), target->data.set.set_name,
-                               target->line, target->column);
-            if (old.type != VAL_NUMBER)
-            {
-                log_script_error(target->line, target->column,
-                                  "Increment target must be a number");
-                exit(1);
-            }
-            Value new_val = {.type = VAL_NUMBER, .num = old.num + 1};
-            set_variable(interpreter_current_env(), target->data.set.set_name,
-                         new_val);
-        }
-        else if (target->type == NODE_ATTR_ACCESS)
-        {
-            old = resolve_attribute_chain(target);
-            if (old.type != VAL_NUMBER)
-            {
-                log_script_error(target->line, target->column,
-                                  "Increment target must be a number");
-                exit(1);
-            }
-            Value new_val = {.type = VAL_NUMBER, .num = old.num + 1};
-            assign_attribute_chain(target, new_val);
-        }
-        else
-        {
-            log_script_error(target->line, target->column,
-                              "Invalid increment target");
-            exit(1);
-        }
-        return old;
-    }
-    case NODE_INDEX:
-    {
-        Value collection = eval_node(n->children[0]);
-        if (collection.type != VAL_LIST)
-        {
-            log_script_error(n->line, n->column, "Indexing requires a list");
-            exit(1);
-        }
-        if (n->data.index.is_slice)
-        {
-            int start = 0;
-            int end = collection.list->count;
-            int child_idx = 1;
-            if (n->data.index.has_start)
-            {
-                Value sv = eval_node(n->children[child_idx++]);
-                if (sv.type != VAL_NUMBER)
-                {
-                    log_script_error(n->line, n->column,
-                                      "Slice start must be a number");
-                    exit(1);
-                }
-                start = (int)sv.num;
-            }
-            if (n->data.index.has_end)
-            {
-                Value ev = eval_node(n->children[child_idx]);
-                if (ev.type != VAL_NUMBER)
-                {
-                    log_script_error(n->line, n->column,
-                                      "Slice end must be a number");
-                    exit(1);
-                }
-                end = (int)ev.num;
-            }
-            List *slice = list_slice(collection.list, start, end);
-            Value res = {.type = VAL_LIST, .list = slice};
-            return res;
-        }
-        Value idxv = eval_node(n->children[1]);
-        if (idxv.type != VAL_NUMBER)
-        {
-            log_script_error(n->line, n->column, "List index must be a number");
-            exit(1);
-        }
-        int idx = (int)idxv.num;
-        Value item = list_get(collection.list, idx);
-        return clone_value(&item);
-    }
-    case NODE_UNARY:
-    {
-        Value val = eval_node(n->children[0]);
-        bool result;
-        switch (n->data.unary.op)
-        {
-        case UNARY_NOT:
-            result = !to_boolean(val);
-            break;
-        default:
-            log_script_error(n->line, n->column, "Unknown unary operator");
-            exit(1);
-        }
-        return (Value){.type = VAL_BOOL, .boolean = result};
-    }
-    case NODE_BINARY:
-    {
-        if (n->data.binary.op == OP_AND || n->data.binary.op == OP_OR)
-        {
-            Value left = eval_node(n->children[0]);
-            bool lb = to_boolean(left);
-            if (n->data.binary.op == OP_AND)
-            {
-                if (!lb)
-                    return (Value){.type = VAL_BOOL, .boolean = false};
-                Value right = eval_node(n->children[1]);
-                return (Value){.type = VAL_BOOL,
-                               .boolean = lb && to_boolean(right)};
-            }
-            else
-            {
-                if (lb)
-                    return (Value){.type = VAL_BOOL, .boolean = true};
-                Value right = eval_node(n->children[1]);
-                return (Value){.type = VAL_BOOL,
-                               .boolean = lb || to_boolean(right)};
-            }
-        }
-
-        Value left = eval_node(n->children[0]);
-        Value right = eval_node(n->children[1]);
-        if (n->data.binary.op == OP_EQ || n->data.binary.op == OP_STRICT_EQ)
-        {
-            bool eq = n->data.binary.op == OP_EQ ? loose_equal(left, right)
-                                            : strict_equal(left, right);
-            Value res = {.type = VAL_BOOL, .boolean = eq};
-            return res;
-        }
-
-        if (n->data.binary.op == OP_LT || n->data.binary.op == OP_GT ||
-            n->data.binary.op == OP_LTE || n->data.binary.op == OP_GTE)
-        {
-            bool cmp;
-            if ((left.type == VAL_NUMBER || left.type == VAL_BOOL) &&
-                (right.type == VAL_NUMBER || right.type == VAL_BOOL))
-            {
-                double ln = to_number(left);
-                double rn = to_number(right);
-                switch (n->data.binary.op)
-                {
-                case OP_LT:
-                    cmp = ln < rn;
-                    break;
-                case OP_GT:
-                    cmp = ln > rn;
-                    break;
-                case OP_LTE:
-                    cmp = ln <= rn;
-                    break;
-                default:
-                    cmp = ln >= rn;
-                }
-            }
-            else if (left.type == VAL_STRING && right.type == VAL_STRING)
-            {
-                int c = strcmp(left.str, right.str);
-                switch (n->data.binary.op)
-                {
-                case OP_LT:
-                    cmp = c < 0;
-                    break;
-                case OP_GT:
-                    cmp = c > 0;
-                    break;
-                case OP_LTE:
-                    cmp = c <= 0;
-                    break;
-                default:
-                    cmp = c >= 0;
-                }
-            }
-            else
-            {
-                log_script_error(n->line, n->column, "Type error in binary expression");
-                exit(1);
-            }
-            Value res = {.type = VAL_BOOL, .boolean = cmp};
-            return res;
-        }
-
-        if (left.type == VAL_NUMBER && right.type == VAL_NUMBER)
-        {
-            Value res = {.type = VAL_NUMBER};
-            switch (n->data.binary.op)
-            {
-            case OP_ADD:
-                res.num = left.num + right.num;
-                break;
-            case OP_SUB:
-                res.num = left.num - right.num;
-                break;
-            case OP_MUL:
-                res.num = left.num * right.num;
-                break;
-            case OP_DIV:
-                res.num = right.num != 0 ? left.num / right.num : 0;
-                break;
-            case OP_MOD:
-                res.num = fmod(left.num, right.num);
-                break;
-            default:
-                log_script_error(n->line, n->column, "Unknown operator");
-                exit(1);
-            }
-            return res;
-        }
-        if (n->data.binary.op == OP_ADD && left.type == VAL_STRING && right.type == VAL_STRING)
-        {
-            size_t len1 = strlen(left.str);
-            size_t len2 = strlen(right.str);
-            char *buf = malloc(len1 + len2 + 1);
-            memcpy(buf, left.str, len1);
-            memcpy(buf + len1, right.str, len2);
-            buf[len1 + len2] = '\0';
-            Value res = {.type = VAL_STRING, .str = buf};
-            return res;
-        }
-        if (n->data.binary.op == OP_ADD && left.type == VAL_LIST && right.type == VAL_LIST)
-        {
-            List *list = malloc(sizeof(List));
-            list->count = 0;
-            list->capacity = left.list->count + right.list->count;
-            list->items = malloc(sizeof(Value) * list->capacity);
-            for (int i = 0; i < left.list->count; ++i)
-                list->items[list->count++] = clone_value(&left.list->items[i]);
-            for (int j = 0; j < right.list->count; ++j)
-                list->items[list->count++] = clone_value(&right.list->items[j]);
-            Value res = {.type = VAL_LIST, .list = list};
-            return res;
-        }
-
-        log_script_error(n->line, n->column, "Type error in binary expression");
-        exit(1);
-    }
-    case NODE_TERNARY:
-    {
-        Value cond = eval_node(n->children[0]);
-        if (to_boolean(cond))
-            return eval_node(n->children[1]);
-        return eval_node(n->children[2]);
-    }
-    case NODE_IF:
-    {
-        Value cond = eval_node(n->children[0]);
-        if (to_boolean(cond))
-        {
-            return run_ast(n->children[1]->children, n->children[1]->child_count);
-        }
-        if (n->child_count >= 3)
-        {
-            ASTNode *else_node = n->children[2];
-            if (else_node->type == NODE_IF)
-                return eval_node(else_node);
-            return run_ast(else_node->children, else_node->child_count);
-        }
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
-    }
-    case NODE_BLOCK:
-        return run_ast(n->children, n->child_count);
-    default:
-        log_script_error(n->line, n->column, "Unsupported eval node type");
-        exit(1);
-    }
+    optimize_program(nodes, count);
+    Chunk *chunk = compile_program(nodes, count, name);
+    Value result = vm_execute(chunk, interpreter_current_env());
+    chunk_free(chunk);
+    return result;
 }
 
-static Value exec_func_call(ASTNode *n)
+void interpreter_run_script(const char *filename, const char *source, const char *exec_path)
 {
-    if (n->data.call.func_callee->type == NODE_VAR)
-    {
-        const char *func_name = n->data.call.func_callee->data.set.set_name;
-        if (network_is_http_method(func_name))
-        {
-            Value *args = NULL;
-            if (n->child_count > 0)
-            {
-                args = malloc(sizeof(Value) * n->child_count);
-                if (!args)
-                {
-                    log_script_error(n->line, n->column, "Failed to allocate arguments for %s", func_name);
-                    exit(1);
-                }
-                for (int j = 0; j < n->child_count; ++j)
-                    args[j] = eval_node(n->children[j]);
-            }
-
-            Value result = network_execute(func_name, args, n->child_count, n->line, n->column);
-
-            if (args)
-            {
-                for (int j = 0; j < n->child_count; ++j)
-                    free_value(args[j]);
-                free(args);
-            }
+    Lexer lexer;
+    lexer_init(&lexer, source);
+    int stmt_count;
+    ASTNode **prog = parse_program(&lexer, &stmt_count);
+
+    Env *global_env = env_create(NULL);
+    interpreter_init();
+    module_system_init(global_env, exec_path);
+    builtins_register(global_env, filename);
+    interpreter_set_env(global_env);
+    interpreter_run(prog, stmt_count, filename);
+    module_system_cleanup();
+    interpreter_cleanup();
+
+    // Run "Garbage Collection"
+    free_ast(prog, stmt_count);
+    env_release(global_env);
+    gc_cleanup();
+    shape_cleanup();
+    intern_cleanup();
+}
 
-            return result;
-        }
-    }
+Value interpreter_call_intrinsic_method(Value target, const char *name, Value *args, int argc, int line, int column, bool *handled)
+{
+    *handled = true;
 
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "server_listen") == 0)
+    if (promise_value_is_namespace(target))
     {
-        Value *args = NULL;
-        if (n->child_count > 0)
+        if (name == intrinsic.resolve)
         {
-            args = malloc(sizeof(Value) * n->child_count);
-            if (!args)
+            if (argc != 1)
             {
-                log_script_error(n->line, n->column, "Failed to allocate arguments for server_listen");
+                log_script_error(line, column, "Promise.resolve expects one argument");
                 exit(1);
             }
-            for (int j = 0; j < n->child_count; ++j)
-                args[j] = eval_node(n->children[j]);
-        }
-
-        Value result = interpreter_server_listen(args, n->child_count, n->line, n->column);
-
-        if (args)
-        {
-            for (int j = 0; j < n->child_count; ++j)
-                free_value(args[j]);
-            free(args);
-        }
-
-        return result;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "register_modifier") == 0)
-    {
-        if (n->child_count != 2)
-        {
-            log_script_error(n->line, n->column, "register_modifier expects name and handler");
-            exit(1);
-        }
-        Value name_val = eval_node(n->children[0]);
-        Value handler_val = eval_node(n->children[1]);
-        if (name_val.type != VAL_STRING)
-        {
-            log_script_error(n->line, n->column, "register_modifier expects string name");
-            exit(1);
-        }
-        if (handler_val.type != VAL_FUNCTION)
-        {
-            log_script_error(n->line, n->column, "register_modifier expects function handler");
-            exit(1);
-        }
-        annotations_register(name_val.str, ANNOTATION_HANDLER_MODIFIER, handler_val);
-        free_value(name_val);
-        free_value(handler_val);
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "register_decorator") == 0)
-    {
-        if (n->child_count != 2)
-        {
-            log_script_error(n->line, n->column, "register_decorator expects name and handler");
-            exit(1);
-        }
-        Value name_val = eval_node(n->children[0]);
-        Value handler_val = eval_node(n->children[1]);
-        if (name_val.type != VAL_STRING)
-        {
-            log_script_error(n->line, n->column, "register_decorator expects string name");
-            exit(1);
-        }
-        if (handler_val.type != VAL_FUNCTION)
-        {
-            log_script_error(n->line, n->column, "register_decorator expects function handler");
-            exit(1);
-        }
-        annotations_register(name_val.str, ANNOTATION_HANDLER_DECORATOR, handler_val);
-        free_value(name_val);
-        free_value(handler_val);
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "pr") == 0)
-    {
-        for (int j = 0; j < n->child_count; ++j)
-        {
-            Value val = eval_node(n->children[j]);
-            print_value(val, 0);
-        }
-        printf("\n");
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "type") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "type() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        const char *name = value_type_name(arg.type);
-        Value res = {.type = VAL_STRING, .str = strdup(name)};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "bool") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "bool() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        Value res = {.type = VAL_BOOL, .boolean = to_boolean(arg)};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "len") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "len() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        if (arg.type == VAL_STRING)
-        {
-            Value res = {.type = VAL_NUMBER, .num = (double)strlen(arg.str)};
-            return res;
-        }
-        if (arg.type == VAL_LIST)
-        {
-            Value res = {.type = VAL_NUMBER, .num = (double)arg.list->count};
-            return res;
+            Value value = args[0];
+            if (IS_PROMISE(value))
+                return clone_value(&value);
+            Promise *promise = promise_create();
+            promise_resolve(promise, value);
+            return PROMISE_VAL(promise);
         }
-        if (arg.type == VAL_OBJECT)
+        if (name == intrinsic.reject)
         {
-            Value res = {.type = VAL_NUMBER, .num = (double)arg.obj->count};
-            return res;
-        }
-        log_script_error(n->line, n->column, "len() unsupported type");
-        exit(1);
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "int") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "int() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        Value res = {.type = VAL_NUMBER, .num = (double)(long long)to_number(arg)};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "float") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "float() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        Value res = {.type = VAL_NUMBER, .num = to_number(arg)};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "str") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "str() expects exactly one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        char buf[64];
-        switch (arg.type)
-        {
-        case VAL_NUMBER:
-            snprintf(buf, sizeof(buf), "%g", arg.num);
-            return (Value){.type = VAL_STRING, .str = strdup(buf)};
-        case VAL_BOOL:
-            return (Value){.type = VAL_STRING, .str = strdup(arg.boolean ? "true" : "false")};
-        case VAL_STRING:
-            return clone_value(&arg);
-        default:
-            log_script_error(n->line, n->column, "str() unsupported type");
-            exit(1);
-        }
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "json_stringify") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "json_stringify() expects exactly one argument");
-            exit(1);
-        }
-
-        Value arg = eval_node(n->children[0]);
-        char *json = NULL;
-        char *error = NULL;
-        if (!json_stringify_value(&arg, &json, &error))
-        {
-            if (error)
-            {
-                log_script_error(n->line, n->column, "json_stringify failed: %s", error);
-                free(error);
-            }
-            else
-            {
-                log_script_error(n->line, n->column, "json_stringify failed");
-            }
-            exit(1);
-        }
-
-        Value res = {.type = VAL_STRING, .str = json};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "json_parse") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "json_parse() expects exactly one argument");
-            exit(1);
-        }
-
-        Value arg = eval_node(n->children[0]);
-        if (arg.type != VAL_STRING)
-        {
-            log_script_error(n->line, n->column, "json_parse() expects a string argument");
-            exit(1);
-        }
-
-        Value parsed = {.type = VAL_NULL};
-        char *error = NULL;
-        if (!json_parse_string(arg.str, &parsed, &error))
-        {
-            if (error)
-            {
-                log_script_error(n->line, n->column, "json_parse failed: %s", error);
-                free(error);
-            }
-            else
+            if (argc != 1)
             {
-                log_script_error(n->line, n->column, "json_parse failed");
-            }
-            exit(1);
-        }
-
-        return parsed;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "read_text_file") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "read_text_file() expects exactly one argument");
-            exit(1);
-        }
-
-        Value path = eval_node(n->children[0]);
-        if (path.type != VAL_STRING)
-        {
-            log_script_error(n->line, n->column, "read_text_file() expects a string path");
-            exit(1);
-        }
-
-        char *content = read_file(path.str);
-        Value res = {.type = VAL_STRING, .str = content};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "dict") == 0)
-    {
-        if (n->child_count > 1)
-        {
-            log_script_error(n->line, n->column, "dict() expects at most one argument");
-            exit(1);
-        }
-        Object *obj = malloc(sizeof(Object));
-        obj->count = 0;
-        obj->capacity = 0;
-        obj->pairs = NULL;
-        if (n->child_count == 1)
-        {
-            Value arg = eval_node(n->children[0]);
-            if (arg.type != VAL_OBJECT)
-            {
-                log_script_error(n->line, n->column, "dict() expects an object");
+                log_script_error(line, column, "Promise.reject expects one argument");
                 exit(1);
             }
-            for (int i = 0; i < arg.obj->count; ++i)
-                object_set(obj, arg.obj->pairs[i].key, arg.obj->pairs[i].value);
-        }
-        return (Value){.type = VAL_OBJECT, .obj = obj};
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "range") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "range() expects one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        if (arg.type != VAL_NUMBER)
-        {
-            log_script_error(n->line, n->column, "range() expects a number");
-            exit(1);
-        }
-        int limit = (int)arg.num;
-        List *list = malloc(sizeof(List));
-        list->count = 0;
-        list->capacity = 0;
-        list->items = NULL;
-        for (int i = 0; i < limit; ++i)
-        {
-            Value numv = {.type = VAL_NUMBER, .num = i};
-            list_append(list, numv);
-        }
-        return (Value){.type = VAL_LIST, .list = list};
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "input") == 0)
-    {
-        if (n->child_count > 1)
-        {
-            log_script_error(n->line, n->column, "input() expects zero or one argument");
-            exit(1);
-        }
-        if (n->child_count == 1)
-        {
-            Value prompt = eval_node(n->children[0]);
-            if (prompt.type == VAL_STRING)
-                printf("%s", prompt.str);
-        }
-        char buf[256];
-        if (!fgets(buf, sizeof(buf), stdin))
-        {
-            buf[0] = '\0';
-        }
-        size_t len = strlen(buf);
-        if (len > 0 && buf[len - 1] == '\n')
-            buf[len - 1] = '\0';
-        return (Value){.type = VAL_STRING, .str = strdup(buf)};
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "time") == 0)
-    {
-        if (n->child_count != 0)
-        {
-            log_script_error(n->line, n->column, "time() expects no arguments");
-            exit(1);
-        }
-        double t = (double)time(NULL);
-        return (Value){.type = VAL_NUMBER, .num = t};
-    }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "sleep") == 0)
-    {
-        if (n->child_count != 1)
-        {
-            log_script_error(n->line, n->column, "sleep() expects one argument");
-            exit(1);
-        }
-        Value arg = eval_node(n->children[0]);
-        if (arg.type != VAL_NUMBER)
-        {
-            log_script_error(n->line, n->column, "sleep() expects a number");
-            exit(1);
+            Value reason = args[0];
+            Promise *promise = promise_create();
+            promise_reject(promise, reason);
+            return PROMISE_VAL(promise);
         }
-        double sec = to_number(arg);
-        if (sec > 0)
-            usleep((useconds_t)(sec * 1000000));
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
+        log_script_error(line, column, "Unknown Promise method '%s'", name);
+        exit(1);
     }
-
-    if (n->data.call.func_callee->type == NODE_VAR && strcmp(n->data.call.func_callee->data.set.set_name, "list") == 0)
+    if (IS_LIST(target))
     {
-        if (n->child_count > 1)
-        {
-            log_script_error(n->line, n->column, "list() expects at most one argument");
-            exit(1);
-        }
-        List *list = malloc(sizeof(List));
-        list->count = 0;
-        list->capacity = 0;
-        list->items = NULL;
-        if (n->child_count == 1)
+        if (name == intrinsic.append)
         {
-            Value arg = eval_node(n->children[0]);
-            if (arg.type == VAL_LIST)
-            {
-                free(list);
-                list = clone_list(arg.list);
-            }
-            else
+            if (argc != 1)
             {
-                list_append(list, arg);
+                log_script_error(line, column, "append() expects one argument");
+                exit(1);
             }
+            Value arg = args[0];
+            list_append(AS_LIST(target), arg);
+            return UNDEFINED_VAL;
         }
-        Value res = {.type = VAL_LIST, .list = list};
-        return res;
-    }
-
-    if (n->data.call.func_callee->type == NODE_ATTR_ACCESS)
-    {
-        ASTNode *attr = n->data.call.func_callee;
-        if (attr->child_count > 0)
+        if (name == intrinsic.remove)
         {
-            ASTNode *last = attr->children[attr->child_count - 1];
-            const char *name = last->data.attr.attr_name;
-            Value target = resolve_attr_prefix(attr, attr->child_count - 1);
-            if (promise_value_is_namespace(target))
+            if (argc != 1)
             {
-                if (strcmp(name, "resolve") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "Promise.resolve expects one argument");
-                        exit(1);
-                    }
-                    Value value = eval_node(n->children[0]);
-                    if (value.type == VAL_PROMISE)
-                        return value;
-                    Promise *promise = promise_create();
-                    promise_resolve(promise, value);
-                    free_value(value);
-                    Value promise_val = {.type = VAL_PROMISE, .promise = promise};
-                    return promise_val;
-                }
-                if (strcmp(name, "reject") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "Promise.reject expects one argument");
-                        exit(1);
-                    }
-                    Value reason = eval_node(n->children[0]);
-                    Promise *promise = promise_create();
-                    promise_reject(promise, reason);
-                    free_value(reason);
-                    Value promise_val = {.type = VAL_PROMISE, .promise = promise};
-                    return promise_val;
-                }
-                log_script_error(n->line, n->column, "Unknown Promise method '%s'", name);
+                log_script_error(line, column, "remove() expects one argument");
                 exit(1);
             }
-            if (target.type == VAL_LIST)
+            Value idxv = args[0];
+            if (!IS_NUMBER(idxv))
             {
-                if (strcmp(name, "append") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "append() expects one argument");
-                        exit(1);
-                    }
-                    Value arg = eval_node(n->children[0]);
-                    list_append(target.list, arg);
-                    Value undef = {.type = VAL_UNDEFINED};
-                    return undef;
-                }
-                if (strcmp(name, "remove") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "remove() expects one argument");
-                        exit(1);
-                    }
-                    Value idxv = eval_node(n->children[0]);
-                    if (idxv.type != VAL_NUMBER)
-                    {
-                        log_script_error(n->line, n->column, "remove() index must be number");
-                        exit(1);
-                    }
-                    return list_remove(target.list, (int)idxv.num);
-                }
-                if (strcmp(name, "get") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "get() expects one argument");
-                        exit(1);
-                    }
-                    Value idxv = eval_node(n->children[0]);
-                    if (idxv.type != VAL_NUMBER)
-                    {
-                        log_script_error(n->line, n->column, "get() index must be number");
-                        exit(1);
-                    }
-                    Value item = list_get(target.list, (int)idxv.num);
-                    return clone_value(&item);
-                }
-                if (strcmp(name, "extend") == 0)
-                {
-                    if (n->child_count != 1)
-                    {
-                        log_script_error(n->line, n->column, "extend() expects one argument");
-                        exit(1);
-                    }
-                    Value lst = eval_node(n->children[0]);
-                    if (lst.type != VAL_LIST)
-                    {
-                        log_script_error(n->line, n->column, "extend() expects a list");
-                        exit(1);
-                    }
-                    list_extend(target.list, lst.list);
-                    Value undef = {.type = VAL_UNDEFINED};
-                    return undef;
-                }
+                log_script_error(line, column, "remove() index must be number");
+                exit(1);
             }
+            return list_remove(AS_LIST(target), (int)AS_NUMBER(idxv));
         }
-    }
-
-    Value callee_val = eval_node(n->data.call.func_callee);
-    if (callee_val.type == VAL_BOUND_METHOD)
-    {
-        Function *fn = callee_val.bound->func;
-        if (fn->param_count - 1 != n->child_count)
-        {
-            log_script_error(n->line, n->column,
-                             "Function '%s' expects %d arguments, but got %d",
-                             n->data.call.func_name,
-                             fn->param_count - 1, n->child_count);
-            exit(1);
-        }
-
-        Value self_val = {.type = VAL_INSTANCE, .instance = callee_val.bound->self};
-        if (fn->is_async)
+        if (name == intrinsic.get)
         {
-            Value *arg_vals = NULL;
-            if (n->child_count > 0)
+            if (argc != 1)
             {
-                arg_vals = malloc(sizeof(Value) * n->child_count);
-                for (int p = 0; p < n->child_count; ++p)
-                    arg_vals[p] = eval_node(n->children[p]);
+                log_script_error(line, column, "get() expects one argument");
+                exit(1);
             }
-            Value promise_val = interpreter_create_async_promise(fn, arg_vals, n->child_count, true, self_val, n->line, n->column);
-            if (arg_vals)
+            Value idxv = args[0];
+            if (!IS_NUMBER(idxv))
             {
-                for (int p = 0; p < n->child_count; ++p)
-                    free_value(arg_vals[p]);
-                free(arg_vals);
+                log_script_error(line, column, "get() index must be number");
+                exit(1);
             }
-            return promise_val;
+            Value item = list_get(AS_LIST(target), (int)AS_NUMBER(idxv));
+            return clone_value(&item);
         }
-
-        Env *call_env = env_create(fn->env);
-        set_variable(call_env, fn->params[0], self_val);
-        for (int p = 0; p < n->child_count; ++p)
+        if (name == intrinsic.extend)
         {
-            Value arg_val = eval_node(n->children[p]);
-            set_variable(call_env, fn->params[p + 1], arg_val);
-        }
-        CallFrame frame = {.env = call_env, .return_ptr = NULL, .returning = false};
-        push_frame(&call_stack, frame);
-        Value result = run_ast(fn->body, fn->body_count);
-        pop_frame(&call_stack);
-        Value ret_val = clone_value(&result);
-        env_release(call_env);
-        return ret_val;
-    }
-    if (callee_val.type == VAL_TYPE)
-    {
-        Instance *inst = instance_create(callee_val.cls);
-        Value inst_val = {.type = VAL_INSTANCE, .instance = inst};
-        Value init = value_get_attr(inst_val, "init");
-        if (init.type == VAL_BOUND_METHOD)
-        {
-            Function *fn = init.bound->func;
-            if (fn->param_count - 1 != n->child_count)
+            if (argc != 1)
             {
-                log_script_error(n->line, n->column,
-                                 "init expects %d arguments, got %d",
-                                 fn->param_count - 1, n->child_count);
+                log_script_error(line, column, "extend() expects one argument");
                 exit(1);
             }
-            Env *env = env_create(fn->env);
-            Value selfv = {.type = VAL_INSTANCE, .instance = init.bound->self};
-            set_variable(env, fn->params[0], selfv);
-            for (int p = 0; p < n->child_count; ++p)
+            Value lst = args[0];
+            if (!IS_LIST(lst))
             {
-                Value arg_val = eval_node(n->children[p]);
-                set_variable(env, fn->params[p + 1], arg_val);
+                log_script_error(line, column, "extend() expects a list");
+                exit(1);
             }
-            CallFrame frame = {.env = env, .return_ptr = NULL, .returning = false};
-            push_frame(&call_stack, frame);
-            run_ast(fn->body, fn->body_count);
-            pop_frame(&call_stack);
-            env_release(env);
-        }
-        return inst_val;
-    }
-    if (callee_val.type != VAL_FUNCTION)
-    {
-        log_script_error(n->line, n->column, "Attempting to call non-function");
-        Value undef = {.type = VAL_UNDEFINED};
-        return undef;
-    }
-
-    // Check correct arguments
-    Function *fn = callee_val.func;
-
-    if (callee_val.func->param_count != n->child_count)
-    {
-        log_script_error(n->line, n->column, "Function '%s' expects %d arguments, but got %d",
-                  n->data.call.func_name,
-                  fn->param_count,
-                  n->child_count);
-        exit(1);
-    }
-
-    if (fn->is_async)
-    {
-        Value undef = {.type = VAL_UNDEFINED};
-        Value *arg_vals = NULL;
-        if (n->child_count > 0)
-        {
-            arg_vals = malloc(sizeof(Value) * n->child_count);
-            for (int p = 0; p < n->child_count; ++p)
-                arg_vals[p] = eval_node(n->children[p]);
-        }
-        Value promise_val = interpreter_create_async_promise(fn, arg_vals, n->child_count, false, undef, n->line, n->column);
-        if (arg_vals)
-        {
-            for (int p = 0; p < n->child_count; ++p)
-                free_value(arg_vals[p]);
-            free(arg_vals);
+            list_extend(AS_LIST(target), AS_LIST(lst));
+            return UNDEFINED_VAL;
         }
-        return promise_val;
     }
 
-    Env *call_env = env_create(fn->env);
-    for (int p = 0; p < fn->param_count && p < n->child_count; ++p)
-    {
-        Value arg_val = eval_node(n->children[p]);
-        set_variable(call_env, fn->params[p], arg_val);
-    }
-    CallFrame frame = {.env = call_env, .return_ptr = NULL, .returning = false};
-    push_frame(&call_stack, frame);
-    Value result = run_ast(fn->body, fn->body_count);
-    pop_frame(&call_stack);
-    Value ret_val = clone_value(&result);
-    env_release(call_env);
-    return ret_val;
+    *handled = false;
+    return UNDEFINED_VAL;
 }
 
-static const char *annotation_target_label(AnnotationTargetType type)
+/* Install a method closure under the interned `name`, resolving whether
+ * it binds on access and merging any server route metadata into the class. */
+void interpreter_add_method(Type *t, const char *name, Value fv, bool is_static)
 {
-    switch (type)
-    {
-    case ANNOTATION_TARGET_FUNCTION:
-        return "function";
-    case ANNOTATION_TARGET_METHOD:
-        return "method";
-    case ANNOTATION_TARGET_CLASS:
-        return "class";
-    case ANNOTATION_TARGET_ASSIGNMENT:
-        return "assignment";
-    default:
-        return NULL;
-    }
-}
-
-static bool apply_annotations(ASTNode *node, Value *value, AnnotationTargetType target_type, const char *name)
-{
-    if (!node || node->annotation_count == 0)
-        return false;
-
-    int count = node->annotation_count;
-    Value *decorators = calloc(count, sizeof(Value));
-    Value *modifiers = calloc(count, sizeof(Value));
-    if (!decorators || !modifiers)
-    {
-        log_script_error(node->line, node->column, "Out of memory while applying annotations");
-        exit(1);
-    }
-
-    for (int i = 0; i < count; ++i)
-    {
-        Annotation *ann = node->annotations[i];
-        decorators[i] = annotations_clone_handler(ann->name, ANNOTATION_HANDLER_DECORATOR);
-        modifiers[i] = annotations_clone_handler(ann->name, ANNOTATION_HANDLER_MODIFIER);
-        if (decorators[i].type == VAL_UNDEFINED && modifiers[i].type == VAL_UNDEFINED)
-        {
-            log_script_error(ann->line, ann->column, "Unknown annotation '@%s'", ann->name);
-            exit(1);
-        }
-        if (ann->is_call && decorators[i].type == VAL_UNDEFINED)
-        {
-            log_script_error(ann->line, ann->column, "Annotation '@%s' does not support arguments", ann->name);
-            exit(1);
-        }
-        if (ann->arg_count > 0 && modifiers[i].type != VAL_UNDEFINED && decorators[i].type == VAL_UNDEFINED)
-        {
-            log_script_error(ann->line, ann->column, "Modifier '@%s' does not accept arguments", ann->name);
-            exit(1);
-        }
-    }
-
-    for (int i = count - 1; i >= 0; --i)
-    {
-        if (decorators[i].type == VAL_UNDEFINED)
-            continue;
-        Annotation *ann = node->annotations[i];
-        Value decorator_callable = decorators[i];
-        decorators[i].type = VAL_UNDEFINED;
-
-        Value *args = NULL;
-        if (ann->is_call)
-        {
-            if (ann->arg_count > 0)
-            {
-                args = malloc(sizeof(Value) * ann->arg_count);
-                if (!args)
-                {
-                    log_script_error(ann->line, ann->column, "Out of memory while applying decorator");
-                    exit(1);
-                }
-                for (int j = 0; j < ann->arg_count; ++j)
-                    args[j] = eval_node(ann->args[j]);
-            }
-            Value intermediate = interpreter_call_value(decorator_callable, args, ann->arg_count, ann->line, ann->column);
-            free_value(decorator_callable);
-            decorator_callable = intermediate;
-            if (args)
-            {
-                for (int j = 0; j < ann->arg_count; ++j)
-                    free_value(args[j]);
-                free(args);
-                args = NULL;
-            }
-        }
-
-        Value decorator_args[1];
-        decorator_args[0] = *value;
-        Value decorated = interpreter_call_value(decorator_callable, decorator_args, 1, ann->line, ann->column);
-        free_value(decorator_callable);
-        *value = decorated;
-    }
-
-    Object *info_obj = object_create();
-    if (!info_obj)
-    {
-        log_script_error(node->line, node->column, "Out of memory while applying annotations");
-        exit(1);
-    }
-    Value info_val = {.type = VAL_OBJECT, .obj = info_obj};
-    const char *label = annotation_target_label(target_type);
-    if (label)
-    {
-        Value type_val = {.type = VAL_STRING, .str = strdup(label)};
-        object_set(info_obj, "target_type", type_val);
-        free_value(type_val);
-    }
-    if (name)
-    {
-        Value name_val = {.type = VAL_STRING, .str = strdup(name)};
-        object_set(info_obj, "name", name_val);
-        free_value(name_val);
-    }
-
-    bool assign_private = false;
-    for (int i = 0; i < count; ++i)
-    {
-        if (modifiers[i].type == VAL_UNDEFINED)
-            continue;
-        Annotation *ann = node->annotations[i];
-        Value args[2];
-        args[0] = *value;
-        args[1] = info_val;
-        Value result = interpreter_call_value(modifiers[i], args, 2, ann->line, ann->column);
-        free_value(modifiers[i]);
-        modifiers[i].type = VAL_UNDEFINED;
-
-        if (result.type == VAL_OBJECT)
-        {
-            Value flag = object_get(result.obj, "assign_private");
-            if (flag.type == VAL_BOOL && flag.boolean)
-                assign_private = true;
-        }
-        free_value(result);
-    }
-
-    free_value(info_val);
-
-    for (int i = 0; i < count; ++i)
-    {
-        if (decorators[i].type != VAL_UNDEFINED)
-            free_value(decorators[i]);
-        if (modifiers[i].type != VAL_UNDEFINED)
-            free_value(modifiers[i]);
+    if (IS_FUNCTION(fv))
+    {
+        Function *fn = AS_FUNCTION(fv);
+        Value static_flag = UNDEFINED_VAL;
+        if (fn->attributes)
+            static_flag = object_get(fn->attributes, "static");
+        if (IS_BOOL(static_flag))
+            fn->bind_on_access = !AS_BOOL(static_flag);
+        else
+            fn->bind_on_access = !is_static;
     }
+    object_set_atom(t->attributes, name, fv);
+    type_epoch++;
 
-    free(decorators);
-    free(modifiers);
-
-    return assign_private;
-}
-
-Value run_ast(ASTNode **nodes, int count)
-{
-    Value last = {.type = VAL_UNDEFINED};
-    for (int i = 0; i < count; ++i)
+    Value method_meta = value_get_attr(fv, intern("__abl_server_meta__"));
+    if (IS_OBJECT(method_meta))
     {
-        ASTNode *n = nodes[i];
-        switch (n->type)
-        {
-        case NODE_SET:
+        Value method_routes = object_get(AS_OBJECT(method_meta), "routes");
+        if (IS_LIST(method_routes) && AS_LIST(method_routes))
         {
-            Value result = eval_node(n->children[0]);
-
-            if (n->data.set.set_attr)
-            {
-                if (n->annotation_count > 0)
-                {
-                    log_script_error(n->line, n->column, "Annotations are not supported on attribute assignments");
-                    exit(1);
-                }
-                assign_attribute_chain(n->data.set.set_attr, result);
-            }
-            else
+            Value tv_tmp = TYPE_VAL(t);
+            Value class_meta = value_get_attr(tv_tmp, intern("__abl_server_meta__"));
+            if (!IS_OBJECT(class_meta))
             {
-                AnnotationTargetType target_type = result.type == VAL_FUNCTION ? ANNOTATION_TARGET_FUNCTION : ANNOTATION_TARGET_ASSIGNMENT;
-                bool modifier_private = apply_annotations(n, &result, target_type, n->data.set.set_name);
-                if (result.type == VAL_FUNCTION && result.func->env == NULL)
-                {
-                    result.func->env = interpreter_current_env();
-                    env_retain(interpreter_current_env());
-                }
-                if (n->is_private || modifier_private)
-                    set_private_variable(interpreter_current_env(), n->data.set.set_name, result);
-                else
-                    set_variable(interpreter_current_env(), n->data.set.set_name, result);
-            }
-            break;
-        }
-        case NODE_CLASS_DEF:
-        {
-            int base_count = n->data.cls.base_count;
-            Type **bases = NULL;
-            if (base_count > 0)
-            {
-                bases = malloc(sizeof(Type *) * base_count);
-                for (int i = 0; i < base_count; ++i)
-                {
-                    Value bv = get_variable(interpreter_current_env(), n->data.cls.base_names[i], n->line, n->column);
-                    if (bv.type != VAL_TYPE)
-                    {
-                        log_script_error(n->line, n->column, "Unknown base type '%s'", n->data.cls.base_names[i]);
-                        exit(1);
-                    }
-                    bases[i] = bv.cls;
-                }
+                Object *meta_obj = object_create();
+                Value meta_val = OBJECT_VAL(meta_obj);
+                value_set_attr(tv_tmp, intern("__abl_server_meta__"), meta_val);
+                free_value(meta_val);
+                class_meta = value_get_attr(tv_tmp, intern("__abl_server_meta__"));
             }
 
-            Type *t = type_create(n->data.cls.class_name);
-            type_set_bases(t, bases, base_count);
-
-            for (int m = 0; m < n->child_count; ++m)
+            Value class_routes = object_get(AS_OBJECT(class_meta), "routes");
+            if (!IS_LIST(class_routes) || !AS_LIST(class_routes))
             {
-                ASTNode *method = n->children[m];
-                Function *fn = malloc(sizeof(Function));
-                fn->name = strdup(method->data.method.method_name);
-                fn->param_count = method->data.method.param_count;
-                fn->params = malloc(sizeof(char *) * fn->param_count);
-                for (int p = 0; p < fn->param_count; ++p)
-                    fn->params[p] = strdup(method->data.method.params[p]);
-                fn->body = method->children;
-                fn->body_count = method->child_count;
-                method->children = NULL;
-                method->child_count = 0;
-                fn->env = interpreter_current_env();
-                env_retain(interpreter_current_env());
-                fn->attributes = object_create();
-                fn->is_async = method->data.method.is_async;
-                Value fv = {.type = VAL_FUNCTION, .func = fn};
-                bool method_private = apply_annotations(method, &fv, ANNOTATION_TARGET_METHOD, method->data.method.method_name);
-                (void)method_private;
-                if (fv.type == VAL_FUNCTION)
-                {
-                    Value static_flag = {.type = VAL_UNDEFINED};
-                    if (fv.func->attributes)
-                        static_flag = object_get(fv.func->attributes, "static");
-                    if (static_flag.type == VAL_BOOL)
-                        fv.func->bind_on_access = !static_flag.boolean;
-                    else
-                        fv.func->bind_on_access = !method->is_static;
-                }
-                object_set(t->attributes, method->data.method.method_name, fv);
-
-                Value method_meta = value_get_attr(fv, "__abl_server_meta__");
-                if (method_meta.type == VAL_OBJECT)
-                {
-                    Value method_routes = object_get(method_meta.obj, "routes");
-                    if (method_routes.type == VAL_LIST && method_routes.list)
-                    {
-                        Value tv_tmp = {.type = VAL_TYPE, .cls = t};
-                        Value class_meta = value_get_attr(tv_tmp, "__abl_server_meta__");
-                        if (class_meta.type != VAL_OBJECT)
-                        {
-                            Object *meta_obj = object_create();
-                            Value meta_val = {.type = VAL_OBJECT, .obj = meta_obj};
-                            value_set_attr(tv_tmp, "__abl_server_meta__", meta_val);
-                            free_value(meta_val);
-                            class_meta = value_get_attr(tv_tmp, "__abl_server_meta__");
-                        }
-
-                        Value class_routes = object_get(class_meta.obj, "routes");
-                        if (class_routes.type != VAL_LIST || !class_routes.list)
-                        {
-                            List *routes_list = malloc(sizeof(List));
-                            routes_list->count = 0;
-                            routes_list->capacity = 0;
-                            routes_list->items = NULL;
-                            Value routes_val = {.type = VAL_LIST, .list = routes_list};
-                            object_set(class_meta.obj, "routes", routes_val);
-                            class_routes = object_get(class_meta.obj, "routes");
-                        }
-
-                        for (int r = 0; r < method_routes.list->count; ++r)
-                        {
-                            Value entry = method_routes.list->items[r];
-                            if (entry.type != VAL_OBJECT)
-                                continue;
-                            Value route_val = {.type = VAL_OBJECT, .obj = clone_object(entry.obj)};
-                            list_append(class_routes.list, route_val);
-                            free_value(route_val);
-                        }
-                    }
-                }
+                Value routes_val = LIST_VAL(list_create());
+                object_set(AS_OBJECT(class_meta), "routes", routes_val);
+                free_value(routes_val);
+                class_routes = object_get(AS_OBJECT(class_meta), "routes");
             }
 
-            Value tv = {.type = VAL_TYPE, .cls = t};
-            bool class_private = apply_annotations(n, &tv, ANNOTATION_TARGET_CLASS, n->data.cls.class_name);
-            if (n->is_private || class_private)
-                set_private_variable(interpreter_current_env(), n->data.cls.class_name, tv);
-            else
-                set_variable(interpreter_current_env(), n->data.cls.class_name, tv);
-            break;
-        }
-        case NODE_FUNC_CALL:
-            exec_func_call(n);
-            break;
-        case NODE_POSTFIX_INC:
-            eval_node(n);
-            break;
-        case NODE_IF:
-        {
-            Value cond = eval_node(n->children[0]);
-            if (to_boolean(cond))
-            {
-                last = run_ast(n->children[1]->children, n->children[1]->child_count);
-            }
-            else if (n->child_count >= 3)
+            for (int r = 0; r < AS_LIST(method_routes)->count; ++r)
             {
-                ASTNode *else_node = n->children[2];
-                if (else_node->type == NODE_IF)
-                {
-                    Value res = eval_node(else_node);
-                    last = res;
-                }
-                else
-                {
-                    last = run_ast(else_node->children, else_node->child_count);
-                }
-            }
-            break;
-        }
-        case NODE_RETURN:
-        {
-            last = eval_node(n->children[0]);
-            CallFrame *f = current_frame(&call_stack);
-            if (f)
-                f->returning = true;
-            return last;
-        }
-        case NODE_BLOCK:
-            last = run_ast(n->children, n->child_count);
-            break;
-        case NODE_FOR:
-        {
-            Value iterable = eval_node(n->children[0]);
-            ASTNode *body = n->children[1];
-            if (iterable.type == VAL_NUMBER)
-            {
-                int limit = (int)iterable.num;
-                for (int i = 0; i < limit; ++i)
-                {
-                    Value idx = {.type = VAL_NUMBER, .num = i};
-                    set_variable(interpreter_current_env(), n->data.loop.loop_var,
-                                 idx);
-                    last = run_ast(body->children, body->child_count);
-                    CallFrame *cf = current_frame(&call_stack);
-                    if (cf && cf->returning)
-                        break;
-                    if (break_flag)
-                    {
-                        break_flag = false;
-                        break;
-                    }
-                    if (continue_flag)
-                    {
-                        continue_flag = false;
-                        continue;
-                    }
-                }
-            }
-            else if (iterable.type == VAL_LIST)
-            {
-                for (int i = 0; i < iterable.list->count; ++i)
-                {
-                    set_variable(interpreter_current_env(), n->data.loop.loop_var,
-                                 iterable.list->items[i]);
-                    last = run_ast(body->children, body->child_count);
-                    CallFrame *cf = current_frame(&call_stack);
-                    if (cf && cf->returning)
-                        break;
-                    if (break_flag)
-                    {
-                        break_flag = false;
-                        break;
-                    }
-                    if (continue_flag)
-                    {
-                        continue_flag = false;
-                        continue;
-                    }
-                }
-            }
-            else
-            {
-                Value iter_func = value_get_attr(iterable, "__iter__");
-                if (iter_func.type == VAL_UNDEFINED || iter_func.type == VAL_NULL)
-                {
-                    log_script_error(n->line, n->column, "Object is not iterable");
-                    exit(1);
-                }
-                Value iterator = interpreter_call_value(iter_func, NULL, 0, n->line, n->column);
-                while (1)
-                {
-                    Value next_f = value_get_attr(iterator, "__next__");
-                    if (next_f.type == VAL_UNDEFINED || next_f.type == VAL_NULL)
-                    {
-                        log_script_error(n->line, n->column,
-                                         "Iterator missing __next__ method");
-                        exit(1);
-                    }
-                    Value item = interpreter_call_value(next_f, NULL, 0, n->line, n->column);
-                    if (item.type == VAL_UNDEFINED)
-                        break;
-                    set_variable(interpreter_current_env(), n->data.loop.loop_var,
-                                 item);
-                    last = run_ast(body->children, body->child_count);
-                    CallFrame *cf = current_frame(&call_stack);
-                    if (cf && cf->returning)
-                        break;
-                    if (break_flag)
-                    {
-                        break_flag = false;
-                        break;
-                    }
-                    if (continue_flag)
-                    {
-                        continue_flag = false;
-                        continue;
-                    }
-                }
-            }
-            break;
-        }
-        case NODE_WHILE:
-        {
-            while (to_boolean(eval_node(n->children[0])))
-            {
-                last = run_ast(n->children[1]->children, n->children[1]->child_count);
-                CallFrame *cf = current_frame(&call_stack);
-                if (cf && cf->returning)
-                    break;
-                if (break_flag)
-                {
-                    break_flag = false;
-                    break;
-                }
-                if (continue_flag)
-                {
-                    continue_flag = false;
+                Value entry = list_get(AS_LIST(method_routes), r);
+                if (!IS_OBJECT(entry))
                     continue;
-                }
+                Value route_val = OBJECT_VAL(clone_object(AS_OBJECT(entry)));
+                list_append(AS_LIST(class_routes), route_val);
+                free_value(route_val);
             }
-            break;
-        }
-        case NODE_BREAK:
-            break_flag = true;
-            return last;
-        case NODE_CONTINUE:
-            continue_flag = true;
-            return last;
-        case NODE_IMPORT_MODULE:
-        {
-            Value mod = import_module_value(n->data.import_module.module_name,
-                                           n->line, n->column);
-            set_variable(interpreter_current_env(), n->data.import_module.module_name,
-                         mod);
-            break;
         }
-        case NODE_IMPORT_NAMES:
-        {
-            for (int i = 0; i < n->data.import_names.name_count; ++i)
-            {
-                Value attr = import_module_attr(n->data.import_names.module_name,
-                                               n->data.import_names.names[i],
-                                               n->line, n->column);
-                set_variable(interpreter_current_env(),
-                             n->data.import_names.names[i], attr);
-            }
-            break;
-        }
-        default:
-            break;
-        }
-
-        CallFrame *cf = current_frame(&call_stack);
-        if (cf && cf->returning)
-            return last;
-        if (break_flag || continue_flag)
-            return last;
     }
-
-    return last;
 }
@@ -5,6 +5,7 @@
 #include "types/value.h"
 #include "types/env.h"
 #include "types/function.h"
+#include "types/type.h"
 #include "interpreter/stack.h"
 
 void interpreter_init();
@@ -12,10 +13,24 @@ void interpreter_cleanup();
 void interpreter_set_env(Env *env);
 void interpreter_pop_env();
 Env *interpreter_current_env();
-Value run_ast(ASTNode **nodes, int count);
+Value interpreter_run(ASTNode **nodes, int count, const char *name);
+/* Run a whole program: set up the global environment and module system,
+   execute `source` as the main module `filename`, then tear it all down. */
+void interpreter_run_script(const char *filename, const char *source, const char *exec_path);
 Value interpreter_create_async_promise(Function *fn, Value *args, int arg_count, bool has_self, Value self, int line, int column);
 Value interpreter_await(Value awaited, int line, int column);
 Value interpreter_call_value(Value callee, Value *args, int arg_count, int line, int column);
+/* Call `fn` with `self` as its receiver, as a bound method would. */
+Value interpreter_call_method(Function *fn, Value self, Value *args, int arg_count, int line, int column);
 Value interpreter_call_and_await(Value callee, Value *args, int arg_count, int line, int column);
 
+/* Evaluation helpers shared with the VM */
+bool interpreter_to_boolean(Value v);
+double interpreter_to_number(Value v);
+Value interpreter_binary_op(BinaryOp op, Value left, Value right, int line, int column);
+/* Built-in methods of lists and the Promise namespace; `name` is an atom.
+   Sets *handled to false for any other receiver or name. */
+Value interpreter_call_intrinsic_method(Value target, const char *name, Value *args, int argc, int line, int column, bool *handled);
+void interpreter_add_method(Type *t, const char *name, Value fv, bool is_static);
+
 #endif
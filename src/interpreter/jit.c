@@ -0,0 +1,922 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/jit.h"
+#include "utils/utils.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+/* Calls plus loop back-edges before a function is translated. */
+#define JIT_HOT_THRESHOLD 1000
+/* Bailouts after which native code is dropped and the chunk interpreted. */
+#define JIT_MAX_BAILOUTS 64
+
+typedef struct JitCode
+{
+    JitEntry entry;
+    void *memory;
+    size_t size;
+    char *name;
+    bool precompiled;
+    unsigned long calls;
+    unsigned long bailouts;
+    struct JitCode *next;
+} JitCode;
+
+static struct
+{
+    bool enabled;
+    bool stats;
+    JitCode *compiled;
+    int rejected;
+} jit;
+
+static struct
+{
+    const JitPrecompiled *functions;
+    int count;
+} precompiled;
+
+void jit_init(void)
+{
+    jit.enabled = (JIT_SUPPORTED || precompiled.count > 0) && env_flag("ABLE_JIT", true);
+    jit.stats = env_flag("ABLE_JIT_STATS", false);
+    jit.compiled = NULL;
+    jit.rejected = 0;
+}
+
+bool jit_enabled(void)
+{
+    return jit.enabled;
+}
+
+static void print_stats(void)
+{
+    int count = 0;
+    int ahead = 0;
+    size_t bytes = 0;
+    unsigned long calls = 0;
+    unsigned long bailouts = 0;
+    for (JitCode *code = jit.compiled; code; code = code->next)
+    {
+        if (code->precompiled)
+            ahead++;
+        else
+            count++;
+        bytes += code->size;
+        calls += code->calls;
+        bailouts += code->bailouts;
+    }
+    fprintf(stderr, "jit: %s, %d compiled (%zu bytes), %d precompiled, %d rejected, %lu native calls, %lu bailouts\n",
+            jit.enabled ? "on" : "off", count, bytes, ahead, jit.rejected, calls, bailouts);
+    for (JitCode *code = jit.compiled; code; code = code->next)
+        fprintf(stderr, "jit:   %s: %lu calls, %lu bailouts%s\n", code->name, code->calls, code->bailouts,
+                code->precompiled ? " (precompiled)" : "");
+}
+
+void jit_cleanup(void)
+{
+    if (jit.stats)
+        print_stats();
+    JitCode *code = jit.compiled;
+    while (code)
+    {
+        JitCode *next = code->next;
+#if JIT_SUPPORTED
+        if (code->memory)
+            munmap(code->memory, code->size);
+#endif
+        free(code->name);
+        free(code);
+        code = next;
+    }
+    jit.compiled = NULL;
+}
+
+void jit_set_precompiled(const JitPrecompiled *functions, int count)
+{
+    precompiled.functions = functions;
+    precompiled.count = count;
+}
+
+void jit_record_call(Chunk *chunk, bool bailed_out)
+{
+    JitCode *code = chunk->jit;
+    code->calls++;
+    if (!bailed_out)
+        return;
+    code->bailouts++;
+    if (code->bailouts >= JIT_MAX_BAILOUTS)
+    {
+        chunk->jit = NULL;
+        chunk->jit_rejected = true;
+    }
+}
+
+/* --- translation --- */
+
+/* The bytecode-level operation a (possibly quickened) opcode performs. */
+static OpCode generic_op(OpCode op)
+{
+    switch (op)
+    {
+    case BC_ADD_INT:
+    case BC_ADD_NUM:
+    case BC_ADD_STR:
+        return BC_ADD;
+    case BC_SUB_INT:
+    case BC_SUB_NUM:
+        return BC_SUB;
+    case BC_MUL_INT:
+    case BC_MUL_NUM:
+        return BC_MUL;
+    case BC_DIV_NUM:
+        return BC_DIV;
+    case BC_EQ_INT:
+    case BC_EQ_NUM:
+    case BC_EQ_STR:
+        return BC_EQ;
+    case BC_LT_INT:
+    case BC_LT_NUM:
+    case BC_LT_STR:
+        return BC_LT;
+    case BC_GT_INT:
+    case BC_GT_NUM:
+    case BC_GT_STR:
+        return BC_GT;
+    case BC_LTE_INT:
+    case BC_LTE_NUM:
+    case BC_LTE_STR:
+        return BC_LTE;
+    case BC_GTE_INT:
+    case BC_GTE_NUM:
+    case BC_GTE_STR:
+        return BC_GTE;
+    default:
+        return op;
+    }
+}
+
+static int read_u16(const Chunk *chunk, int offset)
+{
+    return (chunk->code[offset + 1] << 8) | chunk->code[offset + 2];
+}
+
+/* Operand stack effect of a translatable opcode, or INT32_MIN if the
+   opcode cannot be translated. */
+static int stack_effect(const Chunk *chunk, int offset)
+{
+    switch (generic_op((OpCode)chunk->code[offset]))
+    {
+    case BC_CONSTANT:
+    {
+        Value v = chunk->constants[read_u16(chunk, offset)];
+        /* Heap constants are cloned on every load, which needs the runtime. */
+        if (!IS_DOUBLE(v) && !IS_SMALL_INT(v) && !VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_CONST))
+            return INT32_MIN;
+        return 1;
+    }
+    case BC_UNDEFINED:
+    case BC_NULL:
+    case BC_TRUE:
+    case BC_FALSE:
+    case BC_GET_LOCAL:
+    case BC_INCREMENT:
+        return 1;
+    case BC_POP:
+    case BC_SET_LOCAL:
+    case BC_ADD:
+    case BC_SUB:
+    case BC_MUL:
+    case BC_MOD:
+    case BC_EQ:
+    case BC_LT:
+    case BC_GT:
+    case BC_LTE:
+    case BC_GTE:
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+    case BC_RETURN:
+        return -1;
+    case BC_NOT:
+    case BC_TO_BOOL:
+    case BC_JUMP:
+    case BC_LOOP:
+        return 0;
+    default:
+        return INT32_MIN;
+    }
+}
+
+static int jump_target(const Chunk *chunk, int offset)
+{
+    int next = offset + 3;
+    if (chunk->code[offset] == BC_LOOP)
+        return next - read_u16(chunk, offset);
+    return next + read_u16(chunk, offset);
+}
+
+/*
+ * Operand stack depth before every instruction, or -1 where unreachable.
+ * Returns false if the chunk uses an opcode with no template or its
+ * depths disagree at a join.
+ */
+static bool compute_depths(const Chunk *chunk, int *depth)
+{
+    for (int i = 0; i < chunk->count; ++i)
+        depth[i] = -1;
+    int *work = malloc(sizeof(int) * (chunk->count + 1));
+    int work_count = 0;
+    depth[0] = 0;
+    work[work_count++] = 0;
+    bool ok = true;
+    while (ok && work_count > 0)
+    {
+        int offset = work[--work_count];
+        int effect = stack_effect(chunk, offset);
+        if (effect == INT32_MIN)
+        {
+            ok = false;
+            break;
+        }
+        OpCode op = (OpCode)chunk->code[offset];
+        int after = depth[offset] + effect;
+        int succ[2];
+        int succ_count = 0;
+        if (op == BC_JUMP || op == BC_LOOP)
+            succ[succ_count++] = jump_target(chunk, offset);
+        else if (op != BC_RETURN)
+        {
+            succ[succ_count++] = offset + opcode_length(chunk, offset);
+            if (op == BC_JUMP_IF_FALSE || op == BC_JUMP_IF_TRUE)
+                succ[succ_count++] = jump_target(chunk, offset);
+        }
+        for (int s = 0; s < succ_count; ++s)
+        {
+            int target = succ[s];
+            if (target < 0 || target >= chunk->count || after < 0 || after > chunk->max_stack)
+                ok = false;
+            else if (depth[target] < 0)
+            {
+                depth[target] = after;
+                work[work_count++] = target;
+            }
+            else if (depth[target] != after)
+                ok = false;
+        }
+    }
+    free(work);
+    return ok;
+}
+
+static uint32_t hash_mix(uint32_t hash, const void *data, size_t length)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint32_t jit_chunk_hash(const Chunk *chunk)
+{
+    uint32_t hash = hash_mix(2166136261u, chunk->name, strlen(chunk->name));
+    for (int offset = 0; offset < chunk->count;)
+    {
+        int length = opcode_length(chunk, offset);
+        uint8_t op = (uint8_t)generic_op((OpCode)chunk->code[offset]);
+        hash = hash_mix(hash, &op, 1);
+        hash = hash_mix(hash, chunk->code + offset + 1, length - 1);
+        offset += length;
+    }
+    for (int i = 0; i < chunk->constant_count; ++i)
+    {
+        Value v = chunk->constants[i];
+        /* Heap constants differ in address from run to run. */
+        uint64_t key = IS_DOUBLE(v) || IS_SMALL_INT(v) || VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_CONST)
+                           ? v.bits
+                           : (uint64_t)value_type(v);
+        hash = hash_mix(hash, &key, sizeof(key));
+    }
+    return hash;
+}
+
+/* --- C emitter --- */
+
+/* Frame slots become the C locals r0, r1, ...; the operand stack starts
+   at local_count. Nothing is written back to `frame`, so a bailout leaves
+   the arguments as they were. */
+static void emit_c_instruction(FILE *out, const Chunk *chunk, int offset, int depth)
+{
+    static const char *const helpers[] = {
+        [BC_ADD] = "aot_add", [BC_SUB] = "aot_sub", [BC_MUL] = "aot_mul", [BC_MOD] = "aot_mod",
+        [BC_EQ] = "aot_eq", [BC_LT] = "aot_lt", [BC_GT] = "aot_gt", [BC_LTE] = "aot_lte",
+        [BC_GTE] = "aot_gte",
+    };
+    int top = chunk->local_count + depth;
+    OpCode op = generic_op((OpCode)chunk->code[offset]);
+    switch (op)
+    {
+    case BC_CONSTANT:
+        fprintf(out, "    r%d.bits = UINT64_C(0x%016llx);\n", top,
+                (unsigned long long)chunk->constants[read_u16(chunk, offset)].bits);
+        break;
+    case BC_UNDEFINED:
+        fprintf(out, "    r%d = UNDEFINED_VAL;\n", top);
+        break;
+    case BC_NULL:
+        fprintf(out, "    r%d = NULL_VAL;\n", top);
+        break;
+    case BC_TRUE:
+    case BC_FALSE:
+        fprintf(out, "    r%d = BOOL_VAL(%s);\n", top, op == BC_TRUE ? "true" : "false");
+        break;
+    case BC_POP:
+        fprintf(out, "    (void)r%d;\n", top - 1);
+        break;
+    case BC_GET_LOCAL:
+        fprintf(out, "    r%d = r%d;\n", top, read_u16(chunk, offset));
+        break;
+    case BC_SET_LOCAL:
+        fprintf(out, "    r%d = r%d;\n", read_u16(chunk, offset), top - 1);
+        break;
+    case BC_ADD:
+    case BC_SUB:
+    case BC_MUL:
+    case BC_MOD:
+    case BC_EQ:
+    case BC_LT:
+    case BC_GT:
+    case BC_LTE:
+    case BC_GTE:
+        fprintf(out, "    if (!%s(r%d, r%d, &r%d))\n        return false;\n", helpers[op], top - 2, top - 1,
+                top - 2);
+        break;
+    case BC_NOT:
+    case BC_TO_BOOL:
+        fprintf(out, "    {\n        int t = aot_truth(r%d);\n        if (t < 0)\n            return false;\n"
+                     "        r%d = BOOL_VAL(%st);\n    }\n",
+                top - 1, top - 1, op == BC_NOT ? "!" : "");
+        break;
+    case BC_INCREMENT:
+        fprintf(out, "    if (!aot_add(r%d, SMALL_INT_VAL(1), &r%d))\n        return false;\n", top - 1, top);
+        break;
+    case BC_JUMP:
+    case BC_LOOP:
+        fprintf(out, "    goto L%d;\n", jump_target(chunk, offset));
+        break;
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+        fprintf(out, "    {\n        int t = aot_truth(r%d);\n        if (t < 0)\n            return false;\n"
+                     "        if (%st)\n            goto L%d;\n    }\n",
+                top - 1, op == BC_JUMP_IF_FALSE ? "!" : "", jump_target(chunk, offset));
+        break;
+    case BC_RETURN:
+        fprintf(out, "    if (!aot_plain(r%d))\n        return false;\n    *result = r%d;\n    return true;\n",
+                top - 1, top - 1);
+        break;
+    default:
+        break;
+    }
+}
+
+bool jit_emit_c(const Chunk *chunk, const char *name, FILE *out)
+{
+    int *depth = malloc(sizeof(int) * (chunk->count > 0 ? chunk->count : 1));
+    if (chunk->count == 0 || !compute_depths(chunk, depth))
+    {
+        free(depth);
+        return false;
+    }
+
+    bool *is_target = calloc(chunk->count, sizeof(bool));
+    int slots = chunk->local_count;
+    for (int offset = 0; offset < chunk->count; offset += opcode_length(chunk, offset))
+    {
+        if (depth[offset] < 0)
+            continue;
+        OpCode op = (OpCode)chunk->code[offset];
+        if (op == BC_JUMP || op == BC_LOOP || op == BC_JUMP_IF_FALSE || op == BC_JUMP_IF_TRUE)
+            is_target[jump_target(chunk, offset)] = true;
+        int reach = chunk->local_count + depth[offset] + (stack_effect(chunk, offset) > 0 ? 1 : 0);
+        if (reach > slots)
+            slots = reach;
+    }
+
+    fprintf(out, "/* %s */\nstatic bool %s(Value *frame, Value *result)\n{\n", chunk->name, name);
+    for (int i = 0; i < slots; ++i)
+    {
+        if (i < chunk->local_count)
+            fprintf(out, "    Value r%d = frame[%d];\n", i, i);
+        else
+            fprintf(out, "    Value r%d = UNDEFINED_VAL;\n", i);
+    }
+    fprintf(out, "    (void)frame;\n");
+    for (int i = 0; i < slots; ++i)
+        fprintf(out, "    (void)r%d;\n", i);
+    for (int offset = 0; offset < chunk->count; offset += opcode_length(chunk, offset))
+    {
+        if (depth[offset] < 0)
+            continue;
+        if (is_target[offset])
+            fprintf(out, "L%d:\n", offset);
+        emit_c_instruction(out, chunk, offset, depth[offset]);
+    }
+    fprintf(out, "}\n\n");
+    free(is_target);
+    free(depth);
+    return true;
+}
+
+#if JIT_SUPPORTED
+
+/* --- x86-64 emitter --- */
+
+enum
+{
+    RAX = 0,
+    RCX = 1,
+    RDX = 2
+};
+
+typedef struct
+{
+    int at;     /* offset of the rel32 field */
+    int target; /* bytecode offset, or -1 for the bailout exit */
+} Fixup;
+
+typedef struct
+{
+    uint8_t *code;
+    int count;
+    int capacity;
+    Fixup *fixups;
+    int fixup_count;
+    int fixup_capacity;
+} Emitter;
+
+static void emit_bytes(Emitter *e, const uint8_t *bytes, int n)
+{
+    if (e->count + n > e->capacity)
+    {
+        while (e->count + n > e->capacity)
+            e->capacity = e->capacity ? e->capacity * 2 : 256;
+        e->code = realloc(e->code, e->capacity);
+        if (!e->code)
+        {
+            log_error("Out of memory while compiling native code");
+            exit(1);
+        }
+    }
+    memcpy(e->code + e->count, bytes, n);
+    e->count += n;
+}
+
+#define EMIT(...)                                           \
+    do                                                      \
+    {                                                       \
+        const uint8_t bytes_[] = {__VA_ARGS__};             \
+        emit_bytes(e, bytes_, (int)sizeof(bytes_));         \
+    } while (0)
+
+static void emit_u32(Emitter *e, uint32_t v)
+{
+    EMIT(v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, (v >> 24) & 0xff);
+}
+
+static void emit_u64(Emitter *e, uint64_t v)
+{
+    emit_u32(e, (uint32_t)v);
+    emit_u32(e, (uint32_t)(v >> 32));
+}
+
+/* rel32 to a bytecode offset (or the bailout exit), patched at the end. */
+static void emit_rel32(Emitter *e, int target)
+{
+    if (e->fixup_count == e->fixup_capacity)
+    {
+        e->fixup_capacity = e->fixup_capacity ? e->fixup_capacity * 2 : 32;
+        e->fixups = realloc(e->fixups, sizeof(Fixup) * e->fixup_capacity);
+    }
+    e->fixups[e->fixup_count++] = (Fixup){.at = e->count, .target = target};
+    emit_u32(e, 0);
+}
+
+#define BAIL (-1)
+
+static void emit_jmp(Emitter *e, int target)
+{
+    EMIT(0xe9);
+    emit_rel32(e, target);
+}
+
+enum
+{
+    CC_O = 0x0,
+    CC_E = 0x4,
+    CC_NE = 0x5,
+    CC_S = 0x8,
+    CC_L = 0xc,
+    CC_GE = 0xd,
+    CC_LE = 0xe,
+    CC_G = 0xf
+};
+
+/* jcc rel32; `cc` is the low nibble of the 0F 8x condition code. */
+static void emit_jcc(Emitter *e, int cc, int target)
+{
+    EMIT(0x0f, 0x80 | cc);
+    emit_rel32(e, target);
+}
+
+/* mov reg, [rbx + 8 * slot] and mov [rbx + 8 * slot], reg */
+static void emit_load(Emitter *e, int reg, int slot)
+{
+    EMIT(0x48, 0x8b, 0x83 | (reg << 3));
+    emit_u32(e, (uint32_t)(slot * 8));
+}
+
+static void emit_store(Emitter *e, int reg, int slot)
+{
+    EMIT(0x48, 0x89, 0x83 | (reg << 3));
+    emit_u32(e, (uint32_t)(slot * 8));
+}
+
+static void emit_mov_imm(Emitter *e, int reg, uint64_t imm)
+{
+    EMIT(0x48, 0xb8 + reg);
+    emit_u64(e, imm);
+}
+
+/* Bail unless `reg` holds an inline int: its top 16 bits are exactly the
+   quiet-NaN pattern of tag 0. Clobbers rdx. */
+static void emit_guard_int(Emitter *e, int reg)
+{
+    EMIT(0x48, 0x89, 0xc2 | (reg << 3));   /* mov rdx, reg */
+    EMIT(0x48, 0xc1, 0xea, 48);            /* shr rdx, 48 */
+    EMIT(0x81, 0xfa);                      /* cmp edx, imm32 */
+    emit_u32(e, (uint32_t)(VALUE_QNAN >> 48));
+    emit_jcc(e, CC_NE, BAIL);
+}
+
+/* Sign-extend the 48-bit payload of `reg` to a full int64. */
+static void emit_untag(Emitter *e, int reg)
+{
+    EMIT(0x48, 0xc1, 0xe0 + reg, 16); /* shl reg, 16 */
+    EMIT(0x48, 0xc1, 0xf8 + reg, 16); /* sar reg, 16 */
+}
+
+/* Box the int64 in rax as an inline int, bailing when it needs more than
+   48 bits (the interpreter boxes those on the heap). Clobbers rdx. */
+static void emit_tag_int(Emitter *e)
+{
+    EMIT(0x48, 0x89, 0xc2);       /* mov rdx, rax */
+    EMIT(0x48, 0xc1, 0xe2, 16);   /* shl rdx, 16 */
+    EMIT(0x48, 0xc1, 0xfa, 16);   /* sar rdx, 16 */
+    EMIT(0x48, 0x39, 0xc2);       /* cmp rdx, rax */
+    emit_jcc(e, CC_NE, BAIL);
+    emit_mov_imm(e, RDX, VALUE_PAYLOAD_MASK);
+    EMIT(0x48, 0x21, 0xd0);       /* and rax, rdx */
+    emit_mov_imm(e, RDX, VALUE_QNAN);
+    EMIT(0x48, 0x09, 0xd0);       /* or rax, rdx */
+}
+
+/* Load the two operands below `top` as untagged ints into rax and rcx. */
+static void emit_int_operands(Emitter *e, int top)
+{
+    emit_load(e, RAX, top - 2);
+    emit_load(e, RCX, top - 1);
+    emit_guard_int(e, RAX);
+    emit_guard_int(e, RCX);
+    emit_untag(e, RAX);
+    emit_untag(e, RCX);
+}
+
+/* Bail unless rax holds a boolean. Clobbers rcx and rdx. */
+static void emit_guard_bool(Emitter *e)
+{
+    EMIT(0x48, 0x89, 0xc2);       /* mov rdx, rax */
+    EMIT(0x48, 0x83, 0xca, 0x08); /* or rdx, 8 */
+    emit_mov_imm(e, RCX, VALUE_BITS_TRUE);
+    EMIT(0x48, 0x39, 0xca);       /* cmp rdx, rcx */
+    emit_jcc(e, CC_NE, BAIL);
+}
+
+/* Patch a rel8 jump emitted at `at` to land at the current position. */
+static void patch_rel8(Emitter *e, int at)
+{
+    e->code[at + 1] = (uint8_t)(e->count - (at + 2));
+}
+
+/* Return rax if it owns nothing (a double, an inline int or a constant);
+   anything else may be a borrowed argument, so bail. */
+static void emit_return(Emitter *e)
+{
+    emit_mov_imm(e, RCX, VALUE_QNAN);
+    EMIT(0x48, 0x89, 0xc2); /* mov rdx, rax */
+    EMIT(0x48, 0x21, 0xca); /* and rdx, rcx */
+    EMIT(0x48, 0x39, 0xca); /* cmp rdx, rcx */
+    int is_double = e->count;
+    EMIT(0x75, 0);          /* jne exit */
+    EMIT(0x48, 0x89, 0xc2); /* mov rdx, rax */
+    EMIT(0x48, 0xc1, 0xea, 48);
+    EMIT(0x81, 0xfa);       /* cmp edx, imm32 */
+    emit_u32(e, (uint32_t)(VALUE_QNAN >> 48));
+    int is_int = e->count;
+    EMIT(0x74, 0);          /* je exit */
+    emit_mov_imm(e, RCX, VALUE_TAG_MASK | VALUE_SUBTAG_MASK);
+    EMIT(0x48, 0x89, 0xc2); /* mov rdx, rax */
+    EMIT(0x48, 0x21, 0xca); /* and rdx, rcx */
+    emit_mov_imm(e, RCX, VALUE_TAG(VALUE_TAG_OTHER) | VALUE_SUBTAG_CONST);
+    EMIT(0x48, 0x39, 0xca); /* cmp rdx, rcx */
+    emit_jcc(e, CC_NE, BAIL);
+    patch_rel8(e, is_double);
+    patch_rel8(e, is_int);
+    /* mov [r12], rax; mov eax, 1; pop r12; pop rbx; ret */
+    EMIT(0x49, 0x89, 0x04, 0x24, 0xb8, 0x01, 0x00, 0x00, 0x00, 0x41, 0x5c, 0x5b, 0xc3);
+}
+
+static void emit_compare(Emitter *e, int top, int cc)
+{
+    emit_int_operands(e, top);
+    EMIT(0x48, 0x39, 0xc8); /* cmp rax, rcx */
+    emit_mov_imm(e, RAX, VALUE_BITS_FALSE);
+    emit_mov_imm(e, RDX, VALUE_BITS_TRUE);
+    EMIT(0x48, 0x0f, 0x40 | cc, 0xc2); /* cmovcc rax, rdx */
+    emit_store(e, RAX, top - 2);
+}
+
+static void emit_instruction(Emitter *e, const Chunk *chunk, int offset, int depth)
+{
+    int top = chunk->local_count + depth; /* first free operand slot */
+    OpCode op = (OpCode)chunk->code[offset];
+    switch (generic_op(op))
+    {
+    case BC_CONSTANT:
+        emit_mov_imm(e, RAX, chunk->constants[read_u16(chunk, offset)].bits);
+        emit_store(e, RAX, top);
+        break;
+    case BC_UNDEFINED:
+    case BC_NULL:
+    case BC_TRUE:
+    case BC_FALSE:
+    {
+        uint64_t bits = op == BC_UNDEFINED ? VALUE_BITS_UNDEFINED
+                        : op == BC_NULL    ? VALUE_BITS_NULL
+                        : op == BC_TRUE    ? VALUE_BITS_TRUE
+                                           : VALUE_BITS_FALSE;
+        emit_mov_imm(e, RAX, bits);
+        emit_store(e, RAX, top);
+        break;
+    }
+    case BC_POP:
+        break;
+    case BC_GET_LOCAL:
+        emit_load(e, RAX, read_u16(chunk, offset));
+        emit_store(e, RAX, top);
+        break;
+    case BC_SET_LOCAL:
+        emit_load(e, RAX, top - 1);
+        emit_store(e, RAX, read_u16(chunk, offset));
+        break;
+    case BC_ADD:
+    case BC_SUB:
+    case BC_MUL:
+        emit_int_operands(e, top);
+        if (generic_op(op) == BC_ADD)
+            EMIT(0x48, 0x01, 0xc8); /* add rax, rcx */
+        else if (generic_op(op) == BC_SUB)
+            EMIT(0x48, 0x29, 0xc8); /* sub rax, rcx */
+        else
+        {
+            /* A zero product with a negative factor is -0.0 there. */
+            EMIT(0x48, 0x89, 0xc2);       /* mov rdx, rax */
+            EMIT(0x48, 0x09, 0xca);       /* or rdx, rcx */
+            EMIT(0x48, 0x0f, 0xaf, 0xc1); /* imul rax, rcx */
+            emit_jcc(e, CC_O, BAIL);
+            EMIT(0x48, 0x85, 0xc0);       /* test rax, rax */
+            int nonzero = e->count;
+            EMIT(0x75, 0);                /* jne tag */
+            EMIT(0x48, 0x85, 0xd2);       /* test rdx, rdx */
+            emit_jcc(e, CC_S, BAIL);
+            patch_rel8(e, nonzero);
+        }
+        emit_tag_int(e);
+        emit_store(e, RAX, top - 2);
+        break;
+    case BC_MOD:
+        /* C remainder, as interpreter_binary_op computes it for ints; a
+           zero divisor makes a NaN there and a zero remainder of a
+           negative -0.0, so leave both to the interpreter. */
+        emit_int_operands(e, top);
+        EMIT(0x48, 0x85, 0xc9); /* test rcx, rcx */
+        emit_jcc(e, CC_E, BAIL);
+        EMIT(0x48, 0x99);       /* cqo */
+        EMIT(0x48, 0xf7, 0xf9); /* idiv rcx */
+        EMIT(0x48, 0x85, 0xd2); /* test rdx, rdx */
+        int nonzero = e->count;
+        EMIT(0x75, 0);          /* jne done */
+        EMIT(0x48, 0x85, 0xc0); /* test rax, rax */
+        int zero = e->count;
+        EMIT(0x74, 0);          /* je done */
+        /* No remainder: the dividend is quotient * divisor, negative when
+           their signs differ. */
+        EMIT(0x48, 0x31, 0xc8); /* xor rax, rcx */
+        emit_jcc(e, CC_S, BAIL);
+        patch_rel8(e, nonzero);
+        patch_rel8(e, zero);
+        EMIT(0x48, 0x89, 0xd0); /* mov rax, rdx */
+        emit_tag_int(e);
+        emit_store(e, RAX, top - 2);
+        break;
+    case BC_EQ:
+        emit_compare(e, top, CC_E);
+        break;
+    case BC_LT:
+        emit_compare(e, top, CC_L);
+        break;
+    case BC_GT:
+        emit_compare(e, top, CC_G);
+        break;
+    case BC_LTE:
+        emit_compare(e, top, CC_LE);
+        break;
+    case BC_GTE:
+        emit_compare(e, top, CC_GE);
+        break;
+    case BC_NOT:
+    case BC_TO_BOOL:
+        emit_load(e, RAX, top - 1);
+        emit_guard_bool(e);
+        if (op == BC_NOT)
+        {
+            EMIT(0x48, 0x83, 0xf0, 0x08); /* xor rax, 8 */
+            emit_store(e, RAX, top - 1);
+        }
+        break;
+    case BC_INCREMENT:
+        emit_load(e, RAX, top - 1);
+        emit_guard_int(e, RAX);
+        emit_untag(e, RAX);
+        EMIT(0x48, 0x83, 0xc0, 0x01); /* add rax, 1 */
+        emit_tag_int(e);
+        emit_store(e, RAX, top);
+        break;
+    case BC_JUMP:
+    case BC_LOOP:
+        emit_jmp(e, jump_target(chunk, offset));
+        break;
+    case BC_JUMP_IF_FALSE:
+    case BC_JUMP_IF_TRUE:
+    {
+        /* Only booleans: the truthiness of anything else is left to the
+           interpreter. */
+        bool on_true = op == BC_JUMP_IF_TRUE;
+        emit_load(e, RAX, top - 1);
+        emit_mov_imm(e, RDX, on_true ? VALUE_BITS_TRUE : VALUE_BITS_FALSE);
+        EMIT(0x48, 0x39, 0xd0); /* cmp rax, rdx */
+        emit_jcc(e, CC_E, jump_target(chunk, offset));
+        emit_mov_imm(e, RDX, on_true ? VALUE_BITS_FALSE : VALUE_BITS_TRUE);
+        EMIT(0x48, 0x39, 0xd0); /* cmp rax, rdx */
+        emit_jcc(e, CC_NE, BAIL);
+        break;
+    }
+    case BC_RETURN:
+        emit_load(e, RAX, top - 1);
+        emit_return(e);
+        break;
+    default:
+        break;
+    }
+}
+
+static JitCode *compile_chunk(const Chunk *chunk)
+{
+    int *depth = malloc(sizeof(int) * (chunk->count > 0 ? chunk->count : 1));
+    if (chunk->count == 0 || !compute_depths(chunk, depth))
+    {
+        free(depth);
+        return NULL;
+    }
+
+    Emitter e = {0};
+    int *native = malloc(sizeof(int) * chunk->count);
+    /* push rbx; push r12; mov rbx, rdi; mov r12, rsi */
+    emit_bytes(&e, (const uint8_t[]){0x53, 0x41, 0x54, 0x48, 0x89, 0xfb, 0x49, 0x89, 0xf4}, 9);
+    for (int offset = 0; offset < chunk->count; offset += opcode_length(chunk, offset))
+    {
+        native[offset] = e.count;
+        if (depth[offset] >= 0)
+            emit_instruction(&e, chunk, offset, depth[offset]);
+    }
+    int bail = e.count;
+    /* xor eax, eax; pop r12; pop rbx; ret */
+    emit_bytes(&e, (const uint8_t[]){0x31, 0xc0, 0x41, 0x5c, 0x5b, 0xc3}, 6);
+
+    for (int i = 0; i < e.fixup_count; ++i)
+    {
+        Fixup f = e.fixups[i];
+        int target = f.target == BAIL ? bail : native[f.target];
+        int32_t rel = target - (f.at + 4);
+        memcpy(e.code + f.at, &rel, sizeof(rel));
+    }
+    free(e.fixups);
+    free(native);
+    free(depth);
+
+    long page = sysconf(_SC_PAGESIZE);
+    size_t size = ((size_t)e.count + page - 1) / page * page;
+    void *memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED)
+    {
+        free(e.code);
+        return NULL;
+    }
+    memcpy(memory, e.code, e.count);
+    free(e.code);
+    if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0)
+    {
+        munmap(memory, size);
+        return NULL;
+    }
+
+    JitCode *code = calloc(1, sizeof(JitCode));
+    code->memory = memory;
+    code->size = size;
+    code->entry = (JitEntry)memory;
+    code->name = strdup(chunk->name);
+    return code;
+}
+
+#else
+
+static JitCode *compile_chunk(const Chunk *chunk)
+{
+    (void)chunk;
+    return NULL;
+}
+
+#endif
+
+/* The registered ahead-of-time translation of `chunk`, if any. */
+static JitCode *find_precompiled(const Chunk *chunk)
+{
+    if (precompiled.count == 0)
+        return NULL;
+    uint32_t hash = jit_chunk_hash(chunk);
+    for (int i = 0; i < precompiled.count; ++i)
+    {
+        const JitPrecompiled *fn = &precompiled.functions[i];
+        if (fn->hash == hash && fn->code_count == chunk->count && fn->local_count == chunk->local_count &&
+            strcmp(fn->name, chunk->name) == 0)
+        {
+            JitCode *code = calloc(1, sizeof(JitCode));
+            code->entry = fn->entry;
+            code->name = strdup(chunk->name);
+            code->precompiled = true;
+            return code;
+        }
+    }
+    return NULL;
+}
+
+JitEntry jit_lookup(Chunk *chunk)
+{
+    if (chunk->jit)
+        return chunk->jit->entry;
+    if (chunk->jit_rejected)
+        return NULL;
+    ++chunk->hotness;
+    /* Precompiled code is taken on the first call; the threshold check
+       catches chunks that ran (and counted loops) before their first
+       call from bytecode. */
+    JitCode *code = NULL;
+    if (chunk->hotness == 1 || chunk->hotness >= JIT_HOT_THRESHOLD)
+        code = find_precompiled(chunk);
+    if (!code)
+    {
+        if (chunk->hotness < JIT_HOT_THRESHOLD)
+            return NULL;
+        code = compile_chunk(chunk);
+    }
+    if (!code)
+    {
+        chunk->jit_rejected = true;
+        jit.rejected++;
+        return NULL;
+    }
+    code->next = jit.compiled;
+    jit.compiled = code;
+    chunk->jit = code;
+    return code->entry;
+}
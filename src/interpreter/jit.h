@@ -0,0 +1,62 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "compiler/chunk.h"
+#include "types/value.h"
+
+/*
+ * Baseline JIT. Chunks count their calls and loop back-edges in
+ * `hotness`; once a function is hot its bytecode is translated into x86-64
+ * machine code stitched together from one template per opcode.
+ *
+ * Only functions that touch nothing but their own frame are translated:
+ * locals, constants without heap storage, inline-int arithmetic and
+ * comparisons, booleans and jumps. Such a function has no side effects,
+ * so when a guard fails in native code (an operand that is not an inline
+ * int, a result that needs boxing) the call simply runs again from the
+ * start in the interpreter.
+ *
+ * The same functions can be translated to C ahead of time (see aot.h);
+ * a bundle registers them with jit_set_precompiled and they are used from
+ * a function's first call, on any platform.
+ *
+ * ABLE_JIT=0 turns the JIT off; ABLE_JIT_STATS=1 prints counters on exit.
+ * Platforms other than x86-64 Linux always interpret.
+ */
+
+/* Native code for a chunk: fills `result` and returns true, or returns
+ * false (a bailout) having changed nothing outside `frame`. `frame` holds
+ * local_count + max_stack values, the arguments first. */
+typedef bool (*JitEntry)(Value *frame, Value *result);
+
+/* A function compiled ahead of time, matched to its chunk by name, shape
+ * and jit_chunk_hash. */
+typedef struct
+{
+    const char *name;
+    uint32_t hash;
+    int code_count;
+    int local_count;
+    JitEntry entry;
+} JitPrecompiled;
+
+void jit_init(void);
+void jit_cleanup(void);
+bool jit_enabled(void);
+/* Count a call to `chunk`, compiling it once hot. NULL means interpret. */
+JitEntry jit_lookup(Chunk *chunk);
+void jit_record_call(Chunk *chunk, bool bailed_out);
+
+/* Register a translated program's functions; call before jit_init. */
+void jit_set_precompiled(const JitPrecompiled *functions, int count);
+/* Identifies a chunk's bytecode; quickening does not change it. */
+uint32_t jit_chunk_hash(const Chunk *chunk);
+/* Write `chunk` to `out` as a C function `name` of type JitEntry, built
+ * on the helpers in aot.h. Returns false if it cannot be translated. */
+bool jit_emit_c(const Chunk *chunk, const char *name, FILE *out);
+
+#endif
@@ -10,6 +10,7 @@
 #include "types/object.h"
 #include "types/env.h"
 #include "utils/utils.h"
+#include "interpreter/gc.h"
 #include "interpreter/interpreter.h"
 #include "interpreter/module.h"
 
@@ -25,8 +26,25 @@ typedef struct ModuleEntry {
 static ModuleEntry *modules = NULL;
 static Env *global_env_ref = NULL;
 static char exec_dir[PATH_MAX];
+static const EmbeddedModule *embedded_modules = NULL;
+static int embedded_count = 0;
 
-static char *find_module_file(const char *name)
+void module_set_embedded(const EmbeddedModule *embedded, int count)
+{
+    embedded_modules = embedded;
+    embedded_count = count;
+}
+
+static const char *find_embedded(const char *name)
+{
+    for (int i = 0; i < embedded_count; ++i) {
+        if (strcmp(embedded_modules[i].name, name) == 0)
+            return embedded_modules[i].source;
+    }
+    return NULL;
+}
+
+char *find_module_file(const char *name)
 {
     const char *ablepath = getenv("ABLEPATH");
     const char *paths[64];
@@ -65,27 +83,27 @@ static ModuleEntry *load_module(const char *name, int line, int column)
     if (m)
         return m;
 
-    char *file = find_module_file(name);
-    if (!file) {
+    const char *embedded = find_embedded(name);
+    char *file = embedded ? NULL : find_module_file(name);
+    if (!embedded && !file) {
         log_script_error(line, column, "ImportError: module '%s' not found", name);
         exit(1);
     }
-    char *src = read_file(file);
+    char *src = embedded ? strdup(embedded) : read_file(file);
     Lexer lx; lexer_init(&lx, src);
     int count; ASTNode **prog = parse_program(&lx, &count);
     Env *env = env_create(global_env_ref);
     interpreter_set_env(env);
-    run_ast(prog, count);
+    interpreter_run(prog, count, name);
     interpreter_pop_env();
 
-    Object *obj = malloc(sizeof(Object));
-    obj->count = 0; obj->capacity = 0; obj->pairs = NULL;
+    Object *obj = object_create();
     Variable *var, *tmp;
     HASH_ITER(hh, env->vars, var, tmp) {
         if (!var->is_private)
             object_set(obj, var->name, var->value);
     }
-    Value val = { .type = VAL_OBJECT, .obj = obj };
+    Value val = OBJECT_VAL(obj);
 
     m = malloc(sizeof(ModuleEntry));
     m->name = strdup(name);
@@ -123,12 +141,22 @@ void module_system_cleanup()
     HASH_ITER(hh, modules, cur, tmp) {
         HASH_DEL(modules, cur);
         free(cur->name);
-        free_object(cur->obj.obj);
+        free_object(AS_OBJECT(cur->obj));
         env_release(cur->env);
         free(cur);
     }
 }
 
+void module_mark_roots(void)
+{
+    gc_mark_env(global_env_ref);
+    ModuleEntry *cur, *tmp;
+    HASH_ITER(hh, modules, cur, tmp) {
+        gc_mark_value(cur->obj);
+        gc_mark_env(cur->env);
+    }
+}
+
 Value import_module_value(const char *name, int line, int column)
 {
     ModuleEntry *m = load_module(name, line, column);
@@ -138,8 +166,8 @@ Value import_module_value(const char *name, int line, int column)
 Value import_module_attr(const char *mod, const char *attr, int line, int column)
 {
     ModuleEntry *m = load_module(mod, line, column);
-    Value v = object_get(m->obj.obj, attr);
-    if (v.type == VAL_NULL || v.type == VAL_UNDEFINED) {
+    Value v = object_get(AS_OBJECT(m->obj), attr);
+    if (IS_NULL(v) || IS_UNDEFINED(v)) {
         log_script_error(line, column, "ImportError: module '%s' has no attribute '%s'", mod, attr);
         exit(1);
     }
@@ -4,9 +4,23 @@
 #include "types/env.h"
 #include "types/value.h"
 
+/* Module source compiled into the executable (see aot.h), used in place
+   of searching the module path for `name`. */
+typedef struct
+{
+    const char *name;
+    const char *source;
+} EmbeddedModule;
+
 void module_system_init(Env *global_env, const char *exec_path);
 void module_system_cleanup();
 Value import_module_value(const char *name, int line, int column);
 Value import_module_attr(const char *mod, const char *attr, int line, int column);
+/* Path of the file `name` resolves to on the module path, or NULL.
+   The caller frees it. */
+char *find_module_file(const char *name);
+void module_set_embedded(const EmbeddedModule *embedded, int count);
+/* Mark the global environment and every loaded module for the collector. */
+void module_mark_roots(void);
 
 #endif
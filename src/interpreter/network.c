@@ -5,6 +5,7 @@
 #include <string.h>
 
 #include "types/object.h"
+#include "types/str.h"
 #include "utils/http_client.h"
 #include "utils/utils.h"
 
@@ -58,10 +59,10 @@ static int object_try_get(Object *obj, const char *key, Value *out)
         return 0;
     for (int i = 0; i < obj->count; ++i)
     {
-        if (strcmp(obj->pairs[i].key, key) == 0)
+        if (strcmp(object_key(obj, i), key) == 0)
         {
             if (out)
-                *out = obj->pairs[i].value;
+                *out = obj->values[i];
             return 1;
         }
     }
@@ -79,18 +80,18 @@ static char *value_to_string(const Value *value, const char *field, int line, in
 {
     if (!value)
         return NULL;
-    switch (value->type)
+    switch (value_type(*value))
     {
     case VAL_STRING:
-        return duplicate_string(value->str ? value->str : "");
+        return duplicate_string(AS_STRING(*value) ? AS_STRING(*value) : "");
     case VAL_NUMBER:
     {
         char buf[64];
-        snprintf(buf, sizeof(buf), "%.15g", value->num);
+        snprintf(buf, sizeof(buf), "%.15g", AS_NUMBER(*value));
         return strdup(buf);
     }
     case VAL_BOOL:
-        return strdup(value->boolean ? "true" : "false");
+        return strdup(AS_BOOL(*value) ? "true" : "false");
     default:
         log_script_error(line, column, "%s must be a string-compatible value", field);
         exit(1);
@@ -110,8 +111,8 @@ static void parse_headers(Object *headers_obj, ParsedOptions *opts, int line, in
     opts->header_count = (size_t)headers_obj->count;
     for (int i = 0; i < headers_obj->count; ++i)
     {
-        opts->headers[i].name = duplicate_string(headers_obj->pairs[i].key);
-        opts->headers[i].value = value_to_string(&headers_obj->pairs[i].value, "options.headers", line, column);
+        opts->headers[i].name = duplicate_string(object_key(headers_obj, i));
+        opts->headers[i].value = value_to_string(&headers_obj->values[i], "options.headers", line, column);
     }
 }
 
@@ -130,54 +131,43 @@ static void parse_options(Object *options_obj, ParsedOptions *opts, int line, in
         opts->refferer = value_to_string(&value, "options.refferer", line, column);
     if (object_try_get(options_obj, "headers", &value))
     {
-        if (value.type != VAL_OBJECT)
+        if (!IS_OBJECT(value))
         {
             log_script_error(line, column, "options.headers must be an object");
             exit(1);
         }
-        parse_headers(value.obj, opts, line, column);
+        parse_headers(AS_OBJECT(value), opts, line, column);
     }
 }
 
-static Object *create_object(void)
-{
-    Object *obj = malloc(sizeof(Object));
-    if (!obj)
-        return NULL;
-    obj->count = 0;
-    obj->capacity = 0;
-    obj->pairs = NULL;
-    return obj;
-}
-
 static Value build_response_value(const char *method, const HttpResponse *response)
 {
-    Object *root = create_object();
+    Object *root = object_create();
     if (!root)
     {
         log_script_error(0, 0, "Out of memory while creating response object");
         exit(1);
     }
 
-    Value status_val = {.type = VAL_NUMBER, .num = (double)response->status_code};
+    Value status_val = INT_VAL(response->status_code);
     object_set(root, "status", status_val);
 
-    Value ok_val = {.type = VAL_BOOL, .boolean = response->status_code >= 200 && response->status_code < 300};
+    Value ok_val = BOOL_VAL(response->status_code >= 200 && response->status_code < 300);
     object_set(root, "ok", ok_val);
 
-    Value status_text_val = {.type = VAL_STRING, .str = duplicate_string(response->status_text ? response->status_text : "")};
+    Value status_text_val = STRING_VAL(string_from(response->status_text));
     object_set(root, "statusText", status_text_val);
     free_value(status_text_val);
 
-    Value url_val = {.type = VAL_STRING, .str = duplicate_string(response->final_url)};
+    Value url_val = STRING_VAL(string_from(response->final_url));
     object_set(root, "url", url_val);
     free_value(url_val);
 
-    Value body_val = {.type = VAL_STRING, .str = duplicate_string(response->body ? response->body : "")};
+    Value body_val = STRING_VAL(string_new(response->body, response->body ? response->body_length : 0));
     object_set(root, "body", body_val);
     free_value(body_val);
 
-    Object *headers_obj = create_object();
+    Object *headers_obj = object_create();
     if (!headers_obj)
     {
         free_object(root);
@@ -188,19 +178,19 @@ static Value build_response_value(const char *method, const HttpResponse *respon
     {
         const char *name = response->headers[i].name ? response->headers[i].name : "";
         const char *value = response->headers[i].value ? response->headers[i].value : "";
-        Value header_val = {.type = VAL_STRING, .str = duplicate_string(value)};
-        object_set(headers_obj, name, header_val);
+        Value header_val = STRING_VAL(string_from(value));
+        object_set_key(headers_obj, name, strlen(name), header_val);
         free_value(header_val);
     }
-    Value headers_val = {.type = VAL_OBJECT, .obj = headers_obj};
+    Value headers_val = OBJECT_VAL(headers_obj);
     object_set(root, "headers", headers_val);
     free_value(headers_val);
 
-    Value method_val = {.type = VAL_STRING, .str = duplicate_string(method)};
+    Value method_val = STRING_VAL(string_from(method));
     object_set(root, "method", method_val);
     free_value(method_val);
 
-    Value result = {.type = VAL_OBJECT, .obj = root};
+    Value result = OBJECT_VAL(root);
     return result;
 }
 
@@ -229,7 +219,7 @@ Value network_execute(const char *method,
         exit(1);
     }
     const Value *url_val = &args[0];
-    if (url_val->type != VAL_STRING)
+    if (!IS_STRING(*url_val))
     {
         log_script_error(line, column, "%s expects the first argument to be a string URL", method);
         exit(1);
@@ -237,14 +227,14 @@ Value network_execute(const char *method,
 
     const Value *options_val = arg_count > 1 ? &args[1] : NULL;
     Object *options_obj = NULL;
-    if (options_val && options_val->type != VAL_UNDEFINED && options_val->type != VAL_NULL)
+    if (options_val && !IS_UNDEFINED(*options_val) && !IS_NULL(*options_val))
     {
-        if (options_val->type != VAL_OBJECT)
+        if (!IS_OBJECT(*options_val))
         {
             log_script_error(line, column, "%s options must be an object", method);
             exit(1);
         }
-        options_obj = options_val->obj;
+        options_obj = AS_OBJECT(*options_val);
     }
 
     ParsedOptions parsed;
@@ -266,7 +256,7 @@ Value network_execute(const char *method,
 
     HttpResponse response = {0};
     char *error_message = NULL;
-    bool ok = http_client_perform(method, url_val->str, options_obj ? &request_opts : NULL, &response, &error_message);
+    bool ok = http_client_perform(method, AS_STRING(*url_val), options_obj ? &request_opts : NULL, &response, &error_message);
 
     parsed_options_cleanup(&parsed);
 
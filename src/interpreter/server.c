@@ -8,18 +8,22 @@
 #include <string.h>
 #include <strings.h>
 
+#include "interpreter/gc.h"
 #include "interpreter/interpreter.h"
 #include "types/list.h"
 #include "types/object.h"
+#include "types/str.h"
 #include "types/value.h"
 #include "utils/http_server.h"
+#include "utils/intern.h"
 #include "utils/utils.h"
 #include "utils/json.h"
+#include "utils/region.h"
 
 typedef struct
 {
-    char *method;
-    char *path;
+    const char *method; // interned
+    const char *path;   // interned
     Value handler;
 } ServerRoute;
 
@@ -29,18 +33,21 @@ typedef struct
     size_t route_count;
     int call_line;
     int call_column;
+    Shape *request_shape; // keys of the request object, in REQUEST_KEYS order
+    Region *region;       // holds each request's values, NULL if disabled
 } ServerContext;
 
+static const char *const REQUEST_KEYS[] = {"method", "path", "query", "httpVersion", "headers", "body"};
+#define REQUEST_KEY_COUNT (int)(sizeof(REQUEST_KEYS) / sizeof(REQUEST_KEYS[0]))
+
 static void server_route_cleanup(ServerRoute *route)
 {
     if (!route)
         return;
-    free(route->method);
-    free(route->path);
     free_value(route->handler);
     route->method = NULL;
     route->path = NULL;
-    route->handler.type = VAL_UNDEFINED;
+    route->handler = UNDEFINED_VAL;
 }
 
 static void server_context_cleanup(ServerContext *ctx)
@@ -52,6 +59,8 @@ static void server_context_cleanup(ServerContext *ctx)
     free(ctx->routes);
     ctx->routes = NULL;
     ctx->route_count = 0;
+    region_destroy(ctx->region);
+    ctx->region = NULL;
 }
 
 static void fatal_script_error(int line, int column, const char *fmt, ...)
@@ -77,18 +86,18 @@ static char *value_to_owned_string(const Value *value, int line, int column, con
 {
     if (!value)
         return NULL;
-    switch (value->type)
+    switch (value_type(*value))
     {
     case VAL_STRING:
-        return duplicate_string_checked(value->str, line, column, field);
+        return duplicate_string_checked(AS_STRING(*value), line, column, field);
     case VAL_NUMBER:
     {
         char buf[64];
-        snprintf(buf, sizeof(buf), "%.15g", value->num);
+        snprintf(buf, sizeof(buf), "%.15g", AS_NUMBER(*value));
         return duplicate_string_checked(buf, line, column, field);
     }
     case VAL_BOOL:
-        return duplicate_string_checked(value->boolean ? "true" : "false", line, column, field);
+        return duplicate_string_checked(AS_BOOL(*value) ? "true" : "false", line, column, field);
     default:
         fatal_script_error(line, column, "%s must be string-compatible", field);
     }
@@ -102,8 +111,8 @@ static Value *find_field(Object *obj, const char *name)
         return NULL;
     for (int i = 0; i < obj->count; ++i)
     {
-        if (strcmp(obj->pairs[i].key, name) == 0)
-            return &obj->pairs[i].value;
+        if (strcmp(object_key(obj, i), name) == 0)
+            return &obj->values[i];
     }
     return NULL;
 }
@@ -111,9 +120,9 @@ static Value *find_field(Object *obj, const char *name)
 static Object *response_headers_object(Object *obj)
 {
     Value *headers = find_field(obj, "headers");
-    if (!headers || headers->type != VAL_OBJECT)
+    if (!headers || !IS_OBJECT(*headers))
         return NULL;
-    return headers->obj;
+    return AS_OBJECT(*headers);
 }
 
 static bool headers_contains(const Object *headers_obj, const char *name)
@@ -122,7 +131,7 @@ static bool headers_contains(const Object *headers_obj, const char *name)
         return false;
     for (int i = 0; i < headers_obj->count; ++i)
     {
-        if (strcasecmp(headers_obj->pairs[i].key, name) == 0)
+        if (strcasecmp(object_key(headers_obj, i), name) == 0)
             return true;
     }
     return false;
@@ -136,9 +145,7 @@ static bool ensure_json_content_type(Object *response)
     if (headers_contains(headers_obj, "Content-Type"))
         return true;
 
-    Value header_val = {.type = VAL_STRING, .str = strdup("application/json; charset=utf-8")};
-    if (!header_val.str)
-        return false;
+    Value header_val = STRING_VAL(string_from("application/json; charset=utf-8"));
     object_set(headers_obj, "Content-Type", header_val);
     free_value(header_val);
     return true;
@@ -150,7 +157,7 @@ static bool has_response_metadata(const Object *obj)
         return false;
     for (int i = 0; i < obj->count; ++i)
     {
-        const char *key = obj->pairs[i].key;
+        const char *key = object_key(obj, i);
         if (strcmp(key, "status") == 0 || strcmp(key, "statusText") == 0 ||
             strcmp(key, "headers") == 0 || strcmp(key, "body") == 0)
             return true;
@@ -160,8 +167,14 @@ static bool has_response_metadata(const Object *obj)
 
 static bool set_plain_body(Object *response_obj, const Value *source, const ServerContext *ctx, const char *field)
 {
+    if (IS_STRING(*source))
+    {
+        object_set(response_obj, "body", *source);
+        return true;
+    }
     char *body = value_to_owned_string(source, ctx->call_line, ctx->call_column, field);
-    Value body_val = {.type = VAL_STRING, .str = body};
+    Value body_val = STRING_VAL(string_from(body));
+    free(body);
     object_set(response_obj, "body", body_val);
     free_value(body_val);
     return true;
@@ -178,7 +191,8 @@ static bool set_json_body(Object *response_obj, const Value *payload, const Serv
         fatal_script_error(ctx->call_line, ctx->call_column, "Failed to serialize JSON response");
     }
 
-    Value body_val = {.type = VAL_STRING, .str = json};
+    Value body_val = STRING_VAL(string_from(json));
+    free(json);
     object_set(response_obj, "body", body_val);
     free_value(body_val);
 
@@ -189,7 +203,7 @@ static void ensure_route_handler_type(const Value *handler, int line, int column
 {
     if (!handler)
         fatal_script_error(line, column, "Route handler is missing");
-    if (handler->type == VAL_FUNCTION || handler->type == VAL_BOUND_METHOD)
+    if (IS_FUNCTION(*handler) || IS_BOUND_METHOD(*handler) || IS_NATIVE(*handler))
         return;
     fatal_script_error(line, column, "Route handler must be a function or bound method");
 }
@@ -208,33 +222,38 @@ static void parse_route(Object *route_obj, ServerRoute *route, int line, int col
     Value *path_val = NULL;
     Value *handler_val = NULL;
 
+    const char *method_key = intern("method");
+    const char *path_key = intern("path");
+    const char *handler_key = intern("handler");
     for (int i = 0; i < route_obj->count; ++i)
     {
-        if (strcmp(route_obj->pairs[i].key, "method") == 0)
-            method_val = &route_obj->pairs[i].value;
-        else if (strcmp(route_obj->pairs[i].key, "path") == 0)
-            path_val = &route_obj->pairs[i].value;
-        else if (strcmp(route_obj->pairs[i].key, "handler") == 0)
-            handler_val = &route_obj->pairs[i].value;
+        if (object_key(route_obj, i) == method_key)
+            method_val = &route_obj->values[i];
+        else if (object_key(route_obj, i) == path_key)
+            path_val = &route_obj->values[i];
+        else if (object_key(route_obj, i) == handler_key)
+            handler_val = &route_obj->values[i];
     }
 
-    if (!method_val || method_val->type != VAL_STRING)
+    if (!method_val || !IS_STRING(*method_val))
         fatal_script_error(line, column, "Route requires a string method");
-    if (!path_val || path_val->type != VAL_STRING)
+    if (!path_val || !IS_STRING(*path_val))
         fatal_script_error(line, column, "Route requires a string path");
     ensure_route_handler_type(handler_val, line, column);
 
-    route->method = duplicate_string_checked(method_val->str, line, column, "route.method");
-    uppercase_inplace(route->method);
-    route->path = duplicate_string_checked(path_val->str, line, column, "route.path");
+    char *method = duplicate_string_checked(AS_STRING(*method_val), line, column, "route.method");
+    uppercase_inplace(method);
+    route->method = intern(method);
+    free(method);
+    route->path = intern(AS_STRING(*path_val));
     route->handler = clone_value(handler_val);
 }
 
 static void parse_routes(const Value *routes_value, ServerContext *ctx, int line, int column)
 {
-    if (!routes_value || routes_value->type != VAL_LIST)
+    if (!routes_value || !IS_LIST(*routes_value))
         fatal_script_error(line, column, "server_listen config.routes must be a list");
-    List *list = routes_value->list;
+    List *list = AS_LIST(*routes_value);
     if (!list || list->count == 0)
         fatal_script_error(line, column, "server_listen requires at least one route");
 
@@ -245,19 +264,57 @@ static void parse_routes(const Value *routes_value, ServerContext *ctx, int line
 
     for (int i = 0; i < list->count; ++i)
     {
-        Value entry = list->items[i];
-        if (entry.type != VAL_OBJECT)
+        Value entry = list_get(list, i);
+        if (!IS_OBJECT(entry))
             fatal_script_error(line, column, "Each route must be an object");
-        parse_route(entry.obj, &ctx->routes[i], line, column);
+        parse_route(AS_OBJECT(entry), &ctx->routes[i], line, column);
+    }
+}
+
+static int parse_gc_count(const Value *value, int line, int column, const char *field)
+{
+    if (!IS_NUMBER(*value) || AS_NUMBER(*value) < 1)
+        fatal_script_error(line, column, "server_listen config.gc.%s must be a positive number", field);
+    return (int)AS_NUMBER(*value);
+}
+
+/* config.gc: {mode: "incremental" | "full", step, young}, over the
+   ABLE_GC_* defaults. */
+static void parse_gc(const Value *gc_value, GcIncremental *gc, int line, int column)
+{
+    if (!IS_OBJECT(*gc_value))
+        fatal_script_error(line, column, "server_listen config.gc must be an object");
+    Object *obj = AS_OBJECT(*gc_value);
+    for (int i = 0; i < obj->count; ++i)
+    {
+        const char *key = object_key(obj, i);
+        Value *value = &obj->values[i];
+        if (strcmp(key, "mode") == 0)
+        {
+            if (!IS_STRING(*value) ||
+                (strcmp(AS_STRING(*value), "incremental") != 0 && strcmp(AS_STRING(*value), "full") != 0))
+                fatal_script_error(line, column, "server_listen config.gc.mode must be \"incremental\" or \"full\"");
+            gc->enabled = strcmp(AS_STRING(*value), "incremental") == 0;
+        }
+        else if (strcmp(key, "step") == 0)
+            gc->step = parse_gc_count(value, line, column, "step");
+        else if (strcmp(key, "young") == 0)
+            gc->young = parse_gc_count(value, line, column, "young");
     }
 }
 
 static const ServerRoute *find_route(const ServerContext *ctx, const HttpServerRequest *request)
 {
+    /* Lookup-only so request data never grows the intern table; a method or
+       path that was never interned cannot match any route. */
+    const char *method = intern_find(request->method);
+    const char *path = intern_find(request->path);
+    if (!method || !path)
+        return NULL;
     for (size_t i = 0; i < ctx->route_count; ++i)
     {
         const ServerRoute *route = &ctx->routes[i];
-        if (strcmp(route->method, request->method) == 0 && strcmp(route->path, request->path) == 0)
+        if (route->method == method && route->path == path)
             return route;
     }
     return NULL;
@@ -273,40 +330,33 @@ static Object *create_object_checked(int line, int column, const char *context)
 
 static Value build_request_value(const HttpServerRequest *request, const ServerContext *ctx)
 {
-    Object *root = create_object_checked(ctx->call_line, ctx->call_column, "request object");
-
-    Value method_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->method, ctx->call_line, ctx->call_column, "request.method")};
-    object_set(root, "method", method_val);
-    free_value(method_val);
-
-    Value path_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->path, ctx->call_line, ctx->call_column, "request.path")};
-    object_set(root, "path", path_val);
-    free_value(path_val);
-
-    Value query_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->query ? request->query : "", ctx->call_line, ctx->call_column, "request.query")};
-    object_set(root, "query", query_val);
-    free_value(query_val);
-
-    Value version_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->http_version, ctx->call_line, ctx->call_column, "request.httpVersion")};
-    object_set(root, "httpVersion", version_val);
-    free_value(version_val);
+    Object *root = object_create_shaped(ctx->request_shape);
+    if (!root)
+        fatal_script_error(ctx->call_line, ctx->call_column, "Out of memory while creating request object");
 
     Object *headers_obj = create_object_checked(ctx->call_line, ctx->call_column, "request headers");
     for (size_t i = 0; i < request->header_count; ++i)
     {
-        Value header_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->headers[i].value, ctx->call_line, ctx->call_column, "request header")};
-        object_set(headers_obj, request->headers[i].name, header_val);
+        Value header_val = STRING_VAL(string_from(request->headers[i].value));
+        object_set_key(headers_obj, request->headers[i].name, strlen(request->headers[i].name), header_val);
         free_value(header_val);
     }
-    Value headers_val = {.type = VAL_OBJECT, .obj = headers_obj};
-    object_set(root, "headers", headers_val);
-    free_value(headers_val);
 
-    Value body_val = {.type = VAL_STRING, .str = duplicate_string_checked(request->body ? request->body : "", ctx->call_line, ctx->call_column, "request.body")};
-    object_set(root, "body", body_val);
-    free_value(body_val);
+    Value fields[] = {
+        STRING_VAL(string_from(request->method)),
+        STRING_VAL(string_from(request->path)),
+        STRING_VAL(string_from(request->query)),
+        STRING_VAL(string_from(request->http_version)),
+        OBJECT_VAL(headers_obj),
+        STRING_VAL(string_new(request->body, request->body ? request->body_length : 0)),
+    };
+    for (int i = 0; i < REQUEST_KEY_COUNT; ++i)
+    {
+        object_set_slot(root, i, fields[i]);
+        free_value(fields[i]);
+    }
 
-    Value result = {.type = VAL_OBJECT, .obj = root};
+    Value result = OBJECT_VAL(root);
     return result;
 }
 
@@ -314,15 +364,14 @@ static bool apply_header_object(Object *headers_obj, HttpServerResponse *respons
 {
     for (int i = 0; i < headers_obj->count; ++i)
     {
-        char *value = value_to_owned_string(&headers_obj->pairs[i].value, line, column, "response.headers value");
-        if (!http_server_response_add_header(response, headers_obj->pairs[i].key, value))
-        {
-            free(value);
+        const Value *header = &headers_obj->values[i];
+        char *owned = IS_STRING(*header) ? NULL : value_to_owned_string(header, line, column, "response.headers value");
+        bool ok = http_server_response_add_header(response, object_key(headers_obj, i), owned ? owned : AS_STRING(*header));
+        free(owned);
+        if (!ok)
             return false;
-        }
-        if (strcasecmp(headers_obj->pairs[i].key, "Content-Type") == 0)
+        if (strcasecmp(object_key(headers_obj, i), "Content-Type") == 0)
             *has_content_type = true;
-        free(value);
     }
     return true;
 }
@@ -333,7 +382,7 @@ static bool normalize_response_value(const Value *result, Value *normalized, con
     if (!response_obj)
         return false;
 
-    Value status_default = {.type = VAL_NUMBER, .num = 200};
+    Value status_default = INT_VAL(200);
     object_set(response_obj, "status", status_default);
 
     Object *headers_default = object_create();
@@ -342,22 +391,21 @@ static bool normalize_response_value(const Value *result, Value *normalized, con
         free_object(response_obj);
         return false;
     }
-    Value headers_val = {.type = VAL_OBJECT, .obj = headers_default};
+    Value headers_val = OBJECT_VAL(headers_default);
     object_set(response_obj, "headers", headers_val);
     free_value(headers_val);
 
-    if (!result || result->type == VAL_UNDEFINED || result->type == VAL_NULL)
+    if (!result || IS_UNDEFINED(*result) || IS_NULL(*result))
     {
-        normalized->type = VAL_OBJECT;
-        normalized->obj = response_obj;
+        *normalized = OBJECT_VAL(response_obj);
         return true;
     }
 
-    switch (result->type)
+    switch (value_type(*result))
     {
     case VAL_OBJECT:
     {
-        if (!has_response_metadata(result->obj))
+        if (!has_response_metadata(AS_OBJECT(*result)))
         {
             if (!set_json_body(response_obj, result, ctx))
             {
@@ -372,52 +420,43 @@ static bool normalize_response_value(const Value *result, Value *normalized, con
         Value *headers_field = NULL;
         Value *body_field = NULL;
 
-        for (int i = 0; i < result->obj->count; ++i)
+        for (int i = 0; i < AS_OBJECT(*result)->count; ++i)
         {
-            const char *key = result->obj->pairs[i].key;
+            const char *key = object_key(AS_OBJECT(*result), i);
             if (strcmp(key, "status") == 0)
-                status_field = &result->obj->pairs[i].value;
+                status_field = &AS_OBJECT(*result)->values[i];
             else if (strcmp(key, "statusText") == 0)
-                status_text_field = &result->obj->pairs[i].value;
+                status_text_field = &AS_OBJECT(*result)->values[i];
             else if (strcmp(key, "headers") == 0)
-                headers_field = &result->obj->pairs[i].value;
+                headers_field = &AS_OBJECT(*result)->values[i];
             else if (strcmp(key, "body") == 0)
-                body_field = &result->obj->pairs[i].value;
+                body_field = &AS_OBJECT(*result)->values[i];
         }
 
         if (status_field)
         {
-            if (status_field->type != VAL_NUMBER)
+            if (!IS_NUMBER(*status_field))
                 fatal_script_error(ctx->call_line, ctx->call_column, "response.status must be a number");
-            Value status_copy = {.type = VAL_NUMBER, .num = status_field->num};
-            object_set(response_obj, "status", status_copy);
+            object_set(response_obj, "status", *status_field);
         }
 
         if (status_text_field)
         {
-            if (status_text_field->type != VAL_STRING)
+            if (!IS_STRING(*status_text_field))
                 fatal_script_error(ctx->call_line, ctx->call_column, "response.statusText must be a string");
-            const char *text = status_text_field->str ? status_text_field->str : "";
-            Value text_copy = {.type = VAL_STRING, .str = strdup(text)};
-            if (!text_copy.str)
-            {
-                free_object(response_obj);
-                return false;
-            }
-            object_set(response_obj, "statusText", text_copy);
-            free_value(text_copy);
+            object_set(response_obj, "statusText", *status_text_field);
         }
 
         if (headers_field)
         {
-            if (headers_field->type != VAL_OBJECT)
+            if (!IS_OBJECT(*headers_field))
                 fatal_script_error(ctx->call_line, ctx->call_column, "response.headers must be an object");
             Value headers_copy = clone_value(headers_field);
             object_set(response_obj, "headers", headers_copy);
             free_value(headers_copy);
         }
 
-        if (body_field && body_field->type != VAL_NULL && body_field->type != VAL_UNDEFINED)
+        if (body_field && !IS_NULL(*body_field) && !IS_UNDEFINED(*body_field))
         {
             if (!set_plain_body(response_obj, body_field, ctx, "response.body"))
             {
@@ -452,14 +491,13 @@ static bool normalize_response_value(const Value *result, Value *normalized, con
         break;
     }
 
-    normalized->type = VAL_OBJECT;
-    normalized->obj = response_obj;
+    *normalized = OBJECT_VAL(response_obj);
     return true;
 }
 
 static bool apply_response_object(const Value *result, HttpServerResponse *response, const ServerContext *ctx)
 {
-    Object *obj = result->obj;
+    Object *obj = AS_OBJECT(*result);
     Value *status_val = NULL;
     Value *status_text_val = NULL;
     Value *body_val = NULL;
@@ -467,60 +505,60 @@ static bool apply_response_object(const Value *result, HttpServerResponse *respo
 
     for (int i = 0; i < obj->count; ++i)
     {
-        if (strcmp(obj->pairs[i].key, "status") == 0)
-            status_val = &obj->pairs[i].value;
-        else if (strcmp(obj->pairs[i].key, "statusText") == 0)
-            status_text_val = &obj->pairs[i].value;
-        else if (strcmp(obj->pairs[i].key, "body") == 0)
-            body_val = &obj->pairs[i].value;
-        else if (strcmp(obj->pairs[i].key, "headers") == 0)
-            headers_val = &obj->pairs[i].value;
+        if (strcmp(object_key(obj, i), "status") == 0)
+            status_val = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "statusText") == 0)
+            status_text_val = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "body") == 0)
+            body_val = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "headers") == 0)
+            headers_val = &obj->values[i];
     }
 
     if (status_val)
     {
-        if (status_val->type != VAL_NUMBER)
+        if (!IS_NUMBER(*status_val))
             fatal_script_error(ctx->call_line, ctx->call_column, "response.status must be a number");
-        int status_code = (int)status_val->num;
+        int status_code = (int)AS_NUMBER(*status_val);
         if (!http_server_response_set_status(response, status_code, NULL))
             return false;
     }
 
     if (status_text_val)
     {
-        if (status_text_val->type != VAL_STRING)
+        if (!IS_STRING(*status_text_val))
             fatal_script_error(ctx->call_line, ctx->call_column, "response.statusText must be a string");
-        if (!http_server_response_set_status(response, response->status_code, status_text_val->str))
+        if (!http_server_response_set_status(response, response->status_code, AS_STRING(*status_text_val)))
             return false;
     }
 
     bool has_content_type = false;
     if (headers_val)
     {
-        if (headers_val->type != VAL_OBJECT)
+        if (!IS_OBJECT(*headers_val))
             fatal_script_error(ctx->call_line, ctx->call_column, "response.headers must be an object");
-        if (!apply_header_object(headers_val->obj, response, ctx->call_line, ctx->call_column, &has_content_type))
+        if (!apply_header_object(AS_OBJECT(*headers_val), response, ctx->call_line, ctx->call_column, &has_content_type))
             return false;
     }
 
     if (body_val)
     {
-        char *body = value_to_owned_string(body_val, ctx->call_line, ctx->call_column, "response.body");
-        size_t length = strlen(body);
-        if (!http_server_response_set_body(response, body, length))
+        /* String bodies carry their length and may contain NUL bytes. */
+        char *owned = NULL;
+        const char *body = IS_STRING(*body_val) ? AS_STRING(*body_val) : NULL;
+        size_t length = string_length(body);
+        if (!body)
         {
-            free(body);
-            return false;
+            owned = value_to_owned_string(body_val, ctx->call_line, ctx->call_column, "response.body");
+            body = owned;
+            length = strlen(owned);
         }
-        if (!has_content_type)
-        {
-            if (!http_server_response_add_header(response, "Content-Type", "text/plain; charset=utf-8"))
-            {
-                free(body);
-                return false;
-            }
-        }
-        free(body);
+        bool ok = http_server_response_set_body(response, body, length);
+        if (ok && !has_content_type)
+            ok = http_server_response_add_header(response, "Content-Type", "text/plain; charset=utf-8");
+        free(owned);
+        if (!ok)
+            return false;
     }
 
     return true;
@@ -528,10 +566,10 @@ static bool apply_response_object(const Value *result, HttpServerResponse *respo
 
 static bool apply_response_value(const Value *result, HttpServerResponse *response, const ServerContext *ctx)
 {
-    Value normalized = {.type = VAL_UNDEFINED};
+    Value normalized = UNDEFINED_VAL;
     if (!normalize_response_value(result, &normalized, ctx))
     {
-        if (normalized.type != VAL_UNDEFINED)
+        if (!IS_UNDEFINED(normalized))
             free_value(normalized);
         return false;
     }
@@ -544,12 +582,17 @@ static bool apply_response_value(const Value *result, HttpServerResponse *respon
 static bool server_handle_request(const HttpServerRequest *request, HttpServerResponse *response, void *user_data)
 {
     ServerContext *ctx = (ServerContext *)user_data;
+    /* The previous request's values and response are gone by now; whatever
+       of them escaped keeps its block (see region.h). */
+    region_reset(ctx->region);
+    region_activate(ctx->region);
     const ServerRoute *route = find_route(ctx, request);
     if (!route)
     {
         http_server_response_set_status(response, 404, "Not Found");
         http_server_response_set_body(response, "Not Found", strlen("Not Found"));
         http_server_response_add_header(response, "Content-Type", "text/plain; charset=utf-8");
+        region_activate(NULL);
         return true;
     }
 
@@ -565,6 +608,9 @@ static bool server_handle_request(const HttpServerRequest *request, HttpServerRe
     }
 
     free_value(result);
+    region_activate(NULL);
+    /* Nothing of this request is live any more. */
+    gc_step();
     return true;
 }
 
@@ -572,16 +618,16 @@ static char *parse_port(const Value *value, int line, int column)
 {
     if (!value)
         fatal_script_error(line, column, "server_listen requires a port");
-    if (value->type == VAL_NUMBER)
+    if (IS_NUMBER(*value))
     {
-        if (value->num < 0 || value->num > 65535)
+        if (AS_NUMBER(*value) < 0 || AS_NUMBER(*value) > 65535)
             fatal_script_error(line, column, "server_listen port must be between 0 and 65535");
         char buf[16];
-        snprintf(buf, sizeof(buf), "%d", (int)value->num);
+        snprintf(buf, sizeof(buf), "%d", (int)AS_NUMBER(*value));
         return duplicate_string_checked(buf, line, column, "port");
     }
-    if (value->type == VAL_STRING)
-        return duplicate_string_checked(value->str, line, column, "port");
+    if (IS_STRING(*value))
+        return duplicate_string_checked(AS_STRING(*value), line, column, "port");
     fatal_script_error(line, column, "server_listen port must be a string or number");
     return NULL;
 }
@@ -590,25 +636,29 @@ static void parse_config(const Value *config,
                          char **host_out,
                          char **port_out,
                          ServerContext *ctx,
+                         GcIncremental *gc,
                          int line,
                          int column)
 {
-    if (!config || config->type != VAL_OBJECT)
+    if (!config || !IS_OBJECT(*config))
         fatal_script_error(line, column, "server_listen expects a configuration object");
 
     Value *routes_value = NULL;
     Value *host_value = NULL;
     Value *port_value = NULL;
+    Value *gc_value = NULL;
 
-    Object *obj = config->obj;
+    Object *obj = AS_OBJECT(*config);
     for (int i = 0; i < obj->count; ++i)
     {
-        if (strcmp(obj->pairs[i].key, "routes") == 0)
-            routes_value = &obj->pairs[i].value;
-        else if (strcmp(obj->pairs[i].key, "host") == 0)
-            host_value = &obj->pairs[i].value;
-        else if (strcmp(obj->pairs[i].key, "port") == 0)
-            port_value = &obj->pairs[i].value;
+        if (strcmp(object_key(obj, i), "routes") == 0)
+            routes_value = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "host") == 0)
+            host_value = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "port") == 0)
+            port_value = &obj->values[i];
+        else if (strcmp(object_key(obj, i), "gc") == 0)
+            gc_value = &obj->values[i];
     }
 
     if (!routes_value)
@@ -617,9 +667,9 @@ static void parse_config(const Value *config,
 
     if (host_value)
     {
-        if (host_value->type != VAL_STRING)
+        if (!IS_STRING(*host_value))
             fatal_script_error(line, column, "server_listen host must be a string");
-        *host_out = duplicate_string_checked(host_value->str, line, column, "host");
+        *host_out = duplicate_string_checked(AS_STRING(*host_value), line, column, "host");
     }
     else
     {
@@ -627,6 +677,8 @@ static void parse_config(const Value *config,
     }
 
     *port_out = parse_port(port_value, line, column);
+    if (gc_value)
+        parse_gc(gc_value, gc, line, column);
 }
 
 Value interpreter_server_listen(const Value *args, int arg_count, int line, int column)
@@ -635,12 +687,25 @@ Value interpreter_server_listen(const Value *args, int arg_count, int line, int
         fatal_script_error(line, column, "server_listen expects exactly one argument");
 
     ServerContext ctx = {.routes = NULL, .route_count = 0, .call_line = line, .call_column = column};
+    ctx.request_shape = shape_root();
+    for (int i = 0; i < REQUEST_KEY_COUNT; ++i)
+        ctx.request_shape = shape_add(ctx.request_shape, intern(REQUEST_KEYS[i]));
+    /* ABLE_REGION=0 allocates request values from the heap. */
+    if (env_flag("ABLE_REGION", true))
+        ctx.region = region_create();
     char *host = NULL;
     char *port = NULL;
-    parse_config(&args[0], &host, &port, &ctx, line, column);
+    GcIncremental gc = gc_incremental_defaults();
+    parse_config(&args[0], &host, &port, &ctx, &gc, line, column);
+    for (size_t i = 0; i < ctx.route_count; ++i)
+        gc_push_root(&ctx.routes[i].handler);
+    gc_set_incremental(&gc);
 
     char *error_message = NULL;
     bool ok = http_server_listen(host, port, server_handle_request, &ctx, &error_message);
+    gc.enabled = false;
+    gc_set_incremental(&gc);
+    gc_pop_roots((int)ctx.route_count);
 
     free(host);
     free(port);
@@ -660,6 +725,6 @@ Value interpreter_server_listen(const Value *args, int arg_count, int line, int
         exit(1);
     }
 
-    Value undef = {.type = VAL_UNDEFINED};
+    Value undef = UNDEFINED_VAL;
     return undef;
 }
@@ -2,13 +2,23 @@
 #define STACK_H
 
 #include "types/env.h"
-#include "ast/ast.h"
 #include <stdbool.h>
+#include <stdint.h>
 
+struct Chunk;
+struct Function;
+
+/* Frames pushed by the VM also describe their window of the value stack:
+   `slots` holds the locals followed by the operand stack. While a callee
+   runs in the same dispatch loop, `ip` and `sp` record where this frame
+   resumes. */
 typedef struct CallFrame {
     Env *env;
-    struct ASTNode **return_ptr; // optional future use
-    bool returning;
+    struct Chunk *chunk;
+    struct Function *closure; // NULL for module code
+    Value *slots;
+    const uint8_t *ip;
+    Value *sp;
 } CallFrame;
 
 typedef struct CallStack {
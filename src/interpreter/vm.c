@@ -0,0 +1,1179 @@
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/vm.h"
+#include "interpreter/annotations.h"
+#include "interpreter/attr.h"
+#include "interpreter/gc.h"
+#include "interpreter/interpreter.h"
+#include "interpreter/jit.h"
+#include "interpreter/module.h"
+#include "interpreter/stack.h"
+#include "types/function.h"
+#include "types/instance.h"
+#include "types/list.h"
+#include "types/object.h"
+#include "types/str.h"
+#include "types/type.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+/* Computed goto is a GCC/Clang extension; other compilers use the switch. */
+#if defined(__GNUC__) || defined(__clang__)
+#define VM_COMPUTED_GOTO 1
+#else
+#define VM_COMPUTED_GOTO 0
+#endif
+
+#define VM_STACK_SLOTS (1 << 20)
+
+typedef struct VM
+{
+    Value *stack;
+    Value *stack_end;
+    Value *top; /* first slot not reserved by an active frame */
+    Upvalue *open_upvalues; /* sorted by stack address, highest first */
+    int depth;              /* dispatch loops running */
+} VM;
+
+extern CallStack call_stack;
+
+static VM vm;
+
+void vm_init(void)
+{
+    vm.stack = malloc(sizeof(Value) * VM_STACK_SLOTS);
+    if (!vm.stack)
+    {
+        log_error("Out of memory while allocating the VM stack");
+        exit(1);
+    }
+    vm.stack_end = vm.stack + VM_STACK_SLOTS;
+    vm.top = vm.stack;
+    vm.open_upvalues = NULL;
+    vm.depth = 0;
+}
+
+void vm_free(void)
+{
+    free(vm.stack);
+    vm.stack = NULL;
+    vm.stack_end = NULL;
+    vm.top = NULL;
+}
+
+/* Only the outermost dispatch loop collects: a nested one was entered
+   from C code, whose locals the collector cannot see. Natives it calls
+   may collect too (see gc.h), as its frames are all on the call stack. */
+bool vm_can_collect(void)
+{
+    return vm.depth == 1;
+}
+
+void vm_mark_roots(void)
+{
+    for (int i = 0; i < call_stack.size; ++i)
+    {
+        CallFrame *frame = &call_stack.frames[i];
+        gc_mark_env(frame->env);
+        if (frame->closure)
+            gc_mark_value(FUNCTION_VAL(frame->closure));
+        for (Value *slot = frame->slots; slot && slot < frame->sp; ++slot)
+            gc_mark_value(*slot);
+    }
+}
+
+static bool is_container(Value v)
+{
+    return IS_OBJECT(v) || IS_INSTANCE(v) || IS_TYPE(v) || IS_FUNCTION(v);
+}
+
+static void require_container(const Chunk *chunk, Value v, uint16_t recv, int line, int column)
+{
+    if (is_container(v))
+        return;
+    const char *name = chunk->names[recv & ~RECV_INTERMEDIATE];
+    if (recv & RECV_INTERMEDIATE)
+        log_script_error(line, column, "Error: intermediate '%s' is not an object", name);
+    else
+        log_script_error(line, column, "Error: '%s' is not an object", name);
+    exit(1);
+}
+
+static Value make_class(const ClassInfo *info, Value *base_values, int line, int column)
+{
+    Type **bases = NULL;
+    if (info->base_count > 0)
+    {
+        bases = malloc(sizeof(Type *) * info->base_count);
+        for (int i = 0; i < info->base_count; ++i)
+        {
+            Value bv = base_values[i];
+            if (!IS_TYPE(bv))
+            {
+                log_script_error(line, column, "Unknown base type '%s'", info->base_names[i]);
+                exit(1);
+            }
+            bases[i] = AS_TYPE(bv);
+        }
+    }
+
+    Type *t = type_create(info->name);
+    type_set_bases(t, bases, info->base_count);
+    Value tv = TYPE_VAL(t);
+    return tv;
+}
+
+/* Operand stack slots own their values, like locals do: reads push a
+ * counted reference and whatever pops a value releases it, so a callee
+ * that reassigns a variable cannot free a value its caller has pushed.
+ * Most operands are numbers, constants or functions, which are not
+ * counted; the checks below keep those off the call path. */
+static inline bool is_counted(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_STRING:
+    case VAL_OBJECT:
+    case VAL_LIST:
+    case VAL_INSTANCE:
+    case VAL_BOUND_METHOD:
+    case VAL_PROMISE:
+        return true;
+    case VAL_NUMBER:
+        return IS_INT64_BOX(v);
+    default:
+        return false;
+    }
+}
+
+static inline Value stack_retain(Value v)
+{
+    return is_counted(v) ? retain_value(v) : v;
+}
+
+static inline void stack_release(Value v)
+{
+    if (is_counted(v))
+        free_value(v);
+}
+
+static void release_values(Value *from, Value *to)
+{
+    for (Value *v = from; v < to; ++v)
+        stack_release(*v);
+}
+
+/* A stack value turned into one to store, consuming it. Lists and objects
+ * have value semantics: one still referenced elsewhere is cloned, and one
+ * only the stack held is handed over as it is. */
+static Value take_value(Value v)
+{
+    if ((IS_LIST(v) && AS_LIST(v)->ref_count > 1) || (IS_OBJECT(v) && AS_OBJECT(v)->ref_count > 1))
+    {
+        Value copy = clone_value(&v);
+        free_value(v);
+        return copy;
+    }
+    return v;
+}
+
+/* A number used as a list index or count, truncated toward zero. */
+static int list_index(Value v)
+{
+    if (IS_SMALL_INT(v))
+        return (int)AS_SMALL_INT(v);
+    return (int)AS_NUMBER(v);
+}
+
+static Value index_list(Value collection, Value index, int line, int column)
+{
+    if (!IS_LIST(collection))
+    {
+        log_script_error(line, column, "Indexing requires a list");
+        exit(1);
+    }
+    if (!IS_NUMBER(index))
+    {
+        log_script_error(line, column, "List index must be a number");
+        exit(1);
+    }
+    Value item = list_get(AS_LIST(collection), list_index(index));
+    return clone_value(&item);
+}
+
+static Value slice_list(Value collection, uint8_t flags, Value *bounds, int line, int column)
+{
+    if (!IS_LIST(collection))
+    {
+        log_script_error(line, column, "Indexing requires a list");
+        exit(1);
+    }
+    int start = 0;
+    int end = AS_LIST(collection)->count;
+    int next = 0;
+    if (flags & SLICE_HAS_START)
+    {
+        Value sv = bounds[next++];
+        if (!IS_NUMBER(sv))
+        {
+            log_script_error(line, column, "Slice start must be a number");
+            exit(1);
+        }
+        start = list_index(sv);
+    }
+    if (flags & SLICE_HAS_END)
+    {
+        Value ev = bounds[next];
+        if (!IS_NUMBER(ev))
+        {
+            log_script_error(line, column, "Slice end must be a number");
+            exit(1);
+        }
+        end = list_index(ev);
+    }
+    Value res = LIST_VAL(list_slice(AS_LIST(collection), start, end));
+    return res;
+}
+
+/*
+ * Loop state for `for x of iterable` occupies two stack slots: the
+ * iterable (a count, a list or an iterator) and a cursor. An undefined
+ * cursor selects the __iter__/__next__ protocol.
+ */
+static void iter_init(Value *slots, int line, int column)
+{
+    Value iterable = slots[0];
+    Value cursor = SMALL_INT_VAL(0);
+    if (IS_NUMBER(iterable))
+    {
+        slots[0] = SMALL_INT_VAL(list_index(iterable));
+        free_value(iterable);
+    }
+    else if (!IS_LIST(iterable))
+    {
+        Value iter_func = value_get_attr(iterable, intern("__iter__"));
+        if (IS_UNDEFINED(iter_func) || IS_NULL(iter_func))
+        {
+            log_script_error(line, column, "Object is not iterable");
+            exit(1);
+        }
+        slots[0] = interpreter_call_value(iter_func, NULL, 0, line, column);
+        free_value(iterable);
+        cursor = UNDEFINED_VAL;
+    }
+    slots[1] = cursor;
+}
+
+static bool iter_next(Value *slots, Value *out, int line, int column)
+{
+    Value state = slots[0];
+    if (IS_UNDEFINED(slots[1]))
+    {
+        Value next_f = value_get_attr(state, intern("__next__"));
+        if (IS_UNDEFINED(next_f) || IS_NULL(next_f))
+        {
+            log_script_error(line, column, "Iterator missing __next__ method");
+            exit(1);
+        }
+        *out = interpreter_call_value(next_f, NULL, 0, line, column);
+        return !IS_UNDEFINED(*out);
+    }
+
+    int i = (int)AS_SMALL_INT(slots[1]);
+    if (IS_NUMBER(state))
+    {
+        if (i >= AS_SMALL_INT(state))
+            return false;
+        *out = SMALL_INT_VAL(i);
+    }
+    else
+    {
+        /* Lazy ranges are read in place, so a loop over range(n) never
+           materializes it. */
+        if (i >= AS_LIST(state)->count)
+            return false;
+        *out = stack_retain(list_get(AS_LIST(state), i));
+    }
+    slots[1] = SMALL_INT_VAL(i + 1);
+    return true;
+}
+
+static Value annotate(const AnnotationSite *site, Value value, Value *args, Env *env)
+{
+    AnnotationTargetType target;
+    switch (site->kind)
+    {
+    case ANNOTATION_SITE_METHOD:
+        target = ANNOTATION_TARGET_METHOD;
+        break;
+    case ANNOTATION_SITE_CLASS:
+        target = ANNOTATION_TARGET_CLASS;
+        break;
+    default:
+        target = IS_FUNCTION(value) ? ANNOTATION_TARGET_FUNCTION : ANNOTATION_TARGET_ASSIGNMENT;
+        break;
+    }
+
+    bool modifier_private = annotations_apply(site->uses, site->use_count, args, &value, target, site->target_name);
+    if (site->store_name)
+    {
+        if (site->is_private || modifier_private)
+            env_define_private(env, site->store_name, value);
+        else
+            env_define(env, site->store_name, value);
+    }
+    return value;
+}
+
+/* Store an owned stack value into a local or an upvalue. */
+static void store_slot(Value *slot, Value value)
+{
+    Value copy = take_value(value);
+    free_value(*slot);
+    *slot = copy;
+}
+
+static Upvalue *capture_upvalue(Value *slot)
+{
+    Upvalue *prev = NULL;
+    Upvalue *up = vm.open_upvalues;
+    while (up && up->location > slot)
+    {
+        prev = up;
+        up = up->next;
+    }
+    if (up && up->location == slot)
+        return up;
+
+    Upvalue *created = malloc(sizeof(Upvalue));
+    if (!created)
+    {
+        log_error("Out of memory while capturing a variable");
+        exit(1);
+    }
+    created->location = slot;
+    created->closed = UNDEFINED_VAL;
+    created->next = up;
+    if (prev)
+        prev->next = created;
+    else
+        vm.open_upvalues = created;
+    return created;
+}
+
+/* Move every captured slot at or above `last` into its upvalue. */
+static void close_upvalues(Value *last)
+{
+    while (vm.open_upvalues && vm.open_upvalues->location >= last)
+    {
+        Upvalue *up = vm.open_upvalues;
+        up->closed = value_escape(up, *up->location);
+        *up->location = UNDEFINED_VAL;
+        up->location = &up->closed;
+        gc_write_barrier(up, up->closed);
+        vm.open_upvalues = up->next;
+    }
+}
+
+static Function *make_closure(const Function *proto, Env *env, Function *enclosing, Value *base)
+{
+    Function *fn = function_new_closure(proto, env);
+    const Chunk *chunk = proto->chunk;
+    if (chunk->upvalue_count == 0)
+        return fn;
+
+    fn->upvalues = malloc(sizeof(Upvalue *) * chunk->upvalue_count);
+    fn->upvalue_count = chunk->upvalue_count;
+    for (int i = 0; i < chunk->upvalue_count; ++i)
+    {
+        UpvalueDesc desc = chunk->upvalues[i];
+        fn->upvalues[i] = desc.is_local ? capture_upvalue(base + desc.index) : enclosing->upvalues[desc.index];
+    }
+    return fn;
+}
+
+static Value arith_fallback(OpCode op, Value left, Value right, int line, int column)
+{
+    static const BinaryOp ops[] = {
+        [BC_ADD] = OP_ADD, [BC_SUB] = OP_SUB, [BC_MUL] = OP_MUL, [BC_DIV] = OP_DIV,
+        [BC_MOD] = OP_MOD, [BC_EQ] = OP_EQ, [BC_STRICT_EQ] = OP_STRICT_EQ, [BC_LT] = OP_LT,
+        [BC_GT] = OP_GT, [BC_LTE] = OP_LTE, [BC_GTE] = OP_GTE};
+    return interpreter_binary_op(ops[op], left, right, line, column);
+}
+
+/*
+ * The quickened form of a generic binary operator for these operands, or
+ * `op` itself when no form covers them. Inline ints and doubles each have
+ * their own forms; a mixed pair stays generic.
+ */
+static OpCode quickened_binary(OpCode op, Value left, Value right)
+{
+    static const struct
+    {
+        uint8_t on_int, on_num, on_str;
+    } forms[] = {
+        [BC_ADD] = {BC_ADD_INT, BC_ADD_NUM, BC_ADD_STR},
+        [BC_SUB] = {BC_SUB_INT, BC_SUB_NUM, BC_SUB},
+        [BC_MUL] = {BC_MUL_INT, BC_MUL_NUM, BC_MUL},
+        [BC_DIV] = {BC_DIV, BC_DIV_NUM, BC_DIV},
+        [BC_MOD] = {BC_MOD, BC_MOD, BC_MOD},
+        [BC_EQ] = {BC_EQ_INT, BC_EQ_NUM, BC_EQ_STR},
+        [BC_STRICT_EQ] = {BC_STRICT_EQ, BC_STRICT_EQ, BC_STRICT_EQ},
+        [BC_LT] = {BC_LT_INT, BC_LT_NUM, BC_LT_STR},
+        [BC_GT] = {BC_GT_INT, BC_GT_NUM, BC_GT_STR},
+        [BC_LTE] = {BC_LTE_INT, BC_LTE_NUM, BC_LTE_STR},
+        [BC_GTE] = {BC_GTE_INT, BC_GTE_NUM, BC_GTE_STR}};
+    if (IS_SMALL_INT(left) && IS_SMALL_INT(right))
+        return (OpCode)forms[op].on_int;
+    if (IS_DOUBLE(left) && IS_DOUBLE(right))
+        return (OpCode)forms[op].on_num;
+    if (IS_STRING(left) && IS_STRING(right))
+        return (OpCode)forms[op].on_str;
+    return op;
+}
+
+static void reserve_frame(const Chunk *chunk, Value *base)
+{
+    if (base + chunk->local_count + chunk->max_stack > vm.stack_end)
+    {
+        log_error("Stack overflow while calling '%s'", chunk->name);
+        exit(1);
+    }
+}
+
+/*
+ * Run `chunk` as native code if the JIT has it, in a scratch frame above
+ * the live ones so that a bailout leaves the arguments untouched for the
+ * interpreter to start over with.
+ */
+static bool run_native(Chunk *chunk, const Value *args, int argc, Value *result)
+{
+    JitEntry entry = jit_lookup(chunk);
+    if (!entry)
+        return false;
+    Value *frame = vm.top;
+    reserve_frame(chunk, frame);
+    memcpy(frame, args, sizeof(Value) * argc);
+    for (int i = argc; i < chunk->local_count; ++i)
+        frame[i] = UNDEFINED_VAL;
+    bool done = entry(frame, result);
+    jit_record_call(chunk, !done);
+    return done;
+}
+
+/*
+ * Execute `chunk` in a frame starting at `base`: local slots first, then
+ * the operand stack. `closure` supplies upvalues and is NULL for module
+ * code.
+ */
+static Value run(Chunk *chunk, Env *env, Function *closure, Value *base)
+{
+    vm.top = base + chunk->local_count + chunk->max_stack;
+
+    CallFrame frame = {.env = env, .chunk = chunk, .closure = closure, .slots = base};
+    push_frame(&call_stack, frame);
+    int entry_depth = call_stack.size;
+    vm.depth++;
+
+    Value *sp = base + chunk->local_count;
+    const uint8_t *ip = chunk->code;
+    const uint8_t *op_start = ip;
+    Value result;
+
+    /* Operands of enter_function: a plain script function is called in this
+       loop, its first `enter_argc` slots being the values already sitting
+       at `enter_slots` (receiver first for methods). The caller resumes
+       with its stack cut back to `enter_args`. A tail call replaces the
+       current frame instead. */
+    Function *enter_fn;
+    Value *enter_slots;
+    Value *enter_args;
+    int enter_argc;
+    bool enter_tail;
+
+#define READ_U8() (*ip++)
+#define READ_U16() (ip += 2, (uint16_t)((ip[-2] << 8) | ip[-1]))
+#define LINE() (chunk->lines[op_start - chunk->code])
+#define COLUMN() (chunk->columns[op_start - chunk->code])
+#define PUSH(v) (*sp++ = (v))
+#define POP() (*--sp)
+#define PEEK(n) (sp[-1 - (n)])
+#define QUICKEN(op) (chunk->code[op_start - chunk->code] = (uint8_t)(op))
+#define BOTH(test) (test(left) && test(right))
+/* Record how far the current frame's stack reaches, for a collection. */
+#define SYNC_SP() (call_stack.frames[call_stack.size - 1].sp = sp)
+#define GC_SAFE_POINT()                         \
+    do                                          \
+    {                                           \
+        if (gc_requested && vm.depth == 1)      \
+        {                                       \
+            SYNC_SP();                          \
+            gc_collect();                       \
+        }                                       \
+    } while (0)
+/* Body of a quickened binary operator: when the guard no longer holds,
+   rewrite the instruction back to its generic form and run that. */
+#define QUICK_BINARY(generic, guard, result) \
+    {                                        \
+        Value right = sp[-1];                \
+        Value left = sp[-2];                 \
+        if (!(guard))                        \
+        {                                    \
+            QUICKEN(generic);                \
+            ip = op_start;                   \
+            DISPATCH();                      \
+        }                                    \
+        sp--;                                \
+        sp[-1] = (result);                   \
+        DISPATCH();                          \
+    }
+/* The same for two strings, which it releases. */
+#define QUICK_STRING_BINARY(generic, result) \
+    {                                        \
+        Value right = sp[-1];                \
+        Value left = sp[-2];                 \
+        if (!BOTH(IS_STRING))                \
+        {                                    \
+            QUICKEN(generic);                \
+            ip = op_start;                   \
+            DISPATCH();                      \
+        }                                    \
+        Value res = (result);                \
+        free_value(left);                    \
+        free_value(right);                   \
+        sp--;                                \
+        sp[-1] = res;                        \
+        DISPATCH();                          \
+    }
+
+#if VM_COMPUTED_GOTO
+    static const void *dispatch_table[] = {
+#define ABLE_OPCODE_LABEL(name) &&L_##name,
+        ABLE_OPCODES(ABLE_OPCODE_LABEL)
+#undef ABLE_OPCODE_LABEL
+    };
+#define DISPATCH()                      \
+    do                                  \
+    {                                   \
+        op_start = ip;                  \
+        goto *dispatch_table[*ip++];    \
+    } while (0)
+#define CASE(name) L_##name:
+    DISPATCH();
+#else
+#define DISPATCH() goto dispatch
+#define CASE(name) case name:
+dispatch:
+    op_start = ip;
+    switch ((OpCode)*ip++)
+    {
+#endif
+
+    CASE(BC_CONSTANT)
+    {
+        uint16_t idx = READ_U16();
+        PUSH(clone_value(&chunk->constants[idx]));
+        DISPATCH();
+    }
+    CASE(BC_UNDEFINED)
+    {
+        Value v = UNDEFINED_VAL;
+        PUSH(v);
+        DISPATCH();
+    }
+    CASE(BC_NULL)
+    {
+        Value v = NULL_VAL;
+        PUSH(v);
+        DISPATCH();
+    }
+    CASE(BC_TRUE)
+    {
+        Value v = BOOL_VAL(true);
+        PUSH(v);
+        DISPATCH();
+    }
+    CASE(BC_FALSE)
+    {
+        Value v = BOOL_VAL(false);
+        PUSH(v);
+        DISPATCH();
+    }
+    CASE(BC_POP)
+    {
+        stack_release(POP());
+        DISPATCH();
+    }
+    CASE(BC_GET_GLOBAL)
+    {
+        uint16_t name = READ_U16();
+        PUSH(stack_retain(get_variable(env, chunk->names[name], LINE(), COLUMN())));
+        DISPATCH();
+    }
+    CASE(BC_SET_GLOBAL)
+    {
+        uint16_t name = READ_U16();
+        Value value = POP();
+        env_define(env, chunk->names[name], value);
+        stack_release(value);
+        DISPATCH();
+    }
+    CASE(BC_SET_PRIVATE)
+    {
+        uint16_t name = READ_U16();
+        Value value = POP();
+        env_define_private(env, chunk->names[name], value);
+        stack_release(value);
+        DISPATCH();
+    }
+    CASE(BC_GET_LOCAL)
+    {
+        uint16_t slot = READ_U16();
+        PUSH(stack_retain(base[slot]));
+        DISPATCH();
+    }
+    CASE(BC_SET_LOCAL)
+    {
+        uint16_t slot = READ_U16();
+        store_slot(&base[slot], POP());
+        DISPATCH();
+    }
+    CASE(BC_GET_UPVALUE)
+    {
+        uint16_t idx = READ_U16();
+        PUSH(stack_retain(*closure->upvalues[idx]->location));
+        DISPATCH();
+    }
+    CASE(BC_SET_UPVALUE)
+    {
+        uint16_t idx = READ_U16();
+        Upvalue *up = closure->upvalues[idx];
+        store_slot(up->location, POP());
+        if (up->location == &up->closed)
+            up->closed = value_escape(up, up->closed);
+        gc_write_barrier(up, *up->location);
+        DISPATCH();
+    }
+    CASE(BC_GET_ATTR)
+    {
+        uint16_t name = READ_U16();
+        uint16_t recv = READ_U16();
+        AttrCache *cache = &chunk->caches[READ_U16()];
+        Value owner = PEEK(0);
+        require_container(chunk, owner, recv, LINE(), COLUMN());
+        sp[-1] = stack_retain(value_get_attr_cached(owner, chunk->names[name], cache));
+        stack_release(owner);
+        DISPATCH();
+    }
+    CASE(BC_GET_ATTR_FOR_SET)
+    {
+        uint16_t name = READ_U16();
+        uint16_t recv = READ_U16();
+        AttrCache *cache = &chunk->caches[READ_U16()];
+        Value owner = PEEK(0);
+        require_container(chunk, owner, recv, LINE(), COLUMN());
+        Value next = value_get_attr_cached(owner, chunk->names[name], cache);
+        if (IS_NULL(next) || IS_UNDEFINED(next))
+        {
+            Value fresh = OBJECT_VAL(object_create());
+            value_set_attr(owner, chunk->names[name], fresh);
+            free_value(fresh);
+            next = value_get_attr(owner, chunk->names[name]);
+        }
+        sp[-1] = stack_retain(next);
+        stack_release(owner);
+        DISPATCH();
+    }
+    CASE(BC_SET_ATTR)
+    {
+        uint16_t name = READ_U16();
+        uint16_t recv = READ_U16();
+        AttrCache *cache = &chunk->caches[READ_U16()];
+        Value owner = POP();
+        Value value = POP();
+        require_container(chunk, owner, recv, LINE(), COLUMN());
+        value_set_attr_cached(owner, chunk->names[name], value, cache);
+        stack_release(owner);
+        stack_release(value);
+        DISPATCH();
+    }
+    CASE(BC_INDEX)
+    {
+        Value index = POP();
+        Value collection = sp[-1];
+        sp[-1] = index_list(collection, index, LINE(), COLUMN());
+        stack_release(collection);
+        stack_release(index);
+        DISPATCH();
+    }
+    CASE(BC_SLICE)
+    {
+        uint8_t flags = READ_U8();
+        int bound_count = (flags & SLICE_HAS_START ? 1 : 0) + (flags & SLICE_HAS_END ? 1 : 0);
+        sp -= bound_count;
+        Value collection = sp[-1];
+        sp[-1] = slice_list(collection, flags, sp, LINE(), COLUMN());
+        stack_release(collection);
+        release_values(sp, sp + bound_count);
+        DISPATCH();
+    }
+    /* Generic operators look at their operands once, rewrite themselves
+       into the matching quickened form and re-run as that form. Operand
+       pairs with no quickened form (mixed int and double, boxed ints,
+       lists) take interpreter_binary_op. */
+    CASE(BC_ADD)
+    CASE(BC_SUB)
+    CASE(BC_MUL)
+    CASE(BC_DIV)
+    CASE(BC_MOD)
+    CASE(BC_EQ)
+    CASE(BC_STRICT_EQ)
+    CASE(BC_LT)
+    CASE(BC_GT)
+    CASE(BC_LTE)
+    CASE(BC_GTE)
+    {
+        OpCode op = (OpCode)*op_start;
+        Value right = sp[-1];
+        Value left = sp[-2];
+        OpCode quick = quickened_binary(op, left, right);
+        if (quick != op)
+        {
+            QUICKEN(quick);
+            ip = op_start;
+            DISPATCH();
+        }
+        sp--;
+        sp[-1] = arith_fallback(op, left, right, LINE(), COLUMN());
+        stack_release(left);
+        stack_release(right);
+        DISPATCH();
+    }
+    /* Two inline integers cannot overflow int64 when added or subtracted,
+       and their product is exact while the double estimate stays within
+       48 bits; past that, or for a zero that must be -0.0, the checked
+       path in interpreter_binary_op runs. */
+    CASE(BC_ADD_INT)
+    QUICK_BINARY(BC_ADD, BOTH(IS_SMALL_INT), INT_VAL(AS_SMALL_INT(left) + AS_SMALL_INT(right)))
+    CASE(BC_ADD_NUM)
+    QUICK_BINARY(BC_ADD, BOTH(IS_DOUBLE), NUMBER_VAL(left.num + right.num))
+    CASE(BC_ADD_STR)
+    QUICK_STRING_BINARY(BC_ADD, arith_fallback(BC_ADD, left, right, LINE(), COLUMN()))
+    CASE(BC_SUB_INT)
+    QUICK_BINARY(BC_SUB, BOTH(IS_SMALL_INT), INT_VAL(AS_SMALL_INT(left) - AS_SMALL_INT(right)))
+    CASE(BC_SUB_NUM)
+    QUICK_BINARY(BC_SUB, BOTH(IS_DOUBLE), NUMBER_VAL(left.num - right.num))
+    CASE(BC_MUL_INT)
+    QUICK_BINARY(BC_MUL, BOTH(IS_SMALL_INT),
+                 fabs((double)AS_SMALL_INT(left) * (double)AS_SMALL_INT(right)) <= (double)INT48_MAX &&
+                         (AS_SMALL_INT(left) * AS_SMALL_INT(right) != 0 || (AS_SMALL_INT(left) | AS_SMALL_INT(right)) >= 0)
+                     ? SMALL_INT_VAL(AS_SMALL_INT(left) * AS_SMALL_INT(right))
+                     : arith_fallback(BC_MUL, left, right, LINE(), COLUMN()))
+    CASE(BC_MUL_NUM)
+    QUICK_BINARY(BC_MUL, BOTH(IS_DOUBLE), NUMBER_VAL(left.num * right.num))
+    CASE(BC_DIV_NUM)
+    QUICK_BINARY(BC_DIV, BOTH(IS_DOUBLE), NUMBER_VAL(right.num != 0 ? left.num / right.num : 0))
+    CASE(BC_EQ_INT)
+    QUICK_BINARY(BC_EQ, BOTH(IS_SMALL_INT), BOOL_VAL(left.bits == right.bits))
+    CASE(BC_EQ_NUM)
+    QUICK_BINARY(BC_EQ, BOTH(IS_DOUBLE), BOOL_VAL(left.num == right.num))
+    CASE(BC_EQ_STR)
+    QUICK_STRING_BINARY(BC_EQ, BOOL_VAL(string_equals(AS_STRING(left), AS_STRING(right))))
+    CASE(BC_LT_INT)
+    QUICK_BINARY(BC_LT, BOTH(IS_SMALL_INT), BOOL_VAL(AS_SMALL_INT(left) < AS_SMALL_INT(right)))
+    CASE(BC_LT_NUM)
+    QUICK_BINARY(BC_LT, BOTH(IS_DOUBLE), BOOL_VAL(left.num < right.num))
+    CASE(BC_LT_STR)
+    QUICK_STRING_BINARY(BC_LT, BOOL_VAL(string_compare(AS_STRING(left), AS_STRING(right)) < 0))
+    CASE(BC_GT_INT)
+    QUICK_BINARY(BC_GT, BOTH(IS_SMALL_INT), BOOL_VAL(AS_SMALL_INT(left) > AS_SMALL_INT(right)))
+    CASE(BC_GT_NUM)
+    QUICK_BINARY(BC_GT, BOTH(IS_DOUBLE), BOOL_VAL(left.num > right.num))
+    CASE(BC_GT_STR)
+    QUICK_STRING_BINARY(BC_GT, BOOL_VAL(string_compare(AS_STRING(left), AS_STRING(right)) > 0))
+    CASE(BC_LTE_INT)
+    QUICK_BINARY(BC_LTE, BOTH(IS_SMALL_INT), BOOL_VAL(AS_SMALL_INT(left) <= AS_SMALL_INT(right)))
+    CASE(BC_LTE_NUM)
+    QUICK_BINARY(BC_LTE, BOTH(IS_DOUBLE), BOOL_VAL(left.num <= right.num))
+    CASE(BC_LTE_STR)
+    QUICK_STRING_BINARY(BC_LTE, BOOL_VAL(string_compare(AS_STRING(left), AS_STRING(right)) <= 0))
+    CASE(BC_GTE_INT)
+    QUICK_BINARY(BC_GTE, BOTH(IS_SMALL_INT), BOOL_VAL(AS_SMALL_INT(left) >= AS_SMALL_INT(right)))
+    CASE(BC_GTE_NUM)
+    QUICK_BINARY(BC_GTE, BOTH(IS_DOUBLE), BOOL_VAL(left.num >= right.num))
+    CASE(BC_GTE_STR)
+    QUICK_STRING_BINARY(BC_GTE, BOOL_VAL(string_compare(AS_STRING(left), AS_STRING(right)) >= 0))
+    CASE(BC_NOT)
+    {
+        Value v = BOOL_VAL(!interpreter_to_boolean(sp[-1]));
+        stack_release(sp[-1]);
+        sp[-1] = v;
+        DISPATCH();
+    }
+    CASE(BC_TO_BOOL)
+    {
+        Value v = BOOL_VAL(interpreter_to_boolean(sp[-1]));
+        stack_release(sp[-1]);
+        sp[-1] = v;
+        DISPATCH();
+    }
+    CASE(BC_INCREMENT)
+    {
+        Value old = sp[-1];
+        if (!IS_NUMBER(old))
+        {
+            log_script_error(LINE(), COLUMN(), "Increment target must be a number");
+            exit(1);
+        }
+        Value next = IS_SMALL_INT(old) ? INT_VAL(AS_SMALL_INT(old) + 1)
+                                       : interpreter_binary_op(OP_ADD, old, SMALL_INT_VAL(1), LINE(), COLUMN());
+        PUSH(next);
+        DISPATCH();
+    }
+    CASE(BC_JUMP)
+    {
+        uint16_t offset = READ_U16();
+        ip += offset;
+        DISPATCH();
+    }
+    CASE(BC_JUMP_IF_FALSE)
+    {
+        uint16_t offset = READ_U16();
+        Value cond = POP();
+        if (!interpreter_to_boolean(cond))
+            ip += offset;
+        stack_release(cond);
+        DISPATCH();
+    }
+    CASE(BC_JUMP_IF_TRUE)
+    {
+        uint16_t offset = READ_U16();
+        Value cond = POP();
+        if (interpreter_to_boolean(cond))
+            ip += offset;
+        stack_release(cond);
+        DISPATCH();
+    }
+    CASE(BC_LOOP)
+    {
+        uint16_t offset = READ_U16();
+        chunk->hotness++;
+        ip -= offset;
+        GC_SAFE_POINT();
+        DISPATCH();
+    }
+    CASE(BC_ITER_INIT)
+    {
+        sp++;
+        iter_init(sp - 2, LINE(), COLUMN());
+        DISPATCH();
+    }
+    CASE(BC_FOR_ITER)
+    {
+        uint16_t offset = READ_U16();
+        Value item;
+        if (iter_next(sp - 2, &item, LINE(), COLUMN()))
+            PUSH(item);
+        else
+            ip += offset;
+        DISPATCH();
+    }
+    CASE(BC_CALL)
+    CASE(BC_TAIL_CALL)
+    {
+        bool tail = *op_start == BC_TAIL_CALL;
+        int argc = READ_U8();
+        Value *args = sp - argc;
+        Value callee = args[-1];
+        if (IS_FUNCTION(callee) && !AS_FUNCTION(callee)->is_async && AS_FUNCTION(callee)->param_count == argc)
+        {
+            enter_fn = AS_FUNCTION(callee);
+            enter_slots = args;
+            enter_argc = argc;
+            enter_args = args;
+            enter_tail = tail;
+            goto enter_function;
+        }
+        if (IS_BOUND_METHOD(callee) && !AS_BOUND_METHOD(callee)->func->is_async &&
+            AS_BOUND_METHOD(callee)->func->param_count == argc + 1)
+        {
+            /* The receiver takes the callee's place as slot 0. */
+            BoundMethod *bound = AS_BOUND_METHOD(callee);
+            enter_fn = bound->func;
+            instance_retain(bound->self);
+            args[-1] = INSTANCE_VAL(bound->self);
+            bound_method_release(bound);
+            enter_slots = args - 1;
+            enter_argc = argc + 1;
+            enter_args = args;
+            enter_tail = tail;
+            goto enter_function;
+        }
+        SYNC_SP();
+        Value ret = interpreter_call_value(callee, args, argc, LINE(), COLUMN());
+        release_values(args - 1, sp);
+        sp = args;
+        sp[-1] = ret;
+        DISPATCH();
+    }
+    CASE(BC_INVOKE)
+    CASE(BC_TAIL_INVOKE)
+    {
+        bool tail = *op_start == BC_TAIL_INVOKE;
+        uint16_t name = READ_U16();
+        uint16_t recv = READ_U16();
+        int argc = READ_U8();
+        AttrCache *cache = &chunk->caches[READ_U16()];
+        Value *args = sp - argc;
+        Value receiver = args[-1];
+        bool handled = false;
+        Value ret = UNDEFINED_VAL;
+        SYNC_SP();
+        /* Only lists and the Promise namespace have intrinsic methods. */
+        if (IS_LIST(receiver) || IS_TYPE(receiver))
+            ret = interpreter_call_intrinsic_method(receiver, chunk->names[name], args, argc, LINE(), COLUMN(),
+                                                    &handled);
+        if (!handled)
+        {
+            require_container(chunk, receiver, recv, LINE(), COLUMN());
+            Value callee = value_get_method_cached(receiver, chunk->names[name], cache);
+            bool bind = IS_INSTANCE(receiver) && IS_FUNCTION(callee) && AS_FUNCTION(callee)->bind_on_access;
+            if (IS_FUNCTION(callee) && !AS_FUNCTION(callee)->is_async && AS_FUNCTION(callee)->param_count == argc + bind)
+            {
+                enter_fn = AS_FUNCTION(callee);
+                enter_slots = bind ? args - 1 : args;
+                enter_argc = argc + bind;
+                enter_args = args;
+                enter_tail = tail;
+                goto enter_function;
+            }
+            /* Call methods with the receiver directly instead of binding them. */
+            if (bind)
+                ret = interpreter_call_method(AS_FUNCTION(callee), receiver, args, argc, LINE(), COLUMN());
+            else
+                ret = interpreter_call_value(callee, args, argc, LINE(), COLUMN());
+        }
+        release_values(args - 1, sp);
+        sp = args;
+        sp[-1] = ret;
+        DISPATCH();
+    }
+    CASE(BC_CLOSURE)
+    {
+        uint16_t idx = READ_U16();
+        GC_SAFE_POINT();
+        Value fn = FUNCTION_VAL(make_closure(AS_FUNCTION(chunk->constants[idx]), env, closure, base));
+        PUSH(fn);
+        DISPATCH();
+    }
+    CASE(BC_OBJECT)
+    {
+        const ObjectLayout *layout = &chunk->layouts[READ_U16()];
+        Object *obj = object_create_shaped(layout->shape);
+        Value *values = sp - layout->key_count;
+        for (int i = 0; i < layout->key_count; ++i)
+            object_set_slot(obj, layout->slots[i], values[i]);
+        release_values(values, sp);
+        sp = values;
+        Value v = OBJECT_VAL(obj);
+        PUSH(v);
+        DISPATCH();
+    }
+    CASE(BC_AWAIT)
+    {
+        Value awaited = sp[-1];
+        sp[-1] = interpreter_await(awaited, LINE(), COLUMN());
+        stack_release(awaited);
+        DISPATCH();
+    }
+    CASE(BC_CLASS)
+    {
+        const ClassInfo *info = &chunk->classes[READ_U16()];
+        sp -= info->base_count;
+        Value cls = make_class(info, sp, LINE(), COLUMN());
+        PUSH(cls);
+        DISPATCH();
+    }
+    CASE(BC_METHOD)
+    {
+        uint16_t name = READ_U16();
+        bool is_static = READ_U8() != 0;
+        Value fn = POP();
+        interpreter_add_method(AS_TYPE(sp[-1]), chunk->names[name], fn, is_static);
+        DISPATCH();
+    }
+    CASE(BC_ANNOTATE)
+    {
+        const AnnotationSite *site = &chunk->sites[READ_U16()];
+        Value *args = sp - site->arg_count;
+        Value value = annotate(site, args[-1], args, env);
+        release_values(args, sp);
+        sp = args;
+        if (site->store_name)
+        {
+            stack_release(value);
+            sp--;
+        }
+        else
+        {
+            sp[-1] = value;
+        }
+        DISPATCH();
+    }
+    CASE(BC_IMPORT)
+    {
+        uint16_t name = READ_U16();
+        PUSH(stack_retain(import_module_value(chunk->names[name], LINE(), COLUMN())));
+        DISPATCH();
+    }
+    CASE(BC_IMPORT_FROM)
+    {
+        uint16_t module = READ_U16();
+        uint16_t name = READ_U16();
+        PUSH(import_module_attr(chunk->names[module], chunk->names[name], LINE(), COLUMN()));
+        DISPATCH();
+    }
+    CASE(BC_RETURN)
+    {
+        result = POP();
+        /* A return from inside a loop leaves its state behind. */
+        release_values(base + chunk->local_count, sp);
+        if (call_stack.size == entry_depth)
+            goto done;
+
+        /* Leave a frame entered by enter_function and resume its caller. */
+        close_upvalues(base);
+        for (int i = 0; i < chunk->local_count; ++i)
+            free_value(base[i]);
+        Value ret = take_value(result);
+        pop_frame(&call_stack);
+        CallFrame *caller = current_frame(&call_stack);
+        chunk = caller->chunk;
+        env = caller->env;
+        closure = caller->closure;
+        base = caller->slots;
+        ip = caller->ip;
+        sp = caller->sp;
+        sp[-1] = ret;
+        vm.top = base + chunk->local_count + chunk->max_stack;
+        DISPATCH();
+    }
+
+    /* The callee's frame starts where its arguments already are: the slots
+       take them over in place and the remaining locals start undefined. A
+       callee below the arguments that is not slot 0 is released now; the
+       result later replaces it. */
+enter_function:
+    {
+        Value native_result;
+        if (jit_enabled() && run_native(enter_fn->chunk, enter_slots, enter_argc, &native_result))
+        {
+            release_values(enter_args - 1, enter_slots + enter_argc);
+            sp = enter_args;
+            sp[-1] = native_result;
+            DISPATCH();
+        }
+        for (int i = 0; i < enter_argc; ++i)
+            enter_slots[i] = take_value(enter_slots[i]);
+        if (enter_slots == enter_args)
+        {
+            stack_release(enter_args[-1]);
+            enter_args[-1] = UNDEFINED_VAL;
+        }
+        if (enter_tail && call_stack.size > entry_depth)
+        {
+            /* The arguments are the callee's now, so the current frame can
+               go before they move down into its slots. Frames entered from
+               C (vm_call) are kept, since their caller frees them. */
+            close_upvalues(base);
+            for (int i = 0; i < chunk->local_count; ++i)
+                free_value(base[i]);
+            release_values(base + chunk->local_count, enter_slots);
+            memmove(base, enter_slots, sizeof(Value) * enter_argc);
+            pop_frame(&call_stack);
+            enter_slots = base;
+        }
+        else
+        {
+            CallFrame *caller = current_frame(&call_stack);
+            caller->ip = ip;
+            caller->sp = enter_args;
+        }
+
+        chunk = enter_fn->chunk;
+        reserve_frame(chunk, enter_slots);
+        base = enter_slots;
+        for (int i = enter_argc; i < chunk->local_count; ++i)
+            base[i] = UNDEFINED_VAL;
+        env = enter_fn->env;
+        closure = enter_fn;
+        vm.top = base + chunk->local_count + chunk->max_stack;
+
+        CallFrame callee = {.env = env, .chunk = chunk, .closure = closure, .slots = base};
+        push_frame(&call_stack, callee);
+        sp = base + chunk->local_count;
+        ip = chunk->code;
+        DISPATCH();
+    }
+
+#if !VM_COMPUTED_GOTO
+    default:
+        log_script_error(LINE(), COLUMN(), "Unknown opcode %d", *op_start);
+        exit(1);
+    }
+#endif
+
+done:
+    pop_frame(&call_stack);
+    vm.top = base;
+    vm.depth--;
+    return result;
+
+#undef READ_U8
+#undef READ_U16
+#undef LINE
+#undef COLUMN
+#undef PUSH
+#undef POP
+#undef PEEK
+#undef QUICKEN
+#undef BOTH
+#undef SYNC_SP
+#undef GC_SAFE_POINT
+#undef QUICK_BINARY
+#undef QUICK_STRING_BINARY
+#undef DISPATCH
+#undef CASE
+}
+
+Value vm_execute(Chunk *chunk, Env *env)
+{
+    Value *base = vm.top;
+    reserve_frame(chunk, base);
+    return run(chunk, env, NULL, base);
+}
+
+Value vm_call(Function *fn, bool has_self, Value self, Value *args, int arg_count)
+{
+    Chunk *chunk = fn->chunk;
+    Value *base = vm.top;
+    reserve_frame(chunk, base);
+
+    int slot = 0;
+    if (has_self)
+        base[slot++] = clone_value(&self);
+    for (int i = 0; i < arg_count; ++i)
+        base[slot++] = clone_value(&args[i]);
+    for (; slot < chunk->local_count; ++slot)
+        base[slot] = UNDEFINED_VAL;
+
+    Value result = run(chunk, fn->env, fn, base);
+    close_upvalues(base);
+    for (int i = 0; i < chunk->local_count; ++i)
+        free_value(base[i]);
+    return take_value(result);
+}
@@ -0,0 +1,21 @@
+#ifndef VM_H
+#define VM_H
+
+#include "compiler/chunk.h"
+#include "types/env.h"
+#include "types/function.h"
+#include "types/value.h"
+
+void vm_init(void);
+void vm_free(void);
+/* Run a compiled chunk with `env` as its scope and return its result. */
+Value vm_execute(Chunk *chunk, Env *env);
+/* Bind `self` (when present) and the arguments to fn's parameter slots,
+ * run its bytecode and return an owned copy of the result. */
+Value vm_call(Function *fn, bool has_self, Value self, Value *args, int arg_count);
+/* Whether a collection can see every live value right now. */
+bool vm_can_collect(void);
+/* Mark the environment, closure and stack values of every frame. */
+void vm_mark_roots(void);
+
+#endif
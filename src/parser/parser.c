@@ -1,3 +1,4 @@
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -8,6 +9,7 @@
 #include "types/function.h"
 #include "types/object.h"
 #include "types/list.h"
+#include "types/str.h"
 #include "ast/ast.h"
 #include "utils/utils.h"
 
@@ -80,8 +82,8 @@ static Annotation *parse_annotation_entry()
     if (current.type != TOKEN_ANNOTATION)
         return NULL;
 
-    Annotation *ann = malloc(sizeof(Annotation));
-    ann->name = strdup(current.value);
+    Annotation *ann = ast_alloc(sizeof(Annotation));
+    ann->name = ast_strdup(current.value);
     ann->line = current.line;
     ann->column = current.column;
     ann->args = NULL;
@@ -97,14 +99,14 @@ static Annotation *parse_annotation_entry()
         if (current.type != TOKEN_RPAREN)
         {
             cap = 4;
-            ann->args = malloc(sizeof(ASTNode *) * cap);
+            ann->args = ast_alloc(sizeof(ASTNode *) * cap);
             while (1)
             {
                 ASTNode *arg = parse_expression();
                 if (ann->arg_count == cap)
                 {
+                    ann->args = ast_realloc(ann->args, sizeof(ASTNode *) * cap, sizeof(ASTNode *) * cap * 2);
                     cap *= 2;
-                    ann->args = realloc(ann->args, sizeof(ASTNode *) * cap);
                 }
                 ann->args[ann->arg_count++] = arg;
                 if (!match(TOKEN_COMMA))
@@ -128,10 +130,16 @@ static void collect_annotations(Annotation ***out, int *out_count)
         Annotation *ann = parse_annotation_entry();
         if (!ann)
             break;
+        if (count == AST_MAX_ANNOTATIONS)
+        {
+            log_script_error(ann->line, ann->column, "Too many annotations");
+            exit(1);
+        }
         if (count == cap)
         {
-            cap = cap > 0 ? cap * 2 : 4;
-            list = realloc(list, sizeof(Annotation *) * cap);
+            int grown = cap > 0 ? cap * 2 : 4;
+            list = ast_realloc(list, sizeof(Annotation *) * cap, sizeof(Annotation *) * grown);
+            cap = grown;
         }
         list[count++] = ann;
 
@@ -171,7 +179,7 @@ static ASTNode *parse_identifier_chain()
         exit(1);
     }
 
-    char *first = strdup(current.value);
+    char *first = ast_strdup(current.value);
     int id_line = current.line;
     int id_col = current.column;
     advance_token();
@@ -191,7 +199,7 @@ static ASTNode *parse_identifier_chain()
             exit(1);
         }
 
-        ASTNode *attr = new_attr_access_node(NULL, strdup(current.value),
+        ASTNode *attr = new_attr_access_node(NULL, ast_strdup(current.value),
                                             current.line, current.column);
         advance_token();
 
@@ -201,44 +209,45 @@ static ASTNode *parse_identifier_chain()
     return base;
 }
 
+/* Number tokens are digit runs: an int64 when they fit, else a double. */
+static Value parse_number_literal(const char *text)
+{
+    errno = 0;
+    long long value = strtoll(text, NULL, 10);
+    if (errno == ERANGE)
+        return NUMBER_VAL(atof(text));
+    return INT_VAL(value);
+}
+
 static ASTNode *parse_literal_node()
 {
+    if (current.type == TOKEN_LBRACE)
+        return parse_object_literal();
+    if (current.type == TOKEN_LBRACKET)
+        return parse_list_literal();
+
     ASTNode *n = new_node(NODE_LITERAL, current.line, current.column);
 
     if (current.type == TOKEN_STRING)
     {
-        n->data.lit.literal_value.type = VAL_STRING;
-        n->data.lit.literal_value.str = strdup(current.value);
+        n->data.lit.literal_value = STRING_VAL(string_from(current.value));
         advance_token();
     }
     else if (current.type == TOKEN_NUMBER)
     {
-        n->data.lit.literal_value.type = VAL_NUMBER;
-        n->data.lit.literal_value.num = atof(current.value);
+        n->data.lit.literal_value = parse_number_literal(current.value);
         advance_token();
     }
     else if (current.type == TOKEN_TRUE || current.type == TOKEN_FALSE)
     {
-        n->data.lit.literal_value.type = VAL_BOOL;
-        n->data.lit.literal_value.boolean = (current.type == TOKEN_TRUE);
+        n->data.lit.literal_value = BOOL_VAL(current.type == TOKEN_TRUE);
         advance_token();
     }
     else if (current.type == TOKEN_NULL)
     {
-        n->data.lit.literal_value.type = VAL_NULL;
+        n->data.lit.literal_value = NULL_VAL;
         advance_token();
     }
-    else if (current.type == TOKEN_LBRACE)
-    {
-        free(n);
-        return parse_object_literal();
-    }
-    else if (current.type == TOKEN_LBRACKET)
-    {
-        ASTNode *lst = parse_list_literal();
-        n->data.lit.literal_value = lst->data.lit.literal_value;
-        free(lst);
-    }
     else
     {
         log_script_error(current.line, current.column, "Expected literal value");
@@ -254,7 +263,7 @@ static void parse_function_parts(char ***out_params, int *out_param_count,
     expect(TOKEN_LPAREN, "'('");
 
     int cap = 4, count = 0;
-    char **params = malloc(sizeof(char *) * cap);
+    char **params = ast_alloc(sizeof(char *) * cap);
 
     if (current.type != TOKEN_RPAREN)
     {
@@ -268,11 +277,11 @@ static void parse_function_parts(char ***out_params, int *out_param_count,
 
             if (count == cap)
             {
+                params = ast_realloc(params, sizeof(char *) * cap, sizeof(char *) * cap * 2);
                 cap *= 2;
-                params = realloc(params, sizeof(char *) * cap);
             }
 
-            params[count++] = strdup(current.value);
+            params[count++] = ast_strdup(current.value);
             advance_token();
 
             if (!match(TOKEN_COMMA))
@@ -283,8 +292,9 @@ static void parse_function_parts(char ***out_params, int *out_param_count,
     expect(TOKEN_RPAREN, "')'");
     expect(TOKEN_COLON, "':'");
 
+    /* A power of two, as add_child expects of a node's children. */
     int body_cap = 4, body_count = 0;
-    ASTNode **body = malloc(sizeof(ASTNode *) * body_cap);
+    ASTNode **body = ast_alloc(sizeof(ASTNode *) * body_cap);
 
     if (match(TOKEN_NEWLINE))
     {
@@ -300,8 +310,8 @@ static void parse_function_parts(char ***out_params, int *out_param_count,
 
             if (body_count == body_cap)
             {
+                body = ast_realloc(body, sizeof(ASTNode *) * body_cap, sizeof(ASTNode *) * body_cap * 2);
                 body_cap *= 2;
-                body = realloc(body, sizeof(ASTNode *) * body_cap);
             }
 
             body[body_count++] = parse_statement();
@@ -320,21 +330,6 @@ static void parse_function_parts(char ***out_params, int *out_param_count,
     *out_body_count = body_count;
 }
 
-static Function *build_function(char **params, int param_count, ASTNode **body, int body_count, bool is_async)
-{
-    Function *fn = malloc(sizeof(Function));
-    fn->name = NULL;
-    fn->param_count = param_count;
-    fn->params = params;
-    fn->body = body;
-    fn->body_count = body_count;
-    fn->env = NULL;
-    fn->attributes = object_create();
-    fn->bind_on_access = false;
-    fn->is_async = is_async;
-    return fn;
-}
-
 static ASTNode *parse_function_literal_node(const char *name_hint, int line, int col, bool is_async)
 {
     char **params;
@@ -343,13 +338,10 @@ static ASTNode *parse_function_literal_node(const char *name_hint, int line, int
     int body_count;
     parse_function_parts(&params, &param_count, &body, &body_count);
 
-    Function *fn = build_function(params, param_count, body, body_count, is_async);
-    if (name_hint)
-        fn->name = strdup(name_hint);
+    Function *fn = function_create(name_hint, params, param_count, body, body_count, is_async);
 
     ASTNode *lit = new_node(NODE_LITERAL, line, col);
-    lit->data.lit.literal_value.type = VAL_FUNCTION;
-    lit->data.lit.literal_value.func = fn;
+    lit->data.lit.literal_value = FUNCTION_VAL(fn);
     return lit;
 }
 
@@ -364,7 +356,7 @@ static ASTNode *parse_fun_declaration(bool is_private, bool is_async)
         exit(1);
     }
 
-    char *name = strdup(current.value);
+    char *name = ast_strdup(current.value);
     advance_token();
 
     ASTNode *assign = new_set_node(name, NULL, line, col);
@@ -387,7 +379,6 @@ static ASTNode *parse_assignment(ASTNode *dest)
     if (dest->type == NODE_VAR)
     {
         set_name = dest->data.set.set_name;
-        free(dest);
     }
     else
     {
@@ -408,13 +399,13 @@ static ASTNode *parse_class_def(Annotation **leading_annotations, int leading_co
         log_script_error(current.line, current.column, "Expected class name");
         exit(1);
     }
-    char *name = strdup(current.value);
+    char *name = ast_strdup(current.value);
     advance_token();
 
     expect(TOKEN_LPAREN, "'('");
 
     int cap = 4, count = 0;
-    char **bases = malloc(sizeof(char *) * cap);
+    char **bases = ast_alloc(sizeof(char *) * cap);
     if (current.type != TOKEN_RPAREN)
     {
         while (1)
@@ -426,10 +417,10 @@ static ASTNode *parse_class_def(Annotation **leading_annotations, int leading_co
             }
             if (count == cap)
             {
+                bases = ast_realloc(bases, sizeof(char *) * cap, sizeof(char *) * cap * 2);
                 cap *= 2;
-                bases = realloc(bases, sizeof(char *) * cap);
             }
-            bases[count++] = strdup(current.value);
+            bases[count++] = ast_strdup(current.value);
             advance_token();
             if (!match(TOKEN_COMMA))
                 break;
@@ -488,7 +479,7 @@ static ASTNode *parse_class_def(Annotation **leading_annotations, int leading_co
             log_script_error(current.line, current.column, "Expected method name");
             exit(1);
         }
-        char *mname = strdup(current.value);
+        char *mname = ast_strdup(current.value);
         advance_token();
         bool is_static = annotations_contain(method_annotations, method_annotation_count, "static");
         ASTNode *m = parse_method_def(mname, is_static, method_async, fun_line, fun_col, method_annotations, method_annotation_count);
@@ -558,8 +549,7 @@ static ASTNode *parse_unary()
     {
         ASTNode *right = parse_unary();
         ASTNode *zero = new_node(NODE_LITERAL, prev_line, prev_col);
-        zero->data.lit.literal_value.type = VAL_NUMBER;
-        zero->data.lit.literal_value.num = 0;
+        zero->data.lit.literal_value = INT_VAL(0);
         ASTNode *n = new_node(NODE_BINARY, prev_line, prev_col);
         n->data.binary.op = OP_SUB;
         add_child(n, zero);
@@ -811,8 +801,8 @@ static ASTNode *parse_object_literal()
     int col = prev_col;
 
     int cap = 4, count = 0;
-    char **keys = malloc(sizeof(char *) * cap);
-    ASTNode **vals = malloc(sizeof(ASTNode *) * cap);
+    char **keys = ast_alloc(sizeof(char *) * cap);
+    ASTNode **vals = ast_alloc(sizeof(ASTNode *) * cap);
 
     while (current.type != TOKEN_RBRACE)
     {
@@ -821,9 +811,9 @@ static ASTNode *parse_object_literal()
 
         if (count == cap)
         {
+            keys = ast_realloc(keys, sizeof(char *) * cap, sizeof(char *) * cap * 2);
+            vals = ast_realloc(vals, sizeof(ASTNode *) * cap, sizeof(ASTNode *) * cap * 2);
             cap *= 2;
-            keys = realloc(keys, sizeof(char *) * cap);
-            vals = realloc(vals, sizeof(ASTNode *) * cap);
         }
 
         if (!is_identifier_like(current.type) && current.type != TOKEN_STRING)
@@ -833,7 +823,7 @@ static ASTNode *parse_object_literal()
         }
 
         TokenType key_type = current.type;
-        char *key = strdup(current.value);
+        char *key = ast_strdup(current.value);
         int key_line = current.line;
         int key_col = current.column;
         advance_token();
@@ -850,7 +840,7 @@ static ASTNode *parse_object_literal()
                 log_script_error(key_line, key_col, "String keys require ':' and a value");
                 exit(1);
             }
-            val_node = new_var_node(strdup(key), key_line, key_col);
+            val_node = new_var_node(key, key_line, key_col);
         }
 
         keys[count] = key;
@@ -878,54 +868,43 @@ static ASTNode *parse_object_literal()
     return obj_node;
 }
 
-ASTNode *parse_list_literal()
+/* The list a literal of literals builds; nested lists are values too, so
+ * only the outermost one is owned by a literal node. */
+static Value parse_list_value()
 {
     expect(TOKEN_LBRACKET, "'['");
-    int line = prev_line;
-    int col = prev_col;
 
-    int cap = 4, count = 0;
-    Value *items = malloc(sizeof(Value) * cap);
+    List *list = list_create();
 
     while (current.type != TOKEN_RBRACKET)
     {
         while (current.type == TOKEN_NEWLINE)
             advance_token();
 
-        if (count == cap)
-        {
-            cap *= 2;
-            items = realloc(items, sizeof(Value) * cap);
-        }
-
+        Value item;
         if (current.type == TOKEN_STRING)
         {
-            items[count].type = VAL_STRING;
-            items[count].str = strdup(current.value);
+            item = STRING_VAL(string_from(current.value));
             advance_token();
         }
         else if (current.type == TOKEN_NUMBER)
         {
-            items[count].type = VAL_NUMBER;
-            items[count].num = atof(current.value);
+            item = parse_number_literal(current.value);
             advance_token();
         }
         else if (current.type == TOKEN_TRUE || current.type == TOKEN_FALSE)
         {
-            items[count].type = VAL_BOOL;
-            items[count].boolean = (current.type == TOKEN_TRUE);
+            item = BOOL_VAL(current.type == TOKEN_TRUE);
             advance_token();
         }
         else if (current.type == TOKEN_NULL)
         {
-            items[count].type = VAL_NULL;
+            item = NULL_VAL;
             advance_token();
         }
         else if (current.type == TOKEN_LBRACKET)
         {
-            ASTNode *lst = parse_list_literal();
-            items[count] = lst->data.lit.literal_value;
-            free(lst);
+            item = parse_list_value();
         }
         else
         {
@@ -933,7 +912,8 @@ ASTNode *parse_list_literal()
             exit(1);
         }
 
-        count++;
+        list_append(list, item);
+        free_value(item);
         if (!match(TOKEN_COMMA))
         {
             while (current.type == TOKEN_NEWLINE)
@@ -943,15 +923,13 @@ ASTNode *parse_list_literal()
     }
 
     expect(TOKEN_RBRACKET, "]");
+    return LIST_VAL(list);
+}
 
-    List *list = malloc(sizeof(List));
-    list->count = count;
-    list->capacity = cap;
-    list->items = items;
-
-    ASTNode *node = new_node(NODE_LITERAL, line, col);
-    node->data.lit.literal_value.type = VAL_LIST;
-    node->data.lit.literal_value.list = list;
+static ASTNode *parse_list_literal()
+{
+    ASTNode *node = new_node(NODE_LITERAL, current.line, current.column);
+    node->data.lit.literal_value = parse_list_value();
     return node;
 }
 
@@ -963,7 +941,7 @@ static ASTNode *parse_return_stmt()
     if (current.type == TOKEN_NEWLINE || current.type == TOKEN_DEDENT || current.type == TOKEN_EOF)
     {
         ASTNode *undef = new_node(NODE_LITERAL, line, col);
-        undef->data.lit.literal_value.type = VAL_UNDEFINED;
+        undef->data.lit.literal_value = UNDEFINED_VAL;
         add_child(n, undef);
     }
     else
@@ -1034,7 +1012,7 @@ static ASTNode *parse_for_stmt()
         log_script_error(current.line, current.column, "Expected loop variable");
         exit(1);
     }
-    char *var = strdup(current.value);
+    char *var = ast_strdup(current.value);
     advance_token();
     expect(TOKEN_OF, "of");
     ASTNode *iter = parse_expression();
@@ -1074,7 +1052,7 @@ static char *parse_module_name()
 {
     if (current.type == TOKEN_STRING)
     {
-        char *name = strdup(current.value);
+        char *name = ast_strdup(current.value);
         advance_token();
         return name;
     }
@@ -1085,7 +1063,7 @@ static char *parse_module_name()
         exit(1);
     }
 
-    char *name = strdup(current.value);
+    char *name = ast_strdup(current.value);
     advance_token();
     while (match(TOKEN_DOT))
     {
@@ -1096,9 +1074,8 @@ static char *parse_module_name()
             exit(1);
         }
         size_t len = strlen(name) + strlen(current.value) + 2;
-        char *tmp = malloc(len);
+        char *tmp = ast_alloc(len);
         snprintf(tmp, len, "%s/%s", name, current.value);
-        free(name);
         name = tmp;
         advance_token();
     }
@@ -1120,7 +1097,7 @@ static ASTNode *parse_from_import_stmt()
     char *module = parse_module_name();
     expect(TOKEN_IMPORT, "import");
     int cap = 4, count = 0;
-    char **names = malloc(sizeof(char *) * cap);
+    char **names = ast_alloc(sizeof(char *) * cap);
     while (1)
     {
         if (current.type != TOKEN_IDENTIFIER)
@@ -1130,10 +1107,10 @@ static ASTNode *parse_from_import_stmt()
         }
         if (count == cap)
         {
+            names = ast_realloc(names, sizeof(char *) * cap, sizeof(char *) * cap * 2);
             cap *= 2;
-            names = realloc(names, sizeof(char *) * cap);
         }
-        names[count++] = strdup(current.value);
+        names[count++] = ast_strdup(current.value);
         advance_token();
         if (!match(TOKEN_COMMA))
             break;
@@ -1291,6 +1268,7 @@ static ASTNode *parse_statement()
 /* --- public API --- */
 ASTNode **parse_program(Lexer *lexer, int *out_count)
 {
+    AstArena *outer = ast_arena_enter(ast_arena_create());
     L = lexer;
     current = next_token(L);
     prev_line = current.line;
@@ -1314,6 +1292,9 @@ ASTNode **parse_program(Lexer *lexer, int *out_count)
         list[count++] = parse_statement();
     }
 
+    ASTNode **program = ast_program(list, count);
+    free(list);
+    ast_arena_enter(outer);
     *out_count = count;
-    return list;
+    return program;
 }
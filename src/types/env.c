@@ -1,14 +1,20 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "interpreter/gc.h"
 #include "types/env.h"
 #include "types/object.h"
 #include "types/value.h"
+#include "utils/intern.h"
+#include "utils/slab.h"
 #include "utils/utils.h"
 
+static Slab env_slab = SLAB_FOR(Env);
+static Slab variable_slab = SLAB_FOR(Variable);
+
 Env *env_create(Env *parent)
 {
-    Env *env = malloc(sizeof(Env));
+    Env *env = slab_alloc(&env_slab);
     env->parent = parent;
     env->vars = NULL;
     env->ref_count = 1;
@@ -33,24 +39,36 @@ void env_release(Env *env)
     HASH_ITER(hh, env->vars, cur, tmp)
     {
         HASH_DEL(env->vars, cur);
-        free(cur->name);
         free_value(cur->value);
-        free(cur);
+        slab_free(&variable_slab, cur);
     }
 
-    free(env);
+    gc_forget(env);
+    slab_free(&env_slab, env);
 }
 
+/* Variables are keyed by atom pointer, hashed with the atom's precomputed hash. */
 static Variable *find_var(Env *env, const char *name)
 {
     Variable *var = NULL;
-    HASH_FIND_STR(env->vars, name, var);
+    HASH_FIND_BYHASHVALUE(hh, env->vars, &name, sizeof(name), intern_hash(name), var);
     return var;
 }
 
+static void add_var(Env *env, const char *name, Value val, bool is_private)
+{
+    Variable *var = slab_alloc(&variable_slab);
+    var->name = name;
+    var->value = value_escape(env, clone_value(&val));
+    var->is_private = is_private;
+    gc_write_barrier(env, var->value);
+    HASH_ADD_KEYPTR_BYHASHVALUE(hh, env->vars, &var->name, sizeof(var->name), intern_hash(name), var);
+}
+
 static void set_variable_internal(Env *env, const char *name, Value val,
                                   bool is_private)
 {
+    name = intern(name);
     // Search existing variable in chain
     for (Env *e = env; e != NULL; e = e->parent)
     {
@@ -58,17 +76,14 @@ static void set_variable_internal(Env *env, const char *name, Value val,
         if (var)
         {
             free_value(var->value);
-            var->value = clone_value(&val);
+            var->value = value_escape(e, clone_value(&val));
+            gc_write_barrier(e, var->value);
             return;
         }
     }
 
     // Add to current environment
-    Variable *new_var = malloc(sizeof(Variable));
-    new_var->name = strdup(name);
-    new_var->value = clone_value(&val);
-    new_var->is_private = is_private;
-    HASH_ADD_KEYPTR(hh, env->vars, new_var->name, strlen(new_var->name), new_var);
+    add_var(env, name, val, is_private);
 }
 
 void set_variable(Env *env, const char *name, Value val)
@@ -81,6 +96,32 @@ void set_private_variable(Env *env, const char *name, Value val)
     set_variable_internal(env, name, val, true);
 }
 
+static void env_define_internal(Env *env, const char *name, Value val, bool is_private)
+{
+    Variable *var = find_var(env, name);
+    if (var)
+    {
+        Value copy = value_escape(env, clone_value(&val));
+        free_value(var->value);
+        var->value = copy;
+        gc_write_barrier(env, copy);
+        return;
+    }
+
+    add_var(env, name, val, is_private);
+}
+
+/* Bind a name in this scope only, shadowing any outer binding. */
+void env_define(Env *env, const char *name, Value val)
+{
+    env_define_internal(env, name, val, false);
+}
+
+void env_define_private(Env *env, const char *name, Value val)
+{
+    env_define_internal(env, name, val, true);
+}
+
 Value get_variable(Env *env, const char *name, int line, int column)
 {
     for (Env *e = env; e != NULL; e = e->parent)
@@ -8,7 +8,7 @@
 
 typedef struct Variable
 {
-    char *name;           // key
+    const char *name;     // key, interned
     Value value;          // stored value
     bool is_private;
     UT_hash_handle hh;    // uthash handle
@@ -27,6 +27,9 @@ void env_release(Env *env);
 
 void set_variable(Env *env, const char *name, Value val);
 void set_private_variable(Env *env, const char *name, Value val);
+/* The remaining functions take interned names (see utils/intern.h). */
+void env_define(Env *env, const char *name, Value val);
+void env_define_private(Env *env, const char *name, Value val);
 Value get_variable(Env *env, const char *name, int line, int column);
 
 #endif
@@ -0,0 +1,63 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "types/function.h"
+#include "types/env.h"
+#include "types/object.h"
+#include "utils/slab.h"
+#include "utils/utils.h"
+
+static Slab closure_slab = SLAB_FOR(Function);
+
+Function *function_create(const char *name, char **params, int param_count,
+                          ASTNode **body, int body_count, bool is_async)
+{
+    Function *fn = malloc(sizeof(Function));
+    if (!fn)
+    {
+        log_error("Out of memory while creating function");
+        exit(1);
+    }
+    fn->name = name ? strdup(name) : NULL;
+    fn->param_count = param_count;
+    fn->params = params;
+    fn->body = body;
+    fn->body_count = body_count;
+    fn->chunk = NULL;
+    fn->upvalues = NULL;
+    fn->upvalue_count = 0;
+    fn->env = NULL;
+    fn->attributes = object_create_heap();
+    fn->bind_on_access = false;
+    fn->is_async = is_async;
+    return fn;
+}
+
+/* Function literals compile to a prototype; every evaluation of the
+ * literal yields a fresh closure over the defining environment that
+ * shares the prototype's parameters and bytecode. The caller fills in
+ * the closure's upvalues. Closures are never reference counted; the
+ * collector frees them (see gc.h). */
+Function *function_new_closure(const Function *proto, struct Env *env)
+{
+    Function *fn = slab_alloc(&closure_slab);
+    *fn = *proto;
+    fn->env = env;
+    env_retain(env);
+    fn->upvalues = NULL;
+    fn->upvalue_count = 0;
+    fn->attributes = object_create_heap();
+    fn->bind_on_access = false;
+    gc_track(&fn->gc, GC_CLOSURE);
+    return fn;
+}
+
+void function_free_closure(Function *fn, ValueRelease release)
+{
+    gc_untrack(&fn->gc);
+    env_release(fn->env);
+    free(fn->upvalues);
+    free_object_with(fn->attributes, release);
+    gc_forget(fn);
+    slab_free(&closure_slab, fn);
+}
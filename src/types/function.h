@@ -2,22 +2,47 @@
 #define FUNCTION_H
 
 #include "../ast/ast.h"
+#include "interpreter/gc.h"
 #include <stdbool.h>
 
 struct Env;
 struct Object;
+struct Chunk;
+
+/* A captured variable. While the defining frame is live, `location`
+ * points at its slot; when the frame returns the value moves into
+ * `closed` and `location` is redirected there. */
+typedef struct Upvalue
+{
+    Value *location;
+    Value closed;
+    struct Upvalue *next; /* next open upvalue, deeper in the stack */
+} Upvalue;
 
 typedef struct Function
 {
+    GcObject gc; // tracked when a closure
     char *name;
+    /* Parameters and body point into the defining program's AST and are
+       only read while compiling it, before free_ast. */
     int param_count;
     char **params;
     ASTNode **body;
     int body_count;
+    struct Chunk *chunk;
+    Upvalue **upvalues;
+    int upvalue_count;
     struct Env *env;
     struct Object *attributes;
     bool bind_on_access;
     bool is_async;
 } Function;
 
+Function *function_create(const char *name, char **params, int param_count,
+                          ASTNode **body, int body_count, bool is_async);
+Function *function_new_closure(const Function *proto, struct Env *env);
+/* Free a closure, releasing its attributes with `release`. Its upvalues
+ * may be shared with other closures and are left to the caller. */
+void function_free_closure(Function *fn, ValueRelease release);
+
 #endif
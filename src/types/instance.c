@@ -1,23 +1,36 @@
 #include <stdlib.h>
 
 #include "types/instance.h"
+#include "utils/slab.h"
+#include "utils/utils.h"
+
+static Slab instance_slab = SLAB_FOR(Instance);
+static Slab bound_method_slab = SLAB_FOR(BoundMethod);
 
 Instance *instance_create(Type *cls) {
-    Instance *inst = malloc(sizeof(Instance));
+    Instance *inst = slab_alloc(&instance_slab);
     inst->ref_count = 1;
     inst->cls = cls;
-    inst->attributes = malloc(sizeof(Object));
-    inst->attributes->count = 0;
-    inst->attributes->capacity = 0;
-    inst->attributes->pairs = NULL;
+    inst->attributes = object_create_heap();
+    inst->methods = NULL;
+    inst->method_count = 0;
+    gc_track(&inst->gc, GC_INSTANCE);
     return inst;
 }
 
-void instance_free(Instance *inst) {
+void instance_destroy(Instance *inst, ValueRelease release) {
     if (!inst)
         return;
-    free_object(inst->attributes);
-    free(inst);
+    gc_untrack(&inst->gc);
+    free_object_with(inst->attributes, release);
+    for (int i = 0; i < inst->method_count; ++i)
+    {
+        gc_forget(inst->methods[i]);
+        bound_method_free(inst->methods[i]);
+    }
+    free(inst->methods);
+    gc_forget(inst);
+    slab_free(&instance_slab, inst);
 }
 
 void instance_retain(Instance *inst) {
@@ -27,7 +40,55 @@ void instance_retain(Instance *inst) {
 void instance_release(Instance *inst) {
     if (!inst) return;
     if (--inst->ref_count == 0) {
-        instance_free(inst);
+        instance_destroy(inst, free_value);
+    }
+}
+
+static BoundMethod *bound_method_new(Instance *self, struct Function *func, int ref_count) {
+    BoundMethod *bm = slab_alloc(&bound_method_slab);
+    bm->ref_count = ref_count;
+    bm->self = self;
+    bm->func = func;
+    return bm;
+}
+
+BoundMethod *instance_bind(Instance *inst, struct Function *func) {
+    for (int i = 0; i < inst->method_count; ++i) {
+        if (inst->methods[i]->func == func)
+            return inst->methods[i];
+    }
+    BoundMethod **grown = realloc(inst->methods, sizeof(BoundMethod *) * (inst->method_count + 1));
+    if (!grown) {
+        log_error("Out of memory while binding a method");
+        exit(1);
     }
+    inst->methods = grown;
+    /* Not counted: the instance owns it, and it must not keep the
+       instance alive in return. */
+    return inst->methods[inst->method_count++] = bound_method_new(inst, func, 0);
 }
 
+BoundMethod *bound_method_retain(BoundMethod *bm) {
+    if (!bm)
+        return NULL;
+    if (bm->ref_count == 0) {
+        instance_retain(bm->self);
+        return bound_method_new(bm->self, bm->func, 1);
+    }
+    bm->ref_count++;
+    return bm;
+}
+
+void bound_method_release(BoundMethod *bm) {
+    if (!bm || bm->ref_count == 0)
+        return;
+    if (--bm->ref_count == 0) {
+        instance_release(bm->self);
+        gc_forget(bm);
+        bound_method_free(bm);
+    }
+}
+
+void bound_method_free(BoundMethod *bm) {
+    slab_free(&bound_method_slab, bm);
+}
@@ -1,17 +1,31 @@
 #ifndef INSTANCE_H
 #define INSTANCE_H
 
+#include "interpreter/gc.h"
 #include "types/type.h"
 #include "types/object.h"
 
 typedef struct Instance {
+    GcObject gc;
     int ref_count;
     Type *cls;
     Object *attributes;
+    BoundMethod **methods; // handed out by instance_bind, one per function
+    int method_count;
 } Instance;
 
 Instance *instance_create(Type *cls);
 void instance_retain(Instance *inst);
 void instance_release(Instance *inst);
+/* Free `inst` whatever its count, releasing its attributes with `release`. */
+void instance_destroy(Instance *inst, ValueRelease release);
+/* The bound method for `func` on `inst`, owned by `inst`. */
+BoundMethod *instance_bind(Instance *inst, struct Function *func);
+/* A counted reference to `bm`: a new copy retaining the instance if `bm`
+   is owned by its instance, otherwise `bm` itself. */
+BoundMethod *bound_method_retain(BoundMethod *bm);
+void bound_method_release(BoundMethod *bm);
+/* Free `bm` without touching the instance, for the collector. */
+void bound_method_free(BoundMethod *bm);
 
 #endif
@@ -1,76 +1,217 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "interpreter/gc.h"
 #include "types/list.h"
+#include "utils/region.h"
+#include "utils/slab.h"
+#include "utils/utils.h"
+
+static Slab list_slab = SLAB_FOR(List);
+
+/* From the active region, like the buffers, or else the slab. */
+static List *list_alloc(void)
+{
+    List *list = region_try_alloc(sizeof(List));
+    return list ? list : slab_alloc(&list_slab);
+}
+
+static ListBuffer *buffer_alloc(const List *list, int capacity)
+{
+    ListBuffer *buffer = region_malloc_for(list, sizeof(ListBuffer) + sizeof(Value) * capacity);
+    if (!buffer)
+    {
+        log_error("Out of memory while growing a list");
+        exit(1);
+    }
+    buffer->ref_count = 1;
+    buffer->count = 0;
+    return buffer;
+}
+
+static void buffer_release(ListBuffer *buffer, ValueRelease release)
+{
+    if (!buffer || --buffer->ref_count > 0)
+        return;
+    for (int i = 0; i < buffer->count; ++i)
+        release(buffer->items[i]);
+    gc_forget(buffer);
+    region_free(buffer);
+}
+
+static bool is_range(const List *list)
+{
+    return !list->buffer && list->count > 0;
+}
+
+static Value item_at(const List *list, int index)
+{
+    if (is_range(list))
+        return SMALL_INT_VAL((int64_t)list->range_start + index);
+    return list->items[index];
+}
+
+/* Give `list` a buffer of its own holding exactly its items before it is
+   written to: materialize a range, copy a shared buffer or a view. */
+static void list_separate(List *list)
+{
+    ListBuffer *old = list->buffer;
+    if (old && old->ref_count == 1 && list->items == old->items && list->count == old->count)
+        return;
+    if (!old && list->count == 0)
+        return;
+    if (list->capacity < list->count)
+        list->capacity = list->count;
+    ListBuffer *copy = buffer_alloc(list, list->capacity);
+    for (int i = 0; i < list->count; ++i)
+    {
+        Value item = item_at(list, i);
+        copy->items[i] = value_escape(copy, clone_value(&item));
+        /* Copies of nested lists and objects are new containers. */
+        gc_write_barrier(list, copy->items[i]);
+    }
+    copy->count = list->count;
+    buffer_release(old, free_value);
+    list->buffer = copy;
+    list->items = copy->items;
+}
+
+List *list_create(void)
+{
+    List *list = list_alloc();
+    if (!list)
+        return NULL;
+    list->count = 0;
+    list->capacity = 0;
+    list->items = NULL;
+    list->buffer = NULL;
+    list->range_start = 0;
+    list->ref_count = 1;
+    return list;
+}
+
+List *list_range(int start, int count)
+{
+    List *list = list_create();
+    if (list && count > 0)
+    {
+        list->count = count;
+        list->range_start = start;
+    }
+    return list;
+}
 
 List *clone_list(const List *src)
 {
     if (!src)
         return NULL;
-    List *copy = malloc(sizeof(List));
+    List *copy = list_alloc();
     if (!copy)
         return NULL;
-    copy->count = src->count;
-    copy->capacity = src->capacity;
-    copy->items = malloc(sizeof(Value) * copy->capacity);
-    for (int i = 0; i < src->count; ++i)
-        copy->items[i] = clone_value(&src->items[i]);
+    *copy = *src;
+    copy->ref_count = 1;
+    if (copy->buffer)
+        copy->buffer->ref_count++;
+    return copy;
+}
+
+List *list_copy(const List *src)
+{
+    List *copy = clone_list(src);
+    if (copy)
+        list_separate(copy);
     return copy;
 }
 
 void free_list(List *list)
 {
-    if (!list)
+    free_list_with(list, free_value);
+}
+
+void free_list_with(List *list, ValueRelease release)
+{
+    if (!list || --list->ref_count > 0)
         return;
-    for (int i = 0; i < list->count; ++i)
-        free_value(list->items[i]);
-    free(list->items);
-    free(list);
+    buffer_release(list->buffer, release);
+    gc_forget(list);
+    if (!region_try_free(list))
+        slab_free(&list_slab, list);
 }
 
 static void ensure_capacity(List *list, int cap)
 {
+    list_separate(list);
     if (list->capacity >= cap)
         return;
     list->capacity = list->capacity > 0 ? list->capacity * 2 : 4;
     if (list->capacity < cap)
         list->capacity = cap;
-    list->items = realloc(list->items, sizeof(Value) * list->capacity);
+    size_t used = list->buffer ? sizeof(ListBuffer) + sizeof(Value) * list->buffer->count : 0;
+    ListBuffer *grown = region_realloc_for(list, list->buffer, used, sizeof(ListBuffer) + sizeof(Value) * list->capacity);
+    if (!grown)
+    {
+        log_error("Out of memory while growing a list");
+        exit(1);
+    }
+    if (list->buffer && grown != list->buffer)
+        gc_forget(list->buffer);
+    if (!list->buffer)
+    {
+        grown->ref_count = 1;
+        grown->count = 0;
+    }
+    list->buffer = grown;
+    list->items = grown->items;
 }
 
 void list_append(List *list, Value val)
 {
+    /* Clone first: `val` may be borrowed from this list's own buffer. */
+    Value copy = clone_value(&val);
     ensure_capacity(list, list->count + 1);
-    list->items[list->count++] = clone_value(&val);
+    copy = value_escape(list->buffer, copy);
+    list->items[list->count++] = copy;
+    list->buffer->count = list->count;
+    gc_write_barrier(list, copy);
 }
 
 Value list_remove(List *list, int index)
 {
-    Value undef = {.type = VAL_UNDEFINED};
+    Value undef = UNDEFINED_VAL;
     if (index < 0 || index >= list->count)
         return undef;
+    list_separate(list);
     Value removed = list->items[index];
     for (int i = index; i < list->count - 1; ++i)
         list->items[i] = list->items[i + 1];
     list->count--;
+    list->buffer->count = list->count;
     return removed;
 }
 
 Value list_get(List *list, int index)
 {
-    Value undef = {.type = VAL_UNDEFINED};
+    Value undef = UNDEFINED_VAL;
     if (index < 0)
         index += list->count;
     if (index < 0 || index >= list->count)
         return undef;
-    return list->items[index];
+    return item_at(list, index);
 }
 
 void list_extend(List *list, const List *other)
 {
-    ensure_capacity(list, list->count + other->count);
-    for (int i = 0; i < other->count; ++i)
-        list->items[list->count++] = clone_value(&other->items[i]);
+    int added = other->count;
+    ensure_capacity(list, list->count + added);
+    /* `other` may be `list` itself, so read through its (possibly moved) items. */
+    for (int i = 0; i < added; ++i)
+    {
+        Value item = item_at(other, i);
+        list->items[list->count + i] = value_escape(list->buffer, clone_value(&item));
+        gc_write_barrier(list, list->items[list->count + i]);
+    }
+    list->count += added;
+    list->buffer->count = list->count;
 }
 
 List *list_slice(const List *list, int start, int end)
@@ -86,11 +227,16 @@ List *list_slice(const List *list, int start, int end)
     if (end < start)
         end = start;
 
-    List *res = malloc(sizeof(List));
-    res->count = 0;
-    res->capacity = 0;
-    res->items = NULL;
-    for (int i = start; i < end; ++i)
-        list_append(res, list->items[i]);
+    if (is_range(list))
+        return list_range(list->range_start + start, end - start);
+    List *res = list_create();
+    if (end > start)
+    {
+        res->buffer = list->buffer;
+        res->buffer->ref_count++;
+        res->items = list->items + start;
+        res->count = end - start;
+        res->capacity = res->count;
+    }
     return res;
 }
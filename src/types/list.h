@@ -3,18 +3,45 @@
 
 #include "value.h"
 
+/* Element storage. A cloned list shares its buffer with the original until
+   either of them is written to (copy-on-write), and so does a slice, which
+   views a run of the parent's items in place. The buffer owns its first
+   `count` items whichever lists look at them. */
+typedef struct ListBuffer {
+    int ref_count;
+    int count;
+    Value items[];
+} ListBuffer;
+
+/* A list with items but no buffer is a lazy range: item i is the integer
+   range_start + i, and nothing is stored until the list is written to.
+   `ref_count` counts holders of this very list (see retain_value); a
+   clone is a new List. */
 typedef struct List {
     int count;
     int capacity;
-    Value *items;
+    Value *items;       // into buffer->items; NULL while empty or lazy
+    ListBuffer *buffer;
+    int range_start;
+    int ref_count;
 } List;
 
+List *list_create(void);
+/* The integers start .. start + count - 1, without storing them. */
+List *list_range(int start, int count);
 List *clone_list(const List *src);
+/* Like clone_list, but with a buffer of its own rather than a shared one. */
+List *list_copy(const List *src);
+/* Drop a reference to `list`, freeing it after the last one. */
 void free_list(List *list);
+/* free_list, releasing the items with `release` if this was the last
+   reference to them. */
+void free_list_with(List *list, ValueRelease release);
 void list_append(List *list, Value val);
 Value list_remove(List *list, int index);
 Value list_get(List *list, int index);
 void list_extend(List *list, const List *other);
+/* Items [start, end), clamped like Python; shares the parent's storage. */
 List *list_slice(const List *list, int start, int end);
 
 #endif
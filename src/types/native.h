@@ -0,0 +1,24 @@
+#ifndef NATIVE_H
+#define NATIVE_H
+
+#include "types/value.h"
+
+/* max_args value for natives that accept any number of arguments */
+#define NATIVE_VARIADIC -1
+
+struct NativeFunction;
+
+typedef Value (*NativeImpl)(const struct NativeFunction *self, Value *args, int argc, int line, int column);
+
+/* A function implemented in C. Instances are static and never freed, so
+ * values of this kind are copied by pointer. Arguments are checked
+ * against the arity before `impl` runs. */
+typedef struct NativeFunction
+{
+    const char *name;
+    NativeImpl impl;
+    int min_args;
+    int max_args;
+} NativeFunction;
+
+#endif
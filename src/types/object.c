@@ -1,17 +1,221 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "interpreter/gc.h"
 #include "types/object.h"
 #include "types/value.h"
+#include "utils/intern.h"
+#include "utils/region.h"
+#include "utils/slab.h"
+#include "utils/utils.h"
+
+static Slab object_slab = SLAB_FOR(Object);
+
+/* From the active region, like the buffers, or else the slab. */
+static Object *object_alloc(void)
+{
+    Object *obj = region_try_alloc(sizeof(Object));
+    return obj ? obj : slab_alloc(&object_slab);
+}
+
+static ObjectBuffer *buffer_alloc(const Object *obj, int capacity)
+{
+    ObjectBuffer *buffer = region_malloc_for(obj, sizeof(ObjectBuffer) + sizeof(Value) * capacity);
+    if (!buffer)
+    {
+        log_error("Out of memory while growing an object");
+        exit(1);
+    }
+    buffer->ref_count = 1;
+    buffer->keys = NULL;
+    buffer->index = NULL;
+    buffer->index_capacity = 0;
+    return buffer;
+}
+
+static void buffer_release(ObjectBuffer *buffer, int count, ValueRelease release)
+{
+    if (!buffer || --buffer->ref_count > 0)
+        return;
+    for (int i = 0; i < count; ++i)
+        release(buffer->values[i]);
+    for (int i = 0; buffer->keys && i < count; ++i)
+        intern_key_release(buffer->keys[i]);
+    free(buffer->keys);
+    free(buffer->index);
+    region_free(buffer);
+}
+
+static void *checked_realloc(void *ptr, size_t size)
+{
+    void *res = realloc(ptr, size);
+    if (!res)
+    {
+        log_error("Out of memory while growing an object");
+        exit(1);
+    }
+    return res;
+}
+
+static void ensure_capacity(Object *obj, int cap)
+{
+    if (obj->capacity >= cap)
+        return;
+    obj->capacity = obj->capacity > 0 ? obj->capacity * 2 : 4;
+    if (obj->capacity < cap)
+        obj->capacity = cap;
+    size_t used = obj->buffer ? sizeof(ObjectBuffer) + sizeof(Value) * obj->count : 0;
+    ObjectBuffer *grown = region_realloc_for(obj, obj->buffer, used, sizeof(ObjectBuffer) + sizeof(Value) * obj->capacity);
+    if (!grown)
+    {
+        log_error("Out of memory while growing an object");
+        exit(1);
+    }
+    if (!obj->buffer)
+    {
+        grown->ref_count = 1;
+        grown->keys = NULL;
+        grown->index = NULL;
+        grown->index_capacity = 0;
+    }
+    obj->buffer = grown;
+    obj->values = grown->values;
+    if (!obj->shape)
+        grown->keys = checked_realloc(grown->keys, sizeof(const char *) * obj->capacity);
+}
+
+/* Give `obj` a private copy of its values before it is written to. */
+static void object_separate(Object *obj)
+{
+    if (!obj->buffer || obj->buffer->ref_count == 1)
+        return;
+    ObjectBuffer *copy = buffer_alloc(obj, obj->capacity);
+    for (int i = 0; i < obj->count; ++i)
+    {
+        copy->values[i] = value_escape(copy, clone_value(&obj->values[i]));
+        /* Copies of nested lists and objects are new containers. */
+        gc_write_barrier(obj, copy->values[i]);
+    }
+    if (!obj->shape)
+    {
+        copy->keys = checked_realloc(NULL, sizeof(const char *) * obj->capacity);
+        memcpy(copy->keys, obj->buffer->keys, sizeof(const char *) * obj->count);
+        for (int i = 0; i < obj->count; ++i)
+            intern_key_retain(copy->keys[i]);
+        copy->index = checked_realloc(NULL, sizeof(int) * obj->buffer->index_capacity);
+        memcpy(copy->index, obj->buffer->index, sizeof(int) * obj->buffer->index_capacity);
+        copy->index_capacity = obj->buffer->index_capacity;
+    }
+    obj->buffer->ref_count--;
+    obj->buffer = copy;
+    obj->values = copy->values;
+}
+
+// ————— HASH INDEX ————— //
+
+static void index_insert(ObjectBuffer *buffer, const char *atom, int slot)
+{
+    int mask = buffer->index_capacity - 1;
+    int i = (int)(intern_hash(atom) & (uint32_t)mask);
+    while (buffer->index[i])
+        i = (i + 1) & mask;
+    buffer->index[i] = slot + 1;
+}
+
+static void index_rebuild(Object *obj, int capacity)
+{
+    ObjectBuffer *buffer = obj->buffer;
+    free(buffer->index);
+    buffer->index = calloc((size_t)capacity, sizeof(int));
+    if (!buffer->index)
+    {
+        log_error("Out of memory while growing an object");
+        exit(1);
+    }
+    buffer->index_capacity = capacity;
+    for (int i = 0; i < obj->count; ++i)
+        index_insert(buffer, buffer->keys[i], i);
+}
+
+static int index_find(const Object *obj, const char *atom)
+{
+    const ObjectBuffer *buffer = obj->buffer;
+    int mask = buffer->index_capacity - 1;
+    int i = (int)(intern_hash(atom) & (uint32_t)mask);
+    for (int entry; (entry = buffer->index[i]); i = (i + 1) & mask)
+    {
+        if (intern_same(buffer->keys[entry - 1], atom))
+            return entry - 1;
+    }
+    return -1;
+}
+
+/* Move the keys of a private `obj` with a buffer out of its shape. */
+static void object_make_indexed(Object *obj)
+{
+    ObjectBuffer *buffer = obj->buffer;
+    buffer->keys = checked_realloc(NULL, sizeof(const char *) * obj->capacity);
+    memcpy(buffer->keys, obj->shape->table->keys, sizeof(const char *) * obj->count);
+    obj->shape = NULL;
+    int capacity = OBJECT_INDEX_THRESHOLD * 2;
+    while (capacity < obj->count * 2)
+        capacity *= 2;
+    index_rebuild(obj, capacity);
+}
+
+int object_find(const Object *obj, const char *atom)
+{
+    return obj->shape ? shape_find(obj->shape, atom) : index_find(obj, atom);
+}
+
+static void object_insert_indexed(Object *obj, const char *atom, Value val)
+{
+    Value copy = clone_value(&val);
+    object_separate(obj);
+    ensure_capacity(obj, obj->count + 1);
+    if (obj->shape)
+        object_make_indexed(obj);
+    ObjectBuffer *buffer = obj->buffer;
+    copy = value_escape(buffer, copy);
+    intern_key_retain(atom);
+    buffer->keys[obj->count] = atom;
+    obj->values[obj->count] = copy;
+    obj->count++;
+    gc_write_barrier(obj, copy);
+    if (obj->count * 2 > buffer->index_capacity)
+        index_rebuild(obj, buffer->index_capacity * 2);
+    else
+        index_insert(buffer, atom, obj->count - 1);
+}
+
+// ————— OBJECTS ————— //
 
 Object *object_create(void)
 {
-    Object *obj = malloc(sizeof(Object));
+    Object *obj = object_alloc();
     if (!obj)
         return NULL;
+    obj->shape = shape_root();
     obj->count = 0;
     obj->capacity = 0;
-    obj->pairs = NULL;
+    obj->values = NULL;
+    obj->buffer = NULL;
+    obj->ref_count = 1;
+    return obj;
+}
+
+Object *object_create_shaped(Shape *shape)
+{
+    Object *obj = object_create();
+    if (!obj)
+        return NULL;
+    ensure_capacity(obj, shape->key_count);
+    for (int i = 0; i < shape->key_count; ++i)
+        obj->values[i] = NULL_VAL;
+    obj->shape = shape;
+    obj->count = shape->key_count;
+    if (obj->count > OBJECT_INDEX_THRESHOLD)
+        object_make_indexed(obj);
     return obj;
 }
 
@@ -20,79 +224,144 @@ Object *clone_object(const Object *src)
     if (!src)
         return NULL;
 
-    Object *copy = malloc(sizeof(Object));
+    Object *copy = object_alloc();
     if (!copy)
         return NULL;
 
-    copy->count = src->count;
-    copy->capacity = src->capacity;
-    copy->pairs = malloc(sizeof(KeyValuePair) * copy->capacity);
-    if (!copy->pairs)
-    {
-        free(copy);
-        return NULL;
-    }
+    *copy = *src;
+    copy->ref_count = 1;
+    if (copy->buffer)
+        copy->buffer->ref_count++;
+    return copy;
+}
 
-    for (int i = 0; i < src->count; ++i)
-    {
-        copy->pairs[i].key = strdup(src->pairs[i].key);
-        copy->pairs[i].value = clone_value(&src->pairs[i].value);
-    }
+Object *object_create_heap(void)
+{
+    Region *active = region_active;
+    region_activate(NULL);
+    Object *obj = object_create();
+    region_activate(active);
+    return obj;
+}
 
+Object *object_copy(const Object *src)
+{
+    Object *copy = clone_object(src);
+    if (copy)
+        object_separate(copy);
     return copy;
 }
 
 void free_object(Object *obj)
 {
-    if (!obj)
+    free_object_with(obj, free_value);
+}
+
+void free_object_with(Object *obj, ValueRelease release)
+{
+    if (!obj || --obj->ref_count > 0)
         return;
 
-    for (int i = 0; i < obj->count; ++i)
-    {
-        free(obj->pairs[i].key);
-        free_value(obj->pairs[i].value);
-    }
+    buffer_release(obj->buffer, obj->count, release);
+    gc_forget(obj);
+    if (!region_try_free(obj))
+        slab_free(&object_slab, obj);
+}
+
+const char *object_key(const Object *obj, int index)
+{
+    return obj->shape ? obj->shape->table->keys[index] : obj->buffer->keys[index];
+}
+
+Value object_get_atom(Object *obj, const char *atom)
+{
+    int slot = object_find(obj, atom);
+    if (slot < 0)
+        return NULL_VAL;
+    return object_get_slot(obj, slot);
+}
 
-    free(obj->pairs);
-    free(obj);
+Value object_get_slot(Object *obj, int slot)
+{
+    /* The result is borrowed and callers may write through it
+       (`a.b.c = 1`, `a.items.append(x)`), so a nested list or object must
+       not live in a buffer other objects still see. */
+    if (IS_LIST(obj->values[slot]) || IS_OBJECT(obj->values[slot]))
+        object_separate(obj);
+    return obj->values[slot];
 }
 
 // Optional: Get value for a key
 Value object_get(Object *obj, const char *key)
 {
-    for (int i = 0; i < obj->count; ++i)
+    const char *atom = intern_find(key);
+    if (atom)
+        return object_get_atom(obj, atom);
+    /* Only a dictionary-mode object can hold a key nobody interned. */
+    if (obj->shape)
+        return NULL_VAL;
+    const char *loose = intern_key(key, strlen(key));
+    int slot = index_find(obj, loose);
+    intern_key_release(loose);
+    return slot >= 0 ? object_get_slot(obj, slot) : NULL_VAL;
+}
+
+void object_set_slot(Object *obj, int slot, Value val)
+{
+    /* Clone first: `val` may be borrowed from this object's own buffer. */
+    Value copy = clone_value(&val);
+    object_separate(obj);
+    copy = value_escape(obj->buffer, copy);
+    free_value(obj->values[slot]);
+    obj->values[slot] = copy;
+    gc_write_barrier(obj, copy);
+}
+
+void object_set_atom(Object *obj, const char *atom, Value val)
+{
+    int slot = object_find(obj, atom);
+    if (slot >= 0)
+        object_set_slot(obj, slot, val);
+    else
     {
-        if (strcmp(obj->pairs[i].key, key) == 0)
-        {
-            return obj->pairs[i].value;
-        }
+        Shape *next = obj->shape && obj->count < OBJECT_INDEX_THRESHOLD ? shape_extend(obj->shape, atom) : NULL;
+        if (next)
+            object_append(obj, next, val);
+        else
+            object_insert_indexed(obj, atom, val);
     }
+}
 
-    Value v = {.type = VAL_NULL};
-    return v;
+void object_append(Object *obj, Shape *next, Value val)
+{
+    Value copy = clone_value(&val);
+    object_separate(obj);
+    ensure_capacity(obj, obj->count + 1);
+    copy = value_escape(obj->buffer, copy);
+    obj->shape = next;
+    obj->values[obj->count++] = copy;
+    gc_write_barrier(obj, copy);
 }
 
 // Optional: Insert or update key
 void object_set(Object *obj, const char *key, Value val)
 {
-    for (int i = 0; i < obj->count; ++i)
-    {
-        if (strcmp(obj->pairs[i].key, key) == 0)
-        {
-            free_value(obj->pairs[i].value);
-            obj->pairs[i].value = clone_value(&val);
-            return;
-        }
-    }
+    object_set_atom(obj, intern(key), val);
+}
 
-    // Resize if needed
-    if (obj->count >= obj->capacity)
+void object_set_key(Object *obj, const char *key, size_t length, Value val)
+{
+    const char *loose = intern_key(key, length);
+    if (!intern_is_loose(loose))
     {
-        obj->capacity = obj->capacity > 0 ? obj->capacity * 2 : 4;
-        obj->pairs = realloc(obj->pairs, sizeof(KeyValuePair) * obj->capacity);
+        object_set_atom(obj, loose, val);
+        return;
     }
-
-    obj->pairs[obj->count].key = strdup(key);
-    obj->pairs[obj->count].value = clone_value(&val);
-    obj->count++;
+    /* No shape holds a key nobody interned. */
+    int slot = obj->shape ? -1 : index_find(obj, loose);
+    if (slot >= 0)
+        object_set_slot(obj, slot, val);
+    else
+        object_insert_indexed(obj, loose, val);
+    intern_key_release(loose);
 }
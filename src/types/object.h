@@ -2,27 +2,74 @@
 #define OBJECT_H
 
 #include "value.h"
+#include "types/shape.h"
 
-// ————— STRUCT FOR OBJECT PAIR ————— //
-typedef struct
+// ————— OBJECT STRUCT ————— //
+/* Objects with more keys than this, or whose next key would need a shape
+   with too many children (SHAPE_MAX_TRANSITIONS), leave the shape tree for
+   dictionary mode: keys are looked up through a hash index instead (JSON
+   documents, dict() used as a map). */
+#define OBJECT_INDEX_THRESHOLD 16
+
+/* Value storage, shared copy-on-write between clones like ListBuffer.
+   `keys` and `index` are only used by objects without a shape; `keys`
+   holds a reference to each loose key in it. */
+typedef struct ObjectBuffer
 {
-    char *key;
-    Value value;
-} KeyValuePair;
+    int ref_count;
+    const char **keys;  // keys[i] names values[i], in insertion order
+    int *index;         // open addressing, slot + 1 per entry, 0 if empty
+    int index_capacity; // a power of two, at least twice count
+    Value values[];
+} ObjectBuffer;
 
-// ————— OBJECT STRUCT ————— //
+/* Keys live in the shared `shape`, or in the buffer once the object is in
+   dictionary mode (shape is then NULL); values[i]
+   belongs to key i either way. `ref_count` counts holders of this very
+   object, like List's. */
 typedef struct Object
 {
+    Shape *shape;
     int count;
     int capacity;
-    KeyValuePair *pairs;
+    Value *values; // buffer->values, NULL while empty
+    ObjectBuffer *buffer;
+    int ref_count;
 } Object;
 
 // ————— FUNCTIONS ————— //
 Object *object_create(void);
+/* An object already carrying every key of `shape`, each set to null. */
+Object *object_create_shaped(Shape *shape);
 Object *clone_object(const Object *src);
+/* object_create, but never region memory: for the attributes of instances,
+   functions and types, which are not region memory themselves. */
+Object *object_create_heap(void);
+/* Like clone_object, but with a buffer of its own rather than a shared one. */
+Object *object_copy(const Object *src);
+/* Drop a reference to `obj`, freeing it after the last one. */
 void free_object(Object *obj);
+/* free_object, releasing the values with `release` if this was the last
+   reference to them. */
+void free_object_with(Object *obj, ValueRelease release);
+const char *object_key(const Object *obj, int index);
 Value object_get(Object *obj, const char *key);           // Optional helper
 void object_set(Object *obj, const char *key, Value val); // Optional helper
+/* object_set for keys that come from data (JSON, HTTP headers): a key that
+   is not interned yet is stored as a loose key (see utils/intern.h), in
+   dictionary mode, instead of growing the intern table and shape tree. */
+void object_set_key(Object *obj, const char *key, size_t length, Value val);
+// Variants for keys that are already interned (see utils/intern.h)
+Value object_get_atom(Object *obj, const char *atom);
+void object_set_atom(Object *obj, const char *atom, Value val);
+/* Slot holding `atom`, or -1. */
+int object_find(const Object *obj, const char *atom);
+/* Slot-level access for callers that already resolved a key against
+   obj->shape (compiled object literals, attribute inline caches). */
+Value object_get_slot(Object *obj, int slot);
+void object_set_slot(Object *obj, int slot, Value val);
+/* Add a key whose transition from obj->shape (not NULL) is already known
+   to be `next`. */
+void object_append(Object *obj, Shape *next, Value val);
 
 #endif
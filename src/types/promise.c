@@ -2,8 +2,11 @@
 
 #include "types/promise.h"
 #include "types/object.h"
+#include "utils/slab.h"
 
 static Type *PROMISE_NAMESPACE = NULL;
+static Slab promise_slab = SLAB_FOR(Promise);
+static Slab task_slab = SLAB_FOR(AsyncTask);
 
 static void ensure_promise_namespace(void)
 {
@@ -25,23 +28,24 @@ bool promise_type_is_namespace(Type *type)
 Value promise_namespace_value(void)
 {
     ensure_promise_namespace();
-    Value v = {.type = VAL_TYPE, .cls = PROMISE_NAMESPACE};
+    Value v = TYPE_VAL(PROMISE_NAMESPACE);
     return v;
 }
 
 bool promise_value_is_namespace(Value value)
 {
-    return value.type == VAL_TYPE && promise_type_is_namespace(value.cls);
+    return IS_TYPE(value) && promise_type_is_namespace(AS_TYPE(value));
 }
 
 Promise *promise_create(void)
 {
-    Promise *promise = malloc(sizeof(Promise));
+    Promise *promise = slab_alloc(&promise_slab);
     promise->ref_count = 1;
     promise->state = PROMISE_PENDING;
-    promise->result.type = VAL_UNDEFINED;
-    promise->reason.type = VAL_UNDEFINED;
+    promise->result = UNDEFINED_VAL;
+    promise->reason = UNDEFINED_VAL;
     promise->task = NULL;
+    gc_track(&promise->gc, GC_PROMISE);
     return promise;
 }
 
@@ -59,6 +63,13 @@ void promise_attach_task(Promise *promise, AsyncTask *task)
     if (promise->task)
         async_task_free(promise->task);
     promise->task = task;
+    if (task)
+    {
+        gc_write_barrier(promise, FUNCTION_VAL(task->fn));
+        for (int i = 0; i < task->arg_count; ++i)
+            gc_write_barrier(promise, task->args[i]);
+        gc_write_barrier(promise, task->self);
+    }
 }
 
 AsyncTask *promise_take_task(Promise *promise)
@@ -81,37 +92,39 @@ void promise_resolve(Promise *promise, Value value)
 {
     if (!promise)
         return;
-    if (promise->result.type != VAL_UNDEFINED)
+    if (!IS_UNDEFINED(promise->result))
         free_value(promise->result);
-    if (promise->reason.type != VAL_UNDEFINED)
+    if (!IS_UNDEFINED(promise->reason))
     {
         free_value(promise->reason);
-        promise->reason.type = VAL_UNDEFINED;
+        promise->reason = UNDEFINED_VAL;
     }
-    promise->result = clone_value(&value);
+    promise->result = value_escape(promise, clone_value(&value));
     promise->state = PROMISE_FULFILLED;
+    gc_write_barrier(promise, promise->result);
 }
 
 void promise_reject(Promise *promise, Value reason)
 {
     if (!promise)
         return;
-    if (promise->reason.type != VAL_UNDEFINED)
+    if (!IS_UNDEFINED(promise->reason))
         free_value(promise->reason);
-    if (promise->result.type != VAL_UNDEFINED)
+    if (!IS_UNDEFINED(promise->result))
     {
         free_value(promise->result);
-        promise->result.type = VAL_UNDEFINED;
+        promise->result = UNDEFINED_VAL;
     }
-    promise->reason = clone_value(&reason);
+    promise->reason = value_escape(promise, clone_value(&reason));
     promise->state = PROMISE_REJECTED;
+    gc_write_barrier(promise, promise->reason);
 }
 
 Value promise_clone_result(const Promise *promise)
 {
     if (!promise || promise->state != PROMISE_FULFILLED)
     {
-        Value undef = {.type = VAL_UNDEFINED};
+        Value undef = UNDEFINED_VAL;
         return undef;
     }
     return clone_value(&promise->result);
@@ -121,7 +134,7 @@ Value promise_clone_reason(const Promise *promise)
 {
     if (!promise || promise->state != PROMISE_REJECTED)
     {
-        Value undef = {.type = VAL_UNDEFINED};
+        Value undef = UNDEFINED_VAL;
         return undef;
     }
     return clone_value(&promise->reason);
@@ -139,18 +152,39 @@ void promise_release(Promise *promise)
         return;
     if (--promise->ref_count > 0)
         return;
-    if (promise->result.type != VAL_UNDEFINED)
-        free_value(promise->result);
-    if (promise->reason.type != VAL_UNDEFINED)
-        free_value(promise->reason);
-    if (promise->task)
-        async_task_free(promise->task);
-    free(promise);
+    promise_destroy(promise, free_value);
+}
+
+static void task_free(AsyncTask *task, ValueRelease release)
+{
+    if (!task)
+        return;
+    if (task->args)
+    {
+        for (int i = 0; i < task->arg_count; ++i)
+            release(task->args[i]);
+        free(task->args);
+    }
+    if (task->has_self && !IS_UNDEFINED(task->self))
+        release(task->self);
+    slab_free(&task_slab, task);
+}
+
+void promise_destroy(Promise *promise, ValueRelease release)
+{
+    gc_untrack(&promise->gc);
+    if (!IS_UNDEFINED(promise->result))
+        release(promise->result);
+    if (!IS_UNDEFINED(promise->reason))
+        release(promise->reason);
+    task_free(promise->task, release);
+    gc_forget(promise);
+    slab_free(&promise_slab, promise);
 }
 
 AsyncTask *async_task_create(Function *fn, Value *args, int arg_count, bool has_self, Value self, int line, int column)
 {
-    AsyncTask *task = malloc(sizeof(AsyncTask));
+    AsyncTask *task = slab_alloc(&task_slab);
     task->fn = fn;
     task->arg_count = arg_count;
     task->args = NULL;
@@ -164,7 +198,7 @@ AsyncTask *async_task_create(Function *fn, Value *args, int arg_count, bool has_
     if (has_self)
         task->self = clone_value(&self);
     else
-        task->self.type = VAL_UNDEFINED;
+        task->self = UNDEFINED_VAL;
     task->line = line;
     task->column = column;
     return task;
@@ -172,15 +206,5 @@ AsyncTask *async_task_create(Function *fn, Value *args, int arg_count, bool has_
 
 void async_task_free(AsyncTask *task)
 {
-    if (!task)
-        return;
-    if (task->args)
-    {
-        for (int i = 0; i < task->arg_count; ++i)
-            free_value(task->args[i]);
-        free(task->args);
-    }
-    if (task->has_self && task->self.type != VAL_UNDEFINED)
-        free_value(task->self);
-    free(task);
+    task_free(task, free_value);
 }
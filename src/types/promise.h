@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 
+#include "interpreter/gc.h"
 #include "types/value.h"
 #include "types/function.h"
 #include "types/type.h"
@@ -27,6 +28,7 @@ typedef struct AsyncTask
 
 typedef struct Promise
 {
+    GcObject gc;
     int ref_count;
     PromiseState state;
     Value result;
@@ -45,6 +47,8 @@ Value promise_clone_result(const Promise *promise);
 Value promise_clone_reason(const Promise *promise);
 void promise_retain(Promise *promise);
 void promise_release(Promise *promise);
+/* Free `promise` whatever its count, releasing what it holds with `release`. */
+void promise_destroy(Promise *promise, ValueRelease release);
 
 AsyncTask *async_task_create(Function *fn, Value *args, int arg_count, bool has_self, Value self, int line, int column);
 void async_task_free(AsyncTask *task);
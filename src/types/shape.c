@@ -0,0 +1,189 @@
+#include <stdlib.h>
+
+#include "types/shape.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+static Shape *root = NULL;
+
+static void *checked_realloc(void *ptr, size_t size)
+{
+    void *res = realloc(ptr, size);
+    if (!res)
+    {
+        log_error("Out of memory while creating an object shape");
+        exit(1);
+    }
+    return res;
+}
+
+static Shape *shape_new(Shape *parent, ShapeTable *table, bool owns_table, int key_count)
+{
+    Shape *shape = checked_realloc(NULL, sizeof(Shape));
+    shape->parent = parent;
+    shape->table = table;
+    shape->owns_table = owns_table;
+    shape->key_count = key_count;
+    shape->transitions = NULL;
+    shape->transition_count = 0;
+    shape->transition_capacity = 0;
+    shape->transition_index = NULL;
+    shape->transition_index_capacity = 0;
+    return shape;
+}
+
+static void table_append(ShapeTable *table, const char *atom)
+{
+    if (table->count == table->capacity)
+    {
+        table->capacity = table->capacity ? table->capacity * 2 : 4;
+        table->keys = checked_realloc(table->keys, sizeof(const char *) * table->capacity);
+    }
+    table->keys[table->count++] = atom;
+}
+
+Shape *shape_root(void)
+{
+    if (!root)
+    {
+        ShapeTable *table = checked_realloc(NULL, sizeof(ShapeTable));
+        table->keys = NULL;
+        table->count = 0;
+        table->capacity = 0;
+        root = shape_new(NULL, table, true, 0);
+    }
+    return root;
+}
+
+static const char *last_key(const Shape *shape)
+{
+    return shape->table->keys[shape->key_count - 1];
+}
+
+static Shape *find_transition(const Shape *shape, const char *atom)
+{
+    if (shape->transition_index)
+    {
+        int mask = shape->transition_index_capacity - 1;
+        for (int i = (int)(intern_hash(atom) & (uint32_t)mask); shape->transition_index[i]; i = (i + 1) & mask)
+        {
+            if (last_key(shape->transition_index[i]) == atom)
+                return shape->transition_index[i];
+        }
+        return NULL;
+    }
+    for (int i = 0; i < shape->transition_count; ++i)
+    {
+        Shape *next = shape->transitions[i];
+        if (last_key(next) == atom)
+            return next;
+    }
+    return NULL;
+}
+
+static void index_transition(Shape *shape, Shape *next)
+{
+    int mask = shape->transition_index_capacity - 1;
+    int i = (int)(intern_hash(last_key(next)) & (uint32_t)mask);
+    while (shape->transition_index[i])
+        i = (i + 1) & mask;
+    shape->transition_index[i] = next;
+}
+
+static void add_transition(Shape *shape, Shape *next)
+{
+    if (shape->transition_count == shape->transition_capacity)
+    {
+        shape->transition_capacity = shape->transition_capacity ? shape->transition_capacity * 2 : 2;
+        shape->transitions = checked_realloc(shape->transitions, sizeof(Shape *) * shape->transition_capacity);
+    }
+    shape->transitions[shape->transition_count++] = next;
+    if (shape->transition_count <= SHAPE_LINEAR_TRANSITIONS)
+        return;
+    if (shape->transition_count * 2 <= shape->transition_index_capacity)
+    {
+        index_transition(shape, next);
+        return;
+    }
+
+    free(shape->transition_index);
+    shape->transition_index_capacity = shape->transition_index_capacity ? shape->transition_index_capacity * 2
+                                                                         : SHAPE_LINEAR_TRANSITIONS * 4;
+    shape->transition_index = calloc((size_t)shape->transition_index_capacity, sizeof(Shape *));
+    if (!shape->transition_index)
+    {
+        log_error("Out of memory while creating an object shape");
+        exit(1);
+    }
+    for (int i = 0; i < shape->transition_count; ++i)
+        index_transition(shape, shape->transitions[i]);
+}
+
+static Shape *shape_child(Shape *shape, const char *atom)
+{
+    ShapeTable *table = shape->table;
+    bool owns_table = false;
+    if (table->count != shape->key_count)
+    {
+        /* Another child already extended the shared table; copy our prefix. */
+        ShapeTable *copy = checked_realloc(NULL, sizeof(ShapeTable));
+        copy->keys = NULL;
+        copy->count = 0;
+        copy->capacity = 0;
+        for (int i = 0; i < shape->key_count; ++i)
+            table_append(copy, table->keys[i]);
+        table = copy;
+        owns_table = true;
+    }
+    table_append(table, atom);
+
+    Shape *next = shape_new(shape, table, owns_table, shape->key_count + 1);
+    add_transition(shape, next);
+    return next;
+}
+
+Shape *shape_add(Shape *shape, const char *atom)
+{
+    Shape *next = find_transition(shape, atom);
+    return next ? next : shape_child(shape, atom);
+}
+
+Shape *shape_extend(Shape *shape, const char *atom)
+{
+    Shape *next = find_transition(shape, atom);
+    if (next || shape->transition_count >= SHAPE_MAX_TRANSITIONS)
+        return next;
+    return shape_child(shape, atom);
+}
+
+int shape_find(const Shape *shape, const char *atom)
+{
+    const char **keys = shape->table->keys;
+    for (int i = 0; i < shape->key_count; ++i)
+    {
+        if (keys[i] == atom)
+            return i;
+    }
+    return -1;
+}
+
+static void shape_free(Shape *shape)
+{
+    for (int i = 0; i < shape->transition_count; ++i)
+        shape_free(shape->transitions[i]);
+    free(shape->transitions);
+    free(shape->transition_index);
+    if (shape->owns_table)
+    {
+        free(shape->table->keys);
+        free(shape->table);
+    }
+    free(shape);
+}
+
+void shape_cleanup(void)
+{
+    if (root)
+        shape_free(root);
+    root = NULL;
+}
@@ -0,0 +1,55 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <stdbool.h>
+
+/*
+ * Hidden classes for objects. A shape is an ordered list of interned keys;
+ * an object stores only its shape and a dense array of values, with key i
+ * living in slot i. Objects that receive the same keys in the same order
+ * walk the same transitions from the empty root shape and so share one
+ * shape. Shapes are immutable and live until shape_cleanup() at exit.
+ */
+
+/* Children a shape scans linearly before it indexes them by key hash. */
+#define SHAPE_LINEAR_TRANSITIONS 8
+/* Children shape_extend gives a shape for keys added at run time; past
+   this, objects keep further keys in dictionary mode instead (see
+   object.h), so data with unbounded keys cannot grow the tree forever. */
+#define SHAPE_MAX_TRANSITIONS 128
+
+/* Key storage shared along a chain of shapes: a child that extends the
+   last key of its parent appends here instead of copying the prefix. */
+typedef struct ShapeTable
+{
+    const char **keys;
+    int count;
+    int capacity;
+} ShapeTable;
+
+typedef struct Shape
+{
+    struct Shape *parent;
+    ShapeTable *table; // keys[0..key_count) are this shape's keys
+    bool owns_table;
+    int key_count;
+    struct Shape **transitions;
+    int transition_count;
+    int transition_capacity;
+    /* Open addressing by the hash of each child's last key, a power of two
+       at least twice transition_count; NULL up to SHAPE_LINEAR_TRANSITIONS. */
+    struct Shape **transition_index;
+    int transition_index_capacity;
+} Shape;
+
+Shape *shape_root(void);
+/* The shape reached by appending `atom`, created on first use. */
+Shape *shape_add(Shape *shape, const char *atom);
+/* shape_add for keys that come from data rather than code: NULL if the
+   transition is new and `shape` already has SHAPE_MAX_TRANSITIONS. */
+Shape *shape_extend(Shape *shape, const char *atom);
+/* Slot index of `atom` in `shape`, or -1. */
+int shape_find(const Shape *shape, const char *atom);
+void shape_cleanup(void);
+
+#endif
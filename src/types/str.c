@@ -0,0 +1,104 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "interpreter/gc.h"
+#include "types/str.h"
+#include "utils/region.h"
+#include "utils/utils.h"
+
+static StringHeader *header_of(const char *str)
+{
+    return (StringHeader *)(str - offsetof(StringHeader, chars));
+}
+
+char *string_alloc(size_t length)
+{
+    StringHeader *header = region_malloc(sizeof(StringHeader) + length + 1);
+    if (!header)
+    {
+        log_error("Out of memory while allocating a string");
+        exit(1);
+    }
+    header->ref_count = 1;
+    header->hash = 0;
+    header->length = length;
+    header->chars[length] = '\0';
+    return header->chars;
+}
+
+char *string_new(const char *chars, size_t length)
+{
+    char *str = string_alloc(length);
+    if (length > 0)
+        memcpy(str, chars, length);
+    return str;
+}
+
+char *string_from(const char *text)
+{
+    if (!text)
+        text = "";
+    return string_new(text, strlen(text));
+}
+
+char *string_retain(char *str)
+{
+    if (str)
+        header_of(str)->ref_count++;
+    return str;
+}
+
+void string_release(char *str)
+{
+    if (!str)
+        return;
+    StringHeader *header = header_of(str);
+    if (--header->ref_count == 0)
+    {
+        gc_forget(str);
+        region_free(header);
+    }
+}
+
+size_t string_length(const char *str)
+{
+    return str ? header_of(str)->length : 0;
+}
+
+uint32_t string_hash(const char *str)
+{
+    if (!str)
+        return 0;
+    StringHeader *header = header_of(str);
+    if (header->hash == 0)
+    {
+        uint32_t hash = hash_bytes(header->chars, header->length);
+        header->hash = hash ? hash : 1;
+    }
+    return header->hash;
+}
+
+bool string_equals(const char *a, const char *b)
+{
+    if (a == b)
+        return true;
+    if (!a || !b)
+        return false;
+    StringHeader *ha = header_of(a);
+    StringHeader *hb = header_of(b);
+    if (ha->length != hb->length)
+        return false;
+    if (ha->hash && hb->hash && ha->hash != hb->hash)
+        return false;
+    return memcmp(a, b, ha->length) == 0;
+}
+
+int string_compare(const char *a, const char *b)
+{
+    size_t la = string_length(a);
+    size_t lb = string_length(b);
+    int c = memcmp(a, b, la < lb ? la : lb);
+    if (c != 0)
+        return c;
+    return la < lb ? -1 : la > lb ? 1 : 0;
+}
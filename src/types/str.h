@@ -0,0 +1,34 @@
+#ifndef STR_H
+#define STR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * String values. `Value.str` points at `chars` inside a StringHeader, so
+ * the text stays NUL-terminated for C APIs while the header keeps its
+ * length (strings may contain NUL bytes), a lazily computed hash and a
+ * reference count. Header and characters share a single allocation.
+ * Strings are immutable once created; clones share them.
+ */
+typedef struct StringHeader
+{
+    int ref_count;
+    uint32_t hash; // 0 until first requested
+    size_t length;
+    char chars[];
+} StringHeader;
+
+/* Allocate an uninitialised string of `length` bytes for the caller to fill. */
+char *string_alloc(size_t length);
+char *string_new(const char *chars, size_t length);
+char *string_from(const char *text);
+char *string_retain(char *str);
+void string_release(char *str);
+size_t string_length(const char *str);
+uint32_t string_hash(const char *str);
+bool string_equals(const char *a, const char *b);
+int string_compare(const char *a, const char *b);
+
+#endif
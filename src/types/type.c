@@ -2,20 +2,26 @@
 #include <string.h>
 
 #include "types/type.h"
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+unsigned type_epoch = 0;
 
 Type *type_create(const char *name) {
     Type *t = malloc(sizeof(Type));
     t->name = name ? strdup(name) : NULL;
     t->bases = NULL;
     t->base_count = 0;
-    t->attributes = malloc(sizeof(Object));
-    t->attributes->count = 0;
-    t->attributes->capacity = 0;
-    t->attributes->pairs = NULL;
+    t->attributes = object_create_heap();
+    t->method_cache = NULL;
+    t->method_cache_count = 0;
+    t->method_cache_capacity = 0;
+    t->method_cache_epoch = type_epoch;
     return t;
 }
 
 void type_set_bases(Type *t, Type **bases, int base_count) {
+    type_epoch++;
     t->bases = bases;
     t->base_count = base_count;
 }
@@ -23,8 +29,79 @@ void type_set_bases(Type *t, Type **bases, int base_count) {
 void type_free(Type *type) {
     if (!type)
         return;
+    type_epoch++;
     free(type->name);
     free(type->bases);
     free_object(type->attributes);
+    free(type->method_cache);
     free(type);
 }
+
+/* Find the first non-null `atom` along `t` and its bases. A stored
+   undefined hides the name from the rest of that branch. */
+static bool type_resolve(Type *t, const char *atom, Type **owner, int *slot) {
+    int found = object_find(t->attributes, atom);
+    if (found >= 0) {
+        Value v = t->attributes->values[found];
+        if (IS_UNDEFINED(v))
+            return false;
+        if (!IS_NULL(v)) {
+            *owner = t;
+            *slot = found;
+            return true;
+        }
+    }
+    for (int i = 0; i < t->base_count; ++i) {
+        if (type_resolve(t->bases[i], atom, owner, slot))
+            return true;
+    }
+    return false;
+}
+
+static MethodCacheEntry *cache_probe(Type *t, const char *atom) {
+    int mask = t->method_cache_capacity - 1;
+    int i = (int)(intern_hash(atom) & (uint32_t)mask);
+    while (t->method_cache[i].atom && t->method_cache[i].atom != atom)
+        i = (i + 1) & mask;
+    return &t->method_cache[i];
+}
+
+static void cache_grow(Type *t) {
+    MethodCacheEntry *old = t->method_cache;
+    int old_capacity = t->method_cache_capacity;
+    t->method_cache_capacity = old_capacity ? old_capacity * 2 : 8;
+    t->method_cache = calloc((size_t)t->method_cache_capacity, sizeof(MethodCacheEntry));
+    if (!t->method_cache) {
+        log_error("Out of memory while caching a method lookup");
+        exit(1);
+    }
+    for (int i = 0; i < old_capacity; ++i) {
+        if (old[i].atom)
+            *cache_probe(t, old[i].atom) = old[i];
+    }
+    free(old);
+}
+
+Value type_lookup(Type *t, const char *atom) {
+    if (t->method_cache_epoch != type_epoch) {
+        if (t->method_cache)
+            memset(t->method_cache, 0, sizeof(MethodCacheEntry) * t->method_cache_capacity);
+        t->method_cache_count = 0;
+        t->method_cache_epoch = type_epoch;
+    }
+    if ((t->method_cache_count + 1) * 2 > t->method_cache_capacity)
+        cache_grow(t);
+
+    MethodCacheEntry *entry = cache_probe(t, atom);
+    if (!entry->atom) {
+        entry->atom = atom;
+        entry->owner = NULL;
+        type_resolve(t, atom, &entry->owner, &entry->slot);
+        t->method_cache_count++;
+    }
+    if (!entry->owner) {
+        Value undef = UNDEFINED_VAL;
+        return undef;
+    }
+    return object_get_slot(entry->owner->attributes, entry->slot);
+}
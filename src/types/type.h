@@ -3,15 +3,34 @@
 
 #include "types/object.h"
 
+/* Where a name resolved to along a type's bases: slot `slot` of
+   owner->attributes, or nowhere when owner is NULL. */
+typedef struct MethodCacheEntry {
+    const char *atom;
+    struct Type *owner;
+    int slot;
+} MethodCacheEntry;
+
 typedef struct Type {
     char *name;
     struct Type **bases;
     int base_count;
     Object *attributes;
+    MethodCacheEntry *method_cache; // open addressing, valid for method_cache_epoch
+    int method_cache_count;
+    int method_cache_capacity;
+    unsigned method_cache_epoch;
 } Type;
 
+/* Bumped whenever any class gains, loses or changes an attribute or its
+   bases, so caches of inherited lookups know to revalidate. */
+extern unsigned type_epoch;
+
 Type *type_create(const char *name);
 void type_set_bases(Type *t, Type **bases, int base_count);
 void type_free(Type *type);
+/* Look `atom` up on `t` and then its bases, depth first, skipping null
+   values. Returns undefined when nothing matches. */
+Value type_lookup(Type *t, const char *atom);
 
 #endif
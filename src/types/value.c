@@ -9,6 +9,10 @@
 #include "types/list.h"
 #include "types/instance.h"
 #include "types/promise.h"
+#include "types/native.h"
+#include "types/str.h"
+#include "utils/slab.h"
+#include "utils/utils.h"
 
 static const char *TYPE_NAMES[VAL_TYPE_COUNT] = {
     "UNDEFINED",
@@ -22,7 +26,8 @@ static const char *TYPE_NAMES[VAL_TYPE_COUNT] = {
     "TYPE",
     "INSTANCE",
     "BOUND_METHOD",
-    "PROMISE"
+    "PROMISE",
+    "FUNCTION"
 };
 
 const char *value_type_name(ValueType type)
@@ -32,118 +37,190 @@ const char *value_type_name(ValueType type)
     return TYPE_NAMES[type];
 }
 
+/* Integers too wide to inline get a cell of their own. A cell is never
+   written once made, so clones share it and count their references. */
+typedef struct Int64Box
+{
+    int64_t value; // first, so AS_INT64_BOX points at it
+    int ref_count;
+} Int64Box;
+
+static Slab int64_box_slab = SLAB_FOR(Int64Box);
+
+Value value_box_int(int64_t i)
+{
+    Int64Box *box = slab_alloc(&int64_box_slab);
+    box->value = i;
+    box->ref_count = 1;
+    return VALUE_FROM_SUBTAG(VALUE_SUBTAG_INT64, box);
+}
+
 void free_value(Value v)
 {
-    switch (v.type)
+    switch (value_type(v))
     {
     case VAL_STRING:
-        free(v.str);
+        string_release(AS_STRING(v));
         break;
     case VAL_OBJECT:
-        free_object(v.obj);
+        free_object(AS_OBJECT(v));
         break;
     case VAL_LIST:
-        free_list(v.list);
+        free_list(AS_LIST(v));
         break;
     case VAL_FUNCTION:
-        /* functions are freed as part of AST cleanup */
+        /* Closures are freed by the collector (gc.c); prototypes are
+           chunk constants and live as long as the program. */
         break;
     case VAL_TYPE:
         break;
     case VAL_INSTANCE:
-        instance_release(v.instance);
+        instance_release(AS_INSTANCE(v));
         break;
     case VAL_BOUND_METHOD:
-        free(v.bound);
+        bound_method_release(AS_BOUND_METHOD(v));
         break;
     case VAL_PROMISE:
-        promise_release(v.promise);
+        promise_release(AS_PROMISE(v));
+        break;
+    case VAL_NUMBER:
+        if (IS_INT64_BOX(v))
+        {
+            Int64Box *box = (Int64Box *)AS_INT64_BOX(v);
+            if (--box->ref_count > 0)
+                break;
+            gc_forget(box);
+            slab_free(&int64_box_slab, box);
+        }
         break;
     case VAL_BOOL:
         break;
     default:
-        // VAL_NUMBER, VAL_NULL, VAL_UNDEFINED don't need manual freeing
+        // VAL_NULL, VAL_UNDEFINED don't need manual freeing
         break;
     }
 }
 
 Value clone_value(const Value *src)
 {
-    Value copy;
-    copy.type = src->type;
-
-    switch (src->type)
+    switch (value_type(*src))
     {
-    case VAL_STRING:
-        copy.str = src->str ? strdup(src->str) : NULL;
-        break;
     case VAL_NUMBER:
-        copy.num = src->num;
-        break;
+        if (IS_INT64_BOX(*src))
+            ((Int64Box *)AS_INT64_BOX(*src))->ref_count++;
+        return *src;
+    case VAL_STRING:
+        return STRING_VAL(string_retain(AS_STRING(*src)));
     case VAL_OBJECT:
-        copy.obj = clone_object(src->obj);
-        break;
-    case VAL_FUNCTION:
-        copy.func = src->func;
-        break;
+        return OBJECT_VAL(clone_object(AS_OBJECT(*src)));
     case VAL_LIST:
-        copy.list = clone_list(src->list);
-        break;
-    case VAL_TYPE:
-        copy.cls = src->cls;
-        break;
+        return LIST_VAL(clone_list(AS_LIST(*src)));
     case VAL_INSTANCE:
-        copy.instance = src->instance;
-        instance_retain(copy.instance);
-        break;
+        instance_retain(AS_INSTANCE(*src));
+        return *src;
     case VAL_BOUND_METHOD:
-        if (src->bound) {
-            BoundMethod *bm = malloc(sizeof(BoundMethod));
-            bm->self = src->bound->self;
-            bm->func = src->bound->func;
-            copy.bound = bm;
-        } else {
-            copy.bound = NULL;
-        }
-        break;
+        return BOUND_METHOD_VAL(bound_method_retain(AS_BOUND_METHOD(*src)));
     case VAL_PROMISE:
-        copy.promise = src->promise;
-        promise_retain(copy.promise);
-        break;
-    case VAL_BOOL:
-        copy.boolean = src->boolean;
-        break;
-    case VAL_NULL:
-    case VAL_UNDEFINED:
+        promise_retain(AS_PROMISE(*src));
+        return *src;
     default:
-        copy.type = src->type;
-        break;
+        // constants, functions, types and natives copy by bits
+        return *src;
+    }
+}
+
+Value retain_value(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_STRING:
+        string_retain(AS_STRING(v));
+        return v;
+    case VAL_OBJECT:
+        AS_OBJECT(v)->ref_count++;
+        return v;
+    case VAL_LIST:
+        AS_LIST(v)->ref_count++;
+        return v;
+    default:
+        return clone_value(&v);
     }
+}
 
+static bool holds_region_memory(Value v)
+{
+    switch (value_type(v))
+    {
+    case VAL_STRING:
+        return region_owns(AS_STRING(v));
+    case VAL_LIST:
+    {
+        List *list = AS_LIST(v);
+        if (region_owns(list) || region_owns(list->buffer))
+            return true;
+        for (int i = 0; list->buffer && i < list->count; ++i)
+            if (holds_region_memory(list->items[i]))
+                return true;
+        return false;
+    }
+    case VAL_OBJECT:
+    {
+        Object *obj = AS_OBJECT(v);
+        if (region_owns(obj) || region_owns(obj->buffer))
+            return true;
+        for (int i = 0; i < obj->count; ++i)
+            if (holds_region_memory(obj->values[i]))
+                return true;
+        return false;
+    }
+    default:
+        /* Instances, closures and promises are heap memory and copy what
+           is stored into them. */
+        return false;
+    }
+}
+
+Value value_promote(const void *owner, Value v)
+{
+    if (region_owns(owner) || !holds_region_memory(v))
+        return v;
+    Region *active = region_active;
+    region_activate(NULL);
+    Value copy;
+    if (IS_STRING(v))
+        copy = STRING_VAL(string_new(AS_STRING(v), string_length(AS_STRING(v))));
+    else if (IS_LIST(v))
+        copy = LIST_VAL(list_copy(AS_LIST(v)));
+    else
+        copy = OBJECT_VAL(object_copy(AS_OBJECT(v)));
+    region_activate(active);
+    free_value(v);
     return copy;
 }
 
 void print_value(Value v, int indent)
 {
-    switch (v.type)
+    switch (value_type(v))
     {
     case VAL_STRING:
-        printf("%s", v.str);
+        fwrite(AS_STRING(v), 1, string_length(AS_STRING(v)), stdout);
         break;
 
     case VAL_NUMBER:
-        if (fabs(v.num - (long long)v.num) < 1e-9)
-            printf("%lld", (long long)v.num);
+        if (IS_INT(v))
+            printf("%lld", (long long)AS_INT(v));
+        else if (fabs(AS_NUMBER(v) - (long long)AS_NUMBER(v)) < 1e-9)
+            printf("%lld", (long long)AS_NUMBER(v));
         else
-            printf("%f", v.num);
+            printf("%f", AS_NUMBER(v));
         break;
 
     case VAL_BOOL:
-        printf(v.boolean ? "true" : "false");
+        printf(AS_BOOL(v) ? "true" : "false");
         break;
 
     case VAL_OBJECT:
-        if (!v.obj || v.obj->count == 0)
+        if (!AS_OBJECT(v) || AS_OBJECT(v)->count == 0)
         {
             printf("{}");
             break;
@@ -151,16 +228,16 @@ void print_value(Value v, int indent)
 
         printf("{\n");
 
-        for (int i = 0; i < v.obj->count; i++)
+        for (int i = 0; i < AS_OBJECT(v)->count; i++)
         {
             // Indent
             for (int j = 0; j < indent + 2; j++)
                 printf(" ");
 
-            printf("%s: ", v.obj->pairs[i].key);
-            print_value(v.obj->pairs[i].value, indent + 2);
+            printf("%s: ", object_key(AS_OBJECT(v), i));
+            print_value(AS_OBJECT(v)->values[i], indent + 2);
 
-            if (i < v.obj->count - 1)
+            if (i < AS_OBJECT(v)->count - 1)
                 printf(",");
 
             printf("\n");
@@ -172,10 +249,10 @@ void print_value(Value v, int indent)
         break;
 
     case VAL_FUNCTION:
-        if (v.func)
+        if (AS_FUNCTION(v))
         {
-            const char *fname = v.func->name ? v.func->name : "anonymous";
-            printf("<function: %s at %p>", fname, (void *)v.func);
+            const char *fname = AS_FUNCTION(v)->name ? AS_FUNCTION(v)->name : "anonymous";
+            printf("<function: %s at %p>", fname, (void *)AS_FUNCTION(v));
         }
         else
         {
@@ -183,22 +260,25 @@ void print_value(Value v, int indent)
         }
         break;
     case VAL_TYPE:
-        printf("<type %s>", v.cls ? v.cls->name : "unknown");
+        printf("<type %s>", AS_TYPE(v) ? AS_TYPE(v)->name : "unknown");
         break;
     case VAL_INSTANCE:
         printf("<instance of %s at %p>",
-               v.instance && v.instance->cls ? v.instance->cls->name : "?",
-               (void *)v.instance);
+               AS_INSTANCE(v) && AS_INSTANCE(v)->cls ? AS_INSTANCE(v)->cls->name : "?",
+               (void *)AS_INSTANCE(v));
         break;
     case VAL_BOUND_METHOD:
         printf("<bound method>");
         break;
+    case VAL_NATIVE:
+        printf("<native function: %s>", AS_NATIVE(v)->name);
+        break;
     case VAL_LIST:
         printf("[");
-        for (int i = 0; i < v.list->count; ++i)
+        for (int i = 0; i < AS_LIST(v)->count; ++i)
         {
-            print_value(v.list->items[i], indent);
-            if (i < v.list->count - 1)
+            print_value(list_get(AS_LIST(v), i), indent);
+            if (i < AS_LIST(v)->count - 1)
                 printf(", ");
         }
         printf("]");
@@ -206,12 +286,12 @@ void print_value(Value v, int indent)
 
     case VAL_PROMISE:
     {
-        if (!v.promise)
+        if (!AS_PROMISE(v))
         {
             printf("<promise: null>");
             break;
         }
-        PromiseState state = promise_state(v.promise);
+        PromiseState state = promise_state(AS_PROMISE(v));
         switch (state)
         {
         case PROMISE_PENDING:
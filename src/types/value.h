@@ -2,6 +2,9 @@
 #define VALUE_H
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "utils/region.h"
 
 struct Object; // Forward declaration (to avoid circular include)
 struct Function; // Forward declaration for functions
@@ -9,8 +12,13 @@ struct List;    // Forward declaration for lists
 struct Type;
 struct Instance;
 struct Promise;
+struct NativeFunction;
 
+/* A method read off an instance. Attribute reads hand out one owned by
+   `self` (ref_count 0, see instance_bind); cloning one that escapes makes
+   a counted copy that keeps `self` alive. */
 typedef struct BoundMethod {
+    int ref_count;
     struct Instance *self;
     struct Function *func;
 } BoundMethod;
@@ -30,31 +38,212 @@ typedef enum
     VAL_INSTANCE,
     VAL_BOUND_METHOD,
     VAL_PROMISE,
+    VAL_NATIVE,
     VAL_TYPE_COUNT
 } ValueType;
 
 // ————— VALUE STRUCT ————— //
-typedef struct Value
+/*
+ * A Value is 8 bytes, NaN-boxed. A double is stored as itself, except that
+ * every NaN becomes VALUE_CANONICAL_NAN. Everything else hides in the
+ * payload of a quiet NaN that arithmetic never produces (bits 50-62 set):
+ * the sign bit and bits 48-49 form a 3-bit tag and the low 48 bits hold a
+ * pointer or an integer.
+ *
+ *   tag 0  integer in the signed 48-bit range, stored inline
+ *   tag 1  string (points at the chars of a StringHeader)
+ *   tag 2  object      tag 3  list      tag 4  instance
+ *   tag 5  function    tag 6  type
+ *   tag 7  low 3 bits pick bound method (0), promise (1), native
+ *          function (2) or boxed int64 (4), each an 8-byte aligned
+ *          pointer, or a constant (3): undefined, null, false or true in
+ *          bits 3-4
+ *
+ * Integers and doubles are both numbers: IS_NUMBER accepts either and
+ * AS_NUMBER reads either as a double. Use IS_INT/AS_INT for exact integer
+ * paths and INT_VAL to build one; it boxes values too wide to inline.
+ * Test with the IS_* macros, read with AS_* and build with *_VAL.
+ */
+typedef union Value
 {
-    ValueType type;
-    union
-    {
-        bool boolean;
-        double num;
-        char *str;
-        struct Object *obj;
-        struct Function *func;
-        struct List *list;
-        struct Type *cls;
-        struct Instance *instance;
-        BoundMethod *bound;
-        struct Promise *promise;
-    };
+    uint64_t bits;
+    double num;
 } Value;
 
+#define VALUE_QNAN ((uint64_t)0x7ffc000000000000)
+#define VALUE_SIGN ((uint64_t)1 << 63)
+#define VALUE_TAG_MASK (VALUE_QNAN | VALUE_SIGN | ((uint64_t)3 << 48))
+#define VALUE_PAYLOAD_MASK ((uint64_t)0x0000ffffffffffff)
+#define VALUE_TAG(tag) (VALUE_QNAN | ((uint64_t)((tag) & 4) << 61) | ((uint64_t)((tag) & 3) << 48))
+#define VALUE_SUBTAG_MASK ((uint64_t)7)
+
+#define VALUE_TAG_INT 0
+#define VALUE_TAG_STRING 1
+#define VALUE_TAG_OBJECT 2
+#define VALUE_TAG_LIST 3
+#define VALUE_TAG_INSTANCE 4
+#define VALUE_TAG_FUNCTION 5
+#define VALUE_TAG_TYPE 6
+#define VALUE_TAG_OTHER 7
+
+#define VALUE_SUBTAG_BOUND_METHOD 0
+#define VALUE_SUBTAG_PROMISE 1
+#define VALUE_SUBTAG_NATIVE 2
+#define VALUE_SUBTAG_CONST 3
+#define VALUE_SUBTAG_INT64 4
+
+#define VALUE_CONST(k) (VALUE_TAG(VALUE_TAG_OTHER) | ((uint64_t)(k) << 3) | VALUE_SUBTAG_CONST)
+#define VALUE_BITS_UNDEFINED VALUE_CONST(0)
+#define VALUE_BITS_NULL VALUE_CONST(1)
+#define VALUE_BITS_FALSE VALUE_CONST(2)
+#define VALUE_BITS_TRUE VALUE_CONST(3)
+
+/* Inline integers: INT48_MIN <= i <= INT48_MAX. */
+#define INT48_MAX (((int64_t)1 << 47) - 1)
+#define INT48_MIN (-((int64_t)1 << 47))
+
+#define VALUE_HAS_TAG(v, tag) (((v).bits & VALUE_TAG_MASK) == VALUE_TAG(tag))
+#define VALUE_HAS_SUBTAG(v, sub) \
+    (((v).bits & (VALUE_TAG_MASK | VALUE_SUBTAG_MASK)) == (VALUE_TAG(VALUE_TAG_OTHER) | (sub)))
+#define VALUE_POINTER(v, mask) ((void *)(uintptr_t)((v).bits & (mask)))
+#define VALUE_FROM_POINTER(tag, ptr) ((Value){.bits = VALUE_TAG(tag) | (uint64_t)(uintptr_t)(ptr)})
+#define VALUE_FROM_SUBTAG(sub, ptr) ((Value){.bits = VALUE_TAG(VALUE_TAG_OTHER) | (uint64_t)(uintptr_t)(ptr) | (sub)})
+
+#define IS_DOUBLE(v) (((v).bits & VALUE_QNAN) != VALUE_QNAN)
+#define IS_SMALL_INT(v) VALUE_HAS_TAG(v, VALUE_TAG_INT)
+#define IS_INT64_BOX(v) VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_INT64)
+#define IS_INT(v) (IS_SMALL_INT(v) || IS_INT64_BOX(v))
+#define IS_NUMBER(v) (IS_DOUBLE(v) || IS_INT(v))
+#define IS_UNDEFINED(v) ((v).bits == VALUE_BITS_UNDEFINED)
+#define IS_NULL(v) ((v).bits == VALUE_BITS_NULL)
+#define IS_BOOL(v) (((v).bits | 8) == VALUE_BITS_TRUE)
+#define IS_STRING(v) VALUE_HAS_TAG(v, VALUE_TAG_STRING)
+#define IS_OBJECT(v) VALUE_HAS_TAG(v, VALUE_TAG_OBJECT)
+#define IS_LIST(v) VALUE_HAS_TAG(v, VALUE_TAG_LIST)
+#define IS_INSTANCE(v) VALUE_HAS_TAG(v, VALUE_TAG_INSTANCE)
+#define IS_FUNCTION(v) VALUE_HAS_TAG(v, VALUE_TAG_FUNCTION)
+#define IS_TYPE(v) VALUE_HAS_TAG(v, VALUE_TAG_TYPE)
+#define IS_BOUND_METHOD(v) VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_BOUND_METHOD)
+#define IS_PROMISE(v) VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_PROMISE)
+#define IS_NATIVE(v) VALUE_HAS_SUBTAG(v, VALUE_SUBTAG_NATIVE)
+
+#define AS_SMALL_INT(v) ((int64_t)((v).bits << 16) >> 16)
+#define AS_INT(v) value_as_int(v)
+#define AS_NUMBER(v) value_as_number(v)
+#define AS_BOOL(v) ((v).bits == VALUE_BITS_TRUE)
+#define AS_STRING(v) ((char *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_OBJECT(v) ((struct Object *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_LIST(v) ((struct List *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_INSTANCE(v) ((struct Instance *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_FUNCTION(v) ((struct Function *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_TYPE(v) ((struct Type *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK))
+#define AS_BOUND_METHOD(v) ((BoundMethod *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK & ~VALUE_SUBTAG_MASK))
+#define AS_PROMISE(v) ((struct Promise *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK & ~VALUE_SUBTAG_MASK))
+#define AS_NATIVE(v) ((const struct NativeFunction *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK & ~VALUE_SUBTAG_MASK))
+#define AS_INT64_BOX(v) ((int64_t *)VALUE_POINTER(v, VALUE_PAYLOAD_MASK & ~VALUE_SUBTAG_MASK))
+
+#define NUMBER_VAL(n) value_from_double(n)
+#define SMALL_INT_VAL(i) ((Value){.bits = VALUE_TAG(VALUE_TAG_INT) | ((uint64_t)(i) & VALUE_PAYLOAD_MASK)})
+#define INT_VAL(i) value_from_int(i)
+#define UNDEFINED_VAL ((Value){.bits = VALUE_BITS_UNDEFINED})
+#define NULL_VAL ((Value){.bits = VALUE_BITS_NULL})
+#define BOOL_VAL(b) ((Value){.bits = (b) ? VALUE_BITS_TRUE : VALUE_BITS_FALSE})
+#define STRING_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_STRING, p)
+#define OBJECT_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_OBJECT, p)
+#define LIST_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_LIST, p)
+#define INSTANCE_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_INSTANCE, p)
+#define FUNCTION_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_FUNCTION, p)
+#define TYPE_VAL(p) VALUE_FROM_POINTER(VALUE_TAG_TYPE, p)
+#define BOUND_METHOD_VAL(p) VALUE_FROM_SUBTAG(VALUE_SUBTAG_BOUND_METHOD, p)
+#define PROMISE_VAL(p) VALUE_FROM_SUBTAG(VALUE_SUBTAG_PROMISE, p)
+#define NATIVE_VAL(p) VALUE_FROM_SUBTAG(VALUE_SUBTAG_NATIVE, p)
+
+Value value_box_int(int64_t i);
+
+/* The only NaN a Value holds. Others may carry any payload, including one
+   that reads as a tagged pointer (float("nan(0x...)")), so every double is
+   boxed through here. */
+#define VALUE_CANONICAL_NAN ((uint64_t)0x7ff8000000000000)
+
+static inline Value value_from_double(double n)
+{
+    Value v = {.num = n};
+    if (n != n)
+        v.bits = VALUE_CANONICAL_NAN;
+    return v;
+}
+
+static inline Value value_from_int(int64_t i)
+{
+    if (i >= INT48_MIN && i <= INT48_MAX)
+        return SMALL_INT_VAL(i);
+    return value_box_int(i);
+}
+
+static inline int64_t value_as_int(Value v)
+{
+    return IS_SMALL_INT(v) ? AS_SMALL_INT(v) : *AS_INT64_BOX(v);
+}
+
+static inline double value_as_number(Value v)
+{
+    return IS_DOUBLE(v) ? v.num : (double)value_as_int(v);
+}
+
+/* The ValueType of a boxed value, for code that switches on kind. */
+static inline ValueType value_type(Value v)
+{
+    if (IS_DOUBLE(v))
+        return VAL_NUMBER;
+    switch ((v.bits & VALUE_SIGN) >> 61 | (v.bits >> 48 & 3))
+    {
+    case VALUE_TAG_INT:
+        return VAL_NUMBER;
+    case VALUE_TAG_STRING:
+        return VAL_STRING;
+    case VALUE_TAG_OBJECT:
+        return VAL_OBJECT;
+    case VALUE_TAG_LIST:
+        return VAL_LIST;
+    case VALUE_TAG_INSTANCE:
+        return VAL_INSTANCE;
+    case VALUE_TAG_FUNCTION:
+        return VAL_FUNCTION;
+    case VALUE_TAG_TYPE:
+        return VAL_TYPE;
+    default:
+        switch (v.bits & VALUE_SUBTAG_MASK)
+        {
+        case VALUE_SUBTAG_BOUND_METHOD:
+            return VAL_BOUND_METHOD;
+        case VALUE_SUBTAG_PROMISE:
+            return VAL_PROMISE;
+        case VALUE_SUBTAG_NATIVE:
+            return VAL_NATIVE;
+        case VALUE_SUBTAG_INT64:
+            return VAL_NUMBER;
+        default:
+            return v.bits == VALUE_BITS_UNDEFINED ? VAL_UNDEFINED : v.bits == VALUE_BITS_NULL ? VAL_NULL : VAL_BOOL;
+        }
+    }
+}
+
 // ————— FUNCTIONS ————— //
 Value clone_value(const Value *src);
+/* Another counted reference to `v` itself: unlike clone_value, a list or
+   object is shared rather than copied, so writes through either show. */
+Value retain_value(Value v);
 void free_value(Value val);
+/* free_value, or the collector's variant that spares live values. */
+typedef void (*ValueRelease)(Value val);
+/* `v`, an owned value about to be stored into `owner`: when `owner` is
+   not region memory but `v` holds some, a copy on the heap (and `v` is
+   released), so nothing a request leaves behind pins a region block. */
+Value value_promote(const void *owner, Value v);
+static inline Value value_escape(const void *owner, Value v)
+{
+    return region_block_count > 0 ? value_promote(owner, v) : v;
+}
 void print_value(Value v, int indent); // For debugging
 const char *value_type_name(ValueType type);
 
@@ -571,6 +571,7 @@ static void http_response_prepare(HttpResponse *response)
     response->headers = NULL;
     response->header_count = 0;
     response->body = NULL;
+    response->body_length = 0;
 }
 
 static bool extract_curl_metadata(Buffer *body_buffer, HttpResponse *response, char **error_message)
@@ -748,6 +749,7 @@ wait_cleanup:;
         goto cleanup;
 
     response->body = stdout_buffer.data;
+    response->body_length = stdout_buffer.size;
     stdout_buffer.data = NULL;
 
     if (!read_file_into_buffer(header_template, &header_buffer))
@@ -868,6 +870,7 @@ void http_response_cleanup(HttpResponse *response)
     response->final_url = NULL;
     free(response->body);
     response->body = NULL;
+    response->body_length = 0;
     if (response->headers)
     {
         for (size_t i = 0; i < response->header_count; ++i)
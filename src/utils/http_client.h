@@ -35,6 +35,7 @@ typedef struct
     HttpResponseHeader *headers;
     size_t header_count;
     char *body;
+    size_t body_length;
 } HttpResponse;
 
 bool http_client_perform(const char *method,
@@ -119,6 +119,7 @@ static bool populate_response(const HttpFixture *fixture, HttpResponse *response
         cleanup_response_partial(response, 0);
         return false;
     }
+    response->body_length = strlen(response->body);
 
     if (fixture->header_count == 0)
         return true;
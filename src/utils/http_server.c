@@ -13,7 +13,11 @@
 #include <sys/types.h>
 #include <unistd.h>
 
+#include "utils/region.h"
+
 #define READ_BUFFER_SIZE 4096
+/* Buffers reused across connections give back anything larger. */
+#define KEPT_BUFFER_SIZE 65536
 
 typedef struct
 {
@@ -46,6 +50,16 @@ static void buffer_free(Buffer *buffer)
     buffer->capacity = 0;
 }
 
+/* Empty `buffer` for reuse, keeping its storage unless it grew large. */
+static void buffer_clear(Buffer *buffer)
+{
+    if (buffer->capacity > KEPT_BUFFER_SIZE)
+        buffer_free(buffer);
+    buffer->size = 0;
+    if (buffer->data)
+        buffer->data[0] = '\0';
+}
+
 static bool buffer_reserve(Buffer *buffer, size_t additional)
 {
     size_t needed = buffer->size + additional + 1;
@@ -83,11 +97,6 @@ static void header_list_free(HeaderList *list)
 {
     if (!list)
         return;
-    for (size_t i = 0; i < list->count; ++i)
-    {
-        free(list->items[i].name);
-        free(list->items[i].value);
-    }
     free(list->items);
     list->items = NULL;
     list->count = 0;
@@ -109,47 +118,26 @@ static bool header_list_reserve(HeaderList *list, size_t needed)
     return true;
 }
 
-static bool header_list_append(HeaderList *list, const char *name, const char *value)
+/* `name` and `value` stay owned by the read buffer. */
+static bool header_list_append(HeaderList *list, char *name, char *value)
 {
     if (!header_list_reserve(list, list->count + 1))
         return false;
-    char *name_copy = strdup(name ? name : "");
-    char *value_copy = strdup(value ? value : "");
-    if (!name_copy || !value_copy)
-    {
-        free(name_copy);
-        free(value_copy);
-        return false;
-    }
-    list->items[list->count].name = name_copy;
-    list->items[list->count].value = value_copy;
+    list->items[list->count].name = name;
+    list->items[list->count].value = value;
     list->count++;
     return true;
 }
 
-static char *strndup_safe(const char *src, size_t len)
-{
-    char *copy = malloc(len + 1);
-    if (!copy)
-        return NULL;
-    memcpy(copy, src, len);
-    copy[len] = '\0';
-    return copy;
-}
-
+/* Trim [start, end) in place and terminate it. */
 static char *trim_whitespace(char *start, char *end)
 {
     while (start < end && isspace((unsigned char)*start))
         start++;
     while (end > start && isspace((unsigned char)*(end - 1)))
         end--;
-    size_t len = (size_t)(end - start);
-    char *trimmed = malloc(len + 1);
-    if (!trimmed)
-        return NULL;
-    memcpy(trimmed, start, len);
-    trimmed[len] = '\0';
-    return trimmed;
+    *end = '\0';
+    return start;
 }
 
 static const char *default_reason_phrase(int status)
@@ -241,11 +229,8 @@ static bool read_request_into_buffer(int client_fd, Buffer *buffer, size_t *head
                             const char *value_start = colon + 1;
                             while (value_start < line_end && isspace((unsigned char)*value_start))
                                 value_start++;
-                            char *value = strndup_safe(value_start, (size_t)(line_end - value_start));
-                            if (!value)
-                                return false;
-                            expected_body = (size_t)strtoul(value, NULL, 10);
-                            free(value);
+                            /* strtoul stops at the CR ending the line. */
+                            expected_body = (size_t)strtoul(value_start, NULL, 10);
                             break;
                         }
                     }
@@ -270,120 +255,86 @@ static bool read_request_into_buffer(int client_fd, Buffer *buffer, size_t *head
     return true;
 }
 
+/* Split the request in `buffer` in place: its fields point into the
+   buffer, which must outlive the request. */
 static bool parse_request(Buffer *buffer, size_t header_length, HttpServerRequest *request)
 {
     memset(request, 0, sizeof(*request));
 
     HeaderList headers;
     header_list_init(&headers);
-    char *full_path = NULL;
-    bool success = false;
 
     char *request_line_end = strstr(buffer->data, "\r\n");
     if (!request_line_end)
-        goto cleanup;
+        return false;
 
     char *method_end = memchr(buffer->data, ' ', (size_t)(request_line_end - buffer->data));
     if (!method_end)
-        goto cleanup;
+        return false;
 
     char *path_start = method_end + 1;
     char *path_end = memchr(path_start, ' ', (size_t)(request_line_end - path_start));
     if (!path_end)
-        goto cleanup;
+        return false;
 
-    request->method = strndup_safe(buffer->data, (size_t)(method_end - buffer->data));
-    if (!request->method)
-        goto cleanup;
+    *method_end = '\0';
+    *path_end = '\0';
+    *request_line_end = '\0';
+    request->method = buffer->data;
     for (char *c = request->method; *c; ++c)
         *c = (char)toupper((unsigned char)*c);
 
-    full_path = strndup_safe(path_start, (size_t)(path_end - path_start));
-    if (!full_path)
-        goto cleanup;
-
-    char *query_start = strchr(full_path, '?');
+    char *query_start = strchr(path_start, '?');
     if (query_start)
     {
         *query_start = '\0';
-        query_start++;
-        request->query = strdup(query_start);
-        if (!request->query)
-            goto cleanup;
+        request->query = query_start + 1;
     }
-    request->path = strdup(full_path);
-    if (!request->path)
-        goto cleanup;
-
-    request->http_version = strndup_safe(path_end + 1, (size_t)(request_line_end - (path_end + 1)));
-    if (!request->http_version)
-        goto cleanup;
+    request->path = path_start;
+    request->http_version = path_end + 1;
 
+    char *cursor = request_line_end + 2;
+    char *headers_end = buffer->data + header_length;
+    while (cursor < headers_end - 2)
     {
-        char *cursor = request_line_end + 2;
-        char *headers_end = buffer->data + header_length;
-        while (cursor < headers_end - 2)
+        char *line_end = strstr(cursor, "\r\n");
+        if (!line_end)
+            break;
+        if (line_end == cursor)
         {
-            char *line_end = strstr(cursor, "\r\n");
-            if (!line_end)
-                break;
-            if (line_end == cursor)
-            {
-                cursor += 2;
-                continue;
-            }
-            char *colon = memchr(cursor, ':', (size_t)(line_end - cursor));
-            if (!colon)
-                goto cleanup;
-            char *name = strndup_safe(cursor, (size_t)(colon - cursor));
-            if (!name)
-                goto cleanup;
-            for (char *c = name; *c; ++c)
-                *c = (char)tolower((unsigned char)*c);
-
-            char *value = trim_whitespace(colon + 1, line_end);
-            if (!value)
-            {
-                free(name);
-                goto cleanup;
-            }
-            bool appended = header_list_append(&headers, name, value);
-            free(name);
-            free(value);
-            if (!appended)
-                goto cleanup;
-            cursor = line_end + 2;
+            cursor += 2;
+            continue;
         }
-    }
-
-    request->headers = headers.items;
-    request->header_count = headers.count;
-    headers.items = NULL;
-    headers.count = 0;
-
-    {
-        size_t body_len = buffer->size - header_length;
-        if (body_len > 0)
+        char *colon = memchr(cursor, ':', (size_t)(line_end - cursor));
+        if (!colon)
+        {
+            header_list_free(&headers);
+            return false;
+        }
+        *colon = '\0';
+        char *name = cursor;
+        for (char *c = name; *c; ++c)
+            *c = (char)tolower((unsigned char)*c);
+        char *value = trim_whitespace(colon + 1, line_end);
+        if (!header_list_append(&headers, name, value))
         {
-            request->body = malloc(body_len + 1);
-            if (!request->body)
-                goto cleanup;
-            memcpy(request->body, buffer->data + header_length, body_len);
-            request->body[body_len] = '\0';
-            request->body_length = body_len;
+            header_list_free(&headers);
+            return false;
         }
+        cursor = line_end + 2;
     }
 
-    success = true;
+    request->headers = headers.items;
+    request->header_count = headers.count;
 
-cleanup:
-    free(full_path);
-    if (!success)
+    /* buffer_append keeps the data NUL-terminated. */
+    size_t body_len = buffer->size - header_length;
+    if (body_len > 0)
     {
-        header_list_free(&headers);
-        http_server_request_cleanup(request);
+        request->body = buffer->data + header_length;
+        request->body_length = body_len;
     }
-    return success;
+    return true;
 }
 
 static void free_request(HttpServerRequest *request)
@@ -401,19 +352,16 @@ static bool response_has_header(const HttpServerResponse *response, const char *
     return false;
 }
 
-static bool write_response(int client_fd, const HttpServerResponse *response)
+/* Serialize into `buffer`, reusing its storage. */
+static bool write_response(int client_fd, const HttpServerResponse *response, Buffer *buffer)
 {
-    Buffer buffer;
-    buffer_init(&buffer);
+    buffer_clear(buffer);
 
     const char *status_text = response->status_text ? response->status_text : default_reason_phrase(response->status_code);
     char status_line[256];
     int written = snprintf(status_line, sizeof(status_line), "HTTP/1.1 %d %s\r\n", response->status_code, status_text ? status_text : "OK");
-    if (written < 0 || !buffer_append(&buffer, status_line, (size_t)written))
-    {
-        buffer_free(&buffer);
+    if (written < 0 || !buffer_append(buffer, status_line, (size_t)written))
         return false;
-    }
 
     bool has_content_length = response_has_header(response, "Content-Length");
     bool has_connection = response_has_header(response, "Connection");
@@ -424,26 +372,14 @@ static bool write_response(int client_fd, const HttpServerResponse *response)
             continue;
         size_t name_len = strlen(response->headers[i].name);
         size_t value_len = response->headers[i].value ? strlen(response->headers[i].value) : 0;
-        if (!buffer_append(&buffer, response->headers[i].name, name_len))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, response->headers[i].name, name_len))
             return false;
-        }
-        if (!buffer_append(&buffer, ": ", 2))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, ": ", 2))
             return false;
-        }
-        if (!buffer_append(&buffer, response->headers[i].value ? response->headers[i].value : "", value_len))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, response->headers[i].value ? response->headers[i].value : "", value_len))
             return false;
-        }
-        if (!buffer_append(&buffer, "\r\n", 2))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, "\r\n", 2))
             return false;
-        }
     }
 
     char content_length_header[64];
@@ -451,53 +387,39 @@ static bool write_response(int client_fd, const HttpServerResponse *response)
     {
         size_t body_len = response->body ? response->body_length : 0;
         int len_written = snprintf(content_length_header, sizeof(content_length_header), "Content-Length: %zu\r\n", body_len);
-        if (len_written < 0 || !buffer_append(&buffer, content_length_header, (size_t)len_written))
-        {
-            buffer_free(&buffer);
+        if (len_written < 0 || !buffer_append(buffer, content_length_header, (size_t)len_written))
             return false;
-        }
     }
 
     if (!has_connection)
     {
-        if (!buffer_append(&buffer, "Connection: close\r\n", strlen("Connection: close\r\n")))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, "Connection: close\r\n", strlen("Connection: close\r\n")))
             return false;
-        }
     }
 
-    if (!buffer_append(&buffer, "\r\n", 2))
-    {
-        buffer_free(&buffer);
+    if (!buffer_append(buffer, "\r\n", 2))
         return false;
-    }
 
     if (response->body && response->body_length > 0)
     {
-        if (!buffer_append(&buffer, response->body, response->body_length))
-        {
-            buffer_free(&buffer);
+        if (!buffer_append(buffer, response->body, response->body_length))
             return false;
-        }
     }
 
-    size_t total = buffer.size;
+    size_t total = buffer->size;
     size_t sent = 0;
     while (sent < total)
     {
-        ssize_t n = send(client_fd, buffer.data + sent, total - sent, 0);
+        ssize_t n = send(client_fd, buffer->data + sent, total - sent, 0);
         if (n < 0)
         {
             if (errno == EINTR)
                 continue;
-            buffer_free(&buffer);
             return false;
         }
         sent += (size_t)n;
     }
 
-    buffer_free(&buffer);
     return true;
 }
 
@@ -505,20 +427,20 @@ void http_server_request_cleanup(HttpServerRequest *request)
 {
     if (!request)
         return;
-    free(request->method);
-    free(request->path);
-    free(request->query);
-    free(request->http_version);
-    for (size_t i = 0; i < request->header_count; ++i)
-    {
-        free(request->headers[i].name);
-        free(request->headers[i].value);
-    }
     free(request->headers);
-    free(request->body);
     memset(request, 0, sizeof(*request));
 }
 
+/* Response fields come from the active region, if any (see region.h). */
+static char *copy_string(const char *text)
+{
+    size_t length = strlen(text);
+    char *copy = region_malloc(length + 1);
+    if (copy)
+        memcpy(copy, text, length + 1);
+    return copy;
+}
+
 void http_server_response_init(HttpServerResponse *response)
 {
     if (!response)
@@ -535,14 +457,14 @@ void http_server_response_cleanup(HttpServerResponse *response)
 {
     if (!response)
         return;
-    free(response->status_text);
+    region_free(response->status_text);
     for (size_t i = 0; i < response->header_count; ++i)
     {
-        free(response->headers[i].name);
-        free(response->headers[i].value);
+        region_free(response->headers[i].name);
+        region_free(response->headers[i].value);
     }
-    free(response->headers);
-    free(response->body);
+    region_free(response->headers);
+    region_free(response->body);
     memset(response, 0, sizeof(*response));
 }
 
@@ -551,8 +473,8 @@ bool http_server_response_set_status(HttpServerResponse *response, int status_co
     if (!response)
         return false;
     response->status_code = status_code;
-    free(response->status_text);
-    response->status_text = status_text ? strdup(status_text) : NULL;
+    region_free(response->status_text);
+    response->status_text = status_text ? copy_string(status_text) : NULL;
     return status_text == NULL || response->status_text != NULL;
 }
 
@@ -560,14 +482,14 @@ bool http_server_response_set_body(HttpServerResponse *response, const char *bod
 {
     if (!response)
         return false;
-    free(response->body);
+    region_free(response->body);
     if (!body)
     {
         response->body = NULL;
         response->body_length = 0;
         return true;
     }
-    response->body = malloc(length + 1);
+    response->body = region_malloc(length + 1);
     if (!response->body)
         return false;
     memcpy(response->body, body, length);
@@ -580,16 +502,17 @@ bool http_server_response_add_header(HttpServerResponse *response, const char *n
 {
     if (!response || !name)
         return false;
-    HttpServerHeader *resized = realloc(response->headers, sizeof(HttpServerHeader) * (response->header_count + 1));
+    size_t used = sizeof(HttpServerHeader) * response->header_count;
+    HttpServerHeader *resized = region_realloc(response->headers, used, used + sizeof(HttpServerHeader));
     if (!resized)
         return false;
     response->headers = resized;
-    char *name_copy = strdup(name);
-    char *value_copy = strdup(value ? value : "");
+    char *name_copy = copy_string(name);
+    char *value_copy = copy_string(value ? value : "");
     if (!name_copy || !value_copy)
     {
-        free(name_copy);
-        free(value_copy);
+        region_free(name_copy);
+        region_free(value_copy);
         return false;
     }
     response->headers[response->header_count].name = name_copy;
@@ -657,6 +580,10 @@ bool http_server_listen(const char *host,
         return false;
     }
 
+    Buffer buffer;
+    Buffer output;
+    buffer_init(&buffer);
+    buffer_init(&output);
     bool continue_running = true;
     while (continue_running)
     {
@@ -667,12 +594,13 @@ bool http_server_listen(const char *host,
                 continue;
             if (error_message)
                 *error_message = strdup(strerror(errno));
+            buffer_free(&buffer);
+            buffer_free(&output);
             close(listen_fd);
             return false;
         }
 
-        Buffer buffer;
-        buffer_init(&buffer);
+        buffer_clear(&buffer);
         size_t header_length = 0;
         size_t body_length = 0;
         bool read_ok = read_request_into_buffer(client_fd, &buffer, &header_length, &body_length);
@@ -688,20 +616,21 @@ bool http_server_listen(const char *host,
         {
             http_server_response_set_status(&response, 400, "Bad Request");
             http_server_response_set_body(&response, "Bad Request", strlen("Bad Request"));
-            write_response(client_fd, &response);
+            write_response(client_fd, &response, &output);
         }
         else
         {
             continue_running = handler ? handler(&request, &response, user_data) : false;
-            write_response(client_fd, &response);
+            write_response(client_fd, &response, &output);
             free_request(&request);
         }
 
         http_server_response_cleanup(&response);
-        buffer_free(&buffer);
         close(client_fd);
     }
 
+    buffer_free(&buffer);
+    buffer_free(&output);
     close(listen_fd);
     return true;
 }
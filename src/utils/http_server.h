@@ -14,6 +14,8 @@ typedef struct
     char *value;
 } HttpServerHeader;
 
+/* Fields point into the connection's read buffer and are valid until the
+   handler returns. */
 typedef struct
 {
     char *method;
@@ -0,0 +1,161 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/intern.h"
+#include "utils/utils.h"
+
+typedef struct Atom
+{
+    uint32_t hash;
+    uint32_t length;
+    uint32_t refs; // holders of a loose key; 0 for atoms in the table
+    char chars[];
+} Atom;
+
+/* Open-addressed set of atoms; capacity is always a power of two. */
+static Atom **table = NULL;
+static size_t table_capacity = 0;
+static size_t table_count = 0;
+
+static Atom *atom_of(const char *chars)
+{
+    return (Atom *)(chars - offsetof(Atom, chars));
+}
+
+static size_t find_slot(Atom **slots, size_t capacity, const char *str, size_t length, uint32_t hash)
+{
+    size_t mask = capacity - 1;
+    size_t index = hash & mask;
+    while (slots[index])
+    {
+        Atom *atom = slots[index];
+        if (atom->hash == hash && atom->length == length && memcmp(atom->chars, str, length) == 0)
+            break;
+        index = (index + 1) & mask;
+    }
+    return index;
+}
+
+static void grow_table(void)
+{
+    size_t capacity = table_capacity ? table_capacity * 2 : 256;
+    Atom **slots = calloc(capacity, sizeof(Atom *));
+    if (!slots)
+    {
+        log_error("Out of memory while growing the intern table");
+        exit(1);
+    }
+    for (size_t i = 0; i < table_capacity; ++i)
+    {
+        Atom *atom = table[i];
+        if (atom)
+            slots[find_slot(slots, capacity, atom->chars, atom->length, atom->hash)] = atom;
+    }
+    free(table);
+    table = slots;
+    table_capacity = capacity;
+}
+
+static Atom *atom_new(const char *str, size_t length, uint32_t hash, uint32_t refs)
+{
+    Atom *atom = malloc(sizeof(Atom) + length + 1);
+    if (!atom)
+    {
+        log_error("Out of memory while interning a string");
+        exit(1);
+    }
+    atom->hash = hash;
+    atom->length = (uint32_t)length;
+    atom->refs = refs;
+    memcpy(atom->chars, str, length);
+    atom->chars[length] = '\0';
+    return atom;
+}
+
+const char *intern_n(const char *str, size_t length)
+{
+    if ((table_count + 1) * 4 > table_capacity * 3)
+        grow_table();
+
+    uint32_t hash = hash_bytes(str, length);
+    size_t index = find_slot(table, table_capacity, str, length, hash);
+    if (table[index])
+        return table[index]->chars;
+
+    Atom *atom = atom_new(str, length, hash, 0);
+    table[index] = atom;
+    table_count++;
+    return atom->chars;
+}
+
+const char *intern(const char *str)
+{
+    return intern_n(str, strlen(str));
+}
+
+const char *intern_find(const char *str)
+{
+    if (table_count == 0)
+        return NULL;
+    size_t length = strlen(str);
+    Atom *atom = table[find_slot(table, table_capacity, str, length, hash_bytes(str, length))];
+    return atom ? atom->chars : NULL;
+}
+
+const char *intern_key(const char *str, size_t length)
+{
+    uint32_t hash = hash_bytes(str, length);
+    if (table_count > 0)
+    {
+        Atom *atom = table[find_slot(table, table_capacity, str, length, hash)];
+        if (atom)
+            return atom->chars;
+    }
+    return atom_new(str, length, hash, 1)->chars;
+}
+
+bool intern_is_loose(const char *key)
+{
+    return atom_of(key)->refs > 0;
+}
+
+void intern_key_retain(const char *key)
+{
+    Atom *atom = atom_of(key);
+    if (atom->refs > 0)
+        atom->refs++;
+}
+
+void intern_key_release(const char *key)
+{
+    Atom *atom = atom_of(key);
+    if (atom->refs > 0 && --atom->refs == 0)
+        free(atom);
+}
+
+bool intern_same(const char *a, const char *b)
+{
+    if (a == b)
+        return true;
+    const Atom *x = atom_of(a);
+    const Atom *y = atom_of(b);
+    /* Two distinct atoms never hold the same string. */
+    return (x->refs > 0 || y->refs > 0) && x->hash == y->hash && x->length == y->length &&
+           memcmp(x->chars, y->chars, x->length) == 0;
+}
+
+uint32_t intern_hash(const char *atom)
+{
+    return atom_of(atom)->hash;
+}
+
+void intern_cleanup(void)
+{
+    for (size_t i = 0; i < table_capacity; ++i)
+        free(table[i]);
+    free(table);
+    table = NULL;
+    table_capacity = 0;
+    table_count = 0;
+}
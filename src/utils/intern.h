@@ -0,0 +1,37 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Interned strings ("atoms"). Interning returns one canonical, immutable
+ * copy per distinct string, so atoms compare equal exactly when their
+ * pointers are equal. Each atom carries its precomputed hash. Atoms live
+ * until intern_cleanup() at shutdown and must never be freed.
+ */
+const char *intern(const char *str);
+const char *intern_n(const char *str, size_t length);
+/* Return the atom for `str` if one exists, without creating it. */
+const char *intern_find(const char *str);
+/* Also works on loose keys. */
+uint32_t intern_hash(const char *atom);
+
+/*
+ * Loose keys are for strings that come from data (parsed JSON, HTTP
+ * headers), which must not stay in the table forever. intern_key returns
+ * the atom if `str` is interned already and otherwise a reference-counted
+ * copy laid out like an atom but outside the table. Only dictionary-mode
+ * objects hold loose keys; since an atom with the same text may be
+ * created later, compare keys that might be loose with intern_same.
+ * Retaining and releasing an atom does nothing.
+ */
+const char *intern_key(const char *str, size_t length);
+bool intern_is_loose(const char *key);
+void intern_key_retain(const char *key);
+void intern_key_release(const char *key);
+bool intern_same(const char *a, const char *b);
+void intern_cleanup(void);
+
+#endif
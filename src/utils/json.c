@@ -1,6 +1,7 @@
 #include "utils/json.h"
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -10,6 +11,7 @@
 
 #include "types/list.h"
 #include "types/object.h"
+#include "types/str.h"
 #include "types/value.h"
 
 typedef struct
@@ -101,12 +103,13 @@ static bool set_error(char **error, const char *fmt, ...)
     return false;
 }
 
-static bool append_escaped_string(JsonBuffer *buffer, const char *str)
+static bool append_escaped_string(JsonBuffer *buffer, const char *str, size_t length)
 {
     if (!buffer_append_char(buffer, '"'))
         return false;
 
-    for (const unsigned char *p = (const unsigned char *)str; *p; ++p)
+    const unsigned char *end = (const unsigned char *)str + length;
+    for (const unsigned char *p = (const unsigned char *)str; p < end; ++p)
     {
         switch (*p)
         {
@@ -166,32 +169,36 @@ static bool stringify_value(JsonBuffer *buffer, const Value *value, char **error
     if (!value)
         return buffer_append_str(buffer, "null");
 
-    switch (value->type)
+    switch (value_type(*value))
     {
     case VAL_UNDEFINED:
     case VAL_NULL:
         return buffer_append_str(buffer, "null");
     case VAL_BOOL:
-        return buffer_append_str(buffer, value->boolean ? "true" : "false");
+        return buffer_append_str(buffer, AS_BOOL(*value) ? "true" : "false");
     case VAL_NUMBER:
     {
         char numbuf[64];
-        snprintf(numbuf, sizeof(numbuf), "%.15g", value->num);
+        if (IS_INT(*value))
+            snprintf(numbuf, sizeof(numbuf), "%lld", (long long)AS_INT(*value));
+        else
+            snprintf(numbuf, sizeof(numbuf), "%.15g", AS_NUMBER(*value));
         return buffer_append_str(buffer, numbuf);
     }
     case VAL_STRING:
-        return append_escaped_string(buffer, value->str ? value->str : "");
+        return append_escaped_string(buffer, AS_STRING(*value) ? AS_STRING(*value) : "", string_length(AS_STRING(*value)));
     case VAL_LIST:
     {
         if (!buffer_append_char(buffer, '['))
             return false;
-        if (value->list)
+        if (AS_LIST(*value))
         {
-            for (int i = 0; i < value->list->count; ++i)
+            for (int i = 0; i < AS_LIST(*value)->count; ++i)
             {
                 if (i > 0 && !buffer_append_char(buffer, ','))
                     return false;
-                if (!stringify_value(buffer, &value->list->items[i], error))
+                Value item = list_get(AS_LIST(*value), i);
+                if (!stringify_value(buffer, &item, error))
                     return false;
             }
         }
@@ -201,17 +208,17 @@ static bool stringify_value(JsonBuffer *buffer, const Value *value, char **error
     {
         if (!buffer_append_char(buffer, '{'))
             return false;
-        if (value->obj)
+        if (AS_OBJECT(*value))
         {
-            for (int i = 0; i < value->obj->count; ++i)
+            for (int i = 0; i < AS_OBJECT(*value)->count; ++i)
             {
                 if (i > 0 && !buffer_append_char(buffer, ','))
                     return false;
-                if (!append_escaped_string(buffer, value->obj->pairs[i].key))
+                if (!append_escaped_string(buffer, object_key(AS_OBJECT(*value), i), strlen(object_key(AS_OBJECT(*value), i))))
                     return false;
                 if (!buffer_append_char(buffer, ':'))
                     return false;
-                if (!stringify_value(buffer, &value->obj->pairs[i].value, error))
+                if (!stringify_value(buffer, &AS_OBJECT(*value)->values[i], error))
                     return false;
             }
         }
@@ -473,13 +480,8 @@ static bool parse_string(JsonParser *parser, Value *out, char **error)
         }
     }
 
-    out->type = VAL_STRING;
-    out->str = buffer.data ? buffer.data : strdup("");
-    if (!out->str)
-    {
-        buffer_free(&buffer);
-        return set_error(error, "Out of memory");
-    }
+    *out = STRING_VAL(string_new(buffer.data, buffer.length));
+    buffer_free(&buffer);
     return true;
 }
 
@@ -503,14 +505,31 @@ static bool parse_number(JsonParser *parser, Value *out, char **error)
     if (endptr == start)
         return set_error(error, "Invalid number at position %zu", parser->index);
 
+    /* Integers keep every digit as long as they fit in int64; anything
+       with a fraction or exponent, or out of range, stays a double. */
+    bool integral = true;
+    for (const char *p = start; p < endptr; ++p)
+    {
+        if (*p == '.' || *p == 'e' || *p == 'E')
+            integral = false;
+    }
+    long long int_value = 0;
+    if (integral)
+    {
+        char *int_end = NULL;
+        errno = 0;
+        int_value = strtoll(start, &int_end, 10);
+        /* "-0" is the double -0.0; integers have no negative zero. */
+        integral = int_end == endptr && errno != ERANGE && !(int_value == 0 && *start == '-');
+    }
+
     parser->index = (size_t)(endptr - parser->text);
 
     char next = parser_peek(parser);
     if (!(next == '\0' || next == ',' || next == '}' || next == ']' || isspace((unsigned char)next)))
         return set_error(error, "Invalid character after number at position %zu", parser->index);
 
-    out->type = VAL_NUMBER;
-    out->num = value;
+    *out = integral ? INT_VAL(int_value) : NUMBER_VAL(value);
     return true;
 }
 
@@ -519,24 +538,20 @@ static bool parse_array(JsonParser *parser, Value *out, char **error)
     if (!parser_consume(parser, '['))
         return set_error(error, "Expected '[' at position %zu", parser->index);
 
-    List *list = malloc(sizeof(List));
+    List *list = list_create();
     if (!list)
         return set_error(error, "Out of memory");
-    list->count = 0;
-    list->capacity = 0;
-    list->items = NULL;
 
     parser_skip_whitespace(parser);
     if (parser_consume(parser, ']'))
     {
-        out->type = VAL_LIST;
-        out->list = list;
+        *out = LIST_VAL(list);
         return true;
     }
 
     while (true)
     {
-        Value item = {.type = VAL_NULL};
+        Value item = NULL_VAL;
         if (!parse_value(parser, &item, error))
         {
             free_list(list);
@@ -556,8 +571,7 @@ static bool parse_array(JsonParser *parser, Value *out, char **error)
         parser_skip_whitespace(parser);
     }
 
-    out->type = VAL_LIST;
-    out->list = list;
+    *out = LIST_VAL(list);
     return true;
 }
 
@@ -573,14 +587,13 @@ static bool parse_object(JsonParser *parser, Value *out, char **error)
     parser_skip_whitespace(parser);
     if (parser_consume(parser, '}'))
     {
-        out->type = VAL_OBJECT;
-        out->obj = obj;
+        *out = OBJECT_VAL(obj);
         return true;
     }
 
     while (true)
     {
-        Value key_val = {.type = VAL_NULL};
+        Value key_val = NULL_VAL;
         if (!parse_string(parser, &key_val, error))
         {
             free_object(obj);
@@ -590,22 +603,23 @@ static bool parse_object(JsonParser *parser, Value *out, char **error)
         parser_skip_whitespace(parser);
         if (!parser_consume(parser, ':'))
         {
-            free(key_val.str);
+            free_value(key_val);
             free_object(obj);
             return set_error(error, "Expected ':' at position %zu", parser->index);
         }
 
         parser_skip_whitespace(parser);
-        Value val = {.type = VAL_NULL};
+        Value val = NULL_VAL;
         if (!parse_value(parser, &val, error))
         {
-            free(key_val.str);
+            free_value(key_val);
             free_object(obj);
             return false;
         }
 
-        object_set(obj, key_val.str, val);
-        free(key_val.str);
+        /* Clients choose these keys, so they must not be interned for good. */
+        object_set_key(obj, AS_STRING(key_val), string_length(AS_STRING(key_val)), val);
+        free_value(key_val);
         free_value(val);
 
         parser_skip_whitespace(parser);
@@ -619,8 +633,7 @@ static bool parse_object(JsonParser *parser, Value *out, char **error)
         parser_skip_whitespace(parser);
     }
 
-    out->type = VAL_OBJECT;
-    out->obj = obj;
+    *out = OBJECT_VAL(obj);
     return true;
 }
 
@@ -637,23 +650,21 @@ static bool parse_value(JsonParser *parser, Value *out, char **error)
     {
         if (!parse_literal(parser, "true"))
             return set_error(error, "Invalid literal at position %zu", parser->index);
-        out->type = VAL_BOOL;
-        out->boolean = true;
+        *out = BOOL_VAL(true);
         return true;
     }
     if (c == 'f')
     {
         if (!parse_literal(parser, "false"))
             return set_error(error, "Invalid literal at position %zu", parser->index);
-        out->type = VAL_BOOL;
-        out->boolean = false;
+        *out = BOOL_VAL(false);
         return true;
     }
     if (c == 'n')
     {
         if (!parse_literal(parser, "null"))
             return set_error(error, "Invalid literal at position %zu", parser->index);
-        out->type = VAL_NULL;
+        *out = NULL_VAL;
         return true;
     }
     if (c == '[')
@@ -682,7 +693,7 @@ bool json_parse_string(const char *json, Value *out_value, char **error_message)
     if (parser_peek(&parser) != '\0')
     {
         free_value(*out_value);
-        out_value->type = VAL_UNDEFINED;
+        *out_value = UNDEFINED_VAL;
         return set_error(error_message, "Unexpected trailing characters at position %zu", parser.index);
     }
 
@@ -0,0 +1,258 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "utils/region.h"
+
+/* Blocks are aligned to their size, so an address finds its block. */
+#define REGION_BLOCK_SIZE 16384
+/* Larger requests go to the heap rather than waste most of a block. */
+#define REGION_MAX_ALLOC 1024
+/* Empty blocks a region keeps across resets; the rest are freed. */
+#define REGION_SPARE_BLOCKS 8
+#define REGION_ALIGN 16
+
+typedef struct RegionBlock
+{
+    struct RegionBlock *next;
+    Region *region; // NULL once detached
+    size_t used;    // bytes from the block start, header included
+    int live;       // allocations not yet released
+} RegionBlock;
+
+#define REGION_HEADER ((sizeof(RegionBlock) + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1))
+
+struct Region
+{
+    RegionBlock *blocks; // the first one is being allocated from
+    RegionBlock *spare;
+    int spare_count;
+};
+
+Region *region_active = NULL;
+size_t region_block_count = 0;
+
+/* Every block in use, open addressing; capacity is a power of two. */
+static RegionBlock **registry = NULL;
+static size_t registry_capacity = 0;
+
+static size_t slot_of(const RegionBlock *block)
+{
+    uintptr_t key = (uintptr_t)block / REGION_BLOCK_SIZE;
+    return (size_t)(key * 0x9E3779B97F4A7C15ull) & (registry_capacity - 1);
+}
+
+static void registry_insert(RegionBlock *block)
+{
+    size_t i = slot_of(block);
+    while (registry[i])
+        i = (i + 1) & (registry_capacity - 1);
+    registry[i] = block;
+}
+
+static bool registry_add(RegionBlock *block)
+{
+    if ((region_block_count + 1) * 2 > registry_capacity)
+    {
+        RegionBlock **old = registry;
+        size_t old_capacity = registry_capacity;
+        size_t capacity = registry_capacity ? registry_capacity * 2 : 64;
+        RegionBlock **grown = calloc(capacity, sizeof(RegionBlock *));
+        if (!grown)
+            return false;
+        registry = grown;
+        registry_capacity = capacity;
+        for (size_t i = 0; i < old_capacity; ++i)
+        {
+            if (old[i])
+                registry_insert(old[i]);
+        }
+        free(old);
+    }
+    registry_insert(block);
+    region_block_count++;
+    return true;
+}
+
+static RegionBlock *registry_find(const void *ptr)
+{
+    if (region_block_count == 0)
+        return NULL;
+    RegionBlock *block = (RegionBlock *)((uintptr_t)ptr & ~(uintptr_t)(REGION_BLOCK_SIZE - 1));
+    for (size_t i = slot_of(block); registry[i]; i = (i + 1) & (registry_capacity - 1))
+    {
+        if (registry[i] == block)
+            return block;
+    }
+    return NULL;
+}
+
+static void registry_remove(RegionBlock *block)
+{
+    size_t mask = registry_capacity - 1;
+    size_t hole = slot_of(block);
+    while (registry[hole] != block)
+        hole = (hole + 1) & mask;
+    for (size_t i = (hole + 1) & mask; registry[i]; i = (i + 1) & mask)
+    {
+        size_t home = slot_of(registry[i]);
+        /* Entry i may fill the hole unless its home lies in (hole, i]. */
+        if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+            registry[hole] = registry[i];
+            hole = i;
+        }
+    }
+    registry[hole] = NULL;
+    region_block_count--;
+}
+
+static void block_free(RegionBlock *block)
+{
+    registry_remove(block);
+    free(block);
+}
+
+static RegionBlock *block_new(Region *region)
+{
+    RegionBlock *block = region->spare;
+    if (block)
+    {
+        region->spare = block->next;
+        region->spare_count--;
+    }
+    else
+    {
+        void *memory = NULL;
+        if (posix_memalign(&memory, REGION_BLOCK_SIZE, REGION_BLOCK_SIZE) != 0)
+            return NULL;
+        block = memory;
+        if (!registry_add(block))
+        {
+            free(block);
+            return NULL;
+        }
+    }
+    block->region = region;
+    block->used = REGION_HEADER;
+    block->live = 0;
+    block->next = region->blocks;
+    region->blocks = block;
+    return block;
+}
+
+Region *region_create(void)
+{
+    return calloc(1, sizeof(Region));
+}
+
+void region_destroy(Region *region)
+{
+    if (!region)
+        return;
+    if (region_active == region)
+        region_active = NULL;
+    region_reset(region);
+    while (region->spare)
+    {
+        RegionBlock *next = region->spare->next;
+        block_free(region->spare);
+        region->spare = next;
+    }
+    free(region);
+    if (region_block_count == 0)
+    {
+        free(registry);
+        registry = NULL;
+        registry_capacity = 0;
+    }
+}
+
+void region_activate(Region *region)
+{
+    region_active = region;
+}
+
+void region_reset(Region *region)
+{
+    if (!region)
+        return;
+    RegionBlock *block = region->blocks;
+    while (block)
+    {
+        RegionBlock *next = block->next;
+        if (block->live > 0)
+            block->region = NULL;
+        else if (region->spare_count < REGION_SPARE_BLOCKS)
+        {
+            block->next = region->spare;
+            region->spare = block;
+            region->spare_count++;
+        }
+        else
+            block_free(block);
+        block = next;
+    }
+    region->blocks = NULL;
+}
+
+void *region_alloc(Region *region, size_t size)
+{
+    size = (size + REGION_ALIGN - 1) & ~(size_t)(REGION_ALIGN - 1);
+    if (size > REGION_MAX_ALLOC)
+        return NULL;
+    RegionBlock *block = region->blocks;
+    if (!block || block->used + size > REGION_BLOCK_SIZE)
+    {
+        block = block_new(region);
+        if (!block)
+            return NULL;
+    }
+    void *ptr = (char *)block + block->used;
+    block->used += size;
+    block->live++;
+    return ptr;
+}
+
+bool region_release(void *ptr)
+{
+    RegionBlock *block = ptr ? registry_find(ptr) : NULL;
+    if (!block)
+        return false;
+    /* A detached block goes once its escaped allocations are gone. */
+    if (--block->live == 0 && !block->region)
+        block_free(block);
+    return true;
+}
+
+bool region_owns(const void *ptr)
+{
+    return ptr && registry_find(ptr) != NULL;
+}
+
+void *region_realloc(void *ptr, size_t used, size_t size)
+{
+    if (!ptr)
+        return region_malloc(size);
+    if (!region_owns(ptr))
+        return realloc(ptr, size);
+    void *moved = region_malloc(size);
+    if (!moved)
+        return NULL;
+    memcpy(moved, ptr, used < size ? used : size);
+    region_release(ptr);
+    return moved;
+}
+
+void *region_realloc_for(const void *owner, void *ptr, size_t used, size_t size)
+{
+    if (!ptr)
+        return region_malloc_for(owner, size);
+    if (!region_owns(ptr))
+        return realloc(ptr, size);
+    void *moved = region_malloc_for(owner, size);
+    if (!moved)
+        return NULL;
+    memcpy(moved, ptr, used < size ? used : size);
+    region_release(ptr);
+    return moved;
+}
@@ -0,0 +1,90 @@
+#ifndef REGION_H
+#define REGION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+/*
+ * Region allocator. While a region is active, region_malloc bump-allocates
+ * small blocks of memory from it instead of calling malloc; the HTTP
+ * server activates one around each request so the request object and the
+ * strings, lists and objects its handler builds cost no malloc calls.
+ *
+ * Region memory is handed out from aligned, fixed-size blocks that count
+ * their live allocations. region_free finds the block from the address and
+ * only decrements that count, so values freed one by one cost nothing and
+ * region_reset rewinds every block whose allocations have all been freed.
+ * A block still holding live allocations is detached from the region
+ * instead and freed once its last allocation is, so a value the request
+ * still references stays valid.
+ *
+ * Storage follows its owner: region_malloc_for and region_realloc_for only
+ * use the region for a list or object buffer whose list or object is
+ * region memory itself, and values stored into heap containers, globals,
+ * module state or closed-over variables are copied to the heap on the way
+ * in (value_escape in types/value.h). Memory that outlives a request
+ * therefore never pins a block, and region_reset can recycle them all.
+ *
+ * region_free and region_realloc accept heap memory as well, so code can
+ * use them whether or not a region was active when it allocated.
+ */
+
+typedef struct Region Region;
+
+/* The region region_malloc allocates from, or NULL for the heap. */
+extern Region *region_active;
+/* Blocks of any region still in use; region_free skips the lookup at 0. */
+extern size_t region_block_count;
+
+Region *region_create(void);
+void region_destroy(Region *region);
+/* Make `region` (or NULL) the one region_malloc allocates from. */
+void region_activate(Region *region);
+/* Start over, detaching blocks that still hold live allocations. */
+void region_reset(Region *region);
+
+/* Memory from `region`, or NULL if `size` is too large for a block. */
+void *region_alloc(Region *region, size_t size);
+/* Release region memory and return true, or return false for a pointer
+   that is not region memory. */
+bool region_release(void *ptr);
+bool region_owns(const void *ptr);
+/* Resize `ptr`, of which the first `used` bytes are kept. */
+void *region_realloc(void *ptr, size_t used, size_t size);
+/* region_realloc for storage belonging to `owner` (see region_malloc_for). */
+void *region_realloc_for(const void *owner, void *ptr, size_t used, size_t size);
+
+/* Memory from the active region, or NULL to allocate elsewhere. */
+static inline void *region_try_alloc(size_t size)
+{
+    return region_active ? region_alloc(region_active, size) : NULL;
+}
+
+/* Release `ptr` if it is region memory; false means it came from elsewhere. */
+static inline bool region_try_free(void *ptr)
+{
+    return region_block_count > 0 && region_release(ptr);
+}
+
+static inline void *region_malloc(size_t size)
+{
+    void *ptr = region_try_alloc(size);
+    return ptr ? ptr : malloc(size);
+}
+
+/* Memory for storage belonging to `owner`: from the active region only if
+   `owner` is region memory, so nothing the heap points at lives in a block. */
+static inline void *region_malloc_for(const void *owner, size_t size)
+{
+    void *ptr = region_active && region_owns(owner) ? region_alloc(region_active, size) : NULL;
+    return ptr ? ptr : malloc(size);
+}
+
+static inline void region_free(void *ptr)
+{
+    if (!region_try_free(ptr))
+        free(ptr);
+}
+
+#endif
@@ -0,0 +1,72 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/slab.h"
+#include "utils/utils.h"
+
+#ifdef __SANITIZE_ADDRESS__
+#include <sanitizer/asan_interface.h>
+#else
+#define ASAN_POISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#define ASAN_UNPOISON_MEMORY_REGION(addr, size) ((void)(addr), (void)(size))
+#endif
+
+#define SLAB_POISON_BYTE 0xDB
+
+void *slab_refill(Slab *slab)
+{
+    if ((size_t)(slab->limit - slab->carve) < slab->size)
+    {
+        /* The first cell of a chunk links it to the previous one. */
+        size_t bytes = slab->size * (SLAB_CHUNK_CELLS + 1);
+        char *chunk = malloc(bytes);
+        if (!chunk)
+        {
+            log_error("Out of memory while growing a slab");
+            exit(1);
+        }
+        *(void **)chunk = slab->chunks;
+        slab->chunks = chunk;
+        slab->carve = chunk + slab->size;
+        slab->limit = chunk + bytes;
+        ASAN_POISON_MEMORY_REGION(slab->carve, bytes - slab->size);
+    }
+    void *cell = slab->carve;
+    slab->carve += slab->size;
+    ASAN_UNPOISON_MEMORY_REGION(cell, slab->size);
+    return cell;
+}
+
+#if defined(SLAB_POISON) || defined(__SANITIZE_ADDRESS__)
+void *slab_alloc(Slab *slab)
+{
+    SlabCell *cell = slab->free;
+    if (!cell)
+        return slab_refill(slab);
+    ASAN_UNPOISON_MEMORY_REGION(cell, slab->size);
+#ifdef SLAB_POISON
+    const unsigned char *bytes = (const unsigned char *)cell;
+    for (size_t i = sizeof(SlabCell); i < slab->size; ++i)
+    {
+        if (bytes[i] != SLAB_POISON_BYTE)
+        {
+            log_error("Slab cell %p of %zu bytes was written after being freed", (void *)cell, slab->size);
+            abort();
+        }
+    }
+#endif
+    slab->free = cell->next;
+    return cell;
+}
+
+void slab_free(Slab *slab, void *ptr)
+{
+    SlabCell *cell = ptr;
+#ifdef SLAB_POISON
+    memset(cell, SLAB_POISON_BYTE, slab->size);
+#endif
+    cell->next = slab->free;
+    slab->free = cell;
+    ASAN_POISON_MEMORY_REGION(cell, slab->size);
+}
+#endif
@@ -0,0 +1,67 @@
+#ifndef SLAB_H
+#define SLAB_H
+
+#include <stddef.h>
+
+/*
+ * Fixed-size cell allocator for the runtime structs created and freed on
+ * every call: environments and their variables, closures, objects, lists,
+ * instances, bound methods, promises, async tasks and boxed integers.
+ * Each type owns a Slab (see SLAB_FOR). Freed cells go on the slab's free
+ * list and are handed out again first; new cells are carved from chunks
+ * of SLAB_CHUNK_CELLS, which are never returned to malloc, so a steady
+ * workload stops calling malloc once its peak is reached.
+ *
+ * Building with -DSLAB_POISON fills freed cells with a pattern that is
+ * checked when they are handed out again, which catches writes after free.
+ * Under AddressSanitizer freed cells are poisoned, so any access to one is
+ * reported as it would be for heap memory.
+ *
+ * Slabs are not thread-safe; each would need to become per-thread first.
+ */
+
+#define SLAB_CHUNK_CELLS 64
+
+typedef struct SlabCell
+{
+    struct SlabCell *next;
+} SlabCell;
+
+typedef struct Slab
+{
+    size_t size;    // bytes per cell
+    SlabCell *free; // freed cells, most recent first
+    char *carve;    // next cell never handed out, in the newest chunk
+    char *limit;
+    void *chunks; // every chunk, linked through its first cell
+} Slab;
+
+/* A static initializer for the slab of `type`. */
+#define SLAB_FOR(type) \
+    {.size = (sizeof(type) + sizeof(SlabCell) - 1) / sizeof(SlabCell) * sizeof(SlabCell)}
+
+/* Carve a cell from a new or partly used chunk; exits when out of memory. */
+void *slab_refill(Slab *slab);
+
+#if defined(SLAB_POISON) || defined(__SANITIZE_ADDRESS__)
+void *slab_alloc(Slab *slab);
+void slab_free(Slab *slab, void *ptr);
+#else
+static inline void *slab_alloc(Slab *slab)
+{
+    SlabCell *cell = slab->free;
+    if (!cell)
+        return slab_refill(slab);
+    slab->free = cell->next;
+    return cell;
+}
+
+static inline void slab_free(Slab *slab, void *ptr)
+{
+    SlabCell *cell = ptr;
+    cell->next = slab->free;
+    slab->free = cell;
+}
+#endif
+
+#endif
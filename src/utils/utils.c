@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdlib.h>
+#include <string.h>
 #include "utils.h"
 
 void log_info(const char *fmt, ...)
@@ -70,3 +71,22 @@ char *read_file(const char *filename)
     fclose(file);
     return buffer;
 }
+
+uint32_t hash_bytes(const char *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+    {
+        hash ^= (uint8_t)data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+bool env_flag(const char *name, bool fallback)
+{
+    const char *value = getenv(name);
+    if (!value || !*value)
+        return fallback;
+    return strcmp(value, "0") != 0;
+}
@@ -1,10 +1,18 @@
 #ifndef UTILS_H
 #define UTILS_H
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
 void log_info(const char *fmt, ...);
 void log_error(const char *fmt, ...);
 void log_script_error(int line, int column, const char *fmt, ...);
 void log_debug(const char *fmt, ...);
 char *read_file(const char *filename);
+uint32_t hash_bytes(const char *data, size_t length); // FNV-1a
+/* Environment variable `name` as a switch: unset or empty gives
+   `fallback`, "0" false, anything else true. */
+bool env_flag(const char *name, bool fallback);
 
 #endif
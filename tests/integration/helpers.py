@@ -1,10 +1,56 @@
+import http.client
 import os
+import socket
 import subprocess
+import time
 from pathlib import Path
 import unittest
 
 EXE = Path('build/able_exe')
 
+class ServerProcess:
+    """A script serving HTTP on 127.0.0.1. It reads the port from the first
+    line of its stdin, followed by `lines`."""
+
+    def __init__(self, path, lines=(), extra_env=None, preexec_fn=None):
+        with socket.socket() as sock:
+            sock.bind(('127.0.0.1', 0))
+            self.port = sock.getsockname()[1]
+        env = os.environ.copy()
+        env.update(extra_env or {})
+        self.process = subprocess.Popen([str(EXE), path], stdin=subprocess.PIPE, stdout=subprocess.PIPE,
+                                        stderr=subprocess.PIPE, text=True, env=env, preexec_fn=preexec_fn)
+        self.process.stdin.write(''.join(f'{line}\n' for line in [self.port, *lines]))
+        self.process.stdin.flush()
+
+    def get(self, path):
+        """(status, body) of GET `path`, waiting for the server to start."""
+        for _ in range(100):
+            connection = http.client.HTTPConnection('127.0.0.1', self.port, timeout=10)
+            try:
+                connection.request('GET', path)
+                response = connection.getresponse()
+                return response.status, response.read().decode()
+            except ConnectionRefusedError:
+                if self.process.poll() is not None:
+                    raise RuntimeError(self.process.stderr.read())
+                time.sleep(0.05)
+            finally:
+                connection.close()
+        raise RuntimeError('Server did not start')
+
+    def rss(self):
+        """Resident memory of the server in KiB."""
+        with open(f'/proc/{self.process.pid}/status') as status:
+            for line in status:
+                if line.startswith('VmRSS:'):
+                    return int(line.split()[1])
+        raise RuntimeError('No VmRSS in /proc status')
+
+    def close(self):
+        self.process.kill()
+        self.process.communicate()
+
 class AbleTestCase(unittest.TestCase):
     @classmethod
     def setUpClass(cls):
@@ -12,8 +58,16 @@ class AbleTestCase(unittest.TestCase):
         if not EXE.exists():
             raise RuntimeError('Executable not built')
 
-    def run_script(self, path: str) -> str:
+    def start_server(self, path: str, lines=(), extra_env: dict = None, preexec_fn=None) -> ServerProcess:
+        server = ServerProcess(path, lines, extra_env, preexec_fn)
+        self.addCleanup(server.close)
+        return server
+
+    def run_script(self, path: str, extra_env: dict = None) -> str:
+        return self.run_script_full(path, extra_env).stdout
+
+    def run_script_full(self, path: str, extra_env: dict = None) -> subprocess.CompletedProcess:
         env = os.environ.copy()
         env.setdefault('ABLE_HTTP_FIXTURES', '1')
-        result = subprocess.run([str(EXE), path], check=True, capture_output=True, text=True, env=env)
-        return result.stdout
+        env.update(extra_env or {})
+        return subprocess.run([str(EXE), path], check=True, capture_output=True, text=True, env=env)
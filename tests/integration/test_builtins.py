@@ -1,10 +1,68 @@
+import resource
+import subprocess
 import unittest
-from tests.integration.helpers import AbleTestCase
+from tests.integration.helpers import AbleTestCase, EXE
 
 class BuiltinTests(AbleTestCase):
     def test_abs_builtin(self):
         output = self.run_script('examples/builtins/abs_example.abl')
         self.assertEqual(output, '5\n')
 
+    def test_builtins_are_values(self):
+        output = self.run_script('examples/builtins/native_values.abl')
+        self.assertEqual(output, '3\n5!\nFUNCTION\n')
+
+    def test_strings_keep_embedded_nul_bytes(self):
+        output = self.run_script('examples/builtins/binary_strings.abl')
+        self.assertEqual(output, '3\n"a\\u0000b"\nfalse\ntrue\n')
+
+    def test_integers_stay_exact(self):
+        output = self.run_script('examples/builtins/integers.abl')
+        self.assertEqual(output, (
+            '{"id":9223372036854775807,"uid":9007199254740993,"neg":-42,'
+            '"huge":1.23456789012346e+19,"ratio":0.5}\n'
+            '9007199254740995\n9223372036854775806\n9007199254740993000\n'
+            '2\n3.500000\n4\n123456789012345677\n4999950000\n'
+            'false\ntrue\ntrue\n[-0,0]\n'
+        ))
+
+    def test_nan_payloads_are_canonical(self):
+        output = self.run_script('examples/builtins/nan_payloads.abl')
+        self.assertEqual(output, 'nan\nfalse\nnan\nnan\n[nan, nan]\n')
+
+    def test_ranges_and_slices(self):
+        output = self.run_script('examples/builtins/ranges_slices.abl')
+        self.assertEqual(output, (
+            '499999500000\n[0, 1, 2, 3, 4]\n524\n[1, 2]\n[0, 1, 2, 3, 4, 5]\n'
+            '[30, 40, 50]\n[20, 30, 40, 50]\n[30, 40, 50, 60]\n40\n[[1], [2]]\n[[2]]\n'
+        ))
+
+    def test_range_loop_runs_in_constant_memory(self):
+        # Ten million materialized items would need 80MB on their own.
+        def limit_memory():
+            resource.setrlimit(resource.RLIMIT_AS, (48 << 20, 48 << 20))
+        result = subprocess.run([str(EXE), 'examples/builtins/range_loop.abl'], capture_output=True,
+                                text=True, preexec_fn=limit_memory)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, '49999995000000\n')
+
+    def test_wide_int_loop_runs_in_constant_memory(self):
+        # Every sum is boxed; three million cells kept alive would need
+        # well over 48MB.
+        def limit_memory():
+            resource.setrlimit(resource.RLIMIT_AS, (48 << 20, 48 << 20))
+        result = subprocess.run([str(EXE), 'examples/builtins/wide_int_loop.abl'], capture_output=True,
+                                text=True, preexec_fn=limit_memory)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, '9007199257740992\n9007199257740993\n')
+
+    def test_parsed_json_keys_are_not_kept(self):
+        def limit_memory():
+            resource.setrlimit(resource.RLIMIT_AS, (48 << 20, 48 << 20))
+        result = subprocess.run([str(EXE), 'examples/builtins/json_keys_loop.abl'], capture_output=True,
+                                text=True, preexec_fn=limit_memory)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, '1000000{"key999999":1}\n')
+
 if __name__ == '__main__':
     unittest.main()
@@ -15,5 +15,13 @@ class ClassTests(AbleTestCase):
         output = self.run_script('examples/oop/static_method.abl')
         self.assertEqual(output, '5\n')
 
+    def test_method_lookup_follows_redefinition(self):
+        output = self.run_script('examples/oop/method_cache.abl')
+        self.assertEqual(output, 'woof\nmeow\n...\nwoof\nmeow\nwoof\nshh\n...\nwoof\nshh\n1\n2\n3\n4\n5\n6\n')
+
+    def test_bound_methods_keep_receiver_alive(self):
+        output = self.run_script('examples/oop/bound_method.abl')
+        self.assertEqual(output, '11\n12\n1\n2\n')
+
 if __name__ == '__main__':
     unittest.main()
@@ -1,6 +1,10 @@
+import resource
+import subprocess
+import tempfile
 import unittest
+from pathlib import Path
 
-from tests.integration.helpers import AbleTestCase
+from tests.integration.helpers import AbleTestCase, EXE
 
 EXAMPLES = {
     'examples/variables/basic_assignment.abl': 'Daniel22\n\n',
@@ -8,6 +12,12 @@ EXAMPLES = {
     'examples/variables/simple_print.abl': 'Hello World!\n',
     'examples/objects/object_literal.abl': 'First name:Hof\n\n',
     'examples/objects/object_literal_shorthand.abl': '22\n',
+    'examples/objects/shapes.abl': 'undefined\n5\n{\n  y: 6,\n  x: 7\n}\n\n322\n',
+    'examples/objects/large_object.abl': (
+        '201819undefined19\n2120\n0161718\n'
+        '{"a":0,"b":2,"c":3,"d":4,"e":5,"f":6,"g":7,"h":8,"i":9,"j":10,'
+        '"k":11,"l":12,"m":13,"n":14,"o":15,"p":16,"q":17,"r":18}\n'
+    ),
     'examples/functions/return_example.abl': 'test\n',
     'examples/functions/assign_from_return.abl': 'hello\n',
     'examples/variables/bool.abl': 'true\nfalse\n',
@@ -15,6 +25,11 @@ EXAMPLES = {
     'examples/functions/greet.abl': 'AliceWonderland\n',
     'examples/functions/choose_first.abl': 'x\n',
     'examples/functions/fib_recursion.abl': '8\n',
+    'examples/functions/deep_recursion.abl': '20000\n',
+    'examples/functions/tail_calls.abl': '1000000\nfalse\ndone\n',
+    'examples/functions/closure_capture.abl': '12\n',
+    'examples/functions/closure_counter.abl': '1\n2\n1\n',
+    'examples/functions/optimizer.abl': 'hello world\n3\n20.500000\napple\ntrue\n0\n',
     'examples/variables/math.abl': '5\nHello World\n1\n',
     'examples/variables/equality.abl': 'true\ntrue\nfalse\ntrue\n',
     'examples/variables/bool_func.abl': 'false\ntrue\nfalse\n',
@@ -32,6 +47,11 @@ EXAMPLES = {
     'examples/types/function_type.abl': 'FUNCTION\n',
     'examples/variables/list_ops.abl': '1\n2\n3\n',
     'examples/variables/list_indexing.abl': '10\n[20, 30, 40, 50]\n[10, 20, 30]\n50\n',
+    'examples/variables/value_semantics.abl': (
+        '[1, 2]\n[1, 2, 3]\n[1, 2]\n[1, 2, 99]\n[[1], [2]]\n'
+        'Ada[x]\nBob[x, y]\na\nb\n[1, 2, 1, 2]\n'
+    ),
+    'examples/variables/reassign_during_call.abl': '[1, 2, 3]5\nAda!5\nAda5\n[a, b]5\n0\n',
     'examples/control/for_loop.abl': '1\n2\n3\n',
     'examples/control/for_number.abl': '0\n1\n2\n3\n4\n',
     'examples/control/while_loop.abl': '0\n1\n2\n',
@@ -39,8 +59,18 @@ EXAMPLES = {
     'examples/variables/increment.abl': '0\n1\n',
     'examples/variables/logical_ops.abl': 'false\ntrue\ntrue\n',
     'examples/variables/ternary.abl': 'yes\nno\n',
+    'examples/variables/polymorphic_ops.abl': (
+        '5\n1\nabcd\n2.500000\n15\n[1, 2]\n'
+        'true\nfalse\ntrue\nfalse\n1000000000000000000\ntrue\n'
+    ),
 }
 
+HOT_LOOPS = 'examples/functions/hot_loops.abl'
+HOT_LOOPS_OUTPUT = (
+    '1331333\n1331333\n1331333\n3372750\n1.500000\n1000000000000000\n-1499\nyes\n[1, 2]\n'
+    '4495\n-0\n-0\n-1\n'
+)
+
 class ExampleTests(AbleTestCase):
     def run_example(self, path):
         return self.run_script(path)
@@ -51,9 +81,56 @@ class ExampleTests(AbleTestCase):
                 output = self.run_example(file)
                 self.assertEqual(output, expected)
 
+    def test_hot_functions_match_interpreter(self):
+        for flag in ('0', '1'):
+            with self.subTest(jit=flag):
+                result = self.run_script_full(HOT_LOOPS, {'ABLE_JIT': flag, 'ABLE_JIT_STATS': '1'})
+                self.assertEqual(result.stdout, HOT_LOOPS_OUTPUT)
+                self.assertRegex(result.stderr, r'^jit: (on|off), \d+ compiled')
+
+    def test_closure_cycles_are_collected(self):
+        # Each iteration strands a closure and two instances that reach
+        # each other; kept alive they would need well over 100MB.
+        def limit_memory():
+            resource.setrlimit(resource.RLIMIT_AS, (48 << 20, 48 << 20))
+        result = subprocess.run([str(EXE), 'examples/functions/closure_churn.abl'], capture_output=True,
+                                text=True, preexec_fn=limit_memory, env={'ABLE_GC_STATS': '1'})
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, '45000150000\n')
+        self.assertRegex(result.stderr, r'^gc: [1-9]\d* collections')
+
+    def test_many_distinct_keys_stay_linear(self):
+        # A linear scan over the empty shape's children made this loop take
+        # minutes; it needs well under a second.
+        def limit_cpu():
+            resource.setrlimit(resource.RLIMIT_CPU, (10, 10))
+        result = subprocess.run([str(EXE), 'examples/objects/many_keys.abl'], capture_output=True,
+                                text=True, preexec_fn=limit_cpu)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        self.assertEqual(result.stdout, '100000{"k99999":99999}\n2{"k99999":99999,"extra":2}\n31\n')
+
     def test_function_print(self):
         output = self.run_example('examples/functions/print_function.abl')
         self.assertRegex(output, r'^<function: greet at 0x[0-9a-fA-F]+>\n$')
 
+    def test_bundle_matches_interpreter(self):
+        examples = dict(EXAMPLES)
+        examples[HOT_LOOPS] = HOT_LOOPS_OUTPUT
+        examples['examples/modules/import_class.abl'] = 'Hi Alice\n'
+        with tempfile.TemporaryDirectory() as tmp:
+            source = Path(tmp) / 'program.c'
+            program = Path(tmp) / 'program'
+            for file, expected in examples.items():
+                with self.subTest(example=file):
+                    emitted = subprocess.run([str(EXE), '--bundle', file], check=True,
+                                             capture_output=True, text=True)
+                    source.write_text(emitted.stdout)
+                    subprocess.run(['gcc', '-std=c99', '-O2', '-D_GNU_SOURCE', '-Isrc', '-Ivendor',
+                                    str(source), 'build/libable.a', '-lm', '-o', str(program)], check=True)
+                    # Run elsewhere: the program must not need the source tree.
+                    result = subprocess.run([str(program)], check=True, capture_output=True,
+                                            text=True, cwd=tmp)
+                    self.assertEqual(result.stdout, expected)
+
 if __name__ == '__main__':
     unittest.main()
@@ -0,0 +1,45 @@
+import json
+import resource
+import unittest
+from tests.integration.helpers import AbleTestCase
+
+REQUESTS = 600
+
+class ServerGcTests(AbleTestCase):
+    def churn(self, gc_config, extra_env=None):
+        # Each request strands 200 closures and instance cycles; kept alive,
+        # this many requests would need well over 48MB.
+        def limit_memory():
+            resource.setrlimit(resource.RLIMIT_AS, (48 << 20, 48 << 20))
+        server = self.start_server('examples/server/gc_churn.abl', [json.dumps(gc_config)], extra_env,
+                                   limit_memory)
+        for served in range(1, REQUESTS + 1):
+            status, body = server.get('/churn')
+            self.assertEqual(status, 200)
+            self.assertEqual(json.loads(body), {'total': 20100, 'served': served, 'kept': served * 10})
+        status, body = server.get('/stats')
+        self.assertEqual(status, 200)
+        return json.loads(body)
+
+    def assert_incremental(self, stats):
+        # Young objects went in minor collections, and the kept ones grew
+        # the old generation enough for stepped marking cycles.
+        self.assertGreater(stats['minor_collections'], 0)
+        self.assertGreater(stats['marking_steps'], 1)
+        self.assertGreaterEqual(stats['collections'], 2)
+
+    def test_incremental_mode_from_config(self):
+        self.assert_incremental(self.churn({'mode': 'incremental', 'step': 32, 'young': 64}))
+
+    def test_incremental_mode_from_environment(self):
+        env = {'ABLE_GC_MODE': 'incremental', 'ABLE_GC_STEP': '32', 'ABLE_GC_YOUNG': '64'}
+        self.assert_incremental(self.churn({}, env))
+
+    def test_full_mode_from_config(self):
+        stats = self.churn({'mode': 'full'}, {'ABLE_GC_MODE': 'incremental'})
+        self.assertGreater(stats['collections'], 0)
+        self.assertEqual(stats['minor_collections'], 0)
+        self.assertEqual(stats['marking_steps'], 0)
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,46 @@
+import json
+import unittest
+from tests.integration.helpers import AbleTestCase
+
+class ServerRegionTests(AbleTestCase):
+    def exercise(self, extra_env=None):
+        server = self.start_server('examples/server/region_escape.abl', extra_env=extra_env)
+        names = []
+        for name in ['ada', 'grace']:
+            status, body = server.get(f'/store?{name}')
+            self.assertEqual((status, json.loads(body)), (200, {'stored': name}))
+            # Plain requests reuse the region's blocks for their garbage.
+            for _ in range(3):
+                status, body = server.get('/plain')
+                self.assertEqual((status, json.loads(body)), (200, {'plain': 2000, 'last': '/plain-1999'}))
+            status, body = server.get('/read')
+            self.assertEqual(status, 200)
+            kept = json.loads(body)
+            names += [f'{name}?', 'read']
+            self.assertEqual(kept['string'], f'{name}!')
+            self.assertEqual(kept['list'], [name, '/store'])
+            self.assertEqual(kept['object']['query'], name)
+            self.assertEqual(kept['object']['headers']['host'], f'127.0.0.1:{server.port}')
+            self.assertEqual(kept['names'], names)
+
+    def test_escaped_values_outlive_their_request(self):
+        self.exercise()
+
+    def test_escaped_values_without_region(self):
+        self.exercise({'ABLE_REGION': '0'})
+
+    def test_kept_values_do_not_pin_region_blocks(self):
+        # Each request keeps one small string; were it left in its region
+        # block, every request would hold on to another 16 KiB.
+        server = self.start_server('examples/server/region_escape.abl')
+        for kept in range(1, 2001):
+            if kept == 201:
+                before = server.rss()
+            status, body = server.get(f'/keep?q{kept}')
+            self.assertEqual((status, json.loads(body)), (200, {'kept': kept}))
+        self.assertLess(server.rss() - before, 4 << 10)
+        status, body = server.get('/read')
+        self.assertEqual(json.loads(body)['names'][-2:], ['q2000', 'read'])
+
+if __name__ == '__main__':
+    unittest.main()
@@ -11,6 +11,10 @@ TYPE_EXAMPLES = {
     'examples/types/object_type.abl': 'OBJECT\n',
     'examples/types/function_type.abl': 'FUNCTION\n',
     'examples/types/list_type.abl': 'LIST\n',
+    'examples/types/boxed_values.abl': (
+        'NUMBER\nSTRING\nBOOLEAN\nNULL\nNUMBER\nNUMBER\nOBJECT\nINSTANCE\n'
+        'TYPE\nBOUND_METHOD\nFUNCTION\n-3\n0.250000\ntruetruetrue\n'
+    ),
 }
 
 class TypeTests(AbleTestCase):